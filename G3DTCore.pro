@@ -12,6 +12,9 @@ CONFIG += c++11
 SOURCES += \
     Geometry/box2d.cpp \
     Geometry/box3dt.cpp \
+    Geometry/geometrybinary.cpp \
+    Geometry/geometryjsonreader.cpp \
+    Geometry/geometryjsonwriter.cpp \
     Geometry/index2d.cpp \
     Geometry/index3d.cpp \
     Geometry/index3dt.cpp \
@@ -22,12 +25,40 @@ SOURCES += \
     Geometry/rastersize2d.cpp \
     Geometry/rastersize3d.cpp \
     Geometry/rastersize3dt.cpp \
+    Raster/brickcache.cpp \
+    Raster/brickcodec.cpp \
+    Raster/brickgrid.cpp \
+    Raster/brickprefetcher.cpp \
+    Raster/brickstore.cpp \
+    Raster/envifile.cpp \
+    Raster/isosurface.cpp \
+    Raster/lasreader.cpp \
+    Raster/mapalgebra.cpp \
+    Raster/pointbinner.cpp \
+    Raster/rastercell.cpp \
+    Raster/rasterconvert.cpp \
+    Raster/rasterfile.cpp \
+    Raster/rasterstream.cpp \
+    Raster/rasterview.cpp \
+    Raster/tickstore.cpp \
+    Raster/voxelfilter.cpp \
+    g3dtcanceltoken.cpp \
+    g3dtcheckpoint.cpp \
+    g3dtexecutor.cpp \
+    g3dtmetrics.cpp \
+    g3dtnuma.cpp \
+    g3dtparallel.cpp \
+    g3dtpipeline.cpp \
+    g3dtprogress.cpp \
     g3dtworker.cpp
 
 HEADERS += \
     Geometry/box2d.h \
     Geometry/box3dt.h \
     Geometry/geometry.h \
+    Geometry/geometrybinary.h \
+    Geometry/geometryjsonreader.h \
+    Geometry/geometryjsonwriter.h \
     Geometry/index2d.h \
     Geometry/index3d.h \
     Geometry/index3dt.h \
@@ -38,8 +69,34 @@ HEADERS += \
     Geometry/rastersize2d.h \
     Geometry/rastersize3d.h \
     Geometry/rastersize3dt.h \
+    Raster/brickcache.h \
+    Raster/brickcodec.h \
+    Raster/brickgrid.h \
+    Raster/brickprefetcher.h \
+    Raster/brickstore.h \
+    Raster/envifile.h \
+    Raster/isosurface.h \
+    Raster/lasreader.h \
+    Raster/mapalgebra.h \
+    Raster/pointbinner.h \
+    Raster/raster.h \
+    Raster/rastercell.h \
+    Raster/rasterconvert.h \
+    Raster/rasterfile.h \
+    Raster/rasterstream.h \
+    Raster/rasterview.h \
+    Raster/tickstore.h \
+    Raster/voxelfilter.h \
+    g3dtcanceltoken.h \
+    g3dtcheckpoint.h \
     g3dtcore.h \
     g3dtcore_global.h \
+    g3dtexecutor.h \
+    g3dtmetrics.h \
+    g3dtnuma.h \
+    g3dtparallel.h \
+    g3dtpipeline.h \
+    g3dtprogress.h \
     g3dtworker.h
 
 # Default rules for deployment.
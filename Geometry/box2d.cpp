@@ -12,6 +12,7 @@
  */
 
 #include "box2d.h"
+#include "geometrybinary.h"
 
 
 /*!
@@ -305,3 +306,25 @@ bool Box2D::fromJson(QJsonValue jsonVal)
     p1.fromJson(jsonVal["p1"]);
     return true;
 }
+
+
+/*!
+ * \brief Writes the 2D box to a little-endian binary record of binarySize bytes.
+ * \param buffer Output buffer.
+ */
+void Box2D::toBinary(uchar *buffer)
+{
+    p0.Point2D::toBinary(buffer);
+    p1.Point2D::toBinary(buffer + 16);
+}
+
+
+/*!
+ * \brief Reads the 2D box from a binary record written by toBinary().
+ * \param buffer Input buffer.
+ */
+void Box2D::fromBinary(const uchar *buffer)
+{
+    p0.Point2D::fromBinary(buffer);
+    p1.Point2D::fromBinary(buffer + 16);
+}
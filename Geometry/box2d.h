@@ -58,6 +58,11 @@ public:
 
     QJsonObject toJson();
     bool fromJson(QJsonValue jsonVal);
+
+    void toBinary(uchar *buffer);
+    void fromBinary(const uchar *buffer);
+
+    static const int binarySize = 32; //!< size of the binary record in bytes
 };
 
 #endif // BOX2D_H
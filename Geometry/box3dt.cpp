@@ -13,6 +13,7 @@
 
 #include <math.h>
 #include "box3dt.h"
+#include "geometrybinary.h"
 
 
 /*!
@@ -551,3 +552,25 @@ bool Box3DT::fromJson(QJsonValue jsonVal)
     p1.fromJson(jsonVal["p1"]);
     return true;
 }
+
+
+/*!
+ * \brief Writes the 3DT box to a little-endian binary record of binarySize bytes.
+ * \param buffer Output buffer.
+ */
+void Box3DT::toBinary(uchar *buffer)
+{
+    p0.Point3DT::toBinary(buffer);
+    p1.Point3DT::toBinary(buffer + 32);
+}
+
+
+/*!
+ * \brief Reads the 3DT box from a binary record written by toBinary().
+ * \param buffer Input buffer.
+ */
+void Box3DT::fromBinary(const uchar *buffer)
+{
+    p0.Point3DT::fromBinary(buffer);
+    p1.Point3DT::fromBinary(buffer + 32);
+}
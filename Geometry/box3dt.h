@@ -34,6 +34,11 @@ public:
     QJsonObject toJson();
     bool fromJson(QJsonValue jsonVal);
 
+    void toBinary(uchar *buffer);
+    void fromBinary(const uchar *buffer);
+
+    static const int binarySize = 64; //!< size of the binary record in bytes
+
     void set(Point3DT *point);
     void set(Box3DT *box);
     void set(double x0, double y0, double z0, double t0, double x1, double y1, double z1, double t1);
@@ -16,6 +16,9 @@
 
 #include "box2d.h"
 #include "box3dt.h"
+#include "geometrybinary.h"
+#include "geometryjsonreader.h"
+#include "geometryjsonwriter.h"
 #include "index2d.h"
 #include "index3d.h"
 #include "index3dt.h"
@@ -0,0 +1,60 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file geometrybinary.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include "geometrybinary.h"
+
+
+/*!
+ * \brief Array signature.
+ */
+static const char geometryBinaryMagic[8] = {'G', '3', 'D', 'T', 'G', 'E', 'O', 'B'};
+
+
+/*!
+ * \brief Writes an array header.
+ * \param buffer Output buffer of headerSize bytes.
+ * \param type Item type.
+ * \param nItems Number of items.
+ * \return Always true.
+ */
+bool GeometryBinary::writeHeader(uchar *buffer, Type type, qint64 nItems)
+{
+    memcpy(buffer, geometryBinaryMagic, sizeof(geometryBinaryMagic));
+    qToLittleEndian<quint32>(version, buffer + 8);
+    qToLittleEndian<quint32>(quint32(type), buffer + 12);
+    putInt64(buffer + 16, nItems);
+    return true;
+}
+
+
+/*!
+ * \brief Reads and validates an array header.
+ * \param buffer Encoded array.
+ * \param size Size of the buffer in bytes.
+ * \param type Expected item type.
+ * \param recordSize Record size used to check that all records are present, 0 to check the header only.
+ * \return Number of items, or -1 if the header is not valid.
+ */
+qint64 GeometryBinary::readHeader(const uchar *buffer, qint64 size, Type type, qint64 recordSize)
+{
+    qint64 nItems;
+
+    if (size < headerSize) return -1;
+    if (memcmp(buffer, geometryBinaryMagic, sizeof(geometryBinaryMagic)) != 0) return -1;
+    if (qFromLittleEndian<quint32>(buffer + 8) != version) return -1;
+    if (qFromLittleEndian<quint32>(buffer + 12) != quint32(type)) return -1;
+    nItems = getInt64(buffer + 16);
+    if (nItems < 0) return -1;
+    if ((0 < recordSize) && ((size - headerSize) / recordSize < nItems)) return -1;
+    return nItems;
+}
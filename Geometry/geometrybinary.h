@@ -0,0 +1,314 @@
+#ifndef GEOMETRYBINARY_H
+#define GEOMETRYBINARY_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file geometrybinary.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <string.h>
+#include <limits>
+#include <type_traits>
+#include <vector>
+#include <QByteArray>
+#include <QIODevice>
+#include <QtEndian>
+#include "g3dtcore_global.h"
+#include "box2d.h"
+#include "box3dt.h"
+#include "index2d.h"
+#include "index3d.h"
+#include "index3dt.h"
+#include "point2d.h"
+#include "point3d.h"
+#include "point3dt.h"
+#include "rasterblock.h"
+#include "rastersize2d.h"
+#include "rastersize3d.h"
+#include "rastersize3dt.h"
+
+
+/*!
+ * \brief The GeometryBinary encodes geometry objects and arrays in a compact little-endian binary format.
+ *
+ *        An encoded array starts with a 24-byte header (magic "G3DTGEOB", format version, type identifier
+ *        and number of items) followed by fixed-size records. Every geometry class writes its record by
+ *        toBinary() and reads it by fromBinary(); the record size is the class constant binarySize.
+ *        Coordinates are stored as IEEE doubles and indexes as 64-bit integers, so values round-trip exactly.
+ *
+ *        Arrays of trivially copyable types whose memory layout equals the record (RasterBlock) are copied
+ *        with a single memcpy on little-endian hosts.
+ */
+class G3DTCORE_EXPORT GeometryBinary
+{
+public:
+    enum Type
+    {
+        UndefinedType = 0,
+        Point2DType = 1,
+        Point3DType = 2,
+        Point3DTType = 3,
+        Box2DType = 4,
+        Box3DTType = 5,
+        Index2DType = 6,
+        Index3DType = 7,
+        Index3DTType = 8,
+        RasterSize2DType = 9,
+        RasterSize3DType = 10,
+        RasterSize3DTType = 11,
+        RasterBlockType = 12
+    };
+
+    static const quint32 version = 1; //!< format version
+    static const qint64 headerSize = 24; //!< size of the array header in bytes
+
+    static void putInt64(uchar *buffer, qint64 value) { qToLittleEndian<qint64>(value, buffer); }
+    static qint64 getInt64(const uchar *buffer) { return qFromLittleEndian<qint64>(buffer); }
+    static void putDouble(uchar *buffer, double value)
+    {
+        quint64 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        qToLittleEndian<quint64>(bits, buffer);
+    }
+    static double getDouble(const uchar *buffer)
+    {
+        quint64 bits = qFromLittleEndian<quint64>(buffer);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    template <class T> static Type getType();
+    template <class T> static qint64 getEncodedSize(qint64 nItems);
+    template <class T> static qint64 encode(T *items, qint64 nItems, uchar *buffer);
+    template <class T> static QByteArray encode(T *items, qint64 nItems);
+    template <class T> static bool decode(const uchar *buffer, qint64 size, std::vector<T> *items);
+    template <class T> static bool decode(const QByteArray &buffer, std::vector<T> *items);
+    template <class T> static bool decode(const QByteArray &buffer, T *item);
+    template <class T> static bool write(QIODevice *device, T *items, qint64 nItems);
+    template <class T> static bool read(QIODevice *device, std::vector<T> *items);
+
+    static bool writeHeader(uchar *buffer, Type type, qint64 nItems);
+    static qint64 readHeader(const uchar *buffer, qint64 size, Type type, qint64 recordSize);
+
+private:
+    template <class T> static bool isMemoryLayout();
+    template <class T> static bool isValidCount(qint64 nItems);
+    template <class T> static void encodeRecords(T *items, qint64 nItems, uchar *buffer);
+    template <class T> static void decodeRecords(const uchar *buffer, qint64 nItems, T *items);
+};
+
+
+template <> inline GeometryBinary::Type GeometryBinary::getType<Point2D>() { return Point2DType; }
+template <> inline GeometryBinary::Type GeometryBinary::getType<Point3D>() { return Point3DType; }
+template <> inline GeometryBinary::Type GeometryBinary::getType<Point3DT>() { return Point3DTType; }
+template <> inline GeometryBinary::Type GeometryBinary::getType<Box2D>() { return Box2DType; }
+template <> inline GeometryBinary::Type GeometryBinary::getType<Box3DT>() { return Box3DTType; }
+template <> inline GeometryBinary::Type GeometryBinary::getType<Index2D>() { return Index2DType; }
+template <> inline GeometryBinary::Type GeometryBinary::getType<Index3D>() { return Index3DType; }
+template <> inline GeometryBinary::Type GeometryBinary::getType<Index3DT>() { return Index3DTType; }
+template <> inline GeometryBinary::Type GeometryBinary::getType<RasterSize2D>() { return RasterSize2DType; }
+template <> inline GeometryBinary::Type GeometryBinary::getType<RasterSize3D>() { return RasterSize3DType; }
+template <> inline GeometryBinary::Type GeometryBinary::getType<RasterSize3DT>() { return RasterSize3DTType; }
+template <> inline GeometryBinary::Type GeometryBinary::getType<RasterBlock>() { return RasterBlockType; }
+
+
+/*!
+ * \brief Tests whether items of a type can be copied to and from records with memcpy.
+ */
+template <class T>
+bool GeometryBinary::isMemoryLayout()
+{
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    return std::is_trivially_copyable<T>::value && (sizeof(T) == T::binarySize);
+#else
+    return false;
+#endif
+}
+
+
+/*!
+ * \brief Tests whether an array of nItems items fits into memory and qint64 byte counts, so that a corrupt
+ *        header cannot overflow size arithmetic.
+ */
+template <class T>
+bool GeometryBinary::isValidCount(qint64 nItems)
+{
+    return (0 <= nItems) && (nItems <= (std::numeric_limits<qint64>::max() - headerSize) / T::binarySize) &&
+           (quint64(nItems) <= quint64(std::numeric_limits<ptrdiff_t>::max()) / sizeof(T));
+}
+
+
+template <class T>
+void GeometryBinary::encodeRecords(T *items, qint64 nItems, uchar *buffer)
+{
+    if (isMemoryLayout<T>())
+    {
+        memcpy(buffer, items, size_t(nItems * T::binarySize));
+        return;
+    }
+    for (qint64 i = 0; i < nItems; i++)
+        items[i].T::toBinary(buffer + i * T::binarySize);
+}
+
+
+template <class T>
+void GeometryBinary::decodeRecords(const uchar *buffer, qint64 nItems, T *items)
+{
+    if (isMemoryLayout<T>())
+    {
+        memcpy(static_cast<void *>(items), buffer, size_t(nItems * T::binarySize));
+        return;
+    }
+    for (qint64 i = 0; i < nItems; i++)
+        items[i].T::fromBinary(buffer + i * T::binarySize);
+}
+
+
+/*!
+ * \return Size of an encoded array in bytes.
+ */
+template <class T>
+qint64 GeometryBinary::getEncodedSize(qint64 nItems)
+{
+    return headerSize + nItems * T::binarySize;
+}
+
+
+/*!
+ * \brief Encodes an array into a buffer of getEncodedSize<T>(nItems) bytes.
+ * \return Number of bytes written.
+ */
+template <class T>
+qint64 GeometryBinary::encode(T *items, qint64 nItems, uchar *buffer)
+{
+    writeHeader(buffer, getType<T>(), nItems);
+    encodeRecords<T>(items, nItems, buffer + headerSize);
+    return getEncodedSize<T>(nItems);
+}
+
+
+/*!
+ * \brief Encodes an array, or a single object if nItems is 1.
+ *        Larger arrays than a QByteArray can hold should be written to a device by write().
+ * \return Encoded bytes, empty if the encoded array would exceed the QByteArray size limit.
+ */
+template <class T>
+QByteArray GeometryBinary::encode(T *items, qint64 nItems)
+{
+    if (!isValidCount<T>(nItems) || (qint64(std::numeric_limits<int>::max()) < getEncodedSize<T>(nItems))) return QByteArray();
+
+    QByteArray buffer(int(getEncodedSize<T>(nItems)), Qt::Uninitialized);
+    encode<T>(items, nItems, reinterpret_cast<uchar *>(buffer.data()));
+    return buffer;
+}
+
+
+/*!
+ * \brief Decodes an array.
+ * \return True, if the buffer holds a complete array of the type.
+ */
+template <class T>
+bool GeometryBinary::decode(const uchar *buffer, qint64 size, std::vector<T> *items)
+{
+    qint64 nItems = readHeader(buffer, size, getType<T>(), T::binarySize);
+
+    if (!isValidCount<T>(nItems)) return false;
+    items->resize(size_t(nItems));
+    decodeRecords<T>(buffer + headerSize, nItems, items->data());
+    return true;
+}
+
+
+template <class T>
+bool GeometryBinary::decode(const QByteArray &buffer, std::vector<T> *items)
+{
+    return decode<T>(reinterpret_cast<const uchar *>(buffer.constData()), buffer.size(), items);
+}
+
+
+/*!
+ * \brief Decodes a single object.
+ * \return True, if the buffer holds exactly one object of the type.
+ */
+template <class T>
+bool GeometryBinary::decode(const QByteArray &buffer, T *item)
+{
+    const uchar *data = reinterpret_cast<const uchar *>(buffer.constData());
+
+    if (readHeader(data, buffer.size(), getType<T>(), T::binarySize) != 1) return false;
+    decodeRecords<T>(data + headerSize, 1, item);
+    return true;
+}
+
+
+/*!
+ * \brief Writes an encoded array to a device in chunks, without encoding the whole array in memory.
+ * \return True, if all bytes were written.
+ */
+template <class T>
+bool GeometryBinary::write(QIODevice *device, T *items, qint64 nItems)
+{
+    const qint64 chunkItems = qMax(qint64(1), (qint64(1) << 20) / qint64(T::binarySize));
+    uchar header[headerSize];
+    std::vector<uchar> chunk;
+
+    writeHeader(header, getType<T>(), nItems);
+    if (device->write(reinterpret_cast<const char *>(header), headerSize) != headerSize) return false;
+    if (isMemoryLayout<T>())
+        return device->write(reinterpret_cast<const char *>(items), nItems * T::binarySize) == nItems * T::binarySize;
+
+    chunk.resize(size_t(qMin(nItems, chunkItems) * T::binarySize));
+    for (qint64 i = 0; i < nItems; i += chunkItems)
+    {
+        qint64 n = qMin(chunkItems, nItems - i);
+        encodeRecords<T>(items + i, n, chunk.data());
+        if (device->write(reinterpret_cast<const char *>(chunk.data()), n * T::binarySize) != n * T::binarySize) return false;
+    }
+    return true;
+}
+
+
+/*!
+ * \brief Reads an array written by write().
+ *        The item count of the header is checked against the remaining size of random-access devices;
+ *        on sequential devices the array grows chunk by chunk, so a corrupt count fails at the end of data
+ *        instead of allocating memory for it.
+ * \return True, if a complete array of the type was read.
+ */
+template <class T>
+bool GeometryBinary::read(QIODevice *device, std::vector<T> *items)
+{
+    const qint64 chunkItems = qMax(qint64(1), (qint64(1) << 20) / qint64(T::binarySize));
+    uchar header[headerSize];
+    std::vector<uchar> chunk;
+    qint64 nItems;
+
+    if (device->read(reinterpret_cast<char *>(header), headerSize) != headerSize) return false;
+    nItems = readHeader(header, headerSize, getType<T>(), 0);
+    if (!isValidCount<T>(nItems)) return false;
+    if (!device->isSequential() && ((device->size() - device->pos()) / T::binarySize < nItems)) return false;
+
+    items->clear();
+    if (!device->isSequential()) items->reserve(size_t(nItems));
+    if (!isMemoryLayout<T>()) chunk.resize(size_t(qMin(nItems, chunkItems) * T::binarySize));
+    for (qint64 i = 0; i < nItems; i += chunkItems)
+    {
+        qint64 n = qMin(chunkItems, nItems - i);
+        items->resize(size_t(i + n));
+        char *data = isMemoryLayout<T>() ? reinterpret_cast<char *>(items->data() + i) : reinterpret_cast<char *>(chunk.data());
+        if (device->read(data, n * T::binarySize) != n * T::binarySize) return false;
+        if (!isMemoryLayout<T>()) decodeRecords<T>(chunk.data(), n, items->data() + i);
+    }
+    return true;
+}
+
+#endif // GEOMETRYBINARY_H
@@ -0,0 +1,404 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file geometryjsonreader.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <errno.h>
+#include <locale.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "geometryjsonreader.h"
+
+
+/*!
+ * \brief Maximum nesting of arrays and objects.
+ */
+static const int geometryJsonMaxDepth = 512;
+
+
+/*!
+ * \brief Default constructor. Creates a record of undefined type.
+ */
+GeometryJsonRecord::GeometryJsonRecord()
+{
+    clear();
+}
+
+
+/*!
+ * \brief Sets the type to undefined and all members to zero.
+ */
+void GeometryJsonRecord::clear()
+{
+    type = GeometryBinary::UndefinedType;
+    p0.set(0, 0, 0, 0);
+    p1.set(0, 0, 0, 0);
+    index.set(0, 0, 0, 0, 0);
+    size.set(0, 0, 0, 0, 0);
+}
+
+
+/*!
+ * \brief Returns the record type of a "type" member value.
+ */
+static GeometryBinary::Type geometryJsonType(const std::string &name)
+{
+    static const char *names[] = {"Point2D", "Point3D", "Point3DT", "Box2D", "Box3DT", "Index2D", "Index3D", "Index3DT",
+                                  "RasterSize2D", "RasterSize3D", "RasterSize3DT"};
+
+    for (int i = 0; i < 11; i++)
+        if (name == names[i]) return GeometryBinary::Type(GeometryBinary::Point2DType + i);
+    return GeometryBinary::UndefinedType;
+}
+
+
+/*!
+ * \brief Constructs a reader on an open device.
+ * \param device Pointer to a device open for reading; it must outlive the reader.
+ * \param bufferSize Size of the input buffer in bytes.
+ */
+GeometryJsonReader::GeometryJsonReader(QIODevice *device, qint64 bufferSize)
+{
+    this->device = device;
+    buffer.resize(size_t(qMax(bufferSize, qint64(256))));
+    position = 0;
+    length = 0;
+    offset = 0;
+    decimalPoint = localeconv()->decimal_point[0];
+    stopped = false;
+}
+
+
+/*!
+ * \brief Stores an error description with the input offset.
+ * \return Always false.
+ */
+bool GeometryJsonReader::fail(QString message)
+{
+    if (errorString.isEmpty()) errorString = message + QString(" at byte %1.").arg(offset + position);
+    return false;
+}
+
+
+/*!
+ * \return Next input character without consuming it, -1 at the end of input.
+ */
+int GeometryJsonReader::peek()
+{
+    if (position == length)
+    {
+        offset += length;
+        position = 0;
+        length = device->read(buffer.data(), qint64(buffer.size()));
+        if (length <= 0)
+        {
+            length = 0;
+            return -1;
+        }
+    }
+    return uchar(buffer[size_t(position)]);
+}
+
+
+/*!
+ * \return Next input character, -1 at the end of input.
+ */
+int GeometryJsonReader::get()
+{
+    int c = peek();
+    if (0 <= c) position++;
+    return c;
+}
+
+
+void GeometryJsonReader::skipSpace()
+{
+    int c;
+    while (((c = peek()) == ' ') || (c == '\n') || (c == '\r') || (c == '\t')) position++;
+}
+
+
+bool GeometryJsonReader::expect(const char *literal)
+{
+    for (const char *p = literal; *p; p++)
+        if (get() != *p) return fail("Invalid literal");
+    return true;
+}
+
+
+/*!
+ * \brief Parses a string. Escapes are decoded; \\u escapes outside ASCII are replaced by '?'.
+ *        Only the first 256 characters are kept; longer strings are consumed.
+ * \param text Output string, or nullptr to skip the string.
+ */
+bool GeometryJsonReader::parseString(std::string *text)
+{
+    int c;
+
+    if (get() != '"') return fail("Expected a string");
+    if (text) text->clear();
+    for (;;)
+    {
+        c = get();
+        if (c < 0) return fail("Unterminated string");
+        if (c == '"') return true;
+        if (c == '\\')
+        {
+            c = get();
+            switch (c)
+            {
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'n': c = '\n'; break;
+            case 'r': c = '\r'; break;
+            case 't': c = '\t'; break;
+            case 'u':
+            {
+                int code = 0;
+                for (int i = 0; i < 4; i++)
+                {
+                    int h = get();
+                    if (('0' <= h) && (h <= '9')) code = code * 16 + h - '0';
+                    else if (('a' <= h) && (h <= 'f')) code = code * 16 + h - 'a' + 10;
+                    else if (('A' <= h) && (h <= 'F')) code = code * 16 + h - 'A' + 10;
+                    else return fail("Invalid escape");
+                }
+                c = (code < 128) ? code : '?';
+                break;
+            }
+            case '"': case '\\': case '/': break;
+            default: return fail("Invalid escape");
+            }
+        }
+        if (text && (text->size() < 256)) text->push_back(char(c));
+    }
+}
+
+
+/*!
+ * \brief Parses a number.
+ * \param value Output value, or nullptr.
+ * \param integer Output value rounded to an integer, exact for integral numbers; or nullptr.
+ */
+bool GeometryJsonReader::parseNumber(double *value, qint64 *integer)
+{
+    char text[64];
+    char *end;
+    int n = 0, c;
+    bool integral = true;
+
+    while ((c = peek()) >= 0)
+    {
+        if (('0' <= c && c <= '9') || (c == '-') || (c == '+')) ;
+        else if ((c == '.') || (c == 'e') || (c == 'E')) integral = false;
+        else break;
+        if (n == int(sizeof(text)) - 1) return fail("Number too long");
+        text[n++] = (c == '.') ? decimalPoint : char(c);
+        position++;
+    }
+    text[n] = '\0';
+    if (n == 0) return fail("Expected a number");
+
+    double d = strtod(text, &end);
+    if (end != text + n) return fail("Invalid number");
+    if (value) *value = d;
+    if (integer)
+    {
+        errno = 0;
+        if (integral)
+        {
+            *integer = strtoll(text, &end, 10);
+            if (errno == ERANGE) *integer = qint64(d);
+        }
+        else *integer = qint64(llround(d));
+    }
+    return true;
+}
+
+
+/*!
+ * \brief Parses a member value of an object; known members are stored in the record.
+ */
+bool GeometryJsonReader::parseMember(GeometryJsonRecord *record, const std::string &key, int depth)
+{
+    int c = peek();
+    bool isNumber = (c == '-') || (('0' <= c) && (c <= '9'));
+    qint64 *integer = nullptr;
+    double *value = nullptr;
+
+    if ((key == "type") && (c == '"'))
+    {
+        std::string name;
+        if (!parseString(&name)) return false;
+        record->type = geometryJsonType(name);
+        return true;
+    }
+    if (((key == "p0") || (key == "p1")) && (c == '{'))
+    {
+        GeometryJsonRecord corner;
+        if (!parseObject(&corner, depth + 1)) return false;
+        if (key == "p0") record->p0 = corner.p0;
+        else record->p1 = corner.p0;
+        return true;
+    }
+    if (!isNumber) return parseValue(depth);
+
+    if (key.size() == 1)
+    {
+        switch (key[0])
+        {
+        case 'x': value = &record->p0.x; break;
+        case 'y': value = &record->p0.y; break;
+        case 'z': value = &record->p0.z; break;
+        case 't': value = &record->p0.t; break;
+        default: break;
+        }
+    }
+    else if (key == "col") integer = &record->index.col;
+    else if (key == "row") integer = &record->index.row;
+    else if (key == "lay") integer = &record->index.lay;
+    else if (key == "band") integer = &record->index.band;
+    else if (key == "tick") integer = &record->index.tick;
+    else if (key == "nCols") integer = &record->size.nCols;
+    else if (key == "nRows") integer = &record->size.nRows;
+    else if (key == "nLays") integer = &record->size.nLays;
+    else if (key == "nBands") integer = &record->size.nBands;
+    else if (key == "nTicks") integer = &record->size.nTicks;
+    return parseNumber(value, integer);
+}
+
+
+/*!
+ * \brief Parses an object into a record. The caller reports the record.
+ */
+bool GeometryJsonReader::parseObject(GeometryJsonRecord *record, int depth)
+{
+    std::string key;
+    int c;
+
+    if (geometryJsonMaxDepth < depth) return fail("Nesting too deep");
+    if (get() != '{') return fail("Expected an object");
+    skipSpace();
+    if (peek() == '}')
+    {
+        position++;
+        return true;
+    }
+    for (;;)
+    {
+        skipSpace();
+        if (!parseString(&key)) return false;
+        skipSpace();
+        if (get() != ':') return fail("Expected ':'");
+        skipSpace();
+        if (!parseMember(record, key, depth)) return false;
+        skipSpace();
+        c = get();
+        if (c == '}') return true;
+        if (c != ',') return fail("Expected ',' or '}'");
+    }
+}
+
+
+bool GeometryJsonReader::parseArray(int depth)
+{
+    int c;
+
+    if (geometryJsonMaxDepth < depth) return fail("Nesting too deep");
+    if (get() != '[') return fail("Expected an array");
+    skipSpace();
+    if (peek() == ']')
+    {
+        position++;
+        return true;
+    }
+    for (;;)
+    {
+        if (!parseValue(depth)) return false;
+        skipSpace();
+        c = get();
+        if (c == ']') return true;
+        if (c != ',') return fail("Expected ',' or ']'");
+    }
+}
+
+
+/*!
+ * \brief Parses any value; objects of a known type are reported.
+ */
+bool GeometryJsonReader::parseValue(int depth)
+{
+    skipSpace();
+    switch (peek())
+    {
+    case '{':
+    {
+        GeometryJsonRecord record;
+        if (!parseObject(&record, depth + 1)) return false;
+        if ((record.type != GeometryBinary::UndefinedType) && !onRecord(&record))
+        {
+            stopped = true;
+            return false;
+        }
+        return true;
+    }
+    case '[': return parseArray(depth + 1);
+    case '"': return parseString(nullptr);
+    case 't': return expect("true");
+    case 'f': return expect("false");
+    case 'n': return expect("null");
+    case -1: return fail("Unexpected end of input");
+    default: return parseNumber(nullptr, nullptr);
+    }
+}
+
+
+/*!
+ * \brief Reads the whole input, which may hold several top-level values (e.g. one record per line).
+ * \param func Function called for every record.
+ * \return True, if the input was parsed or reading was stopped by the function.
+ */
+bool GeometryJsonReader::read(RecordFunction func)
+{
+    onRecord = func;
+    stopped = false;
+    errorString.clear();
+
+    for (;;)
+    {
+        skipSpace();
+        if (peek() < 0) return true;
+        if (!parseValue(0)) return stopped;
+    }
+}
+
+
+/*!
+ * \brief Reads point records (Point2D, Point3D and Point3DT) into coordinate arrays; other records are skipped.
+ *        Missing coordinates are zero.
+ * \param x Array of x-coordinates the points are appended to.
+ * \param y Array of y-coordinates.
+ * \param z Array of z-coordinates, or nullptr.
+ * \param t Array of t-coordinates, or nullptr.
+ * \return True, if the input was parsed.
+ */
+bool GeometryJsonReader::readPoints(std::vector<double> *x, std::vector<double> *y, std::vector<double> *z, std::vector<double> *t)
+{
+    return read([x, y, z, t](GeometryJsonRecord *record) {
+        if ((record->type < GeometryBinary::Point2DType) || (GeometryBinary::Point3DTType < record->type)) return true;
+        x->push_back(record->p0.x);
+        y->push_back(record->p0.y);
+        if (z) z->push_back(record->p0.z);
+        if (t) t->push_back(record->p0.t);
+        return true;
+    });
+}
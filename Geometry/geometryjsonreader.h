@@ -0,0 +1,93 @@
+#ifndef GEOMETRYJSONREADER_H
+#define GEOMETRYJSONREADER_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file geometryjsonreader.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <QIODevice>
+#include <QString>
+#include "g3dtcore_global.h"
+#include "geometrybinary.h"
+#include "index3dt.h"
+#include "point3dt.h"
+#include "rastersize3dt.h"
+
+
+/*!
+ * \brief A geometry object read from JSON. Members not present in the record are zero.
+ */
+struct G3DTCORE_EXPORT GeometryJsonRecord
+{
+    GeometryBinary::Type type; //!< record type, UndefinedType for objects without a known "type"
+    Point3DT p0; //!< point coordinates, or the first corner of a box
+    Point3DT p1; //!< second corner of a box
+    Index3DT index; //!< index members
+    RasterSize3DT size; //!< raster size members
+
+    GeometryJsonRecord();
+    void clear();
+};
+
+
+/*!
+ * \brief The GeometryJsonReader parses JSON from a device in a single pass and reports geometry records
+ *        (objects with a known "type" member in the schema of toJson()) as they are completed.
+ *
+ *        Records may appear at any depth, e.g. in a top-level array or in arrays under other members, and
+ *        members may be in any order. The input is read in chunks of a fixed size and no document tree is
+ *        built, so memory use does not depend on the input size. Integers are parsed exactly.
+ */
+class G3DTCORE_EXPORT GeometryJsonReader
+{
+public:
+    /*!
+     * \brief Called for every record; returning false stops reading.
+     */
+    typedef std::function<bool(GeometryJsonRecord *record)> RecordFunction;
+
+    QString errorString; //!< description of the last error
+
+public:
+    GeometryJsonReader(QIODevice *device, qint64 bufferSize = 65536);
+
+    bool read(RecordFunction func);
+    bool readPoints(std::vector<double> *x, std::vector<double> *y, std::vector<double> *z = nullptr, std::vector<double> *t = nullptr);
+
+private:
+    QIODevice *device;
+    std::vector<char> buffer;
+    qint64 position; //!< read position in the buffer
+    qint64 length; //!< number of valid bytes in the buffer
+    qint64 offset; //!< input offset of the buffer start
+    char decimalPoint; //!< decimal point of the C locale used by strtod
+    RecordFunction onRecord;
+    bool stopped;
+
+    int peek();
+    int get();
+    void skipSpace();
+    bool expect(const char *literal);
+    bool fail(QString message);
+
+    bool parseValue(int depth);
+    bool parseObject(GeometryJsonRecord *record, int depth);
+    bool parseArray(int depth);
+    bool parseString(std::string *text);
+    bool parseNumber(double *value, qint64 *integer);
+    bool parseMember(GeometryJsonRecord *record, const std::string &key, int depth);
+};
+
+#endif // GEOMETRYJSONREADER_H
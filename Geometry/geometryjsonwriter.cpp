@@ -0,0 +1,472 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file geometryjsonwriter.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <locale.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "geometryjsonwriter.h"
+
+
+/*!
+ * \brief Constructs a writer on an open device.
+ * \param device Pointer to a device open for writing; it must outlive the writer.
+ * \param bufferSize Size of the output buffer in bytes.
+ */
+GeometryJsonWriter::GeometryJsonWriter(QIODevice *device, qint64 bufferSize)
+{
+    this->device = device;
+    buffer.resize(size_t(qMax(bufferSize, qint64(256))));
+    used = 0;
+    ok = true;
+    decimalPoint = localeconv()->decimal_point[0];
+}
+
+
+/*!
+ * \brief Destructor. Flushes buffered output.
+ */
+GeometryJsonWriter::~GeometryJsonWriter()
+{
+    flush();
+}
+
+
+/*!
+ * \brief Writes buffered output to the device.
+ * \return True, if no write failed so far.
+ */
+bool GeometryJsonWriter::flush()
+{
+    if (ok && (0 < used))
+        ok = device->write(buffer.data(), qint64(used)) == qint64(used);
+    used = 0;
+    return ok;
+}
+
+
+/*!
+ * \return True, if no write failed so far.
+ */
+bool GeometryJsonWriter::isValid()
+{
+    return ok;
+}
+
+
+void GeometryJsonWriter::put(const char *text, size_t length)
+{
+    if (buffer.size() < used + length)
+    {
+        flush();
+        if (buffer.size() < length)
+        {
+            if (ok) ok = device->write(text, qint64(length)) == qint64(length);
+            return;
+        }
+    }
+    memcpy(buffer.data() + used, text, length);
+    used += length;
+}
+
+
+void GeometryJsonWriter::put(char c)
+{
+    if (used == buffer.size()) flush();
+    buffer[used++] = c;
+}
+
+
+void GeometryJsonWriter::putString(const char *text)
+{
+    put('"');
+    put(text, strlen(text));
+    put('"');
+}
+
+
+void GeometryJsonWriter::putInteger(qint64 value)
+{
+    char digits[24];
+    int n = 0;
+    quint64 v = (value < 0) ? quint64(0) - quint64(value) : quint64(value);
+
+    do
+    {
+        digits[sizeof(digits) - 1 - n++] = char('0' + v % 10);
+        v /= 10;
+    } while (v);
+    if (value < 0) digits[sizeof(digits) - 1 - n++] = '-';
+    put(digits + sizeof(digits) - n, size_t(n));
+}
+
+
+/*!
+ * \brief Writes a double with the fewest digits that round-trip in most cases.
+ *        Integral values below 2^53 are written as integers. Other values in [1e-5, 2^53) are scaled by powers
+ *        of ten until they round to an integer m with m / 10^d == value; since m and 10^d are exact doubles,
+ *        the division is correctly rounded and equals parsing "m e-d", so the check is exact. Remaining values
+ *        are written by snprintf with 15 significant digits if they round-trip, otherwise with 17.
+ */
+void GeometryJsonWriter::putDouble(double value)
+{
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    const double limit = 9007199254740992.0;
+    double magnitude = fabs(value);
+    char text[40];
+    int n;
+
+    if (!std::isfinite(value))
+    {
+        put("null", 4);
+        return;
+    }
+    if ((magnitude < limit) && (value == floor(value)))
+    {
+        putInteger(qint64(value));
+        return;
+    }
+    if ((1e-5 <= magnitude) && (magnitude < limit))
+    {
+        for (int d = 1; (d <= 22) && (magnitude * powers[d] < limit); d++)
+        {
+            double m = nearbyint(magnitude * powers[d]);
+            if (m / powers[d] != magnitude) continue;
+
+            char digits[24];
+            quint64 v = quint64(m);
+            int nDigits = 0;
+            while ((v != 0) || (nDigits <= d))
+            {
+                digits[sizeof(digits) - 1 - nDigits++] = char('0' + v % 10);
+                v /= 10;
+            }
+            n = 0;
+            if (value < 0) text[n++] = '-';
+            memcpy(text + n, digits + sizeof(digits) - nDigits, size_t(nDigits - d));
+            n += nDigits - d;
+            text[n++] = '.';
+            memcpy(text + n, digits + sizeof(digits) - d, size_t(d));
+            put(text, size_t(n + d));
+            return;
+        }
+        n = snprintf(text, sizeof(text), "%.17g", value);
+    }
+    else
+    {
+        n = snprintf(text, sizeof(text), "%.15g", value);
+        if (strtod(text, nullptr) != value) n = snprintf(text, sizeof(text), "%.17g", value);
+    }
+    if (decimalPoint != '.')
+        for (int i = 0; i < n; i++)
+            if (text[i] == decimalPoint) text[i] = '.';
+    put(text, size_t(n));
+}
+
+
+void GeometryJsonWriter::putKey(const char *key, bool first)
+{
+    if (!first) put(',');
+    putString(key);
+    put(':');
+}
+
+
+/*!
+ * \brief Writes an element separator if needed, the opening brace and the type member.
+ */
+void GeometryJsonWriter::beginRecord(const char *type)
+{
+    if (!firstElement.empty())
+    {
+        if (!firstElement.back()) put(',');
+        firstElement.back() = false;
+    }
+    put('{');
+    putKey("type", true);
+    putString(type);
+}
+
+
+void GeometryJsonWriter::endRecord()
+{
+    put('}');
+    if (firstElement.empty()) put('\n');
+}
+
+
+/*!
+ * \brief Opens a JSON array. Arrays may be nested.
+ * \return True, if no write failed so far.
+ */
+bool GeometryJsonWriter::beginArray()
+{
+    if (!firstElement.empty())
+    {
+        if (!firstElement.back()) put(',');
+        firstElement.back() = false;
+    }
+    put('[');
+    firstElement.push_back(true);
+    return ok;
+}
+
+
+/*!
+ * \brief Closes the innermost open array.
+ * \return True, if an array was open and no write failed so far.
+ */
+bool GeometryJsonWriter::endArray()
+{
+    if (firstElement.empty()) return false;
+    firstElement.pop_back();
+    put(']');
+    if (firstElement.empty()) put('\n');
+    return ok;
+}
+
+
+void GeometryJsonWriter::putPoint(const char *type, double x, double y, const double *z, const double *t)
+{
+    beginRecord(type);
+    putKey("x");
+    putDouble(x);
+    putKey("y");
+    putDouble(y);
+    if (z)
+    {
+        putKey("z");
+        putDouble(*z);
+    }
+    if (t)
+    {
+        putKey("t");
+        putDouble(*t);
+    }
+    endRecord();
+}
+
+
+/*!
+ * \brief Writes a 2D point record.
+ * \return True, if no write failed so far.
+ */
+bool GeometryJsonWriter::write(Point2D *point)
+{
+    putPoint("Point2D", point->x, point->y, nullptr, nullptr);
+    return ok;
+}
+
+
+/*!
+ * \brief Writes a 3D point record.
+ * \return True, if no write failed so far.
+ */
+bool GeometryJsonWriter::write(Point3D *point)
+{
+    putPoint("Point3D", point->x, point->y, &point->z, nullptr);
+    return ok;
+}
+
+
+/*!
+ * \brief Writes a 3DT point record.
+ * \return True, if no write failed so far.
+ */
+bool GeometryJsonWriter::write(Point3DT *point)
+{
+    putPoint("Point3DT", point->x, point->y, &point->z, &point->t);
+    return ok;
+}
+
+
+/*!
+ * \brief Writes a 2D box record with nested corner points.
+ * \return True, if no write failed so far.
+ */
+bool GeometryJsonWriter::write(Box2D *box)
+{
+    beginRecord("Box2D");
+    putKey("p0");
+    firstElement.push_back(true);
+    putPoint("Point2D", box->p0.x, box->p0.y, nullptr, nullptr);
+    firstElement.pop_back();
+    putKey("p1");
+    firstElement.push_back(true);
+    putPoint("Point2D", box->p1.x, box->p1.y, nullptr, nullptr);
+    firstElement.pop_back();
+    endRecord();
+    return ok;
+}
+
+
+/*!
+ * \brief Writes a 3DT box record with nested corner points.
+ * \return True, if no write failed so far.
+ */
+bool GeometryJsonWriter::write(Box3DT *box)
+{
+    beginRecord("Box3DT");
+    putKey("p0");
+    firstElement.push_back(true);
+    putPoint("Point3DT", box->p0.x, box->p0.y, &box->p0.z, &box->p0.t);
+    firstElement.pop_back();
+    putKey("p1");
+    firstElement.push_back(true);
+    putPoint("Point3DT", box->p1.x, box->p1.y, &box->p1.z, &box->p1.t);
+    firstElement.pop_back();
+    endRecord();
+    return ok;
+}
+
+
+/*!
+ * \brief Writes a 2D index record.
+ * \return True, if no write failed so far.
+ */
+bool GeometryJsonWriter::write(Index2D *index)
+{
+    beginRecord("Index2D");
+    putKey("col");
+    putInteger(index->col);
+    putKey("row");
+    putInteger(index->row);
+    putKey("band");
+    putInteger(index->band);
+    endRecord();
+    return ok;
+}
+
+
+/*!
+ * \brief Writes a 3D index record.
+ * \return True, if no write failed so far.
+ */
+bool GeometryJsonWriter::write(Index3D *index)
+{
+    beginRecord("Index3D");
+    putKey("col");
+    putInteger(index->col);
+    putKey("row");
+    putInteger(index->row);
+    putKey("lay");
+    putInteger(index->lay);
+    putKey("band");
+    putInteger(index->band);
+    endRecord();
+    return ok;
+}
+
+
+/*!
+ * \brief Writes a 3DT index record.
+ * \return True, if no write failed so far.
+ */
+bool GeometryJsonWriter::write(Index3DT *index)
+{
+    beginRecord("Index3DT");
+    putKey("col");
+    putInteger(index->col);
+    putKey("row");
+    putInteger(index->row);
+    putKey("lay");
+    putInteger(index->lay);
+    putKey("band");
+    putInteger(index->band);
+    putKey("tick");
+    putInteger(index->tick);
+    endRecord();
+    return ok;
+}
+
+
+/*!
+ * \brief Writes a 2D raster size record.
+ * \return True, if no write failed so far.
+ */
+bool GeometryJsonWriter::write(RasterSize2D *size)
+{
+    beginRecord("RasterSize2D");
+    putKey("nCols");
+    putInteger(size->nCols);
+    putKey("nRows");
+    putInteger(size->nRows);
+    putKey("nBands");
+    putInteger(size->nBands);
+    endRecord();
+    return ok;
+}
+
+
+/*!
+ * \brief Writes a 3D raster size record.
+ * \return True, if no write failed so far.
+ */
+bool GeometryJsonWriter::write(RasterSize3D *size)
+{
+    beginRecord("RasterSize3D");
+    putKey("nCols");
+    putInteger(size->nCols);
+    putKey("nRows");
+    putInteger(size->nRows);
+    putKey("nLays");
+    putInteger(size->nLays);
+    putKey("nBands");
+    putInteger(size->nBands);
+    endRecord();
+    return ok;
+}
+
+
+/*!
+ * \brief Writes a 3DT raster size record.
+ * \return True, if no write failed so far.
+ */
+bool GeometryJsonWriter::write(RasterSize3DT *size)
+{
+    beginRecord("RasterSize3DT");
+    putKey("nCols");
+    putInteger(size->nCols);
+    putKey("nRows");
+    putInteger(size->nRows);
+    putKey("nLays");
+    putInteger(size->nLays);
+    putKey("nBands");
+    putInteger(size->nBands);
+    putKey("nTicks");
+    putInteger(size->nTicks);
+    endRecord();
+    return ok;
+}
+
+
+/*!
+ * \brief Writes points stored in separate coordinate arrays (structure of arrays).
+ *        The record type is Point2D, Point3D or Point3DT according to the arrays given.
+ * \param x Array of x-coordinates.
+ * \param y Array of y-coordinates.
+ * \param z Array of z-coordinates, or nullptr for 2D points.
+ * \param t Array of t-coordinates, or nullptr; ignored without z.
+ * \param nPoints Number of points.
+ * \return True, if no write failed so far.
+ */
+bool GeometryJsonWriter::writePoints(const double *x, const double *y, const double *z, const double *t, qint64 nPoints)
+{
+    const char *type = !z ? "Point2D" : (t ? "Point3DT" : "Point3D");
+
+    for (qint64 i = 0; ok && (i < nPoints); i++)
+        putPoint(type, x[i], y[i], z ? z + i : nullptr, (z && t) ? t + i : nullptr);
+    return ok;
+}
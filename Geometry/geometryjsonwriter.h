@@ -0,0 +1,87 @@
+#ifndef GEOMETRYJSONWRITER_H
+#define GEOMETRYJSONWRITER_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file geometryjsonwriter.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <vector>
+#include <QIODevice>
+#include "g3dtcore_global.h"
+#include "box2d.h"
+#include "box3dt.h"
+#include "index2d.h"
+#include "index3d.h"
+#include "index3dt.h"
+#include "point2d.h"
+#include "point3d.h"
+#include "point3dt.h"
+#include "rastersize2d.h"
+#include "rastersize3d.h"
+#include "rastersize3dt.h"
+
+
+/*!
+ * \brief The GeometryJsonWriter streams geometry objects as compact JSON to a device.
+ *
+ *        Records use the schema of toJson() ("type" and coordinate, index or size members), so files can be
+ *        read by QJsonDocument and fromJson(). Nothing is materialized: records are formatted into a fixed
+ *        buffer that is written to the device when full. Indexes and integral values are written as integers
+ *        (exact above 2^53); other doubles with the shortest decimal of up to 15 significant digits that
+ *        round-trips, otherwise with 17 digits. Non-finite numbers are written as null.
+ *        A file descriptor can be written through QFile::open(int, ...).
+ */
+class G3DTCORE_EXPORT GeometryJsonWriter
+{
+public:
+    GeometryJsonWriter(QIODevice *device, qint64 bufferSize = 65536);
+    ~GeometryJsonWriter();
+
+    bool beginArray();
+    bool endArray();
+
+    bool write(Point2D *point);
+    bool write(Point3D *point);
+    bool write(Point3DT *point);
+    bool write(Box2D *box);
+    bool write(Box3DT *box);
+    bool write(Index2D *index);
+    bool write(Index3D *index);
+    bool write(Index3DT *index);
+    bool write(RasterSize2D *size);
+    bool write(RasterSize3D *size);
+    bool write(RasterSize3DT *size);
+    bool writePoints(const double *x, const double *y, const double *z, const double *t, qint64 nPoints);
+
+    bool flush();
+    bool isValid();
+
+private:
+    QIODevice *device;
+    std::vector<char> buffer;
+    size_t used;
+    std::vector<bool> firstElement; //!< per open array, no element was written yet
+    bool ok;
+    char decimalPoint; //!< decimal point of the C locale used by snprintf
+
+    void put(const char *text, size_t length);
+    void put(char c);
+    void putString(const char *text);
+    void putInteger(qint64 value);
+    void putDouble(double value);
+    void putKey(const char *key, bool first = false);
+    void beginRecord(const char *type);
+    void endRecord();
+    void putPoint(const char *type, double x, double y, const double *z, const double *t);
+};
+
+#endif // GEOMETRYJSONWRITER_H
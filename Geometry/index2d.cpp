@@ -12,6 +12,7 @@
  */
 
 #include "index2d.h"
+#include "geometrybinary.h"
 
 
 /*!
@@ -78,7 +79,7 @@ void Index2D::invalidate()
  * \brief Validates index status.
  * \return Returns true if and only if the column, row, and band index are valid.
  */
-inline bool Index2D::isValid()
+bool Index2D::isValid()
 {
     return (0 <= this->col) && (0 <= this->row) && (0 <= this->band);
 }
@@ -128,3 +129,26 @@ bool Index2D::fromJson(QJsonValue jsonVal)
     return true;
 }
 
+
+/*!
+ * \brief Writes the 2D index to a little-endian binary record of binarySize bytes.
+ * \param buffer Output buffer.
+ */
+void Index2D::toBinary(uchar *buffer)
+{
+    GeometryBinary::putInt64(buffer, col);
+    GeometryBinary::putInt64(buffer + 8, row);
+    GeometryBinary::putInt64(buffer + 16, band);
+}
+
+
+/*!
+ * \brief Reads the 2D index from a binary record written by toBinary().
+ * \param buffer Input buffer.
+ */
+void Index2D::fromBinary(const uchar *buffer)
+{
+    col = GeometryBinary::getInt64(buffer);
+    row = GeometryBinary::getInt64(buffer + 8);
+    band = GeometryBinary::getInt64(buffer + 16);
+}
@@ -12,6 +12,7 @@
  */
 
 #include "index3d.h"
+#include "geometrybinary.h"
 
 
 /*!
@@ -80,7 +81,7 @@ void Index3D::invalidate()
  * \brief Checks the index status.
  * \return Returns true if and only if the column, row, layer, and band index are valid.
  */
-inline bool Index3D::isValid()
+bool Index3D::isValid()
 {
     return Index2D::isValid() && (0 <= this->lay);
 }
@@ -132,3 +133,25 @@ bool Index3D::fromJson(QJsonValue jsonVal)
     }
     return false;
 }
+
+
+/*!
+ * \brief Writes the 3D index to a little-endian binary record of binarySize bytes.
+ * \param buffer Output buffer.
+ */
+void Index3D::toBinary(uchar *buffer)
+{
+    Index2D::toBinary(buffer);
+    GeometryBinary::putInt64(buffer + 24, lay);
+}
+
+
+/*!
+ * \brief Reads the 3D index from a binary record written by toBinary().
+ * \param buffer Input buffer.
+ */
+void Index3D::fromBinary(const uchar *buffer)
+{
+    Index2D::fromBinary(buffer);
+    lay = GeometryBinary::getInt64(buffer + 24);
+}
@@ -12,6 +12,7 @@
  */
 
 #include "index3dt.h"
+#include "geometrybinary.h"
 
 
 /*!
@@ -81,7 +82,7 @@ void Index3DT::invalidate()
  * \brief Checks the index status.
  * \return Returns true if and only if the column, row, layer, band, and tick index are valid.
  */
-inline bool Index3DT::isValid()
+bool Index3DT::isValid()
 {
     return Index3D::isValid() && (0 <= this->tick);
 }
@@ -135,3 +136,25 @@ bool Index3DT::fromJson(QJsonValue jsonVal)
     }
     return false;
 }
+
+
+/*!
+ * \brief Writes the 3DT index to a little-endian binary record of binarySize bytes.
+ * \param buffer Output buffer.
+ */
+void Index3DT::toBinary(uchar *buffer)
+{
+    Index3D::toBinary(buffer);
+    GeometryBinary::putInt64(buffer + 32, tick);
+}
+
+
+/*!
+ * \brief Reads the 3DT index from a binary record written by toBinary().
+ * \param buffer Input buffer.
+ */
+void Index3DT::fromBinary(const uchar *buffer)
+{
+    Index3D::fromBinary(buffer);
+    tick = GeometryBinary::getInt64(buffer + 32);
+}
@@ -12,6 +12,7 @@
  */
 
 #include "point2d.h"
+#include "geometrybinary.h"
 
 
 /*!
@@ -69,7 +70,7 @@ Point2D &Point2D::operator=(const Point2D &point)
  * \param x New x-coordinate.
  * \param y New y-coordinate.
  */
-inline void Point2D::set(double x, double y)
+void Point2D::set(double x, double y)
 {
     this->x = x;
     this->y = y;
@@ -103,3 +104,25 @@ bool Point2D::fromJson(QJsonValue jsonVal)
     y = jsonVal["y"].toDouble();
     return true;
 }
+
+
+/*!
+ * \brief Writes the 2D point to a little-endian binary record of binarySize bytes.
+ * \param buffer Output buffer.
+ */
+void Point2D::toBinary(uchar *buffer)
+{
+    GeometryBinary::putDouble(buffer, x);
+    GeometryBinary::putDouble(buffer + 8, y);
+}
+
+
+/*!
+ * \brief Reads the 2D point from a binary record written by toBinary().
+ * \param buffer Input buffer.
+ */
+void Point2D::fromBinary(const uchar *buffer)
+{
+    x = GeometryBinary::getDouble(buffer);
+    y = GeometryBinary::getDouble(buffer + 8);
+}
@@ -34,6 +34,11 @@ public:
 
     virtual QJsonObject toJson();
     virtual bool fromJson(QJsonValue jsonVal);
+
+    virtual void toBinary(uchar *buffer);
+    virtual void fromBinary(const uchar *buffer);
+
+    static const int binarySize = 16; //!< size of the binary record in bytes
 };
 
 #endif // POINT2D_H
@@ -12,6 +12,7 @@
  */
 
 #include "point3d.h"
+#include "geometrybinary.h"
 
 
 /*!
@@ -71,7 +72,7 @@ Point3D &Point3D::operator=(const Point3D &point)
  * \param y New y-coordinate.
  * \param z New z-coordinate.
  */
-inline void Point3D::set(double x, double y, double z)
+void Point3D::set(double x, double y, double z)
 {
     Point2D::set(x, y);
     this->z = z;
@@ -109,3 +110,25 @@ bool Point3D::fromJson(QJsonValue jsonVal)
     }
     return false;
 }
+
+
+/*!
+ * \brief Writes the 3D point to a little-endian binary record of binarySize bytes.
+ * \param buffer Output buffer.
+ */
+void Point3D::toBinary(uchar *buffer)
+{
+    Point2D::toBinary(buffer);
+    GeometryBinary::putDouble(buffer + 16, z);
+}
+
+
+/*!
+ * \brief Reads the 3D point from a binary record written by toBinary().
+ * \param buffer Input buffer.
+ */
+void Point3D::fromBinary(const uchar *buffer)
+{
+    Point2D::fromBinary(buffer);
+    z = GeometryBinary::getDouble(buffer + 16);
+}
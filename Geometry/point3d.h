@@ -34,6 +34,11 @@ public:
 
     QJsonObject toJson() override;
     bool fromJson(QJsonValue jsonVal) override;
+
+    void toBinary(uchar *buffer) override;
+    void fromBinary(const uchar *buffer) override;
+
+    static const int binarySize = 24; //!< size of the binary record in bytes
 };
 
 #endif // POINT3D_H
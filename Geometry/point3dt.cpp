@@ -12,6 +12,7 @@
  */
 
 #include "point3dt.h"
+#include "geometrybinary.h"
 
 
 /*!
@@ -112,3 +113,25 @@ bool Point3DT::fromJson(QJsonValue jsonVal)
     }
     return false;
 }
+
+
+/*!
+ * \brief Writes the 3DT point to a little-endian binary record of binarySize bytes.
+ * \param buffer Output buffer.
+ */
+void Point3DT::toBinary(uchar *buffer)
+{
+    Point3D::toBinary(buffer);
+    GeometryBinary::putDouble(buffer + 24, t);
+}
+
+
+/*!
+ * \brief Reads the 3DT point from a binary record written by toBinary().
+ * \param buffer Input buffer.
+ */
+void Point3DT::fromBinary(const uchar *buffer)
+{
+    Point3D::fromBinary(buffer);
+    t = GeometryBinary::getDouble(buffer + 24);
+}
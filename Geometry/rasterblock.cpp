@@ -12,6 +12,7 @@
  */
 
 #include "rasterblock.h"
+#include "geometrybinary.h"
 
 
 /*!
@@ -180,7 +181,7 @@ qint64 RasterBlock::getNumberOfTicks()
  * \param iCol Column index.
  * \param iRow Row index.
  */
-inline bool RasterBlock::contains(qint64 iCol, qint64 iRow)
+bool RasterBlock::contains(qint64 iCol, qint64 iRow)
 {
     return (col0 <= iCol) && (iCol <= col1) && (row0 <= iRow) && (iRow <= row1);
 }
@@ -192,7 +193,47 @@ inline bool RasterBlock::contains(qint64 iCol, qint64 iRow)
  * \param iRow Row index.
  * \param iLay Layer index.
  */
-inline bool RasterBlock::contains(qint64 iCol, qint64 iRow, qint64 iLay)
+bool RasterBlock::contains(qint64 iCol, qint64 iRow, qint64 iLay)
 {
     return (col0 <= iCol) && (iCol <= col1) && (row0 <= iRow) && (iRow <= row1) && (lay0 <= iLay) && (iLay <= lay1);
 }
+
+
+/*!
+ * \brief Writes the raster block to a little-endian binary record of binarySize bytes.
+ * \param buffer Output buffer.
+ */
+void RasterBlock::toBinary(uchar *buffer)
+{
+    GeometryBinary::putInt64(buffer, col0);
+    GeometryBinary::putInt64(buffer + 8, col1);
+    GeometryBinary::putInt64(buffer + 16, row0);
+    GeometryBinary::putInt64(buffer + 24, row1);
+    GeometryBinary::putInt64(buffer + 32, lay0);
+    GeometryBinary::putInt64(buffer + 40, lay1);
+    GeometryBinary::putInt64(buffer + 48, band0);
+    GeometryBinary::putInt64(buffer + 56, band1);
+    GeometryBinary::putInt64(buffer + 64, tick0);
+    GeometryBinary::putInt64(buffer + 72, tick1);
+    GeometryBinary::putInt64(buffer + 80, numberOfNotNullCells);
+}
+
+
+/*!
+ * \brief Reads the raster block from a binary record written by toBinary().
+ * \param buffer Input buffer.
+ */
+void RasterBlock::fromBinary(const uchar *buffer)
+{
+    col0 = GeometryBinary::getInt64(buffer);
+    col1 = GeometryBinary::getInt64(buffer + 8);
+    row0 = GeometryBinary::getInt64(buffer + 16);
+    row1 = GeometryBinary::getInt64(buffer + 24);
+    lay0 = GeometryBinary::getInt64(buffer + 32);
+    lay1 = GeometryBinary::getInt64(buffer + 40);
+    band0 = GeometryBinary::getInt64(buffer + 48);
+    band1 = GeometryBinary::getInt64(buffer + 56);
+    tick0 = GeometryBinary::getInt64(buffer + 64);
+    tick1 = GeometryBinary::getInt64(buffer + 72);
+    numberOfNotNullCells = GeometryBinary::getInt64(buffer + 80);
+}
@@ -47,6 +47,11 @@ public:
     qint64 getNumberOfTicks();
     bool contains(qint64 iCol, qint64 iRow);
     bool contains(qint64 iCol, qint64 iRow, qint64 iLay);
+
+    void toBinary(uchar *buffer);
+    void fromBinary(const uchar *buffer);
+
+    static const int binarySize = 88; //!< size of the binary record in bytes
 };
 
 #endif // RASTERBLOCK_H
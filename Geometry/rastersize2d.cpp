@@ -12,6 +12,7 @@
  */
 
 #include "rastersize2d.h"
+#include "geometrybinary.h"
 
 
 /*!
@@ -81,7 +82,7 @@ void RasterSize2D::set(qint64 nCols, qint64 nRows, qint64 nBands)
 /*!
  * \return Layer size in cells.
  */
-inline qint64 RasterSize2D::getNumberOfCells2D()
+qint64 RasterSize2D::getNumberOfCells2D()
 {
     return this->nCols * this->nRows * this->nBands;
 }
@@ -90,7 +91,7 @@ inline qint64 RasterSize2D::getNumberOfCells2D()
 /*!
  * \return Total number of cells in raster.
  */
-inline qint64 RasterSize2D::getNumberOfCells()
+qint64 RasterSize2D::getNumberOfCells()
 {
     return getNumberOfCells2D();
 }
@@ -125,3 +126,27 @@ bool RasterSize2D::fromJson(QJsonValue jsonVal)
     nBands = qint64(jsonVal["nBands"].toDouble());
     return true;
 }
+
+
+/*!
+ * \brief Writes the 2D raster size to a little-endian binary record of binarySize bytes.
+ * \param buffer Output buffer.
+ */
+void RasterSize2D::toBinary(uchar *buffer)
+{
+    GeometryBinary::putInt64(buffer, nBands);
+    GeometryBinary::putInt64(buffer + 8, nCols);
+    GeometryBinary::putInt64(buffer + 16, nRows);
+}
+
+
+/*!
+ * \brief Reads the 2D raster size from a binary record written by toBinary().
+ * \param buffer Input buffer.
+ */
+void RasterSize2D::fromBinary(const uchar *buffer)
+{
+    nBands = GeometryBinary::getInt64(buffer);
+    nCols = GeometryBinary::getInt64(buffer + 8);
+    nRows = GeometryBinary::getInt64(buffer + 16);
+}
@@ -37,6 +37,11 @@ public:
 
     virtual QJsonObject toJson();
     virtual bool fromJson(QJsonValue jsonVal);
+
+    virtual void toBinary(uchar *buffer);
+    virtual void fromBinary(const uchar *buffer);
+
+    static const int binarySize = 24; //!< size of the binary record in bytes
 };
 
 #endif // RASTERSIZE2D_H
@@ -12,6 +12,7 @@
  */
 
 #include "rastersize3d.h"
+#include "geometrybinary.h"
 
 
 /*!
@@ -83,7 +84,7 @@ void RasterSize3D::set(qint64 nCols, qint64 nRows, qint64 nLays, qint64 nBands)
 /*!
  * \return Number of cells in 3D raster.
  */
-inline qint64 RasterSize3D::getNumberOfCells3D()
+qint64 RasterSize3D::getNumberOfCells3D()
 {
     return this->nCols * this->nRows * this->nLays * this->nBands;
 }
@@ -92,7 +93,7 @@ inline qint64 RasterSize3D::getNumberOfCells3D()
 /*!
  * \return Total number of cells in raster.
  */
-inline qint64 RasterSize3D::getNumberOfCells()
+qint64 RasterSize3D::getNumberOfCells()
 {
     return getNumberOfCells3D();
 }
@@ -130,3 +131,25 @@ bool RasterSize3D::fromJson(QJsonValue jsonVal)
     }
     return false;
 }
+
+
+/*!
+ * \brief Writes the 3D raster size to a little-endian binary record of binarySize bytes.
+ * \param buffer Output buffer.
+ */
+void RasterSize3D::toBinary(uchar *buffer)
+{
+    RasterSize2D::toBinary(buffer);
+    GeometryBinary::putInt64(buffer + 24, nLays);
+}
+
+
+/*!
+ * \brief Reads the 3D raster size from a binary record written by toBinary().
+ * \param buffer Input buffer.
+ */
+void RasterSize3D::fromBinary(const uchar *buffer)
+{
+    RasterSize2D::fromBinary(buffer);
+    nLays = GeometryBinary::getInt64(buffer + 24);
+}
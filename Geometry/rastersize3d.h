@@ -36,6 +36,11 @@ public:
 
     QJsonObject toJson() override;
     bool fromJson(QJsonValue jsonVal) override;
+
+    void toBinary(uchar *buffer) override;
+    void fromBinary(const uchar *buffer) override;
+
+    static const int binarySize = 32; //!< size of the binary record in bytes
 };
 
 #endif // RASTERSIZE3D_H
@@ -12,6 +12,7 @@
  */
 
 #include "rastersize3dt.h"
+#include "geometrybinary.h"
 
 
 /*!
@@ -86,7 +87,7 @@ void RasterSize3DT::set(qint64 nCols, qint64 nRows, qint64 nLays, qint64 nBands,
 /*!
  * \return Number of cells in 4D raster.
  */
-inline qint64 RasterSize3DT::getNumberOfCells4D()
+qint64 RasterSize3DT::getNumberOfCells4D()
 {
     return this->nCols * this->nRows * this->nLays * this->nBands * this->nTicks;
 }
@@ -95,7 +96,7 @@ inline qint64 RasterSize3DT::getNumberOfCells4D()
 /*!
  * \return Total number of cells in raster.
  */
-inline qint64 RasterSize3DT::getNumberOfCells()
+qint64 RasterSize3DT::getNumberOfCells()
 {
     return getNumberOfCells4D();
 }
@@ -134,3 +135,25 @@ bool RasterSize3DT::fromJson(QJsonValue jsonVal)
     }
     return false;
 }
+
+
+/*!
+ * \brief Writes the 3DT raster size to a little-endian binary record of binarySize bytes.
+ * \param buffer Output buffer.
+ */
+void RasterSize3DT::toBinary(uchar *buffer)
+{
+    RasterSize3D::toBinary(buffer);
+    GeometryBinary::putInt64(buffer + 32, nTicks);
+}
+
+
+/*!
+ * \brief Reads the 3DT raster size from a binary record written by toBinary().
+ * \param buffer Input buffer.
+ */
+void RasterSize3DT::fromBinary(const uchar *buffer)
+{
+    RasterSize3D::fromBinary(buffer);
+    nTicks = GeometryBinary::getInt64(buffer + 32);
+}
@@ -0,0 +1,638 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file brickcache.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <string.h>
+#include <QByteArray>
+#include "brickcache.h"
+
+
+/*!
+ * \brief Bytes in front of cached cells holding the address of their entry; keeps cells aligned.
+ */
+static const qint64 brickCacheHeaderSize = 64;
+
+
+/*!
+ * \brief Lists of a shard. Detached entries were evicted or removed while pinned.
+ */
+enum BrickCacheList
+{
+    BrickCacheRecent = 0, //!< bricks used once (ARC T1), or all bricks for LRU
+    BrickCacheFrequent = 1, //!< bricks used repeatedly (ARC T2)
+    BrickCacheDetached = 2 //!< not in the cache, freed on the last release
+};
+
+
+/*!
+ * \brief Loading state of a cached brick.
+ */
+enum BrickCacheState
+{
+    BrickCacheLoading = 0,
+    BrickCacheReady = 1,
+    BrickCacheFailed = 2
+};
+
+
+/*!
+ * \brief Cache key.
+ */
+struct BrickCacheKey
+{
+    quint64 dataset;
+    qint64 iBrick;
+
+    bool operator==(const BrickCacheKey &key) const
+    {
+        return (dataset == key.dataset) && (iBrick == key.iBrick);
+    }
+};
+
+
+/*!
+ * \brief Mixes both parts of a key.
+ */
+static quint64 brickCacheHash(quint64 dataset, qint64 iBrick)
+{
+    quint64 h = dataset ^ (quint64(iBrick) * 0x9E3779B97F4A7C15ULL);
+    h ^= h >> 31;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 29;
+    return h;
+}
+
+
+struct BrickCacheKeyHash
+{
+    size_t operator()(const BrickCacheKey &key) const
+    {
+        return size_t(brickCacheHash(key.dataset, key.iBrick));
+    }
+};
+
+
+/*!
+ * \brief Cached brick.
+ */
+struct BrickCacheEntry
+{
+    BrickCacheKey key;
+    qint64 nBytes; //!< size of cells in bytes
+    uchar *buffer; //!< entry address followed by cells
+    int pins; //!< number of unreleased acquire() calls
+    BrickCacheState state;
+    BrickCacheList list;
+    std::list<BrickCacheEntry *>::iterator position;
+};
+
+
+/*!
+ * \brief Key of an evicted brick, remembered by ARC.
+ */
+struct BrickCacheGhost
+{
+    BrickCacheKey key;
+    qint64 nBytes;
+    BrickCacheList list; //!< list the brick was evicted from
+};
+
+
+/*!
+ * \brief Part of the cache with its own lock and budget. Lists are ordered from the most recently used.
+ */
+struct BrickCacheShard
+{
+    std::mutex mutex;
+    std::condition_variable loaded;
+    qint64 capacity; //!< budget in bytes
+    qint64 target; //!< ARC target size of the recent list in bytes
+    std::unordered_map<BrickCacheKey, BrickCacheEntry *, BrickCacheKeyHash> entries;
+    std::list<BrickCacheEntry *> lists[2];
+    qint64 bytes[2];
+    std::list<BrickCacheGhost> ghosts[2];
+    qint64 ghostBytes[2];
+    std::unordered_map<BrickCacheKey, std::list<BrickCacheGhost>::iterator, BrickCacheKeyHash> ghostIndex;
+
+    BrickCacheShard()
+    {
+        capacity = 0;
+        target = 0;
+        bytes[0] = bytes[1] = 0;
+        ghostBytes[0] = ghostBytes[1] = 0;
+    }
+};
+
+
+/*!
+ * \brief Inserts an entry at the front of a list.
+ */
+static void brickCacheLink(BrickCacheShard *shard, BrickCacheEntry *entry, BrickCacheList list)
+{
+    entry->list = list;
+    shard->lists[list].push_front(entry);
+    entry->position = shard->lists[list].begin();
+    shard->bytes[list] += entry->nBytes;
+}
+
+
+/*!
+ * \brief Removes an entry from its list.
+ */
+static void brickCacheUnlink(BrickCacheShard *shard, BrickCacheEntry *entry)
+{
+    if (entry->list == BrickCacheDetached) return;
+    shard->lists[entry->list].erase(entry->position);
+    shard->bytes[entry->list] -= entry->nBytes;
+    entry->list = BrickCacheDetached;
+}
+
+
+/*!
+ * \brief Removes an entry from the shard and frees it unless it is pinned.
+ */
+static void brickCacheDetach(BrickCacheShard *shard, BrickCacheEntry *entry)
+{
+    if (entry->list == BrickCacheDetached) return;
+    brickCacheUnlink(shard, entry);
+    shard->entries.erase(entry->key);
+    if (entry->pins == 0)
+    {
+        delete[] entry->buffer;
+        delete entry;
+    }
+}
+
+
+/*!
+ * \brief Drops a pin; detached entries are freed with the last pin.
+ */
+static void brickCacheUnpin(BrickCacheEntry *entry)
+{
+    entry->pins--;
+    if ((entry->pins == 0) && (entry->list == BrickCacheDetached))
+    {
+        delete[] entry->buffer;
+        delete entry;
+    }
+}
+
+
+/*!
+ * \brief Removes the ghost of a key.
+ */
+static void brickCacheForget(BrickCacheShard *shard, std::list<BrickCacheGhost>::iterator ghost)
+{
+    shard->ghostBytes[ghost->list] -= ghost->nBytes;
+    shard->ghostIndex.erase(ghost->key);
+    shard->ghosts[ghost->list].erase(ghost);
+}
+
+
+/*!
+ * \brief Limits remembered keys to the ARC bounds: the recent list with its ghosts up to the budget,
+ *        all lists and ghosts up to twice the budget.
+ */
+static void brickCacheTrimGhosts(BrickCacheShard *shard)
+{
+    while (!shard->ghosts[BrickCacheRecent].empty() &&
+           (shard->capacity < shard->bytes[BrickCacheRecent] + shard->ghostBytes[BrickCacheRecent]))
+        brickCacheForget(shard, std::prev(shard->ghosts[BrickCacheRecent].end()));
+
+    while (2 * shard->capacity < shard->bytes[0] + shard->bytes[1] + shard->ghostBytes[0] + shard->ghostBytes[1])
+    {
+        if (!shard->ghosts[BrickCacheFrequent].empty())
+            brickCacheForget(shard, std::prev(shard->ghosts[BrickCacheFrequent].end()));
+        else if (!shard->ghosts[BrickCacheRecent].empty())
+            brickCacheForget(shard, std::prev(shard->ghosts[BrickCacheRecent].end()));
+        else
+            break;
+    }
+}
+
+
+/*!
+ * \brief Returns the least recently used unpinned entry of a list.
+ */
+static BrickCacheEntry *brickCacheFindVictim(std::list<BrickCacheEntry *> *list)
+{
+    for (std::list<BrickCacheEntry *>::reverse_iterator it = list->rbegin(); it != list->rend(); ++it)
+    {
+        if ((*it)->pins == 0) return *it;
+    }
+    return nullptr;
+}
+
+
+/*!
+ * \brief Evicts unpinned entries until the shard fits its budget.
+ * \param arc Evict by the ARC policy and remember evicted keys.
+ * \param frequentGhostHit The brick being inserted was found among ghosts of the frequent list.
+ * \return Number of evicted entries.
+ */
+static qint64 brickCacheEvict(BrickCacheShard *shard, bool arc, bool frequentGhostHit)
+{
+    qint64 nEvicted = 0;
+
+    while (shard->capacity < shard->bytes[0] + shard->bytes[1])
+    {
+        BrickCacheList from = BrickCacheRecent;
+        BrickCacheEntry *victim;
+
+        if (arc)
+        {
+            qint64 recent = shard->bytes[BrickCacheRecent];
+            if ((recent == 0) || ((recent < shard->target) || ((recent == shard->target) && !frequentGhostHit)))
+                from = BrickCacheFrequent;
+        }
+        victim = brickCacheFindVictim(&shard->lists[from]);
+        if (!victim && arc) victim = brickCacheFindVictim(&shard->lists[1 - from]);
+        if (!victim) break;
+
+        if (arc)
+        {
+            BrickCacheGhost ghost = {victim->key, victim->nBytes, victim->list};
+            shard->ghosts[ghost.list].push_front(ghost);
+            shard->ghostBytes[ghost.list] += ghost.nBytes;
+            shard->ghostIndex[ghost.key] = shard->ghosts[ghost.list].begin();
+        }
+        brickCacheDetach(shard, victim);
+        nEvicted++;
+    }
+    if (arc) brickCacheTrimGhosts(shard);
+    return nEvicted;
+}
+
+
+/*!
+ * \brief Constructor.
+ * \param capacity Budget in bytes, divided evenly between shards.
+ * \param policy Eviction policy.
+ * \param nShards Number of shards.
+ */
+BrickCache::BrickCache(qint64 capacity, Policy policy, int nShards)
+    : hits(0), misses(0), evictions(0)
+{
+    this->policy = policy;
+    shards.resize(size_t(qMax(nShards, 1)));
+    for (size_t i = 0; i < shards.size(); i++)
+        shards[i] = new BrickCacheShard();
+    setCapacity(capacity);
+}
+
+
+/*!
+ * \brief Destructor. All acquired bricks must be released before.
+ */
+BrickCache::~BrickCache()
+{
+    clear();
+    for (size_t i = 0; i < shards.size(); i++)
+        delete shards[i];
+}
+
+
+/*!
+ * \brief Returns the shard of a key.
+ */
+BrickCacheShard *BrickCache::getShard(quint64 dataset, qint64 iBrick)
+{
+    return shards[size_t((brickCacheHash(dataset, iBrick) >> 40) % shards.size())];
+}
+
+
+/*!
+ * \brief Sets the budget and evicts bricks exceeding it.
+ * \param capacity Budget in bytes.
+ */
+void BrickCache::setCapacity(qint64 capacity)
+{
+    this->capacity = qMax(capacity, qint64(0));
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        BrickCacheShard *shard = shards[i];
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->capacity = this->capacity / qint64(shards.size());
+        shard->target = qMin(shard->target, shard->capacity);
+        evictions += brickCacheEvict(shard, policy == ARC, false);
+    }
+}
+
+
+/*!
+ * \return Budget in bytes.
+ */
+qint64 BrickCache::getCapacity()
+{
+    return capacity;
+}
+
+
+/*!
+ * \return Eviction policy.
+ */
+BrickCache::Policy BrickCache::getPolicy()
+{
+    return policy;
+}
+
+
+/*!
+ * \return Number of shards.
+ */
+int BrickCache::getNumberOfShards()
+{
+    return int(shards.size());
+}
+
+
+/*!
+ * \return Bytes of cached bricks, including bricks being loaded.
+ */
+qint64 BrickCache::getBytes()
+{
+    qint64 bytes = 0;
+
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        std::lock_guard<std::mutex> lock(shards[i]->mutex);
+        bytes += shards[i]->bytes[0] + shards[i]->bytes[1];
+    }
+    return bytes;
+}
+
+
+/*!
+ * \return Number of cached bricks, including bricks being loaded.
+ */
+qint64 BrickCache::getNumberOfBricks()
+{
+    qint64 nBricks = 0;
+
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        std::lock_guard<std::mutex> lock(shards[i]->mutex);
+        nBricks += qint64(shards[i]->entries.size());
+    }
+    return nBricks;
+}
+
+
+/*!
+ * \return Number of acquire() calls served from the cache.
+ */
+qint64 BrickCache::getHits()
+{
+    return hits;
+}
+
+
+/*!
+ * \return Number of acquire() calls that loaded a brick.
+ */
+qint64 BrickCache::getMisses()
+{
+    return misses;
+}
+
+
+/*!
+ * \return Number of evicted bricks.
+ */
+qint64 BrickCache::getEvictions()
+{
+    return evictions;
+}
+
+
+/*!
+ * \return Fraction of acquire() calls served from the cache, 0 if there were none.
+ */
+double BrickCache::getHitRatio()
+{
+    qint64 h = hits, m = misses;
+    return (h + m) ? double(h) / double(h + m) : 0.0;
+}
+
+
+/*!
+ * \brief Resets hit, miss and eviction counters.
+ */
+void BrickCache::resetCounters()
+{
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+}
+
+
+/*!
+ * \brief Returns cells of a brick, loading them on a miss. The brick stays pinned until released.
+ *        May be called from several threads.
+ * \param dataset Dataset identifier, see getDatasetId().
+ * \param iBrick Brick index.
+ * \param nBytes Size of brick cells in bytes.
+ * \param load Function filling a buffer of nBytes bytes with brick cells, called without locks.
+ * \return Pointer to the cells, or nullptr if the brick could not be loaded.
+ */
+const uchar *BrickCache::acquire(quint64 dataset, qint64 iBrick, qint64 nBytes, std::function<bool(uchar *)> load)
+{
+    BrickCacheShard *shard = getShard(dataset, iBrick);
+    BrickCacheKey key = {dataset, iBrick};
+    BrickCacheEntry *entry;
+    BrickCacheList list = BrickCacheRecent;
+    bool frequentGhostHit = false;
+    bool ok = false;
+
+    if ((nBytes <= 0) || !load) return nullptr;
+    std::unique_lock<std::mutex> lock(shard->mutex);
+
+    auto found = shard->entries.find(key);
+    if (found != shard->entries.end())
+    {
+        entry = found->second;
+        entry->pins++;
+        hits++;
+        brickCacheUnlink(shard, entry);
+        brickCacheLink(shard, entry, (policy == ARC) ? BrickCacheFrequent : BrickCacheRecent);
+        shard->loaded.wait(lock, [entry]() { return entry->state != BrickCacheLoading; });
+        if (entry->state == BrickCacheFailed)
+        {
+            brickCacheUnpin(entry);
+            return nullptr;
+        }
+        return entry->buffer + brickCacheHeaderSize;
+    }
+
+    misses++;
+    if (policy == ARC)
+    {
+        auto ghost = shard->ghostIndex.find(key);
+        if (ghost != shard->ghostIndex.end())
+        {
+            qint64 recent = qMax(shard->ghostBytes[BrickCacheRecent], qint64(1));
+            qint64 frequent = qMax(shard->ghostBytes[BrickCacheFrequent], qint64(1));
+            if (ghost->second->list == BrickCacheRecent)
+                shard->target = qMin(shard->capacity, shard->target + nBytes * qMax(frequent / recent, qint64(1)));
+            else
+            {
+                shard->target = qMax(qint64(0), shard->target - nBytes * qMax(recent / frequent, qint64(1)));
+                frequentGhostHit = true;
+            }
+            brickCacheForget(shard, ghost->second);
+            list = BrickCacheFrequent;
+        }
+    }
+
+    entry = new BrickCacheEntry();
+    entry->key = key;
+    entry->nBytes = nBytes;
+    entry->buffer = nullptr;
+    entry->pins = 1;
+    entry->state = BrickCacheLoading;
+    entry->list = BrickCacheDetached;
+    brickCacheLink(shard, entry, list);
+    shard->entries[key] = entry;
+    evictions += brickCacheEvict(shard, policy == ARC, frequentGhostHit);
+    lock.unlock();
+
+    entry->buffer = new (std::nothrow) uchar[size_t(brickCacheHeaderSize + nBytes)];
+    if (entry->buffer)
+    {
+        memcpy(entry->buffer, &entry, sizeof(entry));
+        ok = load(entry->buffer + brickCacheHeaderSize);
+    }
+
+    lock.lock();
+    entry->state = ok ? BrickCacheReady : BrickCacheFailed;
+    if (!ok) brickCacheDetach(shard, entry);
+    shard->loaded.notify_all();
+    if (!ok)
+    {
+        brickCacheUnpin(entry);
+        return nullptr;
+    }
+    return entry->buffer + brickCacheHeaderSize;
+}
+
+
+/*!
+ * \brief Unpins a brick returned by acquire().
+ * \param cells Pointer returned by acquire().
+ */
+void BrickCache::release(const uchar *cells)
+{
+    BrickCacheEntry *entry;
+    BrickCacheShard *shard;
+
+    if (!cells) return;
+    memcpy(&entry, cells - brickCacheHeaderSize, sizeof(entry));
+    shard = getShard(entry->key.dataset, entry->key.iBrick);
+
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    brickCacheUnpin(entry);
+    if (shard->capacity < shard->bytes[0] + shard->bytes[1])
+        evictions += brickCacheEvict(shard, policy == ARC, false);
+}
+
+
+/*!
+ * \brief Removes all bricks of a dataset, e.g. after the dataset was modified.
+ *        Pinned bricks stay valid until released.
+ * \param dataset Dataset identifier.
+ */
+void BrickCache::remove(quint64 dataset)
+{
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        BrickCacheShard *shard = shards[i];
+        std::vector<BrickCacheEntry *> removed;
+        std::lock_guard<std::mutex> lock(shard->mutex);
+
+        for (auto it = shard->entries.begin(); it != shard->entries.end(); ++it)
+        {
+            if (it->first.dataset == dataset) removed.push_back(it->second);
+        }
+        for (size_t j = 0; j < removed.size(); j++)
+            brickCacheDetach(shard, removed[j]);
+
+        for (int list = 0; list < 2; list++)
+        {
+            for (auto ghost = shard->ghosts[list].begin(); ghost != shard->ghosts[list].end();)
+            {
+                auto next = std::next(ghost);
+                if (ghost->key.dataset == dataset) brickCacheForget(shard, ghost);
+                ghost = next;
+            }
+        }
+    }
+}
+
+
+/*!
+ * \brief Removes all bricks. Pinned bricks stay valid until released.
+ */
+void BrickCache::clear()
+{
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        BrickCacheShard *shard = shards[i];
+        std::lock_guard<std::mutex> lock(shard->mutex);
+
+        for (int list = 0; list < 2; list++)
+        {
+            while (!shard->lists[list].empty())
+                brickCacheDetach(shard, shard->lists[list].front());
+            shard->ghosts[list].clear();
+            shard->ghostBytes[list] = 0;
+        }
+        shard->ghostIndex.clear();
+        shard->target = 0;
+    }
+}
+
+
+/*!
+ * \brief Returns a dataset identifier derived from a key, e.g. an absolute file name with its size and
+ *        modification time, so that a rewritten file does not hit bricks of its previous content.
+ * \param key Dataset key.
+ * \return 64-bit FNV-1a hash of the key.
+ */
+quint64 BrickCache::getDatasetId(QString key)
+{
+    QByteArray bytes = key.toUtf8();
+    const uchar *data = reinterpret_cast<const uchar *>(bytes.constData());
+    quint64 hash = 14695981039346656037ULL;
+
+    for (int i = 0; i < bytes.size(); i++)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+/*!
+ * \brief Returns the process-wide cache shared by stores and workers. Its default budget is 256 MB.
+ * \return Pointer to the global cache.
+ */
+BrickCache *BrickCache::getGlobal()
+{
+    static BrickCache cache;
+    return &cache;
+}
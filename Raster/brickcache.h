@@ -0,0 +1,87 @@
+#ifndef BRICKCACHE_H
+#define BRICKCACHE_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file brickcache.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <QString>
+#include "g3dtcore_global.h"
+
+
+struct BrickCacheShard;
+
+
+/*!
+ * \brief The BrickCache keeps decoded bricks in memory within a byte budget.
+ *
+ *        Bricks are keyed by a dataset identifier and a brick index. acquire() returns the cached cells of
+ *        a brick, or loads them by a callback on a miss; concurrent requests of a brick being loaded wait for
+ *        the first load. Returned bricks are pinned and never evicted until release() is called.
+ *
+ *        Keys are spread over shards, each with its own lock, list and share of the budget. Eviction follows
+ *        the adaptive replacement cache (ARC) policy weighted by brick bytes: bricks used once and bricks used
+ *        repeatedly are kept in separate lists, and keys of recently evicted bricks steer the split between
+ *        them, so that a single scan does not flush the frequently used bricks. The LRU policy keeps a single
+ *        least-recently-used list. If all bricks of a shard are pinned, the budget is exceeded temporarily.
+ *
+ *        getGlobal() returns a cache shared by all stores and workers of the process.
+ */
+class G3DTCORE_EXPORT BrickCache
+{
+public:
+    enum Policy
+    {
+        LRU = 0, //!< least recently used
+        ARC = 1 //!< adaptive replacement cache
+    };
+
+public:
+    BrickCache(qint64 capacity = 256 * 1024 * 1024, Policy policy = ARC, int nShards = 16);
+    ~BrickCache();
+
+    void setCapacity(qint64 capacity);
+    qint64 getCapacity();
+    Policy getPolicy();
+    int getNumberOfShards();
+    qint64 getBytes();
+    qint64 getNumberOfBricks();
+
+    qint64 getHits();
+    qint64 getMisses();
+    qint64 getEvictions();
+    double getHitRatio();
+    void resetCounters();
+
+    const uchar *acquire(quint64 dataset, qint64 iBrick, qint64 nBytes, std::function<bool(uchar *)> load);
+    void release(const uchar *cells);
+    void remove(quint64 dataset);
+    void clear();
+
+    static quint64 getDatasetId(QString key);
+    static BrickCache *getGlobal();
+
+private:
+    qint64 capacity;
+    Policy policy;
+    std::vector<BrickCacheShard *> shards;
+    std::atomic<qint64> hits;
+    std::atomic<qint64> misses;
+    std::atomic<qint64> evictions;
+
+    BrickCacheShard *getShard(quint64 dataset, qint64 iBrick);
+};
+
+#endif // BRICKCACHE_H
@@ -0,0 +1,290 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file brickcodec.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <string.h>
+#include <vector>
+#include <QtEndian>
+#include "brickcodec.h"
+
+
+/*!
+ * \brief Replaces cells by differences to the previous cell; cells are treated as unsigned integers.
+ */
+template <typename T>
+static void brickCodecDelta(const uchar *cells, uchar *deltas, qint64 nCells)
+{
+    T previous = 0, value, delta;
+
+    for (qint64 i = 0; i < nCells; i++)
+    {
+        memcpy(&value, cells + i * qint64(sizeof(T)), sizeof(T));
+        delta = T(value - previous);
+        memcpy(deltas + i * qint64(sizeof(T)), &delta, sizeof(T));
+        previous = value;
+    }
+}
+
+
+/*!
+ * \brief Restores cells from differences in place.
+ */
+template <typename T>
+static void brickCodecUndelta(uchar *cells, qint64 nCells)
+{
+    T previous = 0, value;
+
+    for (qint64 i = 0; i < nCells; i++)
+    {
+        memcpy(&value, cells + i * qint64(sizeof(T)), sizeof(T));
+        previous = T(previous + value);
+        memcpy(cells + i * qint64(sizeof(T)), &previous, sizeof(T));
+    }
+}
+
+
+static bool brickCodecDelta(const uchar *cells, uchar *deltas, qint64 nCells, qint64 cellSize)
+{
+    switch (cellSize)
+    {
+    case 1: brickCodecDelta<quint8>(cells, deltas, nCells); return true;
+    case 2: brickCodecDelta<quint16>(cells, deltas, nCells); return true;
+    case 4: brickCodecDelta<quint32>(cells, deltas, nCells); return true;
+    case 8: brickCodecDelta<quint64>(cells, deltas, nCells); return true;
+    default: return false;
+    }
+}
+
+
+static bool brickCodecUndelta(uchar *cells, qint64 nCells, qint64 cellSize)
+{
+    switch (cellSize)
+    {
+    case 1: brickCodecUndelta<quint8>(cells, nCells); return true;
+    case 2: brickCodecUndelta<quint16>(cells, nCells); return true;
+    case 4: brickCodecUndelta<quint32>(cells, nCells); return true;
+    case 8: brickCodecUndelta<quint64>(cells, nCells); return true;
+    default: return false;
+    }
+}
+
+
+/*!
+ * \brief Tests whether all cells are equal.
+ * \param cells Cells.
+ * \param nCells Number of cells.
+ * \param cellSize Cell size in bytes.
+ * \return True, if all cells have the same bytes.
+ */
+bool BrickCodec::isConstant(const void *cells, qint64 nCells, qint64 cellSize)
+{
+    const uchar *p = static_cast<const uchar *>(cells);
+
+    for (qint64 i = 1; i < nCells; i++)
+        if (memcmp(p, p + i * cellSize, size_t(cellSize)) != 0) return false;
+    return true;
+}
+
+
+/*!
+ * \brief Counts runs of equal cells.
+ * \param cells Cells.
+ * \param nCells Number of cells.
+ * \param cellSize Cell size in bytes.
+ * \return Number of runs.
+ */
+qint64 BrickCodec::getNumberOfRuns(const void *cells, qint64 nCells, qint64 cellSize)
+{
+    const uchar *p = static_cast<const uchar *>(cells);
+    qint64 nRuns = (0 < nCells) ? 1 : 0;
+
+    for (qint64 i = 1; i < nCells; i++)
+        if (memcmp(p + (i - 1) * cellSize, p + i * cellSize, size_t(cellSize)) != 0) nRuns++;
+    return nRuns;
+}
+
+
+/*!
+ * \brief Encodes cells with a codec.
+ * \param cells Cells.
+ * \param nCells Number of cells.
+ * \param cellSize Cell size in bytes (1, 2, 4 or 8 for DeltaShuffle).
+ * \param codec Requested codec; Auto selects the smallest encoding.
+ * \param usedCodec Pointer receiving the codec of the payload.
+ * \param level Deflate compression level, 1 (fastest) to 9 (smallest).
+ * \return Encoded payload.
+ */
+QByteArray BrickCodec::encode(const void *cells, qint64 nCells, qint64 cellSize, Type codec, Type *usedCodec, int level)
+{
+    const uchar *p = static_cast<const uchar *>(cells);
+    qint64 nBytes = nCells * cellSize;
+    QByteArray payload;
+
+    if (codec == Auto)
+    {
+        if (isConstant(cells, nCells, cellSize))
+            return encode(cells, nCells, cellSize, Constant, usedCodec, level);
+
+        // runs are worth it when they are much shorter than the brick
+        QByteArray best;
+        Type bestCodec = Raw;
+        if (getNumberOfRuns(cells, nCells, cellSize) * (4 + cellSize) < nBytes / 4)
+            best = encode(cells, nCells, cellSize, RunLength, &bestCodec, level);
+        if (best.isEmpty() || (nBytes / 16 < best.size()))
+        {
+            Type shuffled;
+            payload = encode(cells, nCells, cellSize, DeltaShuffle, &shuffled, level);
+            if (best.isEmpty() || (payload.size() < best.size()))
+            {
+                best = payload;
+                bestCodec = shuffled;
+            }
+        }
+        if (best.isEmpty() || (nBytes <= best.size()))
+            return encode(cells, nCells, cellSize, Raw, usedCodec, level);
+        *usedCodec = bestCodec;
+        return best;
+    }
+
+    *usedCodec = codec;
+    switch (codec)
+    {
+    case Constant:
+        payload = QByteArray(reinterpret_cast<const char *>(p), int(cellSize));
+        break;
+
+    case RunLength:
+        for (qint64 i = 0; i < nCells;)
+        {
+            qint64 j = i + 1;
+            uchar count[4];
+            while ((j < nCells) && (j - i < 0xFFFFFFFFLL) && (memcmp(p + i * cellSize, p + j * cellSize, size_t(cellSize)) == 0)) j++;
+            qToLittleEndian<quint32>(quint32(j - i), count);
+            payload.append(reinterpret_cast<const char *>(count), 4);
+            payload.append(reinterpret_cast<const char *>(p + i * cellSize), int(cellSize));
+            i = j;
+        }
+        break;
+
+    case DeltaShuffle:
+    {
+        std::vector<uchar> deltas(static_cast<size_t>(nBytes));
+        std::vector<uchar> shuffled(static_cast<size_t>(nBytes));
+        if (!brickCodecDelta(p, deltas.data(), nCells, cellSize))
+            return encode(cells, nCells, cellSize, Deflate, usedCodec, level);
+        for (qint64 i = 0; i < nCells; i++)
+            for (qint64 b = 0; b < cellSize; b++)
+                shuffled[size_t(b * nCells + i)] = deltas[size_t(i * cellSize + b)];
+        payload = qCompress(shuffled.data(), int(nBytes), level);
+        break;
+    }
+
+    case Deflate:
+        payload = qCompress(p, int(nBytes), level);
+        break;
+
+    default:
+        *usedCodec = Raw;
+        payload = QByteArray(reinterpret_cast<const char *>(p), int(nBytes));
+        break;
+    }
+    return payload;
+}
+
+
+/*!
+ * \brief Decodes a payload to cells.
+ * \param payload Encoded payload.
+ * \param payloadSize Payload size in bytes.
+ * \param codec Codec of the payload.
+ * \param cells Output array of nCells cells.
+ * \param nCells Number of cells.
+ * \param cellSize Cell size in bytes.
+ * \return True, if the payload was decoded.
+ */
+bool BrickCodec::decode(const uchar *payload, qint64 payloadSize, Type codec, void *cells, qint64 nCells, qint64 cellSize)
+{
+    uchar *p = static_cast<uchar *>(cells);
+    qint64 nBytes = nCells * cellSize;
+
+    switch (codec)
+    {
+    case Raw:
+        if (payloadSize != nBytes) return false;
+        memcpy(p, payload, size_t(nBytes));
+        return true;
+
+    case Constant:
+        if (payloadSize != cellSize) return false;
+        if (cellSize == 1)
+        {
+            memset(p, payload[0], size_t(nCells));
+            return true;
+        }
+        for (qint64 i = 0; i < nCells; i++)
+            memcpy(p + i * cellSize, payload, size_t(cellSize));
+        return true;
+
+    case RunLength:
+    {
+        qint64 i = 0;
+        for (qint64 offset = 0; offset + 4 + cellSize <= payloadSize; offset += 4 + cellSize)
+        {
+            qint64 count = qFromLittleEndian<quint32>(payload + offset);
+            if (nCells < i + count) return false;
+            for (qint64 k = 0; k < count; k++, i++)
+                memcpy(p + i * cellSize, payload + offset + 4, size_t(cellSize));
+        }
+        return i == nCells;
+    }
+
+    case DeltaShuffle:
+    {
+        QByteArray shuffled = qUncompress(payload, int(payloadSize));
+        const uchar *s = reinterpret_cast<const uchar *>(shuffled.constData());
+        if (shuffled.size() != nBytes) return false;
+        for (qint64 b = 0; b < cellSize; b++)
+            for (qint64 i = 0; i < nCells; i++)
+                p[i * cellSize + b] = s[b * nCells + i];
+        return brickCodecUndelta(p, nCells, cellSize);
+    }
+
+    case Deflate:
+    {
+        QByteArray data = qUncompress(payload, int(payloadSize));
+        if (data.size() != nBytes) return false;
+        memcpy(p, data.constData(), size_t(nBytes));
+        return true;
+    }
+
+    default:
+        return false;
+    }
+}
+
+
+/*!
+ * \param codec Codec.
+ * \return Name of the codec.
+ */
+QString BrickCodec::toString(Type codec)
+{
+    switch (codec)
+    {
+    case Raw: return "Raw";
+    case Constant: return "Constant";
+    case RunLength: return "RunLength";
+    case DeltaShuffle: return "DeltaShuffle";
+    case Deflate: return "Deflate";
+    default: return "Auto";
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef BRICKCODEC_H
+#define BRICKCODEC_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file brickcodec.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <QByteArray>
+#include <QString>
+#include "g3dtcore_global.h"
+
+
+/*!
+ * \brief The BrickCodec compresses arrays of raster cells (bricks).
+ *        Constant bricks are stored as a single cell, masks and other piecewise constant bricks as runs,
+ *        smooth fields are delta-predicted, byte-shuffled and deflated. Auto selects the smallest encoding.
+ */
+class G3DTCORE_EXPORT BrickCodec
+{
+public:
+    enum Type
+    {
+        Raw = 0, //!< cells are stored unchanged
+        Constant = 1, //!< all cells are equal, a single cell is stored
+        RunLength = 2, //!< runs of equal cells as (quint32 count, cell) pairs
+        DeltaShuffle = 3, //!< differences of neighbouring cells, byte-shuffled and deflated
+        Deflate = 4, //!< cells deflated without preconditioning
+        Auto = 255 //!< the smallest of the above, chosen when encoding
+    };
+
+public:
+    static QByteArray encode(const void *cells, qint64 nCells, qint64 cellSize, Type codec, Type *usedCodec, int level = 1);
+    static bool decode(const uchar *payload, qint64 payloadSize, Type codec, void *cells, qint64 nCells, qint64 cellSize);
+    static bool isConstant(const void *cells, qint64 nCells, qint64 cellSize);
+    static qint64 getNumberOfRuns(const void *cells, qint64 nCells, qint64 cellSize);
+    static QString toString(Type codec);
+};
+
+#endif // BRICKCODEC_H
@@ -0,0 +1,165 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file brickgrid.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include "brickgrid.h"
+#include "g3dtnuma.h"
+#include "g3dtparallel.h"
+
+
+/*!
+ * \brief Default constructor. Creates an empty grid.
+ */
+BrickGrid::BrickGrid()
+{
+    for (int i = 0; i < 5; i++) nBricks[i] = 0;
+}
+
+
+/*!
+ * \brief Sets the raster and brick size.
+ * \param size Pointer to the raster size.
+ * \param brickSize Pointer to the brick shape.
+ * \return True, if all extents are positive.
+ */
+bool BrickGrid::setup(RasterSize3DT *size, RasterSize3DT *brickSize)
+{
+    for (int i = 0; i < 5; i++) nBricks[i] = 0;
+    if ((size->nCols < 1) || (size->nRows < 1) || (size->nLays < 1) || (size->nBands < 1) || (size->nTicks < 1)) return false;
+    if ((brickSize->nCols < 1) || (brickSize->nRows < 1) || (brickSize->nLays < 1) || (brickSize->nBands < 1) || (brickSize->nTicks < 1)) return false;
+
+    this->size = *size;
+    this->brickSize = *brickSize;
+    nBricks[0] = (size->nCols - 1) / brickSize->nCols + 1;
+    nBricks[1] = (size->nRows - 1) / brickSize->nRows + 1;
+    nBricks[2] = (size->nLays - 1) / brickSize->nLays + 1;
+    nBricks[3] = (size->nBands - 1) / brickSize->nBands + 1;
+    nBricks[4] = (size->nTicks - 1) / brickSize->nTicks + 1;
+    return true;
+}
+
+
+/*!
+ * \return Total number of bricks.
+ */
+qint64 BrickGrid::getNumberOfBricks()
+{
+    return nBricks[0] * nBricks[1] * nBricks[2] * nBricks[3] * nBricks[4];
+}
+
+
+/*!
+ * \brief Returns the index of the brick containing a cell. Indexes are not checked.
+ * \return Brick index.
+ */
+qint64 BrickGrid::getBrickIndex(qint64 col, qint64 row, qint64 lay, qint64 band, qint64 tick)
+{
+    return col / brickSize.nCols + nBricks[0] * (row / brickSize.nRows + nBricks[1] * (lay / brickSize.nLays +
+           nBricks[2] * (band / brickSize.nBands + nBricks[3] * (tick / brickSize.nTicks))));
+}
+
+
+/*!
+ * \brief Returns cells covered by a brick, clipped to the raster.
+ * \param iBrick Brick index.
+ * \return Raster block of the brick.
+ */
+RasterBlock BrickGrid::getBrickBlock(qint64 iBrick)
+{
+    RasterBlock block;
+    qint64 bx = iBrick % nBricks[0];
+    qint64 by = (iBrick / nBricks[0]) % nBricks[1];
+    qint64 bz = (iBrick / (nBricks[0] * nBricks[1])) % nBricks[2];
+    qint64 bb = (iBrick / (nBricks[0] * nBricks[1] * nBricks[2])) % nBricks[3];
+    qint64 bt = iBrick / (nBricks[0] * nBricks[1] * nBricks[2] * nBricks[3]);
+
+    block.set(bx * brickSize.nCols, by * brickSize.nRows, bz * brickSize.nLays, bb * brickSize.nBands, bt * brickSize.nTicks,
+              qMin((bx + 1) * brickSize.nCols, size.nCols) - 1, qMin((by + 1) * brickSize.nRows, size.nRows) - 1,
+              qMin((bz + 1) * brickSize.nLays, size.nLays) - 1, qMin((bb + 1) * brickSize.nBands, size.nBands) - 1,
+              qMin((bt + 1) * brickSize.nTicks, size.nTicks) - 1);
+    return block;
+}
+
+
+/*!
+ * \brief Tests whether a block is non-empty and lies inside the raster.
+ * \param block Pointer to a raster block.
+ * \return True, if the block is inside the raster.
+ */
+bool BrickGrid::isInside(RasterBlock *block)
+{
+    return (0 <= block->col0) && (block->col0 <= block->col1) && (block->col1 < size.nCols) &&
+           (0 <= block->row0) && (block->row0 <= block->row1) && (block->row1 < size.nRows) &&
+           (0 <= block->lay0) && (block->lay0 <= block->lay1) && (block->lay1 < size.nLays) &&
+           (0 <= block->band0) && (block->band0 <= block->band1) && (block->band1 < size.nBands) &&
+           (0 <= block->tick0) && (block->tick0 <= block->tick1) && (block->tick1 < size.nTicks);
+}
+
+
+/*!
+ * \brief Calls a function in parallel for every brick overlapping a raster block.
+ *        With a view of the block, bricks are preferably processed on the NUMA node holding their cells
+ *        in the view (G3DTParallel::forEachOnNodes()).
+ * \param block Pointer to a raster block inside the raster.
+ * \param func Function called with the brick index, the overlap in brick coordinates
+ *        and the overlap in block coordinates.
+ * \param nThreads Number of threads, 0 for default.
+ * \param view Pointer to a view with the extents of the block read or written by func, may be nullptr.
+ * \return True, if the block is inside the raster and all bricks were processed; false also if the current
+ *         G3DTCancelToken stopped the loop.
+ */
+bool BrickGrid::forEachBrick(RasterBlock *block, std::function<void(qint64, RasterBlock *, RasterBlock *)> func, int nThreads,
+                             RasterView *view)
+{
+    qint64 c0[5] = {block->col0, block->row0, block->lay0, block->band0, block->tick0};
+    qint64 c1[5] = {block->col1, block->row1, block->lay1, block->band1, block->tick1};
+    qint64 bs[5] = {brickSize.nCols, brickSize.nRows, brickSize.nLays, brickSize.nBands, brickSize.nTicks};
+    qint64 b0[5], nb[5], nItems = 1;
+
+    if (!isInside(block)) return false;
+    for (int axis = 0; axis < 5; axis++)
+    {
+        b0[axis] = c0[axis] / bs[axis];
+        nb[axis] = c1[axis] / bs[axis] - b0[axis] + 1;
+        nItems *= nb[axis];
+    }
+
+    auto locate = [&](qint64 iItem, qint64 *brick, qint64 *lo, qint64 *hi) {
+        qint64 rest = iItem;
+        for (int axis = 0; axis < 5; axis++)
+        {
+            brick[axis] = b0[axis] + rest % nb[axis];
+            rest /= nb[axis];
+            lo[axis] = qMax(c0[axis], brick[axis] * bs[axis]);
+            hi[axis] = qMin(c1[axis], (brick[axis] + 1) * bs[axis] - 1);
+        }
+    };
+    auto work = [&](qint64 iItem, int) {
+        qint64 brick[5], lo[5], hi[5];
+        RasterBlock inBrick, inBlock;
+
+        locate(iItem, brick, lo, hi);
+        qint64 iBrick = brick[0] + nBricks[0] * (brick[1] + nBricks[1] * (brick[2] + nBricks[2] * (brick[3] + nBricks[3] * brick[4])));
+        inBrick.set(lo[0] - brick[0] * bs[0], lo[1] - brick[1] * bs[1], lo[2] - brick[2] * bs[2], lo[3] - brick[3] * bs[3], lo[4] - brick[4] * bs[4],
+                    hi[0] - brick[0] * bs[0], hi[1] - brick[1] * bs[1], hi[2] - brick[2] * bs[2], hi[3] - brick[3] * bs[3], hi[4] - brick[4] * bs[4]);
+        inBlock.set(lo[0] - c0[0], lo[1] - c0[1], lo[2] - c0[2], lo[3] - c0[3], lo[4] - c0[4],
+                    hi[0] - c0[0], hi[1] - c0[1], hi[2] - c0[2], hi[3] - c0[3], hi[4] - c0[4]);
+        func(iBrick, &inBrick, &inBlock);
+    };
+
+    if (!view || !view->isValid()) return G3DTParallel::forEach(nItems, work, nThreads);
+    return G3DTParallel::forEachOnNodes(nItems, [&](qint64 iItem) {
+        qint64 brick[5], lo[5], hi[5];
+        locate(iItem, brick, lo, hi);
+        return G3DTNuma::getNodeOfAddress(view->getCell(lo[0] - c0[0], lo[1] - c0[1], lo[2] - c0[2], lo[3] - c0[3], lo[4] - c0[4]));
+    }, work, nThreads);
+}
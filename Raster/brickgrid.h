@@ -0,0 +1,50 @@
+#ifndef BRICKGRID_H
+#define BRICKGRID_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file brickgrid.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <functional>
+#include "g3dtcore_global.h"
+#include "Geometry/rasterblock.h"
+#include "Geometry/rastersize3dt.h"
+#include "rasterview.h"
+
+
+/*!
+ * \brief The BrickGrid splits a raster into bricks of equal shape.
+ *        Bricks are indexed by column, row, layer, band and tick brick index, column fastest.
+ *        Bricks on the raster boundary are clipped.
+ */
+class G3DTCORE_EXPORT BrickGrid
+{
+public:
+    RasterSize3DT size; //!< raster size
+    RasterSize3DT brickSize; //!< brick shape
+    qint64 nBricks[5]; //!< number of bricks along column, row, layer, band and tick axes
+
+public:
+    BrickGrid();
+
+    bool setup(RasterSize3DT *size, RasterSize3DT *brickSize);
+
+    qint64 getNumberOfBricks();
+    qint64 getBrickIndex(qint64 col, qint64 row, qint64 lay, qint64 band, qint64 tick);
+    RasterBlock getBrickBlock(qint64 iBrick);
+    bool isInside(RasterBlock *block);
+
+    bool forEachBrick(RasterBlock *block, std::function<void(qint64 iBrick, RasterBlock *inBrick, RasterBlock *inBlock)> func, int nThreads = 0,
+                      RasterView *view = nullptr);
+};
+
+#endif // BRICKGRID_H
@@ -0,0 +1,601 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file brickprefetcher.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <errno.h>
+#include <string.h>
+#include "brickprefetcher.h"
+
+#if defined(Q_OS_UNIX)
+#include <unistd.h>
+#endif
+
+#if defined(Q_OS_LINUX) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define G3DT_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+#endif
+
+
+#ifdef G3DT_IO_URING
+
+/*!
+ * \brief Minimal io_uring submission and completion rings, set up through raw system calls
+ *        so that no user-space library is required. Reads are submitted as single-vector READV
+ *        operations, supported by all io_uring kernels; user_data carries the buffer slot.
+ *        Without SQPOLL the kernel consumes submissions only inside io_uring_enter, so a submission
+ *        it did not consume can be withdrawn from the ring.
+ */
+struct BrickPrefetchRing
+{
+    int fd;
+    uchar *sqMap;
+    uchar *cqMap;
+    size_t sqMapSize;
+    size_t cqMapSize;
+    io_uring_sqe *sqes;
+    size_t sqesSize;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    io_uring_cqe *cqes;
+    std::vector<iovec> iovecs;
+
+    BrickPrefetchRing()
+    {
+        fd = -1;
+        sqMap = cqMap = nullptr;
+        sqes = nullptr;
+        sqMapSize = cqMapSize = sqesSize = 0;
+    }
+
+    ~BrickPrefetchRing()
+    {
+        if (sqes) munmap(sqes, sqesSize);
+        if (cqMap && (cqMap != sqMap)) munmap(cqMap, cqMapSize);
+        if (sqMap) munmap(sqMap, sqMapSize);
+        if (0 <= fd) ::close(fd);
+    }
+
+    bool setup(unsigned entries)
+    {
+        io_uring_params params;
+        void *p;
+
+        memset(&params, 0, sizeof(params));
+        fd = int(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) return false;
+
+        sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) sqMapSize = cqMapSize = qMax(sqMapSize, cqMapSize);
+
+        p = mmap(nullptr, sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (p == MAP_FAILED) return false;
+        sqMap = static_cast<uchar *>(p);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) cqMap = sqMap;
+        else
+        {
+            p = mmap(nullptr, cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (p == MAP_FAILED) return false;
+            cqMap = static_cast<uchar *>(p);
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        p = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (p == MAP_FAILED) return false;
+        sqes = static_cast<io_uring_sqe *>(p);
+
+        sqHead = reinterpret_cast<unsigned *>(sqMap + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned *>(sqMap + params.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned *>(sqMap + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned *>(sqMap + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned *>(cqMap + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned *>(cqMap + params.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned *>(cqMap + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe *>(cqMap + params.cq_off.cqes);
+        iovecs.resize(entries);
+        return true;
+    }
+
+    /*!
+     * \brief Submits a read of a slot.
+     * \return True, if the kernel took the read; its completion arrives later even if io_uring_enter failed.
+     *         False, if the read was withdrawn and the slot buffer is not used by the kernel.
+     */
+    bool submit(int slot, int fileHandle, uchar *data, qint64 size, qint64 offset)
+    {
+        unsigned tail = *sqTail;
+        unsigned index = tail & *sqMask;
+        io_uring_sqe *sqe = &sqes[index];
+        long n;
+
+        iovecs[size_t(slot)].iov_base = data;
+        iovecs[size_t(slot)].iov_len = size_t(size);
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = fileHandle;
+        sqe->off = quint64(offset);
+        sqe->addr = quint64(reinterpret_cast<quintptr>(&iovecs[size_t(slot)]));
+        sqe->len = 1;
+        sqe->user_data = quint64(slot);
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+        do n = syscall(__NR_io_uring_enter, fd, 1, 0, 0, nullptr, 0);
+        while ((n < 0) && (errno == EINTR));
+        if (n == 1) return true;
+        if (__atomic_load_n(sqHead, __ATOMIC_ACQUIRE) != tail) return true;
+        __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+        return false;
+    }
+
+    bool wait(int *slot, int *result)
+    {
+        for (;;)
+        {
+            unsigned head = *cqHead;
+            if (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+            {
+                io_uring_cqe *cqe = &cqes[head & *cqMask];
+                *slot = int(cqe->user_data);
+                *result = cqe->res;
+                __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+            if ((syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0) && (errno != EINTR)) return false;
+        }
+    }
+};
+
+#else
+
+/*!
+ * \brief Placeholder on systems without io_uring; setup always fails.
+ */
+struct BrickPrefetchRing
+{
+    bool setup(unsigned) { return false; }
+    bool submit(int, int, uchar *, qint64, qint64) { return false; }
+    bool wait(int *, int *) { return false; }
+};
+
+#endif
+
+
+/*!
+ * \brief Default constructor.
+ */
+BrickPrefetcher::BrickPrefetcher()
+{
+    backend = Auto;
+    queueDepth = 16;
+    nThreads = 4;
+    alignment = 4096;
+    metrics = nullptr;
+    activeBackend = Auto;
+    nSubmitted = 0;
+    nReturned = 0;
+    buffers = nullptr;
+    bufferBytes = 0;
+    ring = nullptr;
+    stopping = false;
+}
+
+
+/*!
+ * \brief Destructor. Stops prefetching and closes the file.
+ */
+BrickPrefetcher::~BrickPrefetcher()
+{
+    close();
+}
+
+
+/*!
+ * \brief Stores an error description.
+ * \return Always false.
+ */
+bool BrickPrefetcher::fail(QString message)
+{
+    errorString = message;
+    return false;
+}
+
+
+/*!
+ * \brief Opens a file for prefetching. The file is opened separately from raster files reading it.
+ * \param fileName File name.
+ * \return True, if the file was opened.
+ */
+bool BrickPrefetcher::open(QString fileName)
+{
+    close();
+    errorString.clear();
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadOnly)) return fail("Cannot open " + fileName + ".");
+    return true;
+}
+
+
+/*!
+ * \brief Stops prefetching and closes the file.
+ */
+void BrickPrefetcher::close()
+{
+    stop();
+    if (file.isOpen()) file.close();
+}
+
+
+/*!
+ * \return True, if a file is open.
+ */
+bool BrickPrefetcher::isOpen()
+{
+    return file.isOpen();
+}
+
+
+/*!
+ * \return Backend of the running or last schedule, Auto if no schedule was started.
+ */
+BrickPrefetcher::Backend BrickPrefetcher::getBackend()
+{
+    return activeBackend;
+}
+
+
+/*!
+ * \brief Starts prefetching a schedule. A running schedule is stopped first.
+ * \param schedule Reads in the order they will be consumed.
+ * \return True, if prefetching was started.
+ */
+bool BrickPrefetcher::start(const std::vector<BrickPrefetchRequest> &schedule)
+{
+    qint64 maxSize = 0;
+    int nSlots;
+
+    stop();
+    errorString.clear();
+    if (!file.isOpen()) return fail("No file is open.");
+    if ((queueDepth < 1) || (alignment < 1)) return fail("Invalid queue depth or alignment.");
+
+    requests = schedule;
+    states.assign(requests.size(), Waiting);
+    requestSlots.assign(requests.size(), -1);
+    nSubmitted = 0;
+    nReturned = 0;
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        if ((requests[i].offset < 0) || (requests[i].size < 0)) return fail("Invalid prefetch request.");
+        maxSize = qMax(maxSize, requests[i].size);
+    }
+
+    nSlots = int(qMin(qint64(queueDepth), qMax(qint64(requests.size()), qint64(1))));
+    bufferBytes = qMax((maxSize + alignment - 1) / alignment * alignment, alignment);
+    memory.resize(size_t(nSlots * bufferBytes + alignment));
+    buffers = memory.data() + (alignment - qint64(reinterpret_cast<quintptr>(memory.data()) % quintptr(alignment))) % alignment;
+    slotRequests.assign(size_t(nSlots), -1);
+    slotBytesRead.assign(size_t(nSlots), 0);
+    freeSlots.clear();
+    for (int slot = nSlots - 1; 0 <= slot; slot--) freeSlots.push_back(slot);
+
+    activeBackend = ThreadPool;
+    if (backend != ThreadPool)
+    {
+        ring = new BrickPrefetchRing();
+        if (ring->setup(unsigned(nSlots))) activeBackend = IoUring;
+        else
+        {
+            delete ring;
+            ring = nullptr;
+            if (backend == IoUring) return fail("io_uring is not available.");
+        }
+    }
+    if (activeBackend == ThreadPool)
+    {
+        stopping = false;
+        for (int i = 0; i < qBound(1, nThreads, nSlots); i++)
+            threads.push_back(std::thread(&BrickPrefetcher::readLoop, this));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    submit();
+    return true;
+}
+
+
+/*!
+ * \brief Starts prefetching bricks of a raster file. The prefetcher must have the raster file open.
+ * \param file Pointer to an open raster file.
+ * \param bricks Brick indexes in the order they will be consumed.
+ * \return True, if prefetching was started.
+ */
+bool BrickPrefetcher::start(RasterFile *file, const std::vector<qint64> &bricks)
+{
+    std::vector<BrickPrefetchRequest> schedule(bricks.size());
+    qint64 brickCellBytes = file->brickSize.getNumberOfCells() * RasterCell::getSize(file->cellType);
+
+    for (size_t i = 0; i < bricks.size(); i++)
+    {
+        if ((bricks[i] < 0) || (file->getNumberOfBricks() <= bricks[i])) return fail("Invalid brick index.");
+        schedule[i].iBrick = bricks[i];
+        schedule[i].offset = file->getBrickOffset(bricks[i]);
+        schedule[i].size = brickCellBytes;
+    }
+    return start(schedule);
+}
+
+
+/*!
+ * \brief Starts prefetching brick payloads of a brick store. The prefetcher must have the store file open.
+ *        Payloads are decoded by BrickStore::decodeBrick(); bricks never written have no payload.
+ * \param store Pointer to an open brick store.
+ * \param bricks Brick indexes in the order they will be consumed.
+ * \return True, if prefetching was started.
+ */
+bool BrickPrefetcher::start(BrickStore *store, const std::vector<qint64> &bricks)
+{
+    std::vector<BrickPrefetchRequest> schedule(bricks.size());
+
+    for (size_t i = 0; i < bricks.size(); i++)
+    {
+        if ((bricks[i] < 0) || (store->getNumberOfBricks() <= bricks[i])) return fail("Invalid brick index.");
+        BrickStoreEntry entry = store->getEntry(bricks[i]);
+        schedule[i].iBrick = bricks[i];
+        schedule[i].offset = qMax(entry.offset, qint64(0));
+        schedule[i].size = (entry.offset < 0) ? 0 : entry.size;
+    }
+    return start(schedule);
+}
+
+
+/*!
+ * \brief Stops prefetching. Waits for reads in flight; buffers returned by next() become invalid.
+ */
+void BrickPrefetcher::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queue.clear();
+    }
+    changed.notify_all();
+    for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+    threads.clear();
+
+    if (ring)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t slot = 0; slot < slotRequests.size(); slot++)
+            while ((0 <= slotRequests[slot]) && (states[size_t(slotRequests[slot])] == Reading))
+                if (!waitForCompletion()) break;
+        delete ring;
+        ring = nullptr;
+    }
+
+    stopping = false;
+    requests.clear();
+    states.clear();
+    requestSlots.clear();
+    slotRequests.clear();
+    slotBytesRead.clear();
+    freeSlots.clear();
+    nSubmitted = 0;
+    nReturned = 0;
+}
+
+
+/*!
+ * \brief Assigns free buffers to the next scheduled requests and submits their reads. The mutex is held.
+ */
+void BrickPrefetcher::submit()
+{
+    while ((nSubmitted < qint64(requests.size())) && !freeSlots.empty())
+    {
+        qint64 iRequest = nSubmitted++;
+        int slot = freeSlots.back();
+
+        freeSlots.pop_back();
+        requestSlots[size_t(iRequest)] = slot;
+        slotRequests[size_t(slot)] = iRequest;
+        slotBytesRead[size_t(slot)] = 0;
+        if (requests[size_t(iRequest)].size == 0) states[size_t(iRequest)] = Done;
+        else
+        {
+            states[size_t(iRequest)] = Reading;
+            if (!ring) queue.push_back(iRequest);
+            else if (!submitRead(slot)) states[size_t(iRequest)] = Failed;
+        }
+    }
+    if (!ring) changed.notify_all();
+}
+
+
+/*!
+ * \brief Submits the remaining part of a buffer read to io_uring. The mutex is held.
+ * \return False, if the read was not submitted; the kernel does not write into the slot buffer then,
+ *         so the slot may be reused. A submitted read keeps the request Reading until its completion.
+ */
+bool BrickPrefetcher::submitRead(int slot)
+{
+    BrickPrefetchRequest *request = &requests[size_t(slotRequests[size_t(slot)])];
+    qint64 done = slotBytesRead[size_t(slot)];
+
+    return ring->submit(slot, file.handle(), buffers + slot * bufferBytes + done, request->size - done, request->offset + done);
+}
+
+
+/*!
+ * \brief Waits for one io_uring completion and updates the request state; short reads are resubmitted.
+ *        The mutex is held.
+ * \return False, if waiting failed.
+ */
+bool BrickPrefetcher::waitForCompletion()
+{
+    int slot, result;
+    qint64 iRequest;
+
+    if (!ring->wait(&slot, &result)) return false;
+    iRequest = slotRequests[size_t(slot)];
+    if ((result == -EINTR) || (result == -EAGAIN))
+    {
+        if (!submitRead(slot)) states[size_t(iRequest)] = Failed;
+        return true;
+    }
+    if (result <= 0)
+    {
+        states[size_t(iRequest)] = Failed;
+        return true;
+    }
+    slotBytesRead[size_t(slot)] += result;
+    if (slotBytesRead[size_t(slot)] < requests[size_t(iRequest)].size)
+    {
+        if (!submitRead(slot)) states[size_t(iRequest)] = Failed;
+    }
+    else states[size_t(iRequest)] = Done;
+    return true;
+}
+
+
+/*!
+ * \brief Reads requests from the queue on a prefetch thread of the thread-pool backend.
+ */
+void BrickPrefetcher::readLoop()
+{
+    for (;;)
+    {
+        qint64 iRequest, done = 0;
+        BrickPrefetchRequest request;
+        uchar *data;
+        bool ok = true;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (stopping) return;
+            iRequest = queue.front();
+            queue.pop_front();
+            request = requests[size_t(iRequest)];
+            data = buffers + requestSlots[size_t(iRequest)] * bufferBytes;
+        }
+
+        while (ok && (done < request.size))
+        {
+#if defined(Q_OS_UNIX)
+            ssize_t n = pread(file.handle(), data + done, size_t(request.size - done), off_t(request.offset + done));
+            if ((n < 0) && (errno == EINTR)) continue;
+#else
+            qint64 n;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                n = file.seek(request.offset + done) ? file.read(reinterpret_cast<char *>(data + done), request.size - done) : -1;
+            }
+#endif
+            if (n <= 0) ok = false;
+            else done += n;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            states[size_t(iRequest)] = ok ? Done : Failed;
+        }
+        changed.notify_all();
+    }
+}
+
+
+/*!
+ * \brief Returns the buffer of the next scheduled request, waiting for its read to complete.
+ *        The buffer stays valid until it is passed to release().
+ * \param request Output request of the buffer.
+ * \return Pointer to request->size bytes, or nullptr at the end of the schedule or on error (errorString is set).
+ *         The buffer of a failed read goes back to the prefetcher.
+ */
+const uchar *BrickPrefetcher::next(BrickPrefetchRequest *request)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    qint64 iRequest = nReturned;
+
+    if (iRequest >= qint64(requests.size())) return nullptr;
+    if (states[size_t(iRequest)] == Waiting)
+    {
+        fail("All prefetch buffers are held by the consumer.");
+        return nullptr;
+    }
+    while (states[size_t(iRequest)] == Reading)
+    {
+        if (!ring) changed.wait(lock);
+        else if (!waitForCompletion())
+        {
+            fail("Waiting for io_uring completions failed.");
+            return nullptr;
+        }
+    }
+    if (states[size_t(iRequest)] == Failed)
+    {
+        int slot = requestSlots[size_t(iRequest)];
+        if (slotRequests[size_t(slot)] == iRequest)
+        {
+            slotRequests[size_t(slot)] = -1;
+            freeSlots.push_back(slot);
+            submit();
+        }
+        fail(QString("Cannot read brick %1.").arg(requests[size_t(iRequest)].iBrick));
+        return nullptr;
+    }
+
+    *request = requests[size_t(iRequest)];
+    nReturned++;
+    if (metrics) metrics->getCounter("brickPrefetcher.bytesRead")->add(request->size);
+    return buffers + requestSlots[size_t(iRequest)] * bufferBytes;
+}
+
+
+/*!
+ * \brief Returns a buffer to the prefetcher; its slot is used for the next scheduled read.
+ * \param buffer Pointer returned by next().
+ */
+void BrickPrefetcher::release(const uchar *buffer)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    qint64 slot;
+
+    if (!buffer || (buffer < buffers)) return;
+    slot = (buffer - buffers) / bufferBytes;
+    if ((qint64(slotRequests.size()) <= slot) || (slotRequests[size_t(slot)] < 0)) return;
+    slotRequests[size_t(slot)] = -1;
+    freeSlots.push_back(int(slot));
+    submit();
+}
+
+
+/*!
+ * \brief Returns the name of a backend.
+ */
+QString BrickPrefetcher::toString(Backend backend)
+{
+    switch (backend)
+    {
+    case IoUring: return "io_uring";
+    case ThreadPool: return "ThreadPool";
+    default: return "Auto";
+    }
+}
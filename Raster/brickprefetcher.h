@@ -0,0 +1,128 @@
+#ifndef BRICKPREFETCHER_H
+#define BRICKPREFETCHER_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file brickprefetcher.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <QFile>
+#include <QString>
+#include "g3dtcore_global.h"
+#include "g3dtmetrics.h"
+#include "brickstore.h"
+#include "rasterfile.h"
+
+
+struct BrickPrefetchRing;
+
+
+/*!
+ * \brief A read of the brick schedule.
+ */
+struct BrickPrefetchRequest
+{
+    qint64 iBrick; //!< brick index, passed through to the consumer
+    qint64 offset; //!< file offset in bytes
+    qint64 size; //!< number of bytes to read, 0 for bricks without data
+};
+
+
+/*!
+ * \brief The BrickPrefetcher reads a schedule of bricks ahead of the consumer.
+ *
+ *        Up to queueDepth reads are kept in flight, each into its own aligned buffer. next() returns
+ *        buffers in schedule order without copying; a buffer is reused for the next scheduled read once
+ *        the consumer passes it to release(). The consumer may hold up to queueDepth buffers at once.
+ *
+ *        On Linux reads are submitted through io_uring; if the kernel refuses io_uring, or on other
+ *        systems, reads are executed by a small pool of threads calling pread().
+ */
+class G3DTCORE_EXPORT BrickPrefetcher
+{
+public:
+    enum Backend
+    {
+        Auto = 0, //!< io_uring if available, otherwise thread pool
+        IoUring = 1, //!< Linux io_uring
+        ThreadPool = 2 //!< blocking reads on prefetch threads
+    };
+
+    Backend backend; //!< requested backend
+    int queueDepth; //!< number of reads in flight and number of buffers
+    int nThreads; //!< number of prefetch threads of the thread-pool backend
+    qint64 alignment; //!< buffer alignment in bytes
+    G3DTMetrics *metrics; //!< receives the counter "brickPrefetcher.bytesRead" of buffers returned by next(), may be nullptr
+    QString errorString; //!< description of the last error
+
+public:
+    BrickPrefetcher();
+    ~BrickPrefetcher();
+
+    bool open(QString fileName);
+    void close();
+    bool isOpen();
+    Backend getBackend();
+
+    bool start(const std::vector<BrickPrefetchRequest> &schedule);
+    bool start(RasterFile *file, const std::vector<qint64> &bricks);
+    bool start(BrickStore *store, const std::vector<qint64> &bricks);
+    void stop();
+
+    const uchar *next(BrickPrefetchRequest *request);
+    void release(const uchar *buffer);
+
+    static QString toString(Backend backend);
+
+private:
+    enum State
+    {
+        Waiting, //!< not submitted yet
+        Reading, //!< read in flight
+        Done, //!< buffer ready
+        Failed //!< read failed
+    };
+
+    QFile file;
+    Backend activeBackend;
+    std::vector<BrickPrefetchRequest> requests;
+    std::vector<State> states;
+    std::vector<int> requestSlots;
+    qint64 nSubmitted; //!< number of requests assigned to a buffer
+    qint64 nReturned; //!< number of requests returned by next()
+
+    std::vector<uchar> memory;
+    uchar *buffers;
+    qint64 bufferBytes;
+    std::vector<qint64> slotRequests;
+    std::vector<qint64> slotBytesRead;
+    std::vector<int> freeSlots;
+
+    BrickPrefetchRing *ring;
+    std::vector<std::thread> threads;
+    std::deque<qint64> queue;
+    bool stopping;
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    bool fail(QString message);
+    void submit();
+    bool submitRead(int slot);
+    bool waitForCompletion();
+    void readLoop();
+};
+
+#endif // BRICKPREFETCHER_H
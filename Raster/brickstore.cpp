@@ -0,0 +1,709 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file brickstore.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <string.h>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QtEndian>
+#include "brickstore.h"
+#include "g3dtnuma.h"
+#include "g3dtparallel.h"
+
+
+/*!
+ * \brief File signature and format version.
+ */
+static const char brickStoreMagic[8] = {'G', '3', 'D', 'T', 'B', 'R', 'K', 'S'};
+static const quint32 brickStoreVersion = 1;
+
+
+/*!
+ * \brief Size of a directory entry in bytes: qint64 offset, qint64 size, quint32 codec, quint32 reserved.
+ */
+static const qint64 brickStoreEntrySize = 24;
+
+
+/*!
+ * \brief Byte offsets of header fields.
+ */
+enum BrickStoreHeaderField
+{
+    BrickStoreMagic = 0, //!< char[8]
+    BrickStoreVersion = 8, //!< quint32
+    BrickStoreHeaderSize = 12, //!< quint32
+    BrickStoreCellType = 16, //!< quint32
+    BrickStoreInterleave = 20, //!< quint32
+    BrickStoreSize = 24, //!< qint64[5]: columns, rows, layers, bands, ticks
+    BrickStoreBrickSize = 64, //!< qint64[5]
+    BrickStoreExtent = 104, //!< double[8]: x0, y0, z0, t0, x1, y1, z1, t1
+    BrickStoreNoData = 168, //!< double
+    BrickStoreUseNoData = 176, //!< quint32
+    BrickStoreDirectoryOffset = 184, //!< qint64
+    BrickStoreNumberOfBricks = 192 //!< qint64
+};
+
+
+template <typename T>
+static void brickStorePut(uchar *buffer, qint64 offset, T value)
+{
+    qToLittleEndian<T>(value, buffer + offset);
+}
+
+
+template <typename T>
+static T brickStoreGet(const uchar *buffer, qint64 offset)
+{
+    return qFromLittleEndian<T>(buffer + offset);
+}
+
+
+static void brickStorePutDouble(uchar *buffer, qint64 offset, double value)
+{
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    brickStorePut<quint64>(buffer, offset, bits);
+}
+
+
+static double brickStoreGetDouble(const uchar *buffer, qint64 offset)
+{
+    quint64 bits = brickStoreGet<quint64>(buffer, offset);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+
+/*!
+ * \brief Content hash of a payload, processed in 64-bit words.
+ */
+static quint64 brickStoreHash(const uchar *data, qint64 size, quint64 hash)
+{
+    qint64 i = 0;
+    quint64 word;
+
+    for (; i + 8 <= size; i += 8)
+    {
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001B3ULL;
+        hash ^= hash >> 29;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ data[i]) * 0x100000001B3ULL;
+    return hash ^ quint64(size);
+}
+
+
+/*!
+ * \brief Multiplies non-negative numbers.
+ * \return False, if the product overflows qint64.
+ */
+static bool brickStoreMultiply(qint64 a, qint64 b, qint64 *product)
+{
+    if ((0 < a) && (std::numeric_limits<qint64>::max() / a < b)) return false;
+    *product = a * b;
+    return true;
+}
+
+
+/*!
+ * \brief Computes the number of bytes of all cells of a size.
+ * \return False, if the number overflows qint64.
+ */
+static bool brickStoreGetBytes(RasterSize3DT *size, qint64 cellSize, qint64 *nBytes)
+{
+    return brickStoreMultiply(size->nCols, size->nRows, nBytes) && brickStoreMultiply(*nBytes, size->nLays, nBytes) &&
+           brickStoreMultiply(*nBytes, size->nBands, nBytes) && brickStoreMultiply(*nBytes, size->nTicks, nBytes) &&
+           brickStoreMultiply(*nBytes, cellSize, nBytes);
+}
+
+
+/*!
+ * \brief Default constructor.
+ */
+BrickStore::BrickStore()
+{
+    brickSize.set(64, 64, 64, 1, 1);
+    cellType = RasterCell::Float64;
+    interleave = RasterView::BSQ;
+    useNoData = false;
+    noData = -9999.0;
+    codec = BrickCodec::Auto;
+    compressionLevel = 1;
+    deduplicate = true;
+    cache = nullptr;
+    metrics = nullptr;
+    map = nullptr;
+    writing = false;
+    fileSize = 0;
+    cacheId = 0;
+}
+
+
+/*!
+ * \brief Destructor. Closes the file.
+ */
+BrickStore::~BrickStore()
+{
+    close();
+}
+
+
+/*!
+ * \brief Stores an error description and closes the file without writing the directory.
+ * \return Always false.
+ */
+bool BrickStore::fail(QString message)
+{
+    errorString = message;
+    writing = false;
+    close();
+    return false;
+}
+
+
+/*!
+ * \brief Writes the header at the beginning of the file.
+ */
+bool BrickStore::writeHeader(qint64 directoryOffset)
+{
+    uchar header[headerSize];
+
+    memset(header, 0, sizeof(header));
+    memcpy(header + BrickStoreMagic, brickStoreMagic, sizeof(brickStoreMagic));
+    brickStorePut<quint32>(header, BrickStoreVersion, brickStoreVersion);
+    brickStorePut<quint32>(header, BrickStoreHeaderSize, quint32(headerSize));
+    brickStorePut<quint32>(header, BrickStoreCellType, quint32(cellType));
+    brickStorePut<quint32>(header, BrickStoreInterleave, quint32(interleave));
+    brickStorePut<qint64>(header, BrickStoreSize, size.nCols);
+    brickStorePut<qint64>(header, BrickStoreSize + 8, size.nRows);
+    brickStorePut<qint64>(header, BrickStoreSize + 16, size.nLays);
+    brickStorePut<qint64>(header, BrickStoreSize + 24, size.nBands);
+    brickStorePut<qint64>(header, BrickStoreSize + 32, size.nTicks);
+    brickStorePut<qint64>(header, BrickStoreBrickSize, brickSize.nCols);
+    brickStorePut<qint64>(header, BrickStoreBrickSize + 8, brickSize.nRows);
+    brickStorePut<qint64>(header, BrickStoreBrickSize + 16, brickSize.nLays);
+    brickStorePut<qint64>(header, BrickStoreBrickSize + 24, brickSize.nBands);
+    brickStorePut<qint64>(header, BrickStoreBrickSize + 32, brickSize.nTicks);
+    brickStorePutDouble(header, BrickStoreExtent, extent.p0.x);
+    brickStorePutDouble(header, BrickStoreExtent + 8, extent.p0.y);
+    brickStorePutDouble(header, BrickStoreExtent + 16, extent.p0.z);
+    brickStorePutDouble(header, BrickStoreExtent + 24, extent.p0.t);
+    brickStorePutDouble(header, BrickStoreExtent + 32, extent.p1.x);
+    brickStorePutDouble(header, BrickStoreExtent + 40, extent.p1.y);
+    brickStorePutDouble(header, BrickStoreExtent + 48, extent.p1.z);
+    brickStorePutDouble(header, BrickStoreExtent + 56, extent.p1.t);
+    brickStorePutDouble(header, BrickStoreNoData, noData);
+    brickStorePut<quint32>(header, BrickStoreUseNoData, useNoData ? 1 : 0);
+    brickStorePut<qint64>(header, BrickStoreDirectoryOffset, directoryOffset);
+    brickStorePut<qint64>(header, BrickStoreNumberOfBricks, qint64(directory.size()));
+
+    if (!file.seek(0)) return false;
+    return file.write(reinterpret_cast<const char *>(header), headerSize) == headerSize;
+}
+
+
+/*!
+ * \brief Creates a store described by the public members. Bricks are written by writeBrick() or write(),
+ *        the directory is written by close().
+ * \param fileName File name.
+ * \return True, if the file was created.
+ */
+bool BrickStore::create(QString fileName)
+{
+    BrickStoreEntry missing;
+    qint64 nBytes;
+
+    close();
+    errorString.clear();
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    return fail("Brick stores are not supported on big-endian hosts.");
+#endif
+    if (RasterCell::getSize(cellType) <= 0) return fail("Undefined cell type.");
+    if ((interleave < RasterView::BSQ) || (RasterView::BIP < interleave)) return fail("Unsupported interleave.");
+    brickSize.set(qMin(brickSize.nCols, size.nCols), qMin(brickSize.nRows, size.nRows), qMin(brickSize.nLays, size.nLays),
+                  qMin(brickSize.nBands, size.nBands), qMin(brickSize.nTicks, size.nTicks));
+    if (!grid.setup(&size, &brickSize)) return fail("Invalid raster or brick size.");
+    if (!brickStoreGetBytes(&size, RasterCell::getSize(cellType), &nBytes)) return fail("The raster is too large.");
+
+    missing.offset = -1;
+    missing.size = 0;
+    missing.codec = BrickCodec::Raw;
+    directory.assign(size_t(grid.getNumberOfBricks()), missing);
+    payloads.clear();
+
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate)) return fail("Cannot create " + fileName + ".");
+    if (!writeHeader(0)) return fail("Cannot write the header of " + fileName + ".");
+    fileSize = headerSize;
+    writing = true;
+    return true;
+}
+
+
+/*!
+ * \brief Opens a store for reading. Only the header and the directory are read; payloads are mapped.
+ * \param fileName File name.
+ * \return True, if the store was opened.
+ */
+bool BrickStore::open(QString fileName)
+{
+    uchar header[headerSize];
+    quint32 type, mode;
+    qint64 directoryOffset, nBricks, nBytes;
+    QByteArray entries;
+
+    close();
+    errorString.clear();
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    return fail("Brick stores are not supported on big-endian hosts.");
+#endif
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadOnly)) return fail("Cannot open " + fileName + ".");
+    if (file.read(reinterpret_cast<char *>(header), headerSize) != headerSize) return fail("Cannot read the header of " + fileName + ".");
+    if (memcmp(header + BrickStoreMagic, brickStoreMagic, sizeof(brickStoreMagic)) != 0) return fail(fileName + " is not a brick store.");
+    if (brickStoreGet<quint32>(header, BrickStoreVersion) != brickStoreVersion) return fail("Unsupported brick store version.");
+
+    type = brickStoreGet<quint32>(header, BrickStoreCellType);
+    mode = brickStoreGet<quint32>(header, BrickStoreInterleave);
+    if ((type < RasterCell::UInt8) || (RasterCell::Float64 < type)) return fail("Unsupported cell type.");
+    if (RasterView::BIP < mode) return fail("Unsupported interleave.");
+    cellType = RasterCell::Type(type);
+    interleave = RasterView::Interleave(mode);
+    size.set(brickStoreGet<qint64>(header, BrickStoreSize), brickStoreGet<qint64>(header, BrickStoreSize + 8),
+             brickStoreGet<qint64>(header, BrickStoreSize + 16), brickStoreGet<qint64>(header, BrickStoreSize + 24),
+             brickStoreGet<qint64>(header, BrickStoreSize + 32));
+    brickSize.set(brickStoreGet<qint64>(header, BrickStoreBrickSize), brickStoreGet<qint64>(header, BrickStoreBrickSize + 8),
+                  brickStoreGet<qint64>(header, BrickStoreBrickSize + 16), brickStoreGet<qint64>(header, BrickStoreBrickSize + 24),
+                  brickStoreGet<qint64>(header, BrickStoreBrickSize + 32));
+    extent.set(brickStoreGetDouble(header, BrickStoreExtent), brickStoreGetDouble(header, BrickStoreExtent + 8),
+               brickStoreGetDouble(header, BrickStoreExtent + 16), brickStoreGetDouble(header, BrickStoreExtent + 24),
+               brickStoreGetDouble(header, BrickStoreExtent + 32), brickStoreGetDouble(header, BrickStoreExtent + 40),
+               brickStoreGetDouble(header, BrickStoreExtent + 48), brickStoreGetDouble(header, BrickStoreExtent + 56));
+    noData = brickStoreGetDouble(header, BrickStoreNoData);
+    useNoData = brickStoreGet<quint32>(header, BrickStoreUseNoData) != 0;
+    directoryOffset = brickStoreGet<qint64>(header, BrickStoreDirectoryOffset);
+    nBricks = brickStoreGet<qint64>(header, BrickStoreNumberOfBricks);
+
+    if (!grid.setup(&size, &brickSize)) return fail("Invalid raster or brick size.");
+    if ((size.nCols < brickSize.nCols) || (size.nRows < brickSize.nRows) || (size.nLays < brickSize.nLays) ||
+        (size.nBands < brickSize.nBands) || (size.nTicks < brickSize.nTicks)) return fail("Invalid raster or brick size.");
+    // bricks are not larger than the raster and there are not more bricks than cells, so they cannot overflow
+    if (!brickStoreGetBytes(&size, RasterCell::getSize(cellType), &nBytes)) return fail("Invalid raster or brick size.");
+    if ((nBricks != grid.getNumberOfBricks()) || (directoryOffset < headerSize)) return fail(fileName + " was not closed properly.");
+    fileSize = file.size();
+    if (!brickStoreMultiply(nBricks, brickStoreEntrySize, &nBytes) || (fileSize - nBytes < directoryOffset)) return fail(fileName + " is truncated.");
+    if (std::numeric_limits<int>::max() < nBytes) return fail("The directory of " + fileName + " is too large.");
+
+    if (!file.seek(directoryOffset)) return fail("Cannot read the directory of " + fileName + ".");
+    entries = file.read(nBricks * brickStoreEntrySize);
+    if (entries.size() != nBricks * brickStoreEntrySize) return fail("Cannot read the directory of " + fileName + ".");
+    directory.resize(size_t(nBricks));
+    for (qint64 i = 0; i < nBricks; i++)
+    {
+        const uchar *e = reinterpret_cast<const uchar *>(entries.constData()) + i * brickStoreEntrySize;
+        BrickStoreEntry *entry = &directory[size_t(i)];
+        entry->offset = brickStoreGet<qint64>(e, 0);
+        entry->size = brickStoreGet<qint64>(e, 8);
+        entry->codec = BrickCodec::Type(brickStoreGet<quint32>(e, 16));
+        if ((0 <= entry->offset) && ((entry->offset < headerSize) || (entry->size < 0) || (directoryOffset - entry->offset < entry->size)))
+            return fail("Invalid directory entry in " + fileName + ".");
+    }
+
+    map = file.map(0, fileSize);
+    if (!map) return fail("Cannot map " + fileName + ".");
+    QFileInfo info(fileName);
+    cacheId = BrickCache::getDatasetId(info.absoluteFilePath() + ":" + QString::number(fileSize) + ":" +
+                                       QString::number(info.lastModified().toMSecsSinceEpoch()));
+    return true;
+}
+
+
+/*!
+ * \brief Closes the store. A store being written gets its directory and final header.
+ * \return True, if the store was closed without errors.
+ */
+bool BrickStore::close()
+{
+    bool ok = true;
+
+    if (writing)
+    {
+        QByteArray entries(int(directory.size() * brickStoreEntrySize), '\0');
+        uchar *e = reinterpret_cast<uchar *>(entries.data());
+
+        writing = false;
+        for (size_t i = 0; i < directory.size(); i++, e += brickStoreEntrySize)
+        {
+            brickStorePut<qint64>(e, 0, directory[i].offset);
+            brickStorePut<qint64>(e, 8, directory[i].size);
+            brickStorePut<quint32>(e, 16, quint32(directory[i].codec));
+        }
+        ok = file.seek(fileSize) && (file.write(entries) == entries.size()) && writeHeader(fileSize);
+        if (!ok) errorString = "Cannot write the directory of " + file.fileName() + ".";
+    }
+    payloads.clear();
+    if (map) file.unmap(map);
+    map = nullptr;
+    if (file.isOpen()) file.close();
+    return ok;
+}
+
+
+/*!
+ * \return True, if the store is open for reading or writing.
+ */
+bool BrickStore::isOpen()
+{
+    return writing || map;
+}
+
+
+/*!
+ * \return Total number of bricks.
+ */
+qint64 BrickStore::getNumberOfBricks()
+{
+    return grid.getNumberOfBricks();
+}
+
+
+/*!
+ * \brief Returns the index of the brick containing a cell. Indexes are not checked.
+ * \return Brick index.
+ */
+qint64 BrickStore::getBrickIndex(qint64 col, qint64 row, qint64 lay, qint64 band, qint64 tick)
+{
+    return grid.getBrickIndex(col, row, lay, band, tick);
+}
+
+
+/*!
+ * \brief Returns cells covered by a brick, clipped to the raster.
+ * \param iBrick Brick index.
+ * \return Raster block of the brick.
+ */
+RasterBlock BrickStore::getBrickBlock(qint64 iBrick)
+{
+    return grid.getBrickBlock(iBrick);
+}
+
+
+/*!
+ * \return Number of cells of a brick buffer (full brick shape).
+ */
+qint64 BrickStore::getNumberOfBrickCells()
+{
+    return brickSize.getNumberOfCells();
+}
+
+
+/*!
+ * \param iBrick Brick index.
+ * \return Directory entry of a brick.
+ */
+BrickStoreEntry BrickStore::getEntry(qint64 iBrick)
+{
+    return directory[size_t(iBrick)];
+}
+
+
+/*!
+ * \return Total size of stored payloads in bytes; shared payloads are counted once.
+ */
+qint64 BrickStore::getStoredBytes()
+{
+    std::vector<std::pair<qint64, qint64>> stored;
+    qint64 n = 0;
+
+    for (size_t i = 0; i < directory.size(); i++)
+        if (0 <= directory[i].offset) stored.push_back(std::make_pair(directory[i].offset, directory[i].size));
+    std::sort(stored.begin(), stored.end());
+    for (size_t i = 0; i < stored.size(); i++)
+        if ((i == 0) || (stored[i].first != stored[i - 1].first)) n += stored[i].second;
+    return n;
+}
+
+
+/*!
+ * \return Number of written bricks referring to a payload stored for another brick.
+ */
+qint64 BrickStore::getNumberOfSharedBricks()
+{
+    std::vector<qint64> offsets;
+    qint64 nShared = 0;
+
+    for (size_t i = 0; i < directory.size(); i++)
+        if (0 <= directory[i].offset) offsets.push_back(directory[i].offset);
+    std::sort(offsets.begin(), offsets.end());
+    for (size_t i = 1; i < offsets.size(); i++)
+        if (offsets[i] == offsets[i - 1]) nShared++;
+    return nShared;
+}
+
+
+/*!
+ * \return Ratio of raw brick bytes to stored payload bytes of written bricks.
+ */
+double BrickStore::getCompressionRatio()
+{
+    qint64 nWritten = 0, stored = getStoredBytes();
+
+    for (size_t i = 0; i < directory.size(); i++)
+        if (0 <= directory[i].offset) nWritten++;
+    if (stored == 0) return 0.0;
+    return double(nWritten * getNumberOfBrickCells() * RasterCell::getSize(cellType)) / double(stored);
+}
+
+
+/*!
+ * \brief Fills a brick buffer with NoData, or zeros if NoData is not defined.
+ */
+void BrickStore::fillMissing(void *cells)
+{
+    qint64 nCells = getNumberOfBrickCells();
+    qint64 cellSize = RasterCell::getSize(cellType);
+    uchar *p = static_cast<uchar *>(cells);
+
+    if (!useNoData)
+    {
+        memset(p, 0, size_t(nCells * cellSize));
+        return;
+    }
+    RasterCell::fromDouble(cellType, noData, p);
+    for (qint64 i = 1; i < nCells; i++)
+        memcpy(p + i * cellSize, p, size_t(cellSize));
+}
+
+
+/*!
+ * \brief Encodes and appends a brick. May be called from several threads.
+ * \param iBrick Brick index.
+ * \param cells Brick cells in full brick shape and the store interleave.
+ * \return True, if the brick was written.
+ */
+bool BrickStore::writeBrick(qint64 iBrick, const void *cells)
+{
+    BrickCodec::Type used;
+    QByteArray payload;
+
+    if (!writing || (iBrick < 0) || (getNumberOfBricks() <= iBrick)) return false;
+    payload = BrickCodec::encode(cells, getNumberOfBrickCells(), RasterCell::getSize(cellType), codec, &used, compressionLevel);
+    return writePayload(iBrick, payload, used);
+}
+
+
+/*!
+ * \brief Writes a brick with all cells equal to a value, without materializing its cells.
+ *        May be called from several threads.
+ * \param iBrick Brick index.
+ * \param value Cell value.
+ * \return True, if the brick was written.
+ */
+bool BrickStore::writeConstantBrick(qint64 iBrick, double value)
+{
+    QByteArray payload(int(RasterCell::getSize(cellType)), '\0');
+
+    if (!writing || (iBrick < 0) || (getNumberOfBricks() <= iBrick)) return false;
+    RasterCell::fromDouble(cellType, value, payload.data());
+    return writePayload(iBrick, payload, BrickCodec::Constant);
+}
+
+
+/*!
+ * \brief Appends an encoded brick, or refers to an equal payload written before if deduplicate is set.
+ */
+bool BrickStore::writePayload(qint64 iBrick, const QByteArray &payload, BrickCodec::Type codec)
+{
+    const uchar *bytes = reinterpret_cast<const uchar *>(payload.constData());
+    quint64 hash = deduplicate ? brickStoreHash(bytes, payload.size(), quint64(codec)) : 0;
+    BrickStoreEntry *entry = &directory[size_t(iBrick)];
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (deduplicate)
+    {
+        auto range = payloads.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            const BrickStoreEntry *stored = &directory[size_t(it->second)];
+            if ((stored->codec != codec) || (stored->size != payload.size()) || !file.seek(stored->offset)) continue;
+            if (file.read(stored->size) != payload) continue;
+            *entry = *stored;
+            return true;
+        }
+    }
+    if (!file.seek(fileSize) || (file.write(payload) != payload.size())) return false;
+    entry->offset = fileSize;
+    entry->size = payload.size();
+    entry->codec = codec;
+    fileSize += payload.size();
+    if (metrics) metrics->getCounter("brickStore.bytesWritten")->add(payload.size());
+    if (deduplicate) payloads.insert(std::make_pair(hash, iBrick));
+    return true;
+}
+
+
+/*!
+ * \brief Writes the whole raster from a view, encoding bricks in parallel on the NUMA nodes holding their cells.
+ *        Cells of edge bricks outside the raster are filled with NoData.
+ * \param source Pointer to a view with the store size and cell type.
+ * \param nThreads Number of threads, 0 for default.
+ * \return True, if all bricks were written; false also if the current G3DTCancelToken stopped writing.
+ */
+bool BrickStore::write(RasterView *source, int nThreads)
+{
+    RasterBlock all;
+    std::atomic<bool> ok(true);
+
+    if (!writing || !source->isValid() || (source->cellType != cellType)) return false;
+    if ((source->size.nCols != size.nCols) || (source->size.nRows != size.nRows) || (source->size.nLays != size.nLays) ||
+        (source->size.nBands != size.nBands) || (source->size.nTicks != size.nTicks)) return false;
+
+    if (!G3DTParallel::forEachOnNodes(getNumberOfBricks(), [&](qint64 iBrick) {
+        RasterBlock block = getBrickBlock(iBrick);
+        return G3DTNuma::getNodeOfAddress(source->getCell(block.col0, block.row0, block.lay0, block.band0, block.tick0));
+    }, [&](qint64 iBrick, int) {
+        std::vector<uchar> cells(static_cast<size_t>(getNumberOfBrickCells() * RasterCell::getSize(cellType)));
+        RasterBlock block = getBrickBlock(iBrick), inBrick;
+        RasterView brick(cells.data(), cellType, &brickSize, interleave);
+
+        fillMissing(cells.data());
+        inBrick.set(0, 0, 0, 0, 0, block.getNumberOfColumns() - 1, block.getNumberOfRows() - 1, block.getNumberOfLayers() - 1,
+                    block.getNumberOfBands() - 1, block.getNumberOfTicks() - 1);
+        RasterView part = source->crop(&block);
+        RasterView target = brick.crop(&inBrick);
+        if (!part.copyTo(&target, 1) || !writeBrick(iBrick, cells.data())) ok = false;
+    }, nThreads)) return false;
+
+    return ok;
+}
+
+
+/*!
+ * \brief Decodes a brick. May be called from several threads.
+ * \param iBrick Brick index.
+ * \param cells Output buffer of getNumberOfBrickCells() cells in the store interleave.
+ * \return True, if the brick was decoded; bricks never written are filled with NoData.
+ */
+bool BrickStore::readBrick(qint64 iBrick, void *cells)
+{
+    if (!map || (iBrick < 0) || (getNumberOfBricks() <= iBrick)) return false;
+    if (metrics && (0 <= directory[size_t(iBrick)].offset)) metrics->getCounter("brickStore.bytesRead")->add(directory[size_t(iBrick)].size);
+    return decodeBrick(iBrick, map + qMax(directory[size_t(iBrick)].offset, qint64(0)), cells);
+}
+
+
+/*!
+ * \brief Decodes a brick payload read outside of the store, e.g. by a BrickPrefetcher.
+ *        May be called from several threads.
+ * \param iBrick Brick index.
+ * \param payload Pointer to getEntry(iBrick).size bytes of the brick payload.
+ * \param cells Output buffer of getNumberOfBrickCells() cells in the store interleave.
+ * \return True, if the brick was decoded; bricks never written are filled with NoData.
+ */
+bool BrickStore::decodeBrick(qint64 iBrick, const uchar *payload, void *cells)
+{
+    BrickStoreEntry *entry;
+
+    if ((iBrick < 0) || (getNumberOfBricks() <= iBrick)) return false;
+    entry = &directory[size_t(iBrick)];
+    if (entry->offset < 0)
+    {
+        fillMissing(cells);
+        return true;
+    }
+    return BrickCodec::decode(payload, entry->size, entry->codec, cells, getNumberOfBrickCells(), RasterCell::getSize(cellType));
+}
+
+
+/*!
+ * \brief Tests whether all cells of a brick are equal, without decoding it. Bricks never written are constant
+ *        NoData (or zero). Applies to opened stores.
+ * \param iBrick Brick index.
+ * \param value Pointer to the cell value of a constant brick, may be nullptr.
+ * \return True, if the brick is constant.
+ */
+bool BrickStore::isConstantBrick(qint64 iBrick, double *value)
+{
+    const BrickStoreEntry *entry;
+
+    if (!map || (iBrick < 0) || (getNumberOfBricks() <= iBrick)) return false;
+    entry = &directory[size_t(iBrick)];
+    if (entry->offset < 0)
+    {
+        if (value) *value = useNoData ? noData : 0.0;
+        return true;
+    }
+    if ((entry->codec != BrickCodec::Constant) || (entry->size != RasterCell::getSize(cellType))) return false;
+    if (value) *value = RasterCell::toDouble(cellType, map + entry->offset);
+    return true;
+}
+
+
+/*!
+ * \brief Reads a raster block into a view, decoding overlapping bricks in parallel on the NUMA nodes
+ *        holding their cells in the view.
+ *        Constant bricks are filled from their single cell without decoding.
+ * \param block Pointer to a raster block.
+ * \param target Pointer to a view with the extents of the block and the store cell type.
+ * \param nThreads Number of threads, 0 for default.
+ * \return True, if cells were read.
+ */
+bool BrickStore::read(RasterBlock *block, RasterView *target, int nThreads)
+{
+    std::atomic<bool> ok(true);
+
+    if (!map || !target->isValid() || (target->cellType != cellType)) return false;
+    if ((target->size.nCols != block->getNumberOfColumns()) || (target->size.nRows != block->getNumberOfRows()) ||
+        (target->size.nLays != block->getNumberOfLayers()) || (target->size.nBands != block->getNumberOfBands()) ||
+        (target->size.nTicks != block->getNumberOfTicks())) return false;
+
+    if (!grid.forEachBrick(block, [&](qint64 iBrick, RasterBlock *inBrick, RasterBlock *inBlock) {
+        qint64 brickBytes = getNumberOfBrickCells() * RasterCell::getSize(cellType);
+        std::vector<uchar> buffer;
+        const uchar *cells;
+        double value;
+
+        if (isConstantBrick(iBrick, &value))
+        {
+            uchar cell[8];
+            RasterView targetPart = target->crop(inBlock);
+            RasterCell::fromDouble(cellType, value, cell);
+            RasterView constant = RasterView::broadcast(cell, cellType, &targetPart.size);
+            if (!constant.copyTo(&targetPart, 1)) ok = false;
+            return;
+        }
+        if (cache)
+            cells = cache->acquire(cacheId, iBrick, brickBytes, [&](uchar *cached) { return readBrick(iBrick, cached); });
+        else
+        {
+            buffer.resize(static_cast<size_t>(brickBytes));
+            cells = readBrick(iBrick, buffer.data()) ? buffer.data() : nullptr;
+        }
+        if (!cells)
+        {
+            ok = false;
+            return;
+        }
+        RasterView brick(const_cast<uchar *>(cells), cellType, &brickSize, interleave);
+        RasterView part = brick.crop(inBrick);
+        RasterView targetPart = target->crop(inBlock);
+        if (!part.copyTo(&targetPart, 1)) ok = false;
+        if (cache) cache->release(cells);
+    }, nThreads, target)) return false;
+
+    return ok;
+}
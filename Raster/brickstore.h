@@ -0,0 +1,124 @@
+#ifndef BRICKSTORE_H
+#define BRICKSTORE_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file brickstore.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <QFile>
+#include <QString>
+#include "g3dtcore_global.h"
+#include "g3dtmetrics.h"
+#include "Geometry/box3dt.h"
+#include "Geometry/rasterblock.h"
+#include "Geometry/rastersize3dt.h"
+#include "brickcache.h"
+#include "brickcodec.h"
+#include "brickgrid.h"
+#include "rastercell.h"
+#include "rasterview.h"
+
+
+/*!
+ * \brief Location and encoding of a stored brick.
+ */
+struct BrickStoreEntry
+{
+    qint64 offset; //!< file offset of the payload, -1 for bricks never written
+    qint64 size; //!< payload size in bytes
+    BrickCodec::Type codec; //!< payload codec
+};
+
+
+/*!
+ * \brief The BrickStore is a compressed bricked raster file.
+ *
+ *        The file starts with a fixed little-endian header (raster size, extent, cell type, interleave, NoData and
+ *        brick shape) followed by brick payloads in the order they were written and a directory of
+ *        (offset, size, codec) entries at the end. Every brick is encoded with its own codec, by default
+ *        the smallest of constant, run-length, delta-shuffle-deflate and raw encodings.
+ *
+ *        Constant bricks are stored as a single cell. With deduplicate set, a brick whose payload equals the
+ *        payload of a brick written before (e.g. NoData bricks, or a brick repeated over ticks) refers to the
+ *        existing payload instead of storing a copy; payloads are matched by a content hash and compared
+ *        byte by byte. isConstantBrick() lets kernels process constant bricks without decoding them.
+ *
+ *        Bricks are encoded in parallel while writing; reading maps the file and decodes only the bricks
+ *        overlapping the requested block, in parallel. With a cache set, read() takes decoded bricks from
+ *        the cache and decodes only the missing ones.
+ */
+class G3DTCORE_EXPORT BrickStore
+{
+public:
+    RasterSize3DT size; //!< raster size
+    RasterSize3DT brickSize; //!< brick shape
+    Box3DT extent; //!< raster extent
+    RasterCell::Type cellType; //!< cell type
+    RasterView::Interleave interleave; //!< band interleave inside bricks
+    bool useNoData; //!< noData is defined; bricks never written read as noData
+    double noData; //!< NoData value
+    BrickCodec::Type codec; //!< codec used for writing, Auto selects per brick
+    int compressionLevel; //!< deflate level, 1 (fastest) to 9 (smallest)
+    bool deduplicate; //!< bricks with equal payloads share a single stored payload
+    BrickCache *cache; //!< cache of decoded bricks used by read(), e.g. BrickCache::getGlobal(), nullptr for none
+    G3DTMetrics *metrics; //!< receives the counters "brickStore.bytesRead" and "brickStore.bytesWritten" of payloads, may be nullptr
+    QString errorString; //!< description of the last error
+
+public:
+    BrickStore();
+    ~BrickStore();
+
+    bool create(QString fileName);
+    bool open(QString fileName);
+    bool close();
+    bool isOpen();
+
+    qint64 getNumberOfBricks();
+    qint64 getBrickIndex(qint64 col, qint64 row, qint64 lay, qint64 band, qint64 tick);
+    RasterBlock getBrickBlock(qint64 iBrick);
+    qint64 getNumberOfBrickCells();
+    BrickStoreEntry getEntry(qint64 iBrick);
+    qint64 getStoredBytes();
+    qint64 getNumberOfSharedBricks();
+    double getCompressionRatio();
+
+    bool writeBrick(qint64 iBrick, const void *cells);
+    bool writeConstantBrick(qint64 iBrick, double value);
+    bool write(RasterView *source, int nThreads = 0);
+    bool readBrick(qint64 iBrick, void *cells);
+    bool decodeBrick(qint64 iBrick, const uchar *payload, void *cells);
+    bool isConstantBrick(qint64 iBrick, double *value = nullptr);
+    bool read(RasterBlock *block, RasterView *target, int nThreads = 0);
+
+    static const qint64 headerSize = 256; //!< size of the file header in bytes
+
+private:
+    QFile file;
+    uchar *map;
+    bool writing;
+    qint64 fileSize;
+    quint64 cacheId; //!< dataset identifier in the cache
+    BrickGrid grid;
+    std::vector<BrickStoreEntry> directory;
+    std::unordered_multimap<quint64, qint64> payloads; //!< payload hash to a brick storing the payload, while writing
+    std::mutex mutex;
+
+    bool fail(QString message);
+    bool writeHeader(qint64 directoryOffset);
+    bool writePayload(qint64 iBrick, const QByteArray &payload, BrickCodec::Type codec);
+    void fillMissing(void *cells);
+};
+
+#endif // BRICKSTORE_H
@@ -0,0 +1,604 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file envifile.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <ctype.h>
+#include <locale.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+#include "envifile.h"
+#include "g3dtparallel.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ENVIFILE_X86
+#include <immintrin.h>
+#endif
+
+
+/*!
+ * \brief Removes leading and trailing white space.
+ */
+static std::string enviTrim(const std::string &text)
+{
+    size_t i0 = 0, i1 = text.size();
+    while ((i0 < i1) && isspace(uchar(text[i0]))) i0++;
+    while ((i0 < i1) && isspace(uchar(text[i1 - 1]))) i1--;
+    return text.substr(i0, i1 - i0);
+}
+
+
+/*!
+ * \brief Splits a brace list "{a, b, c}" into trimmed items.
+ */
+static std::vector<std::string> enviSplit(const std::string &value)
+{
+    std::vector<std::string> items;
+    std::string text = value;
+    size_t i0 = 0, i;
+
+    if (!text.empty() && (text[0] == '{')) text = text.substr(1, text.size() - ((text.back() == '}') ? 2 : 1));
+    for (i = 0; i <= text.size(); i++)
+    {
+        if ((i == text.size()) || (text[i] == ','))
+        {
+            items.push_back(enviTrim(text.substr(i0, i - i0)));
+            i0 = i + 1;
+        }
+    }
+    if ((items.size() == 1) && items[0].empty()) items.clear();
+    return items;
+}
+
+
+/*!
+ * \brief Parses a number written with a decimal point regardless of the C locale.
+ * \return True, if the whole text is a number.
+ */
+static bool enviToDouble(const std::string &text, double *value)
+{
+    std::string s = enviTrim(text);
+    char decimalPoint = localeconv()->decimal_point[0];
+    char *end;
+
+    if (s.empty()) return false;
+    for (size_t i = 0; i < s.size(); i++)
+        if (s[i] == '.') s[i] = decimalPoint;
+    *value = strtod(s.c_str(), &end);
+    return *end == '\0';
+}
+
+
+static bool enviToInteger(const std::string &text, qint64 *value)
+{
+    double d;
+    if (!enviToDouble(text, &d) || (d != floor(d))) return false;
+    *value = qint64(d);
+    return true;
+}
+
+
+/*!
+ * \brief Formats a double with 17 significant digits and a decimal point regardless of the C locale.
+ */
+static std::string enviFormat(double value)
+{
+    char text[40];
+    char decimalPoint = localeconv()->decimal_point[0];
+    int n = snprintf(text, sizeof(text), "%.17g", value);
+
+    for (int i = 0; i < n; i++)
+        if (text[i] == decimalPoint) text[i] = '.';
+    return std::string(text, size_t(n));
+}
+
+
+/*!
+ * \brief Replaces characters that would end a brace value by spaces.
+ * \param isListItem True for items of comma-separated values (band names, map info), whose commas are replaced too.
+ */
+static std::string enviEscape(const QString &text, bool isListItem)
+{
+    std::string s = text.toUtf8().constData();
+    for (size_t i = 0; i < s.size(); i++)
+        if ((s[i] == '}') || (isListItem && (s[i] == ','))) s[i] = ' ';
+    return s;
+}
+
+
+/*!
+ * \brief Reverses bytes of cells of 2, 4 or 8 bytes.
+ */
+template <typename T>
+static void enviSwapScalar(uchar *data, qint64 nCells)
+{
+    T value;
+    for (qint64 i = 0; i < nCells; i++)
+    {
+        memcpy(&value, data + i * qint64(sizeof(T)), sizeof(T));
+        value = qbswap(value);
+        memcpy(data + i * qint64(sizeof(T)), &value, sizeof(T));
+    }
+}
+
+
+static void enviSwapScalar(uchar *data, qint64 nCells, qint64 cellSize)
+{
+    switch (cellSize)
+    {
+    case 2: enviSwapScalar<quint16>(data, nCells); break;
+    case 4: enviSwapScalar<quint32>(data, nCells); break;
+    case 8: enviSwapScalar<quint64>(data, nCells); break;
+    default: break;
+    }
+}
+
+
+#ifdef ENVIFILE_X86
+/*!
+ * \brief AVX2 version of enviSwapScalar(). Bytes are reversed by a shuffle within 128-bit lanes, 32 bytes at once.
+ */
+__attribute__((target("avx2")))
+static void enviSwapAvx2(uchar *data, qint64 nCells, qint64 cellSize)
+{
+    __m256i mask;
+    qint64 nBytes = nCells * cellSize, i = 0;
+
+    switch (cellSize)
+    {
+    case 2: mask = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                    1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14); break;
+    case 4: mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12); break;
+    case 8: mask = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                    7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8); break;
+    default: return;
+    }
+    for (; i + 32 <= nBytes; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(data + i), _mm256_shuffle_epi8(v, mask));
+    }
+    enviSwapScalar(data + i, (nBytes - i) / cellSize, cellSize);
+}
+#endif
+
+
+/*!
+ * \brief Default constructor.
+ */
+EnviFile::EnviFile()
+{
+    size.set(0, 0, 1, 1, 1);
+    cellType = RasterCell::Undefined;
+    interleave = RasterView::BSQ;
+    bigEndian = false;
+    headerOffset = 0;
+    bandsAsLayers = false;
+    useNoData = false;
+    noData = 0.0;
+    useExtent = false;
+    instructionSet = RasterConvert::getSupportedInstructionSet();
+    nThreads = 0;
+    blockSize = 1024 * 1024;
+}
+
+
+/*!
+ * \brief Stores an error description.
+ * \return Always false.
+ */
+bool EnviFile::fail(QString message)
+{
+    errorString = message;
+    return false;
+}
+
+
+/*!
+ * \brief Describes a raster to be exported. Other header fields are not changed.
+ * \param size Raster size with one tick, and one layer unless bandsAsLayers is set.
+ * \param cellType Cell type.
+ * \param interleave Interleave of the data file: BSQ, BIL or BIP.
+ */
+void EnviFile::setup(RasterSize3DT *size, RasterCell::Type cellType, RasterView::Interleave interleave)
+{
+    this->size = *size;
+    this->cellType = cellType;
+    this->interleave = interleave;
+}
+
+
+/*!
+ * \param cellType Cell type.
+ * \return ENVI data type code, or 0 if the cell type cannot be stored.
+ */
+int EnviFile::toDataType(RasterCell::Type cellType)
+{
+    switch (cellType)
+    {
+    case RasterCell::UInt8: return 1;
+    case RasterCell::Int16: return 2;
+    case RasterCell::Int32: return 3;
+    case RasterCell::Float32: return 4;
+    case RasterCell::Float64: return 5;
+    case RasterCell::UInt16: return 12;
+    case RasterCell::UInt32: return 13;
+    default: return 0;
+    }
+}
+
+
+/*!
+ * \param dataType ENVI data type code.
+ * \return Cell type, or Undefined for unsupported (complex and 64-bit integer) types.
+ */
+RasterCell::Type EnviFile::fromDataType(int dataType)
+{
+    switch (dataType)
+    {
+    case 1: return RasterCell::UInt8;
+    case 2: return RasterCell::Int16;
+    case 3: return RasterCell::Int32;
+    case 4: return RasterCell::Float32;
+    case 5: return RasterCell::Float64;
+    case 12: return RasterCell::UInt16;
+    case 13: return RasterCell::UInt32;
+    default: return RasterCell::Undefined;
+    }
+}
+
+
+/*!
+ * \brief Returns the header file name of a data file: the name with the suffix replaced by ".hdr",
+ *        or the name with ".hdr" appended if only such a header exists. Header names are returned unchanged.
+ * \param fileName Data file name.
+ * \return Header file name.
+ */
+QString EnviFile::getHeaderFileName(QString fileName)
+{
+    QFileInfo info(fileName);
+    QString replaced;
+
+    if (info.suffix().toLower() == "hdr") return fileName;
+    replaced = info.path() + "/" + info.completeBaseName() + ".hdr";
+    if (QFile::exists(replaced) || !QFile::exists(fileName + ".hdr")) return replaced;
+    return fileName + ".hdr";
+}
+
+
+/*!
+ * \return Size of the cells in the data file in bytes.
+ */
+qint64 EnviFile::getDataSize()
+{
+    return size.getNumberOfCells() * RasterCell::getSize(cellType);
+}
+
+
+/*!
+ * \return True, if the byte order of the data file differs from the host.
+ */
+bool EnviFile::needsSwap()
+{
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    return !bigEndian && (1 < RasterCell::getSize(cellType));
+#else
+    return bigEndian && (1 < RasterCell::getSize(cellType));
+#endif
+}
+
+
+/*!
+ * \brief Reads an ENVI header. Multi-line values in braces and unknown keys are accepted.
+ * \param fileName Header file name, or data file name (see getHeaderFileName()).
+ * \return True, if the header describes a supported raster.
+ */
+bool EnviFile::readHeader(QString fileName)
+{
+    QString headerName = getHeaderFileName(fileName);
+    QFile file(headerName);
+    QByteArray bytes;
+    std::string text;
+    qint64 nSamples = -1, nLines = -1, nBands = 1, dataType = -1, byteOrder = 0;
+    double refX = 1.0, refY = 1.0, easting = 0.0, northing = 0.0, pixelSizeX = 1.0, pixelSizeY = 1.0;
+    size_t i = 0;
+
+    errorString.clear();
+    interleave = RasterView::BSQ;
+    bigEndian = false;
+    headerOffset = 0;
+    useNoData = false;
+    noData = 0.0;
+    useExtent = false;
+    extent.set(0, 0, 0, 0, 0, 0, 0, 0);
+    projection.clear();
+    projectionParameters.clear();
+    description.clear();
+    bandNames.clear();
+
+    if (!file.open(QIODevice::ReadOnly)) return fail("Cannot open " + headerName + ".");
+    bytes = file.readAll();
+    text.assign(bytes.constData(), size_t(bytes.size()));
+    if (enviTrim(text).compare(0, 4, "ENVI") != 0) return fail(headerName + " is not an ENVI header.");
+
+    while (i < text.size())
+    {
+        size_t lineEnd = text.find('\n', i), equal = text.find('=', i);
+        std::string key, value;
+
+        if (lineEnd == std::string::npos) lineEnd = text.size();
+        if (lineEnd <= equal)
+        {
+            i = lineEnd + 1;
+            continue;
+        }
+        key = enviTrim(text.substr(i, equal - i));
+        for (size_t k = 0; k < key.size(); k++) key[k] = char(tolower(uchar(key[k])));
+        i = equal + 1;
+        while ((i < lineEnd) && isspace(uchar(text[i]))) i++;
+        if ((i < text.size()) && (text[i] == '{'))
+        {
+            size_t close = text.find('}', i);
+            if (close == std::string::npos) return fail("Unterminated value of " + QString::fromUtf8(key.c_str()) + ".");
+            value = text.substr(i, close - i + 1);
+            i = close + 1;
+            lineEnd = text.find('\n', i);
+            if (lineEnd == std::string::npos) lineEnd = text.size();
+        }
+        else value = enviTrim(text.substr(i, lineEnd - i));
+        i = lineEnd + 1;
+
+        bool ok = true;
+        if (key == "samples") ok = enviToInteger(value, &nSamples);
+        else if (key == "lines") ok = enviToInteger(value, &nLines);
+        else if (key == "bands") ok = enviToInteger(value, &nBands);
+        else if (key == "header offset") ok = enviToInteger(value, &headerOffset);
+        else if (key == "data type") ok = enviToInteger(value, &dataType);
+        else if (key == "byte order") ok = enviToInteger(value, &byteOrder);
+        else if (key == "data ignore value") ok = useNoData = enviToDouble(value, &noData);
+        else if (key == "interleave")
+        {
+            std::string mode = enviTrim(value);
+            for (size_t k = 0; k < mode.size(); k++) mode[k] = char(tolower(uchar(mode[k])));
+            if (mode == "bsq") interleave = RasterView::BSQ;
+            else if (mode == "bil") interleave = RasterView::BIL;
+            else if (mode == "bip") interleave = RasterView::BIP;
+            else ok = false;
+        }
+        else if (key == "description")
+        {
+            if ((2 <= value.size()) && (value[0] == '{')) value = enviTrim(value.substr(1, value.size() - 2));
+            description = QString::fromUtf8(value.c_str());
+        }
+        else if (key == "band names")
+        {
+            std::vector<std::string> items = enviSplit(value);
+            for (size_t k = 0; k < items.size(); k++) bandNames.append(QString::fromUtf8(items[k].c_str()));
+        }
+        else if (key == "map info")
+        {
+            std::vector<std::string> items = enviSplit(value);
+            if ((7 <= items.size()) && enviToDouble(items[1], &refX) && enviToDouble(items[2], &refY) &&
+                enviToDouble(items[3], &easting) && enviToDouble(items[4], &northing) &&
+                enviToDouble(items[5], &pixelSizeX) && enviToDouble(items[6], &pixelSizeY))
+            {
+                projection = QString::fromUtf8(items[0].c_str());
+                for (size_t k = 7; k < items.size(); k++)
+                {
+                    if (k > 7) projectionParameters += ", ";
+                    projectionParameters += QString::fromUtf8(items[k].c_str());
+                }
+                useExtent = true;
+            }
+        }
+        if (!ok) return fail("Invalid value of " + QString::fromUtf8(key.c_str()) + ".");
+    }
+
+    cellType = fromDataType(int(dataType));
+    if ((nSamples < 1) || (nLines < 1) || (nBands < 1)) return fail("Invalid raster size.");
+    if (cellType == RasterCell::Undefined) return fail("Unsupported data type.");
+    if ((headerOffset < 0) || ((byteOrder != 0) && (byteOrder != 1))) return fail("Invalid header offset or byte order.");
+    bigEndian = byteOrder == 1;
+    if (bandsAsLayers) size.set(nSamples, nLines, nBands, 1, 1);
+    else size.set(nSamples, nLines, 1, nBands, 1);
+    if (useExtent)
+    {
+        double x0 = easting - (refX - 1.0) * pixelSizeX, y1 = northing + (refY - 1.0) * pixelSizeY;
+        extent.set(x0, y1 - pixelSizeY * double(nLines), 0.0, 0.0, x0 + pixelSizeX * double(nSamples), y1, 0.0, 0.0);
+    }
+    return true;
+}
+
+
+/*!
+ * \brief Writes an ENVI header describing the current size, cell type, interleave and optional fields.
+ * \param fileName Header file name, or data file name (see getHeaderFileName()).
+ * \return True, if the header was written.
+ */
+bool EnviFile::writeHeader(QString fileName)
+{
+    QString headerName = getHeaderFileName(fileName);
+    QFile file(headerName);
+    qint64 nBands = bandsAsLayers ? size.nLays : size.nBands;
+    std::string text = "ENVI\n";
+    static const char *interleaves[] = {"bsq", "bil", "bip"};
+
+    errorString.clear();
+    if (toDataType(cellType) == 0) return fail("Unsupported cell type.");
+    if ((interleave < RasterView::BSQ) || (RasterView::BIP < interleave)) return fail("Unsupported interleave.");
+    if ((size.nCols < 1) || (size.nRows < 1) || (nBands < 1) || (size.nTicks != 1) || ((bandsAsLayers ? size.nBands : size.nLays) != 1))
+        return fail("Invalid raster size.");
+
+    if (!description.isEmpty()) text += "description = {" + enviEscape(description, false) + "}\n";
+    text += "samples = " + std::to_string(size.nCols) + "\n";
+    text += "lines = " + std::to_string(size.nRows) + "\n";
+    text += "bands = " + std::to_string(nBands) + "\n";
+    text += "header offset = " + std::to_string(headerOffset) + "\n";
+    text += "file type = ENVI Standard\n";
+    text += "data type = " + std::to_string(toDataType(cellType)) + "\n";
+    text += std::string("interleave = ") + interleaves[interleave] + "\n";
+    text += std::string("byte order = ") + (bigEndian ? "1" : "0") + "\n";
+    if (useNoData) text += "data ignore value = " + enviFormat(noData) + "\n";
+    if (useExtent)
+    {
+        text += "map info = {" + (projection.isEmpty() ? std::string("Arbitrary") : enviEscape(projection, true)) + ", 1, 1, " +
+                enviFormat(extent.p0.x) + ", " + enviFormat(extent.p1.y) + ", " +
+                enviFormat((extent.p1.x - extent.p0.x) / double(size.nCols)) + ", " + enviFormat((extent.p1.y - extent.p0.y) / double(size.nRows));
+        if (!projectionParameters.isEmpty()) text += ", " + std::string(projectionParameters.toUtf8().constData());
+        text += "}\n";
+    }
+    if (!bandNames.isEmpty())
+    {
+        text += "band names = {";
+        for (int k = 0; k < int(bandNames.size()); k++)
+            text += ((k == 0) ? "" : ", ") + enviEscape(bandNames[k], true);
+        text += "}\n";
+    }
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return fail("Cannot create " + headerName + ".");
+    if (file.write(text.data(), qint64(text.size())) != qint64(text.size())) return fail("Cannot write " + headerName + ".");
+    return true;
+}
+
+
+/*!
+ * \brief Returns a view of data file cells with strides of the file interleave.
+ */
+RasterView EnviFile::getFileView(uchar *data)
+{
+    RasterView view;
+    qint64 cellSize = RasterCell::getSize(cellType);
+    int bandAxis = bandsAsLayers ? RasterView::AxisLay : RasterView::AxisBand;
+    int otherAxis = bandsAsLayers ? RasterView::AxisBand : RasterView::AxisLay;
+    qint64 nCols = size.nCols, nRows = size.nRows, nBands = bandsAsLayers ? size.nLays : size.nBands;
+
+    view.set(data, cellType, &size);
+    switch (interleave)
+    {
+    case RasterView::BIL:
+        view.strides[RasterView::AxisCol] = cellSize;
+        view.strides[bandAxis] = cellSize * nCols;
+        view.strides[RasterView::AxisRow] = cellSize * nCols * nBands;
+        break;
+    case RasterView::BIP:
+        view.strides[bandAxis] = cellSize;
+        view.strides[RasterView::AxisCol] = cellSize * nBands;
+        view.strides[RasterView::AxisRow] = cellSize * nBands * nCols;
+        break;
+    default:
+        view.strides[RasterView::AxisCol] = cellSize;
+        view.strides[RasterView::AxisRow] = cellSize * nCols;
+        view.strides[bandAxis] = cellSize * nCols * nRows;
+        break;
+    }
+    view.strides[otherAxis] = view.strides[RasterView::AxisTick] = cellSize * nCols * nRows * nBands;
+    return view;
+}
+
+
+/*!
+ * \brief Reverses the byte order of contiguous cells in parallel blocks.
+ * \return False, if the current G3DTCancelToken stopped swapping.
+ */
+bool EnviFile::swap(uchar *data, qint64 nCells)
+{
+    qint64 cellSize = RasterCell::getSize(cellType);
+    qint64 block = qMax(blockSize, qint64(1));
+    void (*kernel)(uchar *, qint64, qint64) = &enviSwapScalar;
+
+#ifdef ENVIFILE_X86
+    if (RasterConvert::AVX2 <= qMin(instructionSet, RasterConvert::getSupportedInstructionSet())) kernel = &enviSwapAvx2;
+#endif
+    return G3DTParallel::forEach((nCells + block - 1) / block, [&](qint64 iBlock) {
+        qint64 i0 = iBlock * block;
+        kernel(data + i0 * cellSize, qMin(block, nCells - i0), cellSize);
+    }, nThreads);
+}
+
+
+/*!
+ * \brief Reads the data file described by the header into a view. The file is mapped; cells in the foreign
+ *        byte order are swapped in a private copy-on-write mapping, so the file is never modified.
+ * \param fileName Data file name.
+ * \param target View of the same shape and cell type as the header describes, in any layout.
+ * \return True, if the cells were read; false also if the current G3DTCancelToken stopped reading.
+ */
+bool EnviFile::read(QString fileName, RasterView *target)
+{
+    QFile file(fileName);
+    qint64 dataSize = getDataSize();
+    bool swapped = needsSwap();
+    RasterView view;
+    uchar *map;
+    bool ok;
+
+    errorString.clear();
+    if ((cellType == RasterCell::Undefined) || (dataSize <= 0)) return fail("Undefined raster.");
+    if (!file.open(QIODevice::ReadOnly)) return fail("Cannot open " + fileName + ".");
+    if (file.size() < headerOffset + dataSize) return fail(fileName + " is truncated.");
+    map = file.map(headerOffset, dataSize, swapped ? QFileDevice::MapPrivateOption : QFileDevice::NoOptions);
+    if (!map) return fail("Cannot map " + fileName + ".");
+
+    view = getFileView(map);
+    if (!target->isValid() || !view.hasSameShape(target))
+    {
+        file.unmap(map);
+        return fail("The target view does not match the raster.");
+    }
+    ok = (!swapped || swap(map, size.getNumberOfCells())) && view.copyTo(target, nThreads);
+    file.unmap(map);
+    if (!ok) return fail("Reading " + fileName + " was cancelled.");
+    return true;
+}
+
+
+/*!
+ * \brief Writes cells of a view to a data file described by the current header fields (see setup()).
+ *        The header itself is written by writeHeader(); the first headerOffset bytes are zero.
+ * \param fileName Data file name.
+ * \param source View of the shape and cell type the header describes, in any layout.
+ * \return True, if the cells were written; false also if the current G3DTCancelToken stopped writing.
+ */
+bool EnviFile::write(QString fileName, RasterView *source)
+{
+    QFile file(fileName);
+    qint64 dataSize = getDataSize();
+    RasterView view;
+    uchar *map;
+    bool ok;
+
+    errorString.clear();
+    if (toDataType(cellType) == 0) return fail("Unsupported cell type.");
+    if ((dataSize <= 0) || (headerOffset < 0)) return fail("Undefined raster.");
+    if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate)) return fail("Cannot create " + fileName + ".");
+    if (!file.resize(headerOffset + dataSize)) return fail("Cannot resize " + fileName + ".");
+    map = file.map(headerOffset, dataSize);
+    if (!map) return fail("Cannot map " + fileName + ".");
+
+    view = getFileView(map);
+    if (!source->isValid() || !view.hasSameShape(source))
+    {
+        file.unmap(map);
+        return fail("The source view does not match the raster.");
+    }
+    ok = source->copyTo(&view, nThreads) && (!needsSwap() || swap(map, size.getNumberOfCells()));
+    file.unmap(map);
+    if (!ok) return fail("Writing " + fileName + " was cancelled.");
+    return true;
+}
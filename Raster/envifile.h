@@ -0,0 +1,80 @@
+#ifndef ENVIFILE_H
+#define ENVIFILE_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file envifile.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <QString>
+#include <QStringList>
+#include "g3dtcore_global.h"
+#include "Geometry/box3dt.h"
+#include "Geometry/rastersize3dt.h"
+#include "rasterconvert.h"
+#include "rasterview.h"
+
+
+/*!
+ * \brief The EnviFile imports and exports raw binary rasters described by an ENVI text header (.hdr).
+ *
+ *        Header keys samples, lines and bands map onto columns, rows and bands (or layers, if bandsAsLayers
+ *        is set, e.g. for volumes stored band by band); the ENVI interleave maps onto the raster view strides.
+ *        Data files are memory mapped and copied to or from a raster view of any layout in parallel.
+ *        Cells stored in the foreign byte order are swapped by SIMD shuffles in parallel blocks.
+ *        Supported data types are 1 (UInt8), 2 (Int16), 3 (Int32), 4 (Float32), 5 (Float64), 12 (UInt16) and 13 (UInt32).
+ */
+class G3DTCORE_EXPORT EnviFile
+{
+public:
+    RasterSize3DT size; //!< raster size, one tick
+    RasterCell::Type cellType; //!< cell type
+    RasterView::Interleave interleave; //!< interleave of the data file
+    bool bigEndian; //!< byte order of the data file
+    qint64 headerOffset; //!< number of bytes skipped at the start of the data file
+    bool bandsAsLayers; //!< ENVI bands are raster layers, the raster has a single band
+    bool useNoData; //!< data ignore value is defined
+    double noData; //!< data ignore value
+    bool useExtent; //!< extent is defined by map info
+    Box3DT extent; //!< extent of cells (x and y only), from map info
+    QString projection; //!< projection name of map info
+    QString projectionParameters; //!< map info fields following the pixel size, e.g. zone and datum
+    QString description; //!< description
+    QStringList bandNames; //!< band names
+
+    RasterConvert::InstructionSet instructionSet; //!< kernel used for byte swapping, the best supported one by default
+    int nThreads; //!< number of threads, 0 for default
+    qint64 blockSize; //!< number of cells swapped by one task
+    QString errorString; //!< description of the last error
+
+public:
+    EnviFile();
+
+    void setup(RasterSize3DT *size, RasterCell::Type cellType, RasterView::Interleave interleave = RasterView::BSQ);
+
+    bool readHeader(QString fileName);
+    bool writeHeader(QString fileName);
+    bool read(QString fileName, RasterView *target);
+    bool write(QString fileName, RasterView *source);
+
+    qint64 getDataSize();
+    static QString getHeaderFileName(QString fileName);
+    static int toDataType(RasterCell::Type cellType);
+    static RasterCell::Type fromDataType(int dataType);
+
+private:
+    bool fail(QString message);
+    bool needsSwap();
+    RasterView getFileView(uchar *data);
+    bool swap(uchar *data, qint64 nCells);
+};
+
+#endif // ENVIFILE_H
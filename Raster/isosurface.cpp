@@ -0,0 +1,438 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file isosurface.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <float.h>
+#include <unordered_map>
+#include "isosurface.h"
+#include "g3dtparallel.h"
+
+
+/*!
+ * \brief Corners of the six tetrahedra of a cube. Corner c has offsets (c & 1, (c >> 1) & 1, (c >> 2) & 1).
+ *        Each tetrahedron is a monotone path from corner 0 to corner 7, so face diagonals match between cubes.
+ */
+static const int isoSurfaceTetrahedra[6][4] =
+{
+    {0, 1, 3, 7}, {0, 1, 5, 7}, {0, 2, 3, 7}, {0, 2, 6, 7}, {0, 4, 5, 7}, {0, 4, 6, 7}
+};
+
+
+/*!
+ * \brief Mesh generated from one brick.
+ */
+struct IsoSurfaceBrickMesh
+{
+    std::unordered_map<quint64, qint64> edgeVertices; //!< edge key -> local vertex index
+    std::vector<double> vertices; //!< local vertex coordinates
+    std::vector<char> owned; //!< 1 if the vertex edge is owned by this brick
+    std::vector<qint64> triangles; //!< local vertex indexes
+    std::vector<qint64> globalIndexes; //!< global index per local vertex
+    qint64 nOwned;
+};
+
+
+/*!
+ * \brief Default constructor.
+ */
+IsoSurface::IsoSurface()
+{
+    brickSize = 32;
+    useNoData = false;
+    noData = -DBL_MAX;
+    nThreads = 0;
+    cells = nullptr;
+    nCols = nRows = nLays = 0;
+    strideX = strideY = strideZ = 0;
+    nBricksX = nBricksY = nBricksZ = 0;
+}
+
+
+/*!
+ * \brief Releases bricks and output arrays.
+ */
+void IsoSurface::destroy()
+{
+    std::vector<RasterBlock>().swap(bricks);
+    std::vector<double>().swap(brickMins);
+    std::vector<double>().swap(brickMaxs);
+    std::vector<double>().swap(vertices);
+    std::vector<qint64>().swap(triangles);
+    cells = nullptr;
+}
+
+
+/*!
+ * \return Number of vertices of the extracted surface.
+ */
+qint64 IsoSurface::getNumberOfVertices()
+{
+    return qint64(vertices.size() / 3);
+}
+
+
+/*!
+ * \return Number of triangles of the extracted surface.
+ */
+qint64 IsoSurface::getNumberOfTriangles()
+{
+    return qint64(triangles.size() / 3);
+}
+
+
+/*!
+ * \brief Returns the brick owning raster edges starting at a given cell.
+ */
+qint64 IsoSurface::getOwnerBrick(qint64 col, qint64 row, qint64 lay)
+{
+    qint64 bx = qMin(col / brickSize, nBricksX - 1);
+    qint64 by = qMin(row / brickSize, nBricksY - 1);
+    qint64 bz = qMin(lay / brickSize, nBricksZ - 1);
+    return bx + nBricksX * (by + nBricksY * bz);
+}
+
+
+/*!
+ * \brief Splits the raster into bricks and builds the per-brick min/max table.
+ *        The table is reused by all following extract() calls.
+ * \param cells Cell values; cell (col, row, lay, band) is at col + nCols*(row + nRows*(lay + nLays*band)).
+ * \param size Pointer to the raster size.
+ * \param band Band index.
+ * \return True, if the raster has at least 2 x 2 x 2 cells.
+ */
+bool IsoSurface::setup(const double *cells, RasterSize3D *size, qint64 band)
+{
+    RasterSize3DT size3dt(size->nCols, size->nRows, size->nLays, size->nBands, 1);
+    RasterView view(const_cast<double *>(cells), RasterCell::Float64, &size3dt);
+
+    view = view.selectBand(band);
+    return setup(&view);
+}
+
+
+/*!
+ * \brief Splits a raster view into bricks and builds the per-brick min/max table.
+ *        The view is not copied; its buffer must stay valid until destroy().
+ * \param view Pointer to a single-band, single-tick Float64 view.
+ * \return True, if the view is valid and has at least 2 x 2 x 2 cells; false also if the current G3DTCancelToken
+ *         stopped building the table.
+ */
+bool IsoSurface::setup(RasterView *view)
+{
+    destroy();
+    if (!view->isValid() || (view->cellType != RasterCell::Float64)) return false;
+    if ((view->size.nBands != 1) || (view->size.nTicks != 1)) return false;
+    if ((view->size.nCols < 2) || (view->size.nRows < 2) || (view->size.nLays < 2)) return false;
+    for (int axis = RasterView::AxisCol; axis <= RasterView::AxisLay; axis++)
+        if (view->strides[axis] % qint64(sizeof(double))) return false;
+    if (brickSize < 1) brickSize = 1;
+
+    nCols = view->size.nCols;
+    nRows = view->size.nRows;
+    nLays = view->size.nLays;
+    strideX = view->strides[RasterView::AxisCol] / qint64(sizeof(double));
+    strideY = view->strides[RasterView::AxisRow] / qint64(sizeof(double));
+    strideZ = view->strides[RasterView::AxisLay] / qint64(sizeof(double));
+    this->cells = reinterpret_cast<const double *>(view->data);
+
+    nBricksX = (nCols - 1 + brickSize - 1) / brickSize;
+    nBricksY = (nRows - 1 + brickSize - 1) / brickSize;
+    nBricksZ = (nLays - 1 + brickSize - 1) / brickSize;
+
+    bricks.resize(size_t(nBricksX * nBricksY * nBricksZ));
+    brickMins.resize(bricks.size());
+    brickMaxs.resize(bricks.size());
+
+    if (!G3DTParallel::forEach(qint64(bricks.size()), [&](qint64 iBrick) {
+        RasterBlock *brick = &bricks[size_t(iBrick)];
+        qint64 bx = iBrick % nBricksX;
+        qint64 by = (iBrick / nBricksX) % nBricksY;
+        qint64 bz = iBrick / (nBricksX * nBricksY);
+        double vMin = DBL_MAX, vMax = -DBL_MAX, v;
+        qint64 nNotNull = 0;
+
+        brick->set(bx * brickSize, by * brickSize, bz * brickSize, 0, 0,
+                   qMin((bx + 1) * brickSize, nCols - 1), qMin((by + 1) * brickSize, nRows - 1), qMin((bz + 1) * brickSize, nLays - 1), 0, 0);
+        for (qint64 lay = brick->lay0; lay <= brick->lay1; lay++)
+        {
+            for (qint64 row = brick->row0; row <= brick->row1; row++)
+            {
+                const double *p = this->cells + strideY * row + strideZ * lay;
+                for (qint64 col = brick->col0; col <= brick->col1; col++)
+                {
+                    v = p[strideX * col];
+                    if (useNoData && (v == noData)) continue;
+                    if (v < vMin) vMin = v;
+                    if (vMax < v) vMax = v;
+                    nNotNull++;
+                }
+            }
+        }
+        brick->numberOfNotNullCells = nNotNull;
+        brickMins[size_t(iBrick)] = vMin;
+        brickMaxs[size_t(iBrick)] = vMax;
+    }, nThreads))
+    {
+        destroy();
+        return false;
+    }
+
+    return true;
+}
+
+
+/*!
+ * \brief Clears a partially extracted mesh.
+ * \return Always false.
+ */
+bool IsoSurface::cancelExtraction()
+{
+    vertices.clear();
+    triangles.clear();
+    return false;
+}
+
+
+/*!
+ * \brief Extracts the isosurface separating cells below the isovalue from the others.
+ *        Triangles are oriented so that their normals point towards increasing values.
+ * \param isoValue Isovalue.
+ * \return True, if the surface was extracted; false if not set up or if the current G3DTCancelToken stopped
+ *         the extraction, the mesh is then empty.
+ */
+bool IsoSurface::extract(double isoValue)
+{
+    std::vector<IsoSurfaceBrickMesh> meshes;
+    std::vector<qint64> vertexOffsets, triangleOffsets;
+    double ox = 0.0, oy = 0.0, oz = 0.0, dx = 1.0, dy = 1.0, dz = 1.0;
+
+    vertices.clear();
+    triangles.clear();
+    if (!cells) return false;
+
+    if (!extent.isEmpty())
+    {
+        dx = extent.getLengthX() / double(nCols);
+        dy = extent.getLengthY() / double(nRows);
+        dz = extent.getLengthZ() / double(nLays);
+        ox = extent.p0.x + 0.5 * dx;
+        oy = extent.p0.y + 0.5 * dy;
+        oz = extent.p0.z + 0.5 * dz;
+    }
+
+    meshes.resize(bricks.size());
+
+    // polygonize bricks independently
+    if (!G3DTParallel::forEach(qint64(bricks.size()), [&](qint64 iBrick) {
+        RasterBlock *brick = &bricks[size_t(iBrick)];
+        IsoSurfaceBrickMesh *mesh = &meshes[size_t(iBrick)];
+        double v[8];
+        qint64 index[8];
+        qint64 ids[4];
+        int corners[4];
+
+        mesh->nOwned = 0;
+        if (!((brickMins[size_t(iBrick)] < isoValue) && (isoValue <= brickMaxs[size_t(iBrick)]))) return;
+
+        for (qint64 lay = brick->lay0; lay < brick->lay1; lay++)
+        {
+            for (qint64 row = brick->row0; row < brick->row1; row++)
+            {
+                for (qint64 col = brick->col0; col < brick->col1; col++)
+                {
+                    int below = 0;
+                    bool skip = false;
+
+                    for (int c = 0; c < 8; c++)
+                    {
+                        qint64 cx = col + (c & 1), cy = row + ((c >> 1) & 1), cz = lay + ((c >> 2) & 1);
+                        index[c] = cx + nCols * (cy + nRows * cz);
+                        v[c] = cells[strideX * cx + strideY * cy + strideZ * cz];
+                        if (useNoData && (v[c] == noData)) skip = true;
+                        if (v[c] < isoValue) below++;
+                    }
+                    if (skip || (below == 0) || (below == 8)) continue;
+
+                    for (int iTet = 0; iTet < 6; iTet++)
+                    {
+                        int nBelow = 0;
+                        int in[4], out[4], nIn = 0, nOut = 0;
+
+                        for (int k = 0; k < 4; k++)
+                        {
+                            corners[k] = isoSurfaceTetrahedra[iTet][k];
+                            if (v[corners[k]] < isoValue)
+                            {
+                                in[nIn++] = corners[k];
+                                nBelow++;
+                            }
+                            else
+                            {
+                                out[nOut++] = corners[k];
+                            }
+                        }
+                        if ((nBelow == 0) || (nBelow == 4)) continue;
+
+                        // vertices on crossed tetrahedron edges
+                        int edges[4][2], nEdges = 0;
+                        if (nIn == 1)
+                        {
+                            for (int k = 0; k < 3; k++) { edges[nEdges][0] = in[0]; edges[nEdges][1] = out[k]; nEdges++; }
+                        }
+                        else if (nOut == 1)
+                        {
+                            for (int k = 0; k < 3; k++) { edges[nEdges][0] = in[k]; edges[nEdges][1] = out[0]; nEdges++; }
+                        }
+                        else
+                        {
+                            // quad in cyclic order
+                            edges[0][0] = in[0]; edges[0][1] = out[0];
+                            edges[1][0] = in[0]; edges[1][1] = out[1];
+                            edges[2][0] = in[1]; edges[2][1] = out[1];
+                            edges[3][0] = in[1]; edges[3][1] = out[0];
+                            nEdges = 4;
+                        }
+
+                        for (int e = 0; e < nEdges; e++)
+                        {
+                            int a = edges[e][0], b = edges[e][1];
+                            int lo = (a < b) ? a : b, hi = (a < b) ? b : a;
+                            qint64 baseCol = col + (lo & 1), baseRow = row + ((lo >> 1) & 1), baseLay = lay + ((lo >> 2) & 1);
+                            quint64 key = quint64(index[lo]) * 7 + quint64((hi ^ lo) - 1);
+                            std::unordered_map<quint64, qint64>::iterator it = mesh->edgeVertices.find(key);
+
+                            if (it != mesh->edgeVertices.end())
+                            {
+                                ids[e] = it->second;
+                                continue;
+                            }
+
+                            double t = (isoValue - v[a]) / (v[b] - v[a]);
+                            double ax = double(col + (a & 1)), ay = double(row + ((a >> 1) & 1)), az = double(lay + ((a >> 2) & 1));
+                            double bx = double(col + (b & 1)), by = double(row + ((b >> 1) & 1)), bz = double(lay + ((b >> 2) & 1));
+
+                            ids[e] = qint64(mesh->owned.size());
+                            mesh->edgeVertices[key] = ids[e];
+                            mesh->vertices.push_back(ox + dx * (ax + t * (bx - ax)));
+                            mesh->vertices.push_back(oy + dy * (ay + t * (by - ay)));
+                            mesh->vertices.push_back(oz + dz * (az + t * (bz - az)));
+                            if (getOwnerBrick(baseCol, baseRow, baseLay) == iBrick)
+                            {
+                                mesh->owned.push_back(1);
+                                mesh->nOwned++;
+                            }
+                            else
+                            {
+                                mesh->owned.push_back(0);
+                            }
+                        }
+
+                        // orient triangles along the gradient (from a below corner to an above corner)
+                        double gx = double((out[0] & 1) - (in[0] & 1)) * dx;
+                        double gy = double(((out[0] >> 1) & 1) - ((in[0] >> 1) & 1)) * dy;
+                        double gz = double(((out[0] >> 2) & 1) - ((in[0] >> 2) & 1)) * dz;
+                        for (int iTri = 0; iTri + 2 < nEdges; iTri++)
+                        {
+                            qint64 i0 = ids[0], i1 = ids[iTri + 1], i2 = ids[iTri + 2];
+                            const double *p0 = &mesh->vertices[size_t(3 * i0)];
+                            const double *p1 = &mesh->vertices[size_t(3 * i1)];
+                            const double *p2 = &mesh->vertices[size_t(3 * i2)];
+                            double ux = p1[0] - p0[0], uy = p1[1] - p0[1], uz = p1[2] - p0[2];
+                            double wx = p2[0] - p0[0], wy = p2[1] - p0[1], wz = p2[2] - p0[2];
+                            double nx = uy * wz - uz * wy, ny = uz * wx - ux * wz, nz = ux * wy - uy * wx;
+                            if (nx * gx + ny * gy + nz * gz < 0.0) std::swap(i1, i2);
+                            mesh->triangles.push_back(i0);
+                            mesh->triangles.push_back(i1);
+                            mesh->triangles.push_back(i2);
+                        }
+                    }
+                }
+            }
+        }
+    }, nThreads)) return cancelExtraction();
+
+    // global indexes of owned vertices
+    vertexOffsets.assign(meshes.size() + 1, 0);
+    triangleOffsets.assign(meshes.size() + 1, 0);
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        vertexOffsets[i + 1] = vertexOffsets[i] + meshes[i].nOwned;
+        triangleOffsets[i + 1] = triangleOffsets[i] + qint64(meshes[i].triangles.size());
+    }
+    vertices.resize(size_t(3 * vertexOffsets[meshes.size()]));
+    triangles.resize(size_t(triangleOffsets[meshes.size()]));
+
+    if (!G3DTParallel::forEach(qint64(meshes.size()), [&](qint64 iBrick) {
+        IsoSurfaceBrickMesh *mesh = &meshes[size_t(iBrick)];
+        qint64 iGlobal = vertexOffsets[size_t(iBrick)];
+
+        mesh->globalIndexes.assign(mesh->owned.size(), -1);
+        for (size_t i = 0; i < mesh->owned.size(); i++)
+        {
+            if (!mesh->owned[i]) continue;
+            mesh->globalIndexes[i] = iGlobal;
+            vertices[size_t(3 * iGlobal)] = mesh->vertices[3 * i];
+            vertices[size_t(3 * iGlobal + 1)] = mesh->vertices[3 * i + 1];
+            vertices[size_t(3 * iGlobal + 2)] = mesh->vertices[3 * i + 2];
+            iGlobal++;
+        }
+    }, nThreads)) return cancelExtraction();
+
+    // resolve vertices on shared faces through the edge hash of the owner brick
+    if (!G3DTParallel::forEach(qint64(meshes.size()), [&](qint64 iBrick) {
+        IsoSurfaceBrickMesh *mesh = &meshes[size_t(iBrick)];
+        std::unordered_map<quint64, qint64>::iterator it;
+
+        for (it = mesh->edgeVertices.begin(); it != mesh->edgeVertices.end(); ++it)
+        {
+            if (mesh->owned[size_t(it->second)]) continue;
+            qint64 iCorner = qint64(it->first / 7);
+            qint64 col = iCorner % nCols;
+            qint64 row = (iCorner / nCols) % nRows;
+            qint64 lay = iCorner / (nCols * nRows);
+            IsoSurfaceBrickMesh *owner = &meshes[size_t(getOwnerBrick(col, row, lay))];
+            std::unordered_map<quint64, qint64>::iterator ownerIt = owner->edgeVertices.find(it->first);
+            if (ownerIt != owner->edgeVertices.end())
+                mesh->globalIndexes[size_t(it->second)] = owner->globalIndexes[size_t(ownerIt->second)];
+        }
+    }, nThreads)) return cancelExtraction();
+
+    // the owner brick may miss an edge if its cubes were skipped for NoData cells
+    std::unordered_map<quint64, qint64> orphans;
+    for (size_t iBrick = 0; iBrick < meshes.size(); iBrick++)
+    {
+        IsoSurfaceBrickMesh *mesh = &meshes[iBrick];
+        std::unordered_map<quint64, qint64>::iterator it, orphanIt;
+
+        for (it = mesh->edgeVertices.begin(); it != mesh->edgeVertices.end(); ++it)
+        {
+            if (0 <= mesh->globalIndexes[size_t(it->second)]) continue;
+            orphanIt = orphans.find(it->first);
+            if (orphanIt == orphans.end())
+            {
+                orphanIt = orphans.insert(std::make_pair(it->first, getNumberOfVertices())).first;
+                vertices.insert(vertices.end(), &mesh->vertices[size_t(3 * it->second)], &mesh->vertices[size_t(3 * it->second)] + 3);
+            }
+            mesh->globalIndexes[size_t(it->second)] = orphanIt->second;
+        }
+    }
+
+    // copy triangles
+    if (!G3DTParallel::forEach(qint64(meshes.size()), [&](qint64 iBrick) {
+        IsoSurfaceBrickMesh *mesh = &meshes[size_t(iBrick)];
+        qint64 *dst = triangles.data() + triangleOffsets[size_t(iBrick)];
+        for (size_t i = 0; i < mesh->triangles.size(); i++)
+            dst[i] = mesh->globalIndexes[size_t(mesh->triangles[i])];
+    }, nThreads)) return cancelExtraction();
+
+    return true;
+}
@@ -0,0 +1,70 @@
+#ifndef ISOSURFACE_H
+#define ISOSURFACE_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file isosurface.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <vector>
+#include "g3dtcore_global.h"
+#include "Geometry/box3dt.h"
+#include "Geometry/rasterblock.h"
+#include "Geometry/rastersize3d.h"
+#include "rasterview.h"
+
+
+/*!
+ * \brief The IsoSurface extracts isosurfaces from 3D rasters as indexed triangle meshes.
+ *        Every cube of eight neighbouring cells is split into six tetrahedra sharing the main diagonal
+ *        (marching tetrahedra), which gives crack-free surfaces without ambiguous cases.
+ *        The raster is processed in bricks (raster blocks) in parallel. Bricks whose value range
+ *        excludes the isovalue are skipped using a per-brick min/max table built by setup().
+ *        Vertices are keyed by raster edges, so vertices on shared brick faces are emitted only once.
+ */
+class G3DTCORE_EXPORT IsoSurface
+{
+public:
+    qint64 brickSize; //!< number of cubes along each brick edge
+    bool useNoData; //!< skip cubes containing noData cells
+    double noData; //!< NoData value
+    int nThreads; //!< number of threads, 0 for default
+    Box3DT extent; //!< raster extent; if empty, vertices are in cell index coordinates
+
+    std::vector<RasterBlock> bricks; //!< bricks covering the raster; neighbouring bricks share boundary cells
+    std::vector<double> brickMins; //!< minimum value per brick
+    std::vector<double> brickMaxs; //!< maximum value per brick
+
+    std::vector<double> vertices; //!< vertex coordinates as x, y, z triplets
+    std::vector<qint64> triangles; //!< triangles as triplets of vertex indexes
+
+public:
+    IsoSurface();
+
+    bool setup(const double *cells, RasterSize3D *size, qint64 band = 0);
+    bool setup(RasterView *view);
+    bool extract(double isoValue);
+    void destroy();
+
+    qint64 getNumberOfVertices();
+    qint64 getNumberOfTriangles();
+
+private:
+    const double *cells;
+    qint64 nCols, nRows, nLays;
+    qint64 strideX, strideY, strideZ; //!< cell strides in doubles
+    qint64 nBricksX, nBricksY, nBricksZ;
+
+    qint64 getOwnerBrick(qint64 col, qint64 row, qint64 lay);
+    bool cancelExtraction();
+};
+
+#endif // ISOSURFACE_H
@@ -0,0 +1,369 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file lasreader.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <string.h>
+#include <QtEndian>
+#include "lasreader.h"
+#include "g3dtparallel.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define LASREADER_X86
+#include <immintrin.h>
+#endif
+
+
+/*!
+ * \brief Byte offsets of public header fields.
+ */
+enum LasHeaderField
+{
+    LasSignature = 0, //!< char[4] "LASF"
+    LasVersionMajor = 24, //!< quint8
+    LasVersionMinor = 25, //!< quint8
+    LasHeaderSize = 94, //!< quint16
+    LasDataOffset = 96, //!< quint32
+    LasPointFormat = 104, //!< quint8
+    LasRecordLength = 105, //!< quint16
+    LasLegacyCount = 107, //!< quint32
+    LasScale = 131, //!< double[3]
+    LasOffset = 155, //!< double[3]
+    LasExtent = 179, //!< double[6]: max x, min x, max y, min y, max z, min z
+    LasCount = 247 //!< quint64, LAS 1.4
+};
+
+
+/*!
+ * \brief Size of the LAS 1.0 public header and of the LAS 1.4 public header.
+ */
+static const int lasMinHeaderSize = 227;
+static const int lasMaxHeaderSize = 375;
+
+
+/*!
+ * \brief Minimum record length per point format.
+ */
+static const int lasRecordLengths[] = {20, 28, 26, 34, 57, 63, 30, 36, 38, 59, 67};
+
+
+/*!
+ * \brief Decoding parameters of a point format.
+ */
+struct LasDecodeParameters
+{
+    qint64 recordLength;
+    int timeOffset;
+    double scale[3], offset[3];
+};
+
+
+typedef void (*LasDecodeKernel)(const uchar *records, qint64 n, const LasDecodeParameters *p, double *x, double *y, double *z, double *t);
+
+
+static double lasGetDouble(const uchar *buffer)
+{
+    quint64 bits = qFromLittleEndian<quint64>(buffer);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+
+/*!
+ * \brief Decodes coordinates of consecutive records.
+ * \param t Output times, or nullptr.
+ */
+static void lasDecodeScalar(const uchar *records, qint64 n, const LasDecodeParameters *p, double *x, double *y, double *z, double *t)
+{
+    const uchar *r = records;
+
+    for (qint64 i = 0; i < n; i++, r += p->recordLength)
+    {
+        x[i] = double(qFromLittleEndian<qint32>(r)) * p->scale[0] + p->offset[0];
+        y[i] = double(qFromLittleEndian<qint32>(r + 4)) * p->scale[1] + p->offset[1];
+        z[i] = double(qFromLittleEndian<qint32>(r + 8)) * p->scale[2] + p->offset[2];
+    }
+    if (!t) return;
+    r = records;
+    if (p->timeOffset < 0) memset(t, 0, size_t(n) * sizeof(double));
+    else
+        for (qint64 i = 0; i < n; i++, r += p->recordLength) t[i] = lasGetDouble(r + p->timeOffset);
+}
+
+
+#ifdef LASREADER_X86
+/*!
+ * \brief AVX2 version of lasDecodeScalar(). Four records are gathered at once; the remainder is decoded by the scalar loop.
+ *        Multiplication and addition are not fused, so results equal the scalar kernel.
+ */
+__attribute__((target("avx2")))
+static void lasDecodeAvx2(const uchar *records, qint64 n, const LasDecodeParameters *p, double *x, double *y, double *z, double *t)
+{
+    const int stride = int(p->recordLength);
+    const __m128i index = _mm_setr_epi32(0, stride, 2 * stride, 3 * stride);
+    const __m256d sx = _mm256_set1_pd(p->scale[0]), sy = _mm256_set1_pd(p->scale[1]), sz = _mm256_set1_pd(p->scale[2]);
+    const __m256d ox = _mm256_set1_pd(p->offset[0]), oy = _mm256_set1_pd(p->offset[1]), oz = _mm256_set1_pd(p->offset[2]);
+    const uchar *r = records;
+    qint64 i = 0;
+
+    for (; i + 4 <= n; i += 4, r += 4 * p->recordLength)
+    {
+        __m128i ix = _mm_i32gather_epi32(reinterpret_cast<const int *>(r), index, 1);
+        __m128i iy = _mm_i32gather_epi32(reinterpret_cast<const int *>(r + 4), index, 1);
+        __m128i iz = _mm_i32gather_epi32(reinterpret_cast<const int *>(r + 8), index, 1);
+        _mm256_storeu_pd(x + i, _mm256_add_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(ix), sx), ox));
+        _mm256_storeu_pd(y + i, _mm256_add_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(iy), sy), oy));
+        _mm256_storeu_pd(z + i, _mm256_add_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(iz), sz), oz));
+        if (t && (0 <= p->timeOffset))
+            _mm256_storeu_pd(t + i, _mm256_i32gather_pd(reinterpret_cast<const double *>(r + p->timeOffset), index, 1));
+    }
+    if (t && (p->timeOffset < 0)) memset(t, 0, size_t(i) * sizeof(double));
+    if (i < n) lasDecodeScalar(r, n - i, p, x + i, y + i, z + i, t ? t + i : nullptr);
+}
+#endif
+
+
+/*!
+ * \brief Default constructor.
+ */
+LasReader::LasReader()
+{
+    versionMajor = 0;
+    versionMinor = 0;
+    pointFormat = 0;
+    recordLength = 0;
+    nPoints = 0;
+    dataOffset = 0;
+    scaleX = scaleY = scaleZ = 1.0;
+    offsetX = offsetY = offsetZ = 0.0;
+    instructionSet = RasterConvert::getSupportedInstructionSet();
+    nThreads = 0;
+    blockSize = 64 * 1024;
+    chunkSize = 4 * 1024 * 1024;
+    metrics = nullptr;
+    timeOffset = -1;
+}
+
+
+/*!
+ * \brief Destructor. Closes the file.
+ */
+LasReader::~LasReader()
+{
+    close();
+}
+
+
+/*!
+ * \brief Stores an error description and closes the file.
+ * \return Always false.
+ */
+bool LasReader::fail(QString message)
+{
+    errorString = message;
+    close();
+    return false;
+}
+
+
+/*!
+ * \brief Opens a LAS file and reads its public header. No points are read.
+ * \param fileName File name.
+ * \return True, if the file was opened.
+ */
+bool LasReader::open(QString fileName)
+{
+    uchar header[lasMaxHeaderSize];
+    qint64 headerSize, nRead, format;
+
+    close();
+    errorString.clear();
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    return fail("LAS files are not supported on big-endian hosts.");
+#endif
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadOnly)) return fail("Cannot open " + fileName + ".");
+    memset(header, 0, sizeof(header));
+    nRead = file.read(reinterpret_cast<char *>(header), lasMaxHeaderSize);
+    if ((nRead < lasMinHeaderSize) || (memcmp(header + LasSignature, "LASF", 4) != 0)) return fail(fileName + " is not a LAS file.");
+
+    versionMajor = header[LasVersionMajor];
+    versionMinor = header[LasVersionMinor];
+    headerSize = qFromLittleEndian<quint16>(header + LasHeaderSize);
+    dataOffset = qFromLittleEndian<quint32>(header + LasDataOffset);
+    format = header[LasPointFormat];
+    recordLength = qFromLittleEndian<quint16>(header + LasRecordLength);
+    if ((versionMajor != 1) || (4 < versionMinor)) return fail("Unsupported LAS version.");
+    if ((headerSize < lasMinHeaderSize) || (nRead < qMin(headerSize, qint64(lasMaxHeaderSize))) || (dataOffset < headerSize)) return fail("Invalid LAS header.");
+    if (format & 0xC0) return fail("Compressed point records are not supported.");
+    if (10 < format) return fail("Unsupported point format.");
+    if (recordLength < lasRecordLengths[format]) return fail("Invalid point record length.");
+    pointFormat = int(format);
+
+    nPoints = qFromLittleEndian<quint32>(header + LasLegacyCount);
+    if ((4 <= versionMinor) && (LasCount + 8 <= headerSize))
+    {
+        quint64 count = qFromLittleEndian<quint64>(header + LasCount);
+        if (count) nPoints = qint64(count);
+    }
+    if ((nPoints < 0) || ((file.size() - dataOffset) / recordLength < nPoints)) return fail(fileName + " is truncated.");
+
+    scaleX = lasGetDouble(header + LasScale);
+    scaleY = lasGetDouble(header + LasScale + 8);
+    scaleZ = lasGetDouble(header + LasScale + 16);
+    offsetX = lasGetDouble(header + LasOffset);
+    offsetY = lasGetDouble(header + LasOffset + 8);
+    offsetZ = lasGetDouble(header + LasOffset + 16);
+    extent.set(lasGetDouble(header + LasExtent + 8), lasGetDouble(header + LasExtent + 24), lasGetDouble(header + LasExtent + 40), 0.0,
+               lasGetDouble(header + LasExtent), lasGetDouble(header + LasExtent + 16), lasGetDouble(header + LasExtent + 32), 0.0);
+
+    if ((pointFormat == 1) || ((3 <= pointFormat) && (pointFormat <= 5))) timeOffset = 20;
+    else if (6 <= pointFormat) timeOffset = 22;
+    else timeOffset = -1;
+    return true;
+}
+
+
+/*!
+ * \brief Closes the file.
+ */
+void LasReader::close()
+{
+    if (file.isOpen()) file.close();
+    nPoints = 0;
+    timeOffset = -1;
+}
+
+
+/*!
+ * \return True, if a file is open.
+ */
+bool LasReader::isOpen()
+{
+    return file.isOpen();
+}
+
+
+/*!
+ * \return True, if point records store GPS time.
+ */
+bool LasReader::hasTime()
+{
+    return 0 <= timeOffset;
+}
+
+
+/*!
+ * \return Number of point records.
+ */
+qint64 LasReader::getNumberOfPoints()
+{
+    return nPoints;
+}
+
+
+/*!
+ * \brief Maps a range of point records and decodes them in parallel blocks.
+ * \param first Index of the first point.
+ * \param n Number of points.
+ * \param x Output array of n x-coordinates.
+ * \param y Output array of n y-coordinates.
+ * \param z Output array of n z-coordinates.
+ * \param t Output array of n t-coordinates (GPS time), or nullptr.
+ * \return True, if the points were read; false also if the current G3DTCancelToken stopped decoding.
+ */
+bool LasReader::read(qint64 first, qint64 n, double *x, double *y, double *z, double *t)
+{
+    LasDecodeParameters p;
+    LasDecodeKernel kernel = &lasDecodeScalar;
+    qint64 block = qMax(blockSize, qint64(1));
+    uchar *map;
+
+    if (!isOpen()) return false;
+    if ((first < 0) || (n < 0) || (nPoints - first < n)) return false;
+    if (n == 0) return true;
+
+    p.recordLength = recordLength;
+    p.timeOffset = timeOffset;
+    p.scale[0] = scaleX;
+    p.scale[1] = scaleY;
+    p.scale[2] = scaleZ;
+    p.offset[0] = offsetX;
+    p.offset[1] = offsetY;
+    p.offset[2] = offsetZ;
+#ifdef LASREADER_X86
+    if (RasterConvert::AVX2 <= qMin(instructionSet, RasterConvert::getSupportedInstructionSet()))
+        kernel = &lasDecodeAvx2;
+#endif
+
+    map = file.map(dataOffset + first * recordLength, n * recordLength);
+    if (!map)
+    {
+        errorString = "Cannot map point records.";
+        return false;
+    }
+    if (!G3DTParallel::forEach((n + block - 1) / block, [&](qint64 iBlock) {
+        qint64 i0 = iBlock * block;
+        kernel(map + i0 * recordLength, qMin(block, n - i0), &p, x + i0, y + i0, z + i0, t ? t + i0 : nullptr);
+    }, nThreads))
+    {
+        file.unmap(map);
+        errorString = "Reading point records was cancelled.";
+        return false;
+    }
+    file.unmap(map);
+    if (metrics) metrics->getCounter("lasReader.bytesRead")->add(n * recordLength);
+    return true;
+}
+
+
+/*!
+ * \brief Reads all points. Arrays are resized to the number of points.
+ * \param t Output array of t-coordinates (GPS time), or nullptr.
+ * \return True, if the points were read.
+ */
+bool LasReader::read(std::vector<double> *x, std::vector<double> *y, std::vector<double> *z, std::vector<double> *t)
+{
+    if (!isOpen()) return false;
+    x->resize(size_t(nPoints));
+    y->resize(size_t(nPoints));
+    z->resize(size_t(nPoints));
+    if (t) t->resize(size_t(nPoints));
+    return read(0, nPoints, x->data(), y->data(), z->data(), t ? t->data() : nullptr);
+}
+
+
+/*!
+ * \brief Streams all points in chunks of chunkSize points. Only one chunk is mapped at a time and the
+ *        coordinate buffers are reused, so memory use does not depend on the file size.
+ * \param func Function called for every chunk.
+ * \param withTime Decode t-coordinates.
+ * \return True, if all points were read or reading was stopped by the function.
+ */
+bool LasReader::readChunks(ChunkFunction func, bool withTime)
+{
+    qint64 chunk = qMax(qint64(1), qMin(chunkSize, nPoints));
+    std::vector<double> x, y, z, t;
+
+    if (!isOpen()) return false;
+    x.resize(size_t(chunk));
+    y.resize(size_t(chunk));
+    z.resize(size_t(chunk));
+    if (withTime) t.resize(size_t(chunk));
+    for (qint64 first = 0; first < nPoints; first += chunk)
+    {
+        qint64 n = qMin(chunk, nPoints - first);
+        if (!read(first, n, x.data(), y.data(), z.data(), withTime ? t.data() : nullptr)) return false;
+        if (!func(first, n, x.data(), y.data(), z.data(), withTime ? t.data() : nullptr)) return true;
+    }
+    return true;
+}
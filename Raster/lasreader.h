@@ -0,0 +1,84 @@
+#ifndef LASREADER_H
+#define LASREADER_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file lasreader.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <functional>
+#include <vector>
+#include <QFile>
+#include <QString>
+#include "g3dtcore_global.h"
+#include "g3dtmetrics.h"
+#include "Geometry/box3dt.h"
+#include "rasterconvert.h"
+
+
+/*!
+ * \brief The LasReader reads point coordinates from uncompressed LAS files (versions 1.0 to 1.4,
+ *        point formats 0 to 10) into separate x, y, z and t arrays (structure of arrays).
+ *
+ *        Only the header is read by open(); the extent is taken from the header without scanning points.
+ *        Point records are memory mapped window by window, so a read maps only the records it decodes and
+ *        files larger than memory can be streamed by readChunks(). Scaled integer coordinates are decoded
+ *        in parallel blocks by an AVX2 gather kernel or a scalar loop, with identical results.
+ *        The t-coordinate is the GPS time of the point; formats without time yield zero.
+ */
+class G3DTCORE_EXPORT LasReader
+{
+public:
+    /*!
+     * \brief Called for every chunk of decoded points; returning false stops reading.
+     *        Arrays are valid during the call only; t is nullptr if it was not requested.
+     */
+    typedef std::function<bool(qint64 first, qint64 n, const double *x, const double *y, const double *z, const double *t)> ChunkFunction;
+
+    int versionMajor; //!< LAS major version
+    int versionMinor; //!< LAS minor version
+    int pointFormat; //!< point data record format
+    qint64 recordLength; //!< point record length in bytes
+    qint64 nPoints; //!< number of point records
+    qint64 dataOffset; //!< file offset of the first point record
+    double scaleX, scaleY, scaleZ; //!< coordinate scale factors
+    double offsetX, offsetY, offsetZ; //!< coordinate offsets
+    Box3DT extent; //!< extent of points stored in the header, t-coordinates are zero
+
+    RasterConvert::InstructionSet instructionSet; //!< kernel used for decoding, the best supported one by default
+    int nThreads; //!< number of threads, 0 for default
+    qint64 blockSize; //!< number of points decoded by one task
+    qint64 chunkSize; //!< number of points mapped and decoded at once by readChunks()
+    G3DTMetrics *metrics; //!< receives the counter "lasReader.bytesRead" of decoded point records, may be nullptr
+    QString errorString; //!< description of the last error
+
+public:
+    LasReader();
+    ~LasReader();
+
+    bool open(QString fileName);
+    void close();
+    bool isOpen();
+    bool hasTime();
+    qint64 getNumberOfPoints();
+
+    bool read(qint64 first, qint64 n, double *x, double *y, double *z, double *t = nullptr);
+    bool read(std::vector<double> *x, std::vector<double> *y, std::vector<double> *z, std::vector<double> *t = nullptr);
+    bool readChunks(ChunkFunction func, bool withTime = true);
+
+private:
+    QFile file;
+    int timeOffset; //!< offset of GPS time in a record, -1 if the format has no time
+
+    bool fail(QString message);
+};
+
+#endif // LASREADER_H
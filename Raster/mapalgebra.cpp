@@ -0,0 +1,711 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file mapalgebra.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <atomic>
+#include <climits>
+#include <float.h>
+#include <math.h>
+#include <string>
+#include <string.h>
+#include "mapalgebra.h"
+#include "g3dtparallel.h"
+
+
+/*!
+ * \brief Number of cells evaluated together by one pass over the program.
+ */
+static const qint64 mapAlgebraLanes = 256;
+
+
+/*!
+ * \brief Operation codes of the bytecode.
+ */
+enum MapAlgebraOp
+{
+    MapAlgebraAdd, MapAlgebraSub, MapAlgebraMul, MapAlgebraDiv,
+    MapAlgebraNeg, MapAlgebraNot,
+    MapAlgebraLt, MapAlgebraLe, MapAlgebraGt, MapAlgebraGe, MapAlgebraEq, MapAlgebraNe,
+    MapAlgebraAnd, MapAlgebraOr,
+    MapAlgebraMin, MapAlgebraMax, MapAlgebraClamp,
+    MapAlgebraAbs, MapAlgebraSqrt, MapAlgebraExp, MapAlgebraLog, MapAlgebraPow,
+    MapAlgebraWhere
+};
+
+
+/*!
+ * \brief Recursive descent compiler of map algebra expressions to register bytecode.
+ *        Every subexpression returns the register holding its value. Temporary registers
+ *        are released as soon as they are consumed, so the register file stays small.
+ */
+class MapAlgebraCompiler
+{
+public:
+    MapAlgebra *algebra;
+    std::string text;
+    size_t pos;
+    std::vector<int> temps; //!< temporary registers in order of allocation
+    std::vector<int> freeTemps;
+    std::vector<MapAlgebraInstruction> code;
+    QString error;
+
+    MapAlgebraCompiler(MapAlgebra *algebra, QString expression)
+    {
+        QByteArray bytes = expression.toLatin1();
+        this->algebra = algebra;
+        text = std::string(bytes.constData(), size_t(bytes.size()));
+        pos = 0;
+    }
+
+    void skipSpaces()
+    {
+        while ((pos < text.size()) && isspace((unsigned char)text[pos])) pos++;
+    }
+
+    bool accept(const char *token)
+    {
+        size_t n = strlen(token);
+        skipSpaces();
+        if (text.compare(pos, n, token) != 0) return false;
+        // do not split "<=" into "<" and "=" or "&&" into "&"
+        if ((n == 1) && (pos + 1 < text.size()) && (token[0] == '<' || token[0] == '>' || token[0] == '!') && (text[pos + 1] == '=')) return false;
+        pos += n;
+        return true;
+    }
+
+    int fail(const char *message)
+    {
+        if (error.isEmpty()) error = QString("%1 at position %2").arg(QString(message)).arg(qint64(pos));
+        return INT_MIN;
+    }
+
+    /*!
+     * \brief Allocates a temporary register. Temporaries are encoded as negative numbers until renumbering.
+     */
+    int temp()
+    {
+        int r;
+        if (!freeTemps.empty())
+        {
+            r = freeTemps.back();
+            freeTemps.pop_back();
+        }
+        else
+        {
+            r = int(temps.size());
+            temps.push_back(r);
+        }
+        return -1 - r;
+    }
+
+    void release(int r)
+    {
+        if (r < 0) freeTemps.push_back(-1 - r);
+    }
+
+    int instruction(int op, int a, int b = 0, int c = 0)
+    {
+        MapAlgebraInstruction ins;
+        release(a);
+        if ((op != MapAlgebraNeg) && (op != MapAlgebraNot) && (op != MapAlgebraAbs) && (op != MapAlgebraSqrt) && (op != MapAlgebraExp) && (op != MapAlgebraLog)) release(b);
+        if ((op == MapAlgebraClamp) || (op == MapAlgebraWhere)) release(c);
+        int dst = temp();
+        ins.op = op;
+        ins.dst = dst;
+        ins.a = a;
+        ins.b = b;
+        ins.c = c;
+        code.push_back(ins);
+        return dst;
+    }
+
+    int load(qint64 band, qint64 tick)
+    {
+        for (size_t i = 0; i < algebra->loadBands.size(); i++)
+            if ((algebra->loadBands[i] == band) && (algebra->loadTicks[i] == tick)) return int(i);
+        algebra->loadBands.push_back(band);
+        algebra->loadTicks.push_back(tick);
+        return int(algebra->loadBands.size() - 1);
+    }
+
+    /*!
+     * \brief Returns the register of a constant. Constants are encoded from 1000000 until renumbering.
+     */
+    int constant(double value)
+    {
+        for (size_t i = 0; i < algebra->constants.size(); i++)
+            if (algebra->constants[i] == value) return 1000000 + int(i);
+        algebra->constants.push_back(value);
+        return 1000000 + int(algebra->constants.size() - 1);
+    }
+
+    bool parseInteger(qint64 *value)
+    {
+        size_t p0;
+        bool negative = false;
+
+        skipSpaces();
+        if ((pos < text.size()) && (text[pos] == '-' || text[pos] == '+'))
+        {
+            negative = (text[pos] == '-');
+            pos++;
+        }
+        p0 = pos;
+        *value = 0;
+        while ((pos < text.size()) && isdigit((unsigned char)text[pos]))
+            *value = *value * 10 + (text[pos++] - '0');
+        if (negative) *value = -*value;
+        return p0 < pos;
+    }
+
+    int primary()
+    {
+        skipSpaces();
+        if (pos >= text.size()) return fail("unexpected end of expression");
+
+        char ch = text[pos];
+        if (isdigit((unsigned char)ch) || (ch == '.'))
+        {
+            char *end;
+            double value = strtod(text.c_str() + pos, &end);
+            pos = size_t(end - text.c_str());
+            return constant(value);
+        }
+        if (ch == '(')
+        {
+            pos++;
+            int r = expression();
+            if (r == INT_MIN) return INT_MIN;
+            if (!accept(")")) return fail("missing ')'");
+            return r;
+        }
+        if (isalpha((unsigned char)ch))
+        {
+            size_t p0 = pos;
+            while ((pos < text.size()) && (isalnum((unsigned char)text[pos]) || text[pos] == '_')) pos++;
+            std::string name = text.substr(p0, pos - p0);
+
+            if ((name[0] == 'b') && (1 < name.size()) && (name.find_first_not_of("0123456789", 1) == std::string::npos))
+            {
+                qint64 band = atoll(name.c_str() + 1);
+                qint64 tick = 0;
+                if (accept("["))
+                {
+                    if (!parseInteger(&tick)) return fail("expected tick offset");
+                    if (!accept("]")) return fail("missing ']'");
+                }
+                return load(band, tick);
+            }
+
+            int op, nArgs;
+            if (name == "min") { op = MapAlgebraMin; nArgs = 2; }
+            else if (name == "max") { op = MapAlgebraMax; nArgs = 2; }
+            else if (name == "clamp") { op = MapAlgebraClamp; nArgs = 3; }
+            else if (name == "abs") { op = MapAlgebraAbs; nArgs = 1; }
+            else if (name == "sqrt") { op = MapAlgebraSqrt; nArgs = 1; }
+            else if (name == "exp") { op = MapAlgebraExp; nArgs = 1; }
+            else if (name == "log") { op = MapAlgebraLog; nArgs = 1; }
+            else if (name == "pow") { op = MapAlgebraPow; nArgs = 2; }
+            else if (name == "where") { op = MapAlgebraWhere; nArgs = 3; }
+            else return fail("unknown identifier");
+
+            int args[3] = {0, 0, 0};
+            if (!accept("(")) return fail("missing '('");
+            for (int i = 0; i < nArgs; i++)
+            {
+                if ((0 < i) && !accept(",")) return fail("missing ','");
+                args[i] = expression();
+                if (args[i] == INT_MIN) return INT_MIN;
+            }
+            if (!accept(")")) return fail("missing ')'");
+            return instruction(op, args[0], args[1], args[2]);
+        }
+        return fail("unexpected character");
+    }
+
+    int unary()
+    {
+        if (accept("-"))
+        {
+            int r = unary();
+            return (r == INT_MIN) ? INT_MIN : instruction(MapAlgebraNeg, r);
+        }
+        if (accept("!"))
+        {
+            int r = unary();
+            return (r == INT_MIN) ? INT_MIN : instruction(MapAlgebraNot, r);
+        }
+        if (accept("+")) return unary();
+        return primary();
+    }
+
+    int binary(int level)
+    {
+        static const char *tokens[5][6] =
+        {
+            {"||", nullptr},
+            {"&&", nullptr},
+            {"<=", ">=", "==", "!=", "<", ">"},
+            {"+", "-", nullptr},
+            {"*", "/", nullptr}
+        };
+        static const int ops[5][6] =
+        {
+            {MapAlgebraOr},
+            {MapAlgebraAnd},
+            {MapAlgebraLe, MapAlgebraGe, MapAlgebraEq, MapAlgebraNe, MapAlgebraLt, MapAlgebraGt},
+            {MapAlgebraAdd, MapAlgebraSub},
+            {MapAlgebraMul, MapAlgebraDiv}
+        };
+
+        int a = (level == 4) ? unary() : binary(level + 1);
+        while (a != INT_MIN)
+        {
+            int i;
+            for (i = 0; (i < 6) && tokens[level][i]; i++)
+                if (accept(tokens[level][i])) break;
+            if ((6 <= i) || !tokens[level][i]) break;
+            int b = (level == 4) ? unary() : binary(level + 1);
+            if (b == INT_MIN) return INT_MIN;
+            a = instruction(ops[level][i], a, b);
+        }
+        return a;
+    }
+
+    int expression()
+    {
+        return binary(0);
+    }
+};
+
+
+/*!
+ * \brief Default constructor.
+ */
+MapAlgebra::MapAlgebra()
+{
+    useNoData = false;
+    noData = -9999.0;
+    nThreads = 0;
+    rowsPerBlock = 64;
+    nRegisters = 0;
+    resultRegister = -1;
+}
+
+
+/*!
+ * \brief Compiles an expression.
+ * \param expression Expression text.
+ * \return True, if the expression was compiled. Otherwise errorString describes the error.
+ */
+bool MapAlgebra::compile(QString expression)
+{
+    MapAlgebraCompiler compiler(this, expression);
+    int nLoads, nConstants, r;
+
+    program.clear();
+    loadBands.clear();
+    loadTicks.clear();
+    constants.clear();
+    nRegisters = 0;
+    resultRegister = -1;
+    errorString.clear();
+
+    r = compiler.expression();
+    compiler.skipSpaces();
+    if ((r != INT_MIN) && (compiler.pos < compiler.text.size())) compiler.fail("unexpected character");
+    if (!compiler.error.isEmpty())
+    {
+        errorString = compiler.error;
+        loadBands.clear();
+        loadTicks.clear();
+        constants.clear();
+        return false;
+    }
+
+    // registers: loads, constants, temporaries
+    nLoads = int(loadBands.size());
+    nConstants = int(constants.size());
+    auto renumber = [nLoads, nConstants](int reg) {
+        if (reg < 0) return nLoads + nConstants + (-1 - reg);
+        if (1000000 <= reg) return nLoads + (reg - 1000000);
+        return reg;
+    };
+    for (size_t i = 0; i < compiler.code.size(); i++)
+    {
+        MapAlgebraInstruction ins = compiler.code[i];
+        ins.dst = renumber(ins.dst);
+        ins.a = renumber(ins.a);
+        ins.b = renumber(ins.b);
+        ins.c = renumber(ins.c);
+        program.push_back(ins);
+    }
+    resultRegister = renumber(r);
+    nRegisters = nLoads + nConstants + int(compiler.temps.size());
+    return true;
+}
+
+
+/*!
+ * \return True, if an expression is compiled.
+ */
+bool MapAlgebra::isCompiled()
+{
+    return 0 <= resultRegister;
+}
+
+
+/*!
+ * \return Number of bytecode instructions.
+ */
+qint64 MapAlgebra::getNumberOfInstructions()
+{
+    return qint64(program.size());
+}
+
+
+/*!
+ * \brief Evaluates the expression for all cells in parallel over raster blocks.
+ * \param cells Input cells; cell (col, row, lay, band, tick) is at col + nCols*(row + nRows*(lay + nLays*(band + nBands*tick))).
+ * \param size Pointer to the input raster size.
+ * \param output Output single-band raster; cell (col, row, lay, tick) is at col + nCols*(row + nRows*(lay + nLays*tick)).
+ * \return True, if the expression was evaluated; false if the evaluation failed or was cancelled (the output is then partial).
+ */
+bool MapAlgebra::evaluate(const double *cells, RasterSize3DT *size, double *output)
+{
+    RasterSize3DT outputSize(size->nCols, size->nRows, size->nLays, 1, size->nTicks);
+    RasterView inputView(const_cast<double *>(cells), RasterCell::Float64, size);
+    RasterView outputView(output, RasterCell::Float64, &outputSize);
+
+    return evaluate(&inputView, &outputView);
+}
+
+
+/*!
+ * \brief Evaluates the expression for all cells of a view in parallel over raster blocks.
+ * \param input Pointer to a Float64 input view.
+ * \param output Pointer to a single-band Float64 output view with the columns, rows, layers and ticks of the input.
+ * \return True, if the expression was evaluated; false if the evaluation failed or was cancelled by the current
+ *         G3DTCancelToken (the output is then partial).
+ */
+bool MapAlgebra::evaluate(RasterView *input, RasterView *output)
+{
+    RasterSize3DT *size = &input->size;
+    qint64 nRowBlocks, nBlocks;
+    std::atomic<bool> ok(true);
+
+    if (!isCompiled() || !isValidOutput(input, output)) return false;
+    for (size_t i = 0; i < loadBands.size(); i++)
+        if ((loadBands[i] < 0) || (size->nBands <= loadBands[i])) return false;
+
+    if (rowsPerBlock < 1) rowsPerBlock = 1;
+    nRowBlocks = (size->nRows + rowsPerBlock - 1) / rowsPerBlock;
+    nBlocks = nRowBlocks * size->nLays * size->nTicks;
+
+    if (!G3DTParallel::forEach(nBlocks, [&](qint64 iBlock) {
+        RasterBlock block;
+        qint64 row0 = (iBlock % nRowBlocks) * rowsPerBlock;
+        qint64 lay = (iBlock / nRowBlocks) % size->nLays;
+        qint64 tick = iBlock / (nRowBlocks * size->nLays);
+
+        block.set(0, row0, lay, 0, tick, size->nCols - 1, qMin(row0 + rowsPerBlock, size->nRows) - 1, lay, 0, tick);
+        if (!evaluateBlock(input, output, &block)) ok = false;
+    }, nThreads)) return false;
+
+    return ok;
+}
+
+
+/*!
+ * \brief Evaluates the expression for the cells of one raster block (bands of the block are ignored).
+ * \param cells Input cells, see evaluate().
+ * \param size Pointer to the input raster size.
+ * \param block Pointer to the evaluated raster block.
+ * \param output Output single-band raster, see evaluate().
+ * \return True, if the block was evaluated.
+ */
+bool MapAlgebra::evaluateBlock(const double *cells, RasterSize3DT *size, RasterBlock *block, double *output)
+{
+    RasterSize3DT outputSize(size->nCols, size->nRows, size->nLays, 1, size->nTicks);
+    RasterView inputView(const_cast<double *>(cells), RasterCell::Float64, size);
+    RasterView outputView(output, RasterCell::Float64, &outputSize);
+
+    return evaluateBlock(&inputView, &outputView, block);
+}
+
+
+/*!
+ * \brief Evaluates the expression for the cells of one raster block of a view (bands of the block are ignored).
+ *        Rows with unit column stride are read and written in place; strided rows are gathered
+ *        into and scattered from per-batch scratch registers.
+ * \param input Pointer to a Float64 input view.
+ * \param output Pointer to an output view, see evaluate().
+ * \param block Pointer to the evaluated raster block.
+ * \return True, if the block was evaluated.
+ */
+bool MapAlgebra::evaluateBlock(RasterView *input, RasterView *output, RasterBlock *block)
+{
+    RasterSize3DT *size = &input->size;
+    int nLoads = int(loadBands.size());
+    int nConstants = int(constants.size());
+    std::vector<double> scratch(static_cast<size_t>((nRegisters + 2) * mapAlgebraLanes));
+    std::vector<const double *> registers(static_cast<size_t>(nRegisters));
+    double *missing = scratch.data() + (nRegisters - nLoads) * mapAlgebraLanes;
+    double *gathered = missing + mapAlgebraLanes;
+    double *scattered = gathered + nLoads * mapAlgebraLanes;
+    const qint64 cellSize = qint64(sizeof(double));
+    qint64 inputStride = input->strides[RasterView::AxisCol] / cellSize;
+    qint64 outputStride = output->strides[RasterView::AxisCol] / cellSize;
+
+    if (!isCompiled() || !isValidOutput(input, output)) return false;
+
+    for (int r = nLoads; r < nRegisters; r++)
+        registers[size_t(r)] = scratch.data() + (r - nLoads) * mapAlgebraLanes;
+    for (int i = 0; i < nConstants; i++)
+    {
+        double *p = scratch.data() + i * mapAlgebraLanes;
+        for (qint64 k = 0; k < mapAlgebraLanes; k++) p[k] = constants[size_t(i)];
+    }
+    for (qint64 k = 0; k < mapAlgebraLanes; k++) missing[k] = useNoData ? noData : NAN;
+
+    for (qint64 tick = block->tick0; tick <= block->tick1; tick++)
+    {
+        for (qint64 lay = block->lay0; lay <= block->lay1; lay++)
+        {
+            for (qint64 row = block->row0; row <= block->row1; row++)
+            {
+                double *out = reinterpret_cast<double *>(output->getCell(0, row, lay, 0, tick));
+
+                for (qint64 col0 = block->col0; col0 <= block->col1; col0 += mapAlgebraLanes)
+                {
+                    qint64 n = qMin(mapAlgebraLanes, block->col1 + 1 - col0);
+
+                    // unit-stride loads point directly into the input raster
+                    for (int r = 0; r < nLoads; r++)
+                    {
+                        qint64 t = tick + loadTicks[size_t(r)];
+                        if ((t < 0) || (size->nTicks <= t))
+                        {
+                            registers[size_t(r)] = missing;
+                        }
+                        else
+                        {
+                            const double *p = reinterpret_cast<const double *>(input->getCell(col0, row, lay, loadBands[size_t(r)], t));
+                            if (inputStride == 1)
+                            {
+                                registers[size_t(r)] = p;
+                            }
+                            else
+                            {
+                                double *g = gathered + r * mapAlgebraLanes;
+                                for (qint64 k = 0; k < n; k++) g[k] = p[k * inputStride];
+                                registers[size_t(r)] = g;
+                            }
+                        }
+                    }
+
+                    for (size_t i = 0; i < program.size(); i++)
+                    {
+                        const MapAlgebraInstruction &ins = program[i];
+                        double *d = const_cast<double *>(registers[size_t(ins.dst)]);
+                        const double *a = registers[size_t(ins.a)];
+                        const double *b = registers[size_t(ins.b)];
+                        const double *c = registers[size_t(ins.c)];
+                        qint64 k;
+
+                        switch (ins.op)
+                        {
+                        case MapAlgebraAdd: for (k = 0; k < n; k++) d[k] = a[k] + b[k]; break;
+                        case MapAlgebraSub: for (k = 0; k < n; k++) d[k] = a[k] - b[k]; break;
+                        case MapAlgebraMul: for (k = 0; k < n; k++) d[k] = a[k] * b[k]; break;
+                        case MapAlgebraDiv: for (k = 0; k < n; k++) d[k] = a[k] / b[k]; break;
+                        case MapAlgebraNeg: for (k = 0; k < n; k++) d[k] = -a[k]; break;
+                        case MapAlgebraNot: for (k = 0; k < n; k++) d[k] = (a[k] == 0.0) ? 1.0 : 0.0; break;
+                        case MapAlgebraLt: for (k = 0; k < n; k++) d[k] = (a[k] < b[k]) ? 1.0 : 0.0; break;
+                        case MapAlgebraLe: for (k = 0; k < n; k++) d[k] = (a[k] <= b[k]) ? 1.0 : 0.0; break;
+                        case MapAlgebraGt: for (k = 0; k < n; k++) d[k] = (a[k] > b[k]) ? 1.0 : 0.0; break;
+                        case MapAlgebraGe: for (k = 0; k < n; k++) d[k] = (a[k] >= b[k]) ? 1.0 : 0.0; break;
+                        case MapAlgebraEq: for (k = 0; k < n; k++) d[k] = (a[k] == b[k]) ? 1.0 : 0.0; break;
+                        case MapAlgebraNe: for (k = 0; k < n; k++) d[k] = (a[k] != b[k]) ? 1.0 : 0.0; break;
+                        case MapAlgebraAnd: for (k = 0; k < n; k++) d[k] = ((a[k] != 0.0) && (b[k] != 0.0)) ? 1.0 : 0.0; break;
+                        case MapAlgebraOr: for (k = 0; k < n; k++) d[k] = ((a[k] != 0.0) || (b[k] != 0.0)) ? 1.0 : 0.0; break;
+                        case MapAlgebraMin: for (k = 0; k < n; k++) d[k] = (b[k] < a[k]) ? b[k] : a[k]; break;
+                        case MapAlgebraMax: for (k = 0; k < n; k++) d[k] = (a[k] < b[k]) ? b[k] : a[k]; break;
+                        case MapAlgebraClamp: for (k = 0; k < n; k++) d[k] = (a[k] < b[k]) ? b[k] : ((c[k] < a[k]) ? c[k] : a[k]); break;
+                        case MapAlgebraAbs: for (k = 0; k < n; k++) d[k] = fabs(a[k]); break;
+                        case MapAlgebraSqrt: for (k = 0; k < n; k++) d[k] = sqrt(a[k]); break;
+                        case MapAlgebraExp: for (k = 0; k < n; k++) d[k] = exp(a[k]); break;
+                        case MapAlgebraLog: for (k = 0; k < n; k++) d[k] = log(a[k]); break;
+                        case MapAlgebraPow: for (k = 0; k < n; k++) d[k] = pow(a[k], b[k]); break;
+                        case MapAlgebraWhere: for (k = 0; k < n; k++) d[k] = (a[k] != 0.0) ? b[k] : c[k]; break;
+                        }
+                    }
+
+                    const double *result = registers[size_t(resultRegister)];
+                    double *o = (outputStride == 1) ? out + col0 : scattered;
+                    for (qint64 k = 0; k < n; k++) o[k] = result[k];
+                    if (useNoData)
+                    {
+                        for (int r = 0; r < nLoads; r++)
+                        {
+                            const double *p = registers[size_t(r)];
+                            for (qint64 k = 0; k < n; k++)
+                                if (p[k] == noData) o[k] = noData;
+                        }
+                    }
+                    if (outputStride != 1)
+                    {
+                        for (qint64 k = 0; k < n; k++) out[(col0 + k) * outputStride] = scattered[k];
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+
+/*!
+ * \brief Evaluates the expression brick by brick from a store into a store being written, in parallel.
+ *        If every input brick used by an output brick is constant, the brick is evaluated once and written
+ *        as a constant brick; other bricks are decoded and evaluated cell by cell.
+ * \param input Pointer to an opened Float64 store.
+ * \param output Pointer to a created single-band Float64 store with the columns, rows, layers and ticks
+ *        of the input and the same brick extents along them.
+ * \return True, if all bricks were evaluated and written; false if a brick failed or the evaluation was cancelled.
+ */
+bool MapAlgebra::evaluate(BrickStore *input, BrickStore *output)
+{
+    RasterSize3DT *size = &input->size;
+    qint64 minTick = 0, maxTick = 0;
+    std::atomic<bool> ok(true);
+
+    if (!isCompiled() || !input->isOpen() || !output->isOpen()) return false;
+    if ((input->cellType != RasterCell::Float64) || (output->cellType != RasterCell::Float64) || (output->size.nBands != 1)) return false;
+    if ((size->nCols != output->size.nCols) || (size->nRows != output->size.nRows) ||
+        (size->nLays != output->size.nLays) || (size->nTicks != output->size.nTicks)) return false;
+    if ((input->brickSize.nCols != output->brickSize.nCols) || (input->brickSize.nRows != output->brickSize.nRows) ||
+        (input->brickSize.nLays != output->brickSize.nLays) || (input->brickSize.nTicks != output->brickSize.nTicks)) return false;
+    for (size_t i = 0; i < loadBands.size(); i++)
+    {
+        if ((loadBands[i] < 0) || (size->nBands <= loadBands[i])) return false;
+        minTick = qMin(minTick, loadTicks[i]);
+        maxTick = qMax(maxTick, loadTicks[i]);
+    }
+
+    if (!G3DTParallel::forEach(output->getNumberOfBricks(), [&](qint64 iBrick) {
+        RasterBlock block = output->getBrickBlock(iBrick);
+        double value;
+
+        if (evaluateConstantBrick(input, &block, &value))
+        {
+            if (!output->writeConstantBrick(iBrick, value)) ok = false;
+            return;
+        }
+
+        // input cells of the brick with the ticks referenced relative to it
+        qint64 t0 = qMax(block.tick0 + minTick, qint64(0)), t1 = qMin(block.tick1 + maxTick, size->nTicks - 1);
+        RasterBlock inputBlock, evaluated, inBrick;
+        RasterSize3DT inputSize(block.getNumberOfColumns(), block.getNumberOfRows(), block.getNumberOfLayers(), size->nBands, t1 - t0 + 1);
+        RasterSize3DT resultSize(inputSize.nCols, inputSize.nRows, inputSize.nLays, 1, inputSize.nTicks);
+        std::vector<double> cells(static_cast<size_t>(inputSize.getNumberOfCells()));
+        std::vector<double> result(static_cast<size_t>(resultSize.getNumberOfCells()));
+        std::vector<double> brick(static_cast<size_t>(output->getNumberOfBrickCells()), output->useNoData ? output->noData : 0.0);
+        RasterView inputView(cells.data(), RasterCell::Float64, &inputSize);
+        RasterView resultView(result.data(), RasterCell::Float64, &resultSize);
+        RasterView brickView(brick.data(), RasterCell::Float64, &output->brickSize, output->interleave);
+
+        inputBlock.set(block.col0, block.row0, block.lay0, 0, t0, block.col1, block.row1, block.lay1, size->nBands - 1, t1);
+        evaluated.set(0, 0, 0, 0, block.tick0 - t0, inputSize.nCols - 1, inputSize.nRows - 1, inputSize.nLays - 1, 0, block.tick1 - t0);
+        inBrick.set(0, 0, 0, 0, 0, inputSize.nCols - 1, inputSize.nRows - 1, inputSize.nLays - 1, 0, block.getNumberOfTicks() - 1);
+        if (!input->read(&inputBlock, &inputView, 1) || !evaluateBlock(&inputView, &resultView, &evaluated))
+        {
+            ok = false;
+            return;
+        }
+        RasterView part = resultView.crop(&evaluated);
+        RasterView brickPart = brickView.crop(&inBrick);
+        if (!part.copyTo(&brickPart, 1) || !output->writeBrick(iBrick, brick.data())) ok = false;
+    }, nThreads)) return false;
+
+    return ok;
+}
+
+
+/*!
+ * \brief Evaluates an output brick in O(1) if all input bricks it reads are constant.
+ * \param input Pointer to the input store.
+ * \param block Pointer to the cells of the output brick.
+ * \param value Pointer to the value of the output brick.
+ * \return True, if the output brick is constant and was evaluated.
+ */
+bool MapAlgebra::evaluateConstantBrick(BrickStore *input, RasterBlock *block, double *value)
+{
+    qint64 minTick = 0, maxTick = 0;
+
+    for (size_t i = 0; i < loadTicks.size(); i++)
+    {
+        minTick = qMin(minTick, loadTicks[i]);
+        maxTick = qMax(maxTick, loadTicks[i]);
+    }
+
+    // a single cell per used band and relative tick is evaluated by the regular kernel
+    RasterSize3DT cellSize(1, 1, 1, input->size.nBands, maxTick - minTick + 1);
+    RasterSize3DT resultSize(1, 1, 1, 1, cellSize.nTicks);
+    std::vector<double> cells(static_cast<size_t>(cellSize.getNumberOfCells()), 0.0);
+    std::vector<double> result(static_cast<size_t>(resultSize.getNumberOfCells()), 0.0);
+    RasterView cellView(cells.data(), RasterCell::Float64, &cellSize);
+    RasterView resultView(result.data(), RasterCell::Float64, &resultSize);
+    RasterBlock cell;
+
+    for (size_t i = 0; i < loadBands.size(); i++)
+    {
+        qint64 tick0 = block->tick0 + loadTicks[i], tick1 = block->tick1 + loadTicks[i];
+        double loaded = 0.0, brickValue;
+
+        // ticks outside the raster are missing for part of the brick only
+        if ((tick0 < 0) || (input->size.nTicks <= tick1)) return false;
+        for (qint64 tick = tick0; tick <= tick1;)
+        {
+            qint64 iBrick = input->getBrickIndex(block->col0, block->row0, block->lay0, loadBands[i], tick);
+            if (!input->isConstantBrick(iBrick, &brickValue)) return false;
+            if ((tick != tick0) && (memcmp(&brickValue, &loaded, sizeof(double)) != 0)) return false;
+            loaded = brickValue;
+            tick = input->getBrickBlock(iBrick).tick1 + 1;
+        }
+        cellView.setValue(0, 0, 0, loadBands[i], loadTicks[i] - minTick, loaded);
+    }
+
+    cell.set(0, 0, 0, 0, -minTick, 0, 0, 0, 0, -minTick);
+    if (!evaluateBlock(&cellView, &resultView, &cell)) return false;
+    *value = result[size_t(-minTick)];
+    return true;
+}
+
+
+/*!
+ * \brief Tests whether views can be evaluated: Float64 cells with strides aligned to cells
+ *        and a single-band output with the columns, rows, layers and ticks of the input.
+ */
+bool MapAlgebra::isValidOutput(RasterView *input, RasterView *output)
+{
+    const qint64 cellSize = qint64(sizeof(double));
+
+    if (!input->isValid() || !output->isValid()) return false;
+    if ((input->cellType != RasterCell::Float64) || (output->cellType != RasterCell::Float64)) return false;
+    if (output->size.nBands != 1) return false;
+    if ((input->size.nCols != output->size.nCols) || (input->size.nRows != output->size.nRows) ||
+        (input->size.nLays != output->size.nLays) || (input->size.nTicks != output->size.nTicks)) return false;
+    for (int axis = RasterView::AxisCol; axis <= RasterView::AxisTick; axis++)
+        if ((input->strides[axis] % cellSize) || (output->strides[axis] % cellSize)) return false;
+    return true;
+}
@@ -0,0 +1,86 @@
+#ifndef MAPALGEBRA_H
+#define MAPALGEBRA_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file mapalgebra.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <vector>
+#include <QString>
+#include "g3dtcore_global.h"
+#include "Geometry/rasterblock.h"
+#include "Geometry/rastersize3dt.h"
+#include "brickstore.h"
+#include "rasterview.h"
+
+
+/*!
+ * \brief Instruction of a compiled map algebra expression.
+ */
+struct MapAlgebraInstruction
+{
+    int op; //!< operation code
+    int dst; //!< destination register
+    int a, b, c; //!< operand registers
+};
+
+
+/*!
+ * \brief The MapAlgebra evaluates band math expressions over 3DT rasters in a single fused pass.
+ *        An expression is compiled to a register bytecode. Cells are processed in batches; every band
+ *        used by the expression is loaded once per batch and all intermediates stay in small
+ *        per-thread register arrays (L1-resident), so no temporary rasters are allocated.
+ *        The raster is evaluated in parallel over raster blocks, or over bricks of a BrickStore; bricks whose
+ *        used input bricks are all constant are evaluated once and stored as constant bricks.
+ *
+ *        Syntax: numbers, bands b0, b1, ... (at the current tick), b2[-1] (band 2 at the previous tick),
+ *        operators + - * / < <= > >= == != && || !, and functions
+ *        min(a, b), max(a, b), clamp(x, lo, hi), abs(x), sqrt(x), exp(x), log(x), pow(a, b), where(c, a, b).
+ *        Example: clamp((b3 - b2) / (b3 + b2), -1, 1)
+ */
+class G3DTCORE_EXPORT MapAlgebra
+{
+public:
+    bool useNoData; //!< cells where any used band is noData evaluate to noData
+    double noData; //!< NoData value of input and output rasters
+    int nThreads; //!< number of threads, 0 for default
+    qint64 rowsPerBlock; //!< number of rows in a raster block
+    QString errorString; //!< description of the last compilation error
+
+public:
+    MapAlgebra();
+
+    bool compile(QString expression);
+    bool isCompiled();
+    qint64 getNumberOfInstructions();
+
+    bool evaluate(const double *cells, RasterSize3DT *size, double *output);
+    bool evaluateBlock(const double *cells, RasterSize3DT *size, RasterBlock *block, double *output);
+    bool evaluate(RasterView *input, RasterView *output);
+    bool evaluateBlock(RasterView *input, RasterView *output, RasterBlock *block);
+    bool evaluate(BrickStore *input, BrickStore *output);
+
+private:
+    std::vector<MapAlgebraInstruction> program;
+    std::vector<qint64> loadBands; //!< band per load register
+    std::vector<qint64> loadTicks; //!< relative tick per load register
+    std::vector<double> constants; //!< value per constant register
+    int nRegisters;
+    int resultRegister;
+
+    bool isValidOutput(RasterView *input, RasterView *output);
+    bool evaluateConstantBrick(BrickStore *input, RasterBlock *block, double *value);
+
+    friend class MapAlgebraCompiler;
+};
+
+#endif // MAPALGEBRA_H
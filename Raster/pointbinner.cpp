@@ -0,0 +1,601 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file pointbinner.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <float.h>
+#include "pointbinner.h"
+#include "g3dtparallel.h"
+
+
+/*!
+ * \brief Pointers to the accumulators of one grid (the output grid or a private grid).
+ */
+struct PointBinnerGrid
+{
+    qint64 *counts;
+    double *sums;
+    double *mins;
+    double *maxs;
+    double *lastValues;
+    double *lastTimes;
+
+    /*!
+     * \brief Points the grid to accumulator arrays. Statistics with empty arrays are not accumulated.
+     */
+    void set(std::vector<qint64> *counts, std::vector<double> *sums, std::vector<double> *mins, std::vector<double> *maxs,
+             std::vector<double> *lastValues, std::vector<double> *lastTimes)
+    {
+        this->counts = counts->data();
+        this->sums = sums->empty() ? nullptr : sums->data();
+        this->mins = mins->empty() ? nullptr : mins->data();
+        this->maxs = maxs->empty() ? nullptr : maxs->data();
+        this->lastValues = lastValues->empty() ? nullptr : lastValues->data();
+        this->lastTimes = lastTimes->empty() ? nullptr : lastTimes->data();
+    }
+
+    /*!
+     * \brief Accumulates a value into a cell. Ties in t are resolved in favour of the later point.
+     */
+    inline void add(qint64 iCell, double value, double t)
+    {
+        counts[iCell]++;
+        if (sums) sums[iCell] += value;
+        if (mins && value < mins[iCell]) mins[iCell] = value;
+        if (maxs && maxs[iCell] < value) maxs[iCell] = value;
+        if (lastTimes && lastTimes[iCell] <= t)
+        {
+            lastTimes[iCell] = t;
+            lastValues[iCell] = value;
+        }
+    }
+
+    /*!
+     * \brief Merges a cell of another grid into this grid. The other grid holds later points.
+     */
+    inline void merge(qint64 iCell, PointBinnerGrid *grid)
+    {
+        if (grid->counts[iCell] == 0) return;
+        counts[iCell] += grid->counts[iCell];
+        if (sums) sums[iCell] += grid->sums[iCell];
+        if (mins && grid->mins[iCell] < mins[iCell]) mins[iCell] = grid->mins[iCell];
+        if (maxs && maxs[iCell] < grid->maxs[iCell]) maxs[iCell] = grid->maxs[iCell];
+        if (lastTimes && lastTimes[iCell] <= grid->lastTimes[iCell])
+        {
+            lastTimes[iCell] = grid->lastTimes[iCell];
+            lastValues[iCell] = grid->lastValues[iCell];
+        }
+    }
+};
+
+
+/*!
+ * \brief Owns the accumulators of a per-thread private grid.
+ */
+struct PointBinnerPrivateGrid
+{
+    std::vector<qint64> counts;
+    std::vector<double> sums, mins, maxs, lastValues, lastTimes;
+    PointBinnerGrid grid;
+
+    void allocate(qint64 nCells, int statistics)
+    {
+        counts.assign(size_t(nCells), 0);
+        if (statistics & (PointBinner::StatSum | PointBinner::StatMean)) sums.assign(size_t(nCells), 0.0);
+        if (statistics & PointBinner::StatMin) mins.assign(size_t(nCells), DBL_MAX);
+        if (statistics & PointBinner::StatMax) maxs.assign(size_t(nCells), -DBL_MAX);
+        if (statistics & PointBinner::StatLast)
+        {
+            lastValues.assign(size_t(nCells), 0.0);
+            lastTimes.assign(size_t(nCells), -DBL_MAX);
+        }
+        grid.set(&counts, &sums, &mins, &maxs, &lastValues, &lastTimes);
+    }
+};
+
+
+/*!
+ * \brief Point source reading an array of 3DT point objects.
+ */
+struct PointBinnerObjectSource
+{
+    Point3DT *points;
+    const double *values;
+
+    inline double x(qint64 i) { return points[i].x; }
+    inline double y(qint64 i) { return points[i].y; }
+    inline double z(qint64 i) { return points[i].z; }
+    inline double t(qint64 i) { return points[i].t; }
+    inline double value(qint64 i) { return values ? values[i] : points[i].z; }
+};
+
+
+/*!
+ * \brief Point source reading separate coordinate arrays (structure of arrays).
+ */
+struct PointBinnerArraySource
+{
+    const double *px, *py, *pz, *pt;
+    const double *values;
+
+    inline double x(qint64 i) { return px[i]; }
+    inline double y(qint64 i) { return py[i]; }
+    inline double z(qint64 i) { return pz ? pz[i] : 0.0; }
+    inline double t(qint64 i) { return pt ? pt[i] : 0.0; }
+    inline double value(qint64 i) { return values ? values[i] : (pz ? pz[i] : 0.0); }
+};
+
+
+/*!
+ * \brief Record of a point scattered into a cell-range partition.
+ */
+struct PointBinnerRecord
+{
+    qint64 iCell;
+    double value;
+    double t;
+};
+
+
+/*!
+ * \brief Default constructor.
+ */
+PointBinner::PointBinner()
+{
+    statistics = StatCount;
+    strategy = StrategyAuto;
+    memoryBudget = qint64(512) * 1024 * 1024;
+    nThreads = 0;
+    numberOfBinnedPoints = 0;
+    numberOfRejectedPoints = 0;
+    sx = sy = sz = st = 0.0;
+}
+
+
+/*!
+ * \brief Setups the binned extent, raster shape and accumulated statistics. Clears accumulators.
+ * \param extent Pointer to the binned extent.
+ * \param size Pointer to the raster size. Columns, rows, layers and ticks must be positive.
+ * \param statistics Combination of Statistic flags.
+ * \return True, if the binner was sucessfully set up.
+ */
+bool PointBinner::setup(Box3DT *extent, RasterSize3DT *size, int statistics)
+{
+    if (extent->isEmpty()) return false;
+    if ((size->nCols < 1) || (size->nRows < 1) || (size->nLays < 1) || (size->nTicks < 1)) return false;
+
+    this->extent.set(extent);
+    this->size = *size;
+    this->statistics = statistics;
+
+    sx = (0.0 < this->extent.getLengthX()) ? double(size->nCols) / this->extent.getLengthX() : 0.0;
+    sy = (0.0 < this->extent.getLengthY()) ? double(size->nRows) / this->extent.getLengthY() : 0.0;
+    sz = (0.0 < this->extent.getLengthZ()) ? double(size->nLays) / this->extent.getLengthZ() : 0.0;
+    st = (0.0 < this->extent.getLengthT()) ? double(size->nTicks) / this->extent.getLengthT() : 0.0;
+
+    clear();
+    return true;
+}
+
+
+/*!
+ * \brief Resets all accumulators to empty cells.
+ */
+void PointBinner::clear()
+{
+    PointBinnerPrivateGrid grid;
+    qint64 nCells = getNumberOfCells();
+
+    grid.allocate(nCells, statistics);
+    counts.swap(grid.counts);
+    sums.swap(grid.sums);
+    mins.swap(grid.mins);
+    maxs.swap(grid.maxs);
+    lastValues.swap(grid.lastValues);
+    lastTimes.swap(grid.lastTimes);
+    numberOfBinnedPoints = 0;
+    numberOfRejectedPoints = 0;
+}
+
+
+/*!
+ * \brief Releases allocated accumulators.
+ */
+void PointBinner::destroy()
+{
+    std::vector<qint64>().swap(counts);
+    std::vector<double>().swap(sums);
+    std::vector<double>().swap(mins);
+    std::vector<double>().swap(maxs);
+    std::vector<double>().swap(lastValues);
+    std::vector<double>().swap(lastTimes);
+}
+
+
+/*!
+ * \return Number of raster cells (columns x rows x layers x ticks).
+ */
+qint64 PointBinner::getNumberOfCells()
+{
+    return size.nCols * size.nRows * size.nLays * size.nTicks;
+}
+
+
+/*!
+ * \brief Maps a point to a raster cell. Points on the upper boundary belong to the last cell.
+ * \param x x-coordinate of a point.
+ * \param y y-coordinate of a point.
+ * \param z z-coordinate of a point.
+ * \param t t-coordinate of a point.
+ * \return Cell index, or -1 if the point is outside the extent.
+ */
+qint64 PointBinner::getCellIndex(double x, double y, double z, double t)
+{
+    if (!((extent.p0.x <= x) && (x <= extent.p1.x) && (extent.p0.y <= y) && (y <= extent.p1.y) &&
+          (extent.p0.z <= z) && (z <= extent.p1.z) && (extent.p0.t <= t) && (t <= extent.p1.t))) return -1;
+
+    qint64 col = qint64((x - extent.p0.x) * sx);
+    qint64 row = qint64((y - extent.p0.y) * sy);
+    qint64 lay = qint64((z - extent.p0.z) * sz);
+    qint64 tick = qint64((t - extent.p0.t) * st);
+    if (size.nCols <= col) col = size.nCols - 1;
+    if (size.nRows <= row) row = size.nRows - 1;
+    if (size.nLays <= lay) lay = size.nLays - 1;
+    if (size.nTicks <= tick) tick = size.nTicks - 1;
+
+    return col + size.nCols * (row + size.nRows * (lay + size.nLays * tick));
+}
+
+
+/*!
+ * \return Size of all accumulators of one cell in bytes.
+ */
+qint64 PointBinner::getBytesPerCell()
+{
+    qint64 n = qint64(sizeof(qint64));
+    if (!sums.empty()) n += qint64(sizeof(double));
+    if (!mins.empty()) n += qint64(sizeof(double));
+    if (!maxs.empty()) n += qint64(sizeof(double));
+    if (!lastTimes.empty()) n += 2 * qint64(sizeof(double));
+    return n;
+}
+
+
+/*!
+ * \brief Bins an array of 3DT points. Accumulates into the results of previous calls.
+ * \param points Pointer to an array of points.
+ * \param nPoints Number of points.
+ * \param values Optional per-point values. If null, z-coordinates are binned.
+ * \return True, if points were binned; false if the binner is not set up or binning was cancelled by the current
+ *         G3DTCancelToken (accumulators then hold an unspecified part of the points and should be cleared).
+ */
+bool PointBinner::add(Point3DT *points, qint64 nPoints, const double *values)
+{
+    PointBinnerObjectSource source;
+
+    source.points = points;
+    source.values = values;
+    return addPoints(source, nPoints);
+}
+
+
+/*!
+ * \brief Bins points stored in separate coordinate arrays. Accumulates into the results of previous calls.
+ * \param x Array of x-coordinates.
+ * \param y Array of y-coordinates.
+ * \param z Array of z-coordinates, or null for 0.
+ * \param t Array of t-coordinates, or null for 0.
+ * \param values Optional per-point values. If null, z-coordinates are binned.
+ * \param nPoints Number of points.
+ * \return True, if points were binned; false if the binner is not set up or binning was cancelled, see add().
+ */
+bool PointBinner::add(const double *x, const double *y, const double *z, const double *t, const double *values, qint64 nPoints)
+{
+    PointBinnerArraySource source;
+
+    source.px = x;
+    source.py = y;
+    source.pz = z;
+    source.pt = t;
+    source.values = values;
+    return addPoints(source, nPoints);
+}
+
+
+/*!
+ * \brief Selects the accumulation strategy and bins points.
+ */
+template <class Source>
+bool PointBinner::addPoints(Source &source, qint64 nPoints)
+{
+    qint64 nCells = getNumberOfCells();
+    int n;
+    Strategy s;
+
+    if (counts.empty() || (qint64(counts.size()) != nCells)) return false;
+    if (nPoints <= 0) return true;
+
+    n = (nThreads <= 0) ? G3DTParallel::getNumberOfThreads() : nThreads;
+    if (nPoints < qint64(n) * 4096) n = int((nPoints + 4095) / 4096);
+
+    s = strategy;
+    if (s == StrategyAuto)
+    {
+        qint64 privateBytes = qint64(n - 1) * nCells * getBytesPerCell();
+        if ((privateBytes <= memoryBudget) && (nCells * (n - 1) <= nPoints))
+            s = StrategyPrivateGrids;
+        else
+            s = StrategyPartitioned;
+    }
+
+    if (n <= 1)
+    {
+        addSequential(source, 0, nPoints);
+        return true;
+    }
+    if (s == StrategyPrivateGrids) return addPrivateGrids(source, nPoints, n);
+    return addPartitioned(source, nPoints, n);
+}
+
+
+/*!
+ * \brief Bins a range of points directly into the output grid.
+ */
+template <class Source>
+void PointBinner::addSequential(Source &source, qint64 iPoint0, qint64 iPoint1)
+{
+    PointBinnerGrid grid;
+    qint64 iCell, nBinned = 0;
+
+    grid.set(&counts, &sums, &mins, &maxs, &lastValues, &lastTimes);
+
+    for (qint64 i = iPoint0; i < iPoint1; i++)
+    {
+        iCell = getCellIndex(source.x(i), source.y(i), source.z(i), source.t(i));
+        if (0 <= iCell)
+        {
+            grid.add(iCell, source.value(i), source.t(i));
+            nBinned++;
+        }
+    }
+    numberOfBinnedPoints += nBinned;
+    numberOfRejectedPoints += (iPoint1 - iPoint0) - nBinned;
+}
+
+
+/*!
+ * \brief Bins points into per-chunk private grids and merges them in parallel over cell ranges.
+ *        Points are split into contiguous chunks; the first chunk is binned directly into the output grid.
+ *        Chunks are merged in order, which keeps the StatLast tie-breaking identical to sequential binning.
+ * \return False, if binning was cancelled.
+ */
+template <class Source>
+bool PointBinner::addPrivateGrids(Source &source, qint64 nPoints, int nThreads)
+{
+    qint64 nCells = getNumberOfCells();
+    qint64 chunkSize = (nPoints + nThreads - 1) / nThreads;
+    std::vector<PointBinnerPrivateGrid> privateGrids(size_t(nThreads - 1));
+    std::vector<qint64> nBinned(size_t(nThreads), 0);
+    PointBinnerGrid output;
+
+    output.set(&counts, &sums, &mins, &maxs, &lastValues, &lastTimes);
+
+    if (!G3DTParallel::forEach(nThreads, [&](qint64 iChunk) {
+        PointBinnerGrid *grid = &output;
+        qint64 iPoint0 = iChunk * chunkSize;
+        qint64 iPoint1 = qMin(iPoint0 + chunkSize, nPoints);
+        qint64 iCell, n = 0;
+
+        if (0 < iChunk)
+        {
+            privateGrids[size_t(iChunk - 1)].allocate(nCells, statistics);
+            grid = &privateGrids[size_t(iChunk - 1)].grid;
+        }
+        for (qint64 i = iPoint0; i < iPoint1; i++)
+        {
+            iCell = getCellIndex(source.x(i), source.y(i), source.z(i), source.t(i));
+            if (0 <= iCell)
+            {
+                grid->add(iCell, source.value(i), source.t(i));
+                n++;
+            }
+        }
+        nBinned[size_t(iChunk)] = n;
+    }, nThreads)) return false;
+
+    const qint64 rangeSize = 64 * 1024;
+    if (!G3DTParallel::forEach((nCells + rangeSize - 1) / rangeSize, [&](qint64 iRange) {
+        qint64 iCell0 = iRange * rangeSize;
+        qint64 iCell1 = qMin(iCell0 + rangeSize, nCells);
+        for (size_t iGrid = 0; iGrid < privateGrids.size(); iGrid++)
+        {
+            for (qint64 iCell = iCell0; iCell < iCell1; iCell++)
+                output.merge(iCell, &privateGrids[iGrid].grid);
+        }
+    }, nThreads)) return false;
+
+    qint64 n = 0;
+    for (int i = 0; i < nThreads; i++)
+        n += nBinned[size_t(i)];
+    numberOfBinnedPoints += n;
+    numberOfRejectedPoints += nPoints - n;
+    return true;
+}
+
+
+/*!
+ * \brief Scatters points into cell-range partitions and accumulates each partition by a single thread.
+ *        Points are processed in batches bounded by the memory budget. The scatter is stable,
+ *        so the StatLast tie-breaking is identical to sequential binning.
+ * \return False, if binning was cancelled. Batches accumulated before are kept.
+ */
+template <class Source>
+bool PointBinner::addPartitioned(Source &source, qint64 nPoints, int nThreads)
+{
+    qint64 nCells = getNumberOfCells();
+    qint64 nParts = qMin(qint64(nThreads) * 8, nCells);
+    qint64 partSize = (nCells + nParts - 1) / nParts;
+    qint64 nChunks = qint64(nThreads) * 4;
+    qint64 bytesPerPoint = qint64(sizeof(qint64) + sizeof(PointBinnerRecord));
+    qint64 batchSize = qMax(memoryBudget / bytesPerPoint, nChunks * 4096);
+    std::vector<qint64> cellIndexes;
+    std::vector<PointBinnerRecord> records;
+    std::vector<qint64> offsets;
+    PointBinnerGrid output;
+
+    nParts = (nCells + partSize - 1) / partSize;
+
+    output.set(&counts, &sums, &mins, &maxs, &lastValues, &lastTimes);
+
+    for (qint64 iBatch0 = 0; iBatch0 < nPoints; iBatch0 += batchSize)
+    {
+        qint64 nBatch = qMin(batchSize, nPoints - iBatch0);
+        qint64 chunkSize = (nBatch + nChunks - 1) / nChunks;
+
+        cellIndexes.resize(size_t(nBatch));
+        offsets.assign(size_t(nChunks * nParts + 1), 0);
+
+        // pass 1: cell indexes and per-chunk partition histograms
+        if (!G3DTParallel::forEach(nChunks, [&](qint64 iChunk) {
+            qint64 *histogram = offsets.data() + iChunk * nParts;
+            qint64 i0 = qMin(iChunk * chunkSize, nBatch);
+            qint64 i1 = qMin(i0 + chunkSize, nBatch);
+            qint64 iCell;
+            for (qint64 i = i0; i < i1; i++)
+            {
+                iCell = getCellIndex(source.x(iBatch0 + i), source.y(iBatch0 + i), source.z(iBatch0 + i), source.t(iBatch0 + i));
+                cellIndexes[size_t(i)] = iCell;
+                if (0 <= iCell) histogram[iCell / partSize]++;
+            }
+        }, nThreads)) return false;
+
+        // exclusive prefix sum in partition-major, chunk-minor order
+        std::vector<qint64> partOffsets(size_t(nParts + 1), 0);
+        qint64 total = 0;
+        for (qint64 iPart = 0; iPart < nParts; iPart++)
+        {
+            partOffsets[size_t(iPart)] = total;
+            for (qint64 iChunk = 0; iChunk < nChunks; iChunk++)
+            {
+                qint64 n = offsets[size_t(iChunk * nParts + iPart)];
+                offsets[size_t(iChunk * nParts + iPart)] = total;
+                total += n;
+            }
+        }
+        partOffsets[size_t(nParts)] = total;
+        records.resize(size_t(total));
+
+        // pass 2: stable scatter into partitions
+        if (!G3DTParallel::forEach(nChunks, [&](qint64 iChunk) {
+            qint64 *cursor = offsets.data() + iChunk * nParts;
+            qint64 i0 = qMin(iChunk * chunkSize, nBatch);
+            qint64 i1 = qMin(i0 + chunkSize, nBatch);
+            qint64 iCell;
+            for (qint64 i = i0; i < i1; i++)
+            {
+                iCell = cellIndexes[size_t(i)];
+                if (iCell < 0) continue;
+                PointBinnerRecord &r = records[size_t(cursor[iCell / partSize]++)];
+                r.iCell = iCell;
+                r.value = source.value(iBatch0 + i);
+                r.t = source.t(iBatch0 + i);
+            }
+        }, nThreads)) return false;
+
+        // pass 3: every partition is accumulated by one thread
+        if (!G3DTParallel::forEach(nParts, [&](qint64 iPart) {
+            for (qint64 i = partOffsets[size_t(iPart)]; i < partOffsets[size_t(iPart + 1)]; i++)
+            {
+                PointBinnerRecord &r = records[size_t(i)];
+                output.add(r.iCell, r.value, r.t);
+            }
+        }, nThreads)) return false;
+
+        numberOfBinnedPoints += total;
+        numberOfRejectedPoints += nBatch - total;
+    }
+    return true;
+}
+
+
+/*!
+ * \brief Writes a statistic of all cells to a raster array.
+ * \param stat Requested statistic. It must have been accumulated (StatMean requires sums).
+ * \param raster Output array with getNumberOfCells() values.
+ * \param noData Value written to cells without points.
+ * \return True, if the statistic is available and was written; false if writing was cancelled.
+ */
+bool PointBinner::getStatistic(Statistic stat, double *raster, double noData)
+{
+    qint64 nCells = getNumberOfCells();
+    const qint64 rangeSize = 64 * 1024;
+
+    if (counts.empty()) return false;
+    if ((stat == StatSum || stat == StatMean) && sums.empty()) return false;
+    if ((stat == StatMin) && mins.empty()) return false;
+    if ((stat == StatMax) && maxs.empty()) return false;
+    if ((stat == StatLast) && lastValues.empty()) return false;
+    if ((stat != StatCount) && (stat != StatSum) && (stat != StatMean) && (stat != StatMin) && (stat != StatMax) && (stat != StatLast)) return false;
+
+    return G3DTParallel::forEach((nCells + rangeSize - 1) / rangeSize, [&](qint64 iRange) {
+        qint64 iCell0 = iRange * rangeSize;
+        qint64 iCell1 = qMin(iCell0 + rangeSize, nCells);
+        for (qint64 i = iCell0; i < iCell1; i++)
+        {
+            if (counts[size_t(i)] == 0)
+                raster[i] = (stat == StatCount) ? 0.0 : noData;
+            else if (stat == StatCount)
+                raster[i] = double(counts[size_t(i)]);
+            else if (stat == StatSum)
+                raster[i] = sums[size_t(i)];
+            else if (stat == StatMean)
+                raster[i] = sums[size_t(i)] / double(counts[size_t(i)]);
+            else if (stat == StatMin)
+                raster[i] = mins[size_t(i)];
+            else if (stat == StatMax)
+                raster[i] = maxs[size_t(i)];
+            else
+                raster[i] = lastValues[size_t(i)];
+        }
+    }, nThreads);
+}
+
+
+/*!
+ * \brief Writes a statistic of all cells to a raster view of any cell type.
+ * \param stat Requested statistic, see getStatistic().
+ * \param view Pointer to a single-band view with the columns, rows, layers and ticks of the binner.
+ * \param noData Value written to cells without points.
+ * \return True, if the statistic is available, the view has a matching shape and the statistic was written.
+ */
+bool PointBinner::getStatistic(Statistic stat, RasterView *view, double noData)
+{
+    std::vector<double> raster;
+
+    if (!view->isValid() || (view->size.nBands != 1)) return false;
+    if ((view->size.nCols != size.nCols) || (view->size.nRows != size.nRows) ||
+        (view->size.nLays != size.nLays) || (view->size.nTicks != size.nTicks)) return false;
+
+    if ((view->cellType == RasterCell::Float64) && view->isContiguous())
+        return getStatistic(stat, reinterpret_cast<double *>(view->data), noData);
+
+    raster.resize(size_t(getNumberOfCells()));
+    if (!getStatistic(stat, raster.data(), noData)) return false;
+
+    return G3DTParallel::forEach(size.nRows * size.nLays * size.nTicks, [&](qint64 iLine) {
+        qint64 row = iLine % size.nRows;
+        qint64 lay = (iLine / size.nRows) % size.nLays;
+        qint64 tick = iLine / (size.nRows * size.nLays);
+        const double *p = raster.data() + size.nCols * iLine;
+        for (qint64 col = 0; col < size.nCols; col++)
+            view->setValue(col, row, lay, 0, tick, p[col]);
+    }, nThreads);
+}
@@ -0,0 +1,94 @@
+#ifndef POINTBINNER_H
+#define POINTBINNER_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file pointbinner.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <vector>
+#include "g3dtcore_global.h"
+#include "Geometry/box3dt.h"
+#include "Geometry/rastersize3dt.h"
+#include "rasterview.h"
+
+
+/*!
+ * \brief The PointBinner grids 3DT points into raster cells and accumulates per-cell statistics.
+ *        Cells are addressed as col + nCols*(row + nRows*(lay + nLays*tick)); the band dimension is not used.
+ *        Threads never share accumulators: either every thread fills a private grid that is merged
+ *        in parallel, or points are first partitioned by cell ranges so that each range has a single owner.
+ */
+class G3DTCORE_EXPORT PointBinner
+{
+public:
+    enum Statistic
+    {
+        StatCount = 0x01, //!< number of points
+        StatSum = 0x02, //!< sum of values
+        StatMin = 0x04, //!< minimum value
+        StatMax = 0x08, //!< maximum value
+        StatMean = 0x10, //!< mean value (requires sums)
+        StatLast = 0x20, //!< value of the point with the greatest t-coordinate
+        StatAll = 0x3F
+    };
+
+    enum Strategy
+    {
+        StrategyAuto, //!< choose by memory budget and number of points
+        StrategyPrivateGrids, //!< per-thread private grids merged at the end
+        StrategyPartitioned //!< points scattered into cell-range partitions, one owner per partition
+    };
+
+    Box3DT extent; //!< binned extent
+    RasterSize3DT size; //!< raster shape
+    int statistics; //!< combination of Statistic flags
+    Strategy strategy; //!< accumulation strategy
+    qint64 memoryBudget; //!< maximum size of temporary buffers in bytes
+    int nThreads; //!< number of threads, 0 for default
+
+    std::vector<qint64> counts; //!< number of points per cell
+    std::vector<double> sums; //!< sum of values per cell
+    std::vector<double> mins; //!< minimum value per cell
+    std::vector<double> maxs; //!< maximum value per cell
+    std::vector<double> lastValues; //!< value of the latest point per cell
+    std::vector<double> lastTimes; //!< t-coordinate of the latest point per cell
+
+    qint64 numberOfBinnedPoints; //!< number of points inside the extent
+    qint64 numberOfRejectedPoints; //!< number of points outside the extent
+
+public:
+    PointBinner();
+
+    bool setup(Box3DT *extent, RasterSize3DT *size, int statistics);
+    void clear();
+    void destroy();
+
+    qint64 getNumberOfCells();
+    qint64 getCellIndex(double x, double y, double z, double t);
+
+    bool add(Point3DT *points, qint64 nPoints, const double *values = nullptr);
+    bool add(const double *x, const double *y, const double *z, const double *t, const double *values, qint64 nPoints);
+
+    bool getStatistic(Statistic stat, double *raster, double noData);
+    bool getStatistic(Statistic stat, RasterView *view, double noData);
+
+private:
+    double sx, sy, sz, st;
+
+    qint64 getBytesPerCell();
+    template <class Source> bool addPoints(Source &source, qint64 nPoints);
+    template <class Source> void addSequential(Source &source, qint64 iPoint0, qint64 iPoint1);
+    template <class Source> bool addPrivateGrids(Source &source, qint64 nPoints, int nThreads);
+    template <class Source> bool addPartitioned(Source &source, qint64 nPoints, int nThreads);
+};
+
+#endif // POINTBINNER_H
@@ -0,0 +1,35 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file raster.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include "brickcache.h"
+#include "brickcodec.h"
+#include "brickprefetcher.h"
+#include "brickgrid.h"
+#include "brickstore.h"
+#include "envifile.h"
+#include "isosurface.h"
+#include "lasreader.h"
+#include "mapalgebra.h"
+#include "pointbinner.h"
+#include "rastercell.h"
+#include "rasterconvert.h"
+#include "rasterfile.h"
+#include "rasterstream.h"
+#include "rasterview.h"
+#include "tickstore.h"
+#include "voxelfilter.h"
+
+#endif // RASTER_H
@@ -0,0 +1,174 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file rastercell.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <float.h>
+#include <string.h>
+#include <QString>
+#include "rastercell.h"
+
+
+/*!
+ * \brief Returns the size of a cell type.
+ * \param type Cell type.
+ * \return Cell size in bytes, 0 for undefined types.
+ */
+qint64 RasterCell::getSize(Type type)
+{
+    switch (type)
+    {
+    case UInt8: case Int8: return 1;
+    case UInt16: case Int16: return 2;
+    case UInt32: case Int32: case Float32: return 4;
+    case Float64: return 8;
+    default: return 0;
+    }
+}
+
+
+/*!
+ * \param type Cell type.
+ * \return True, if cells of the type hold integers.
+ */
+bool RasterCell::isInteger(Type type)
+{
+    return (UInt8 <= type) && (type <= Int32);
+}
+
+
+/*!
+ * \param type Cell type.
+ * \return Smallest finite value representable by the cell type.
+ */
+double RasterCell::getMinimum(Type type)
+{
+    switch (type)
+    {
+    case UInt8: case UInt16: case UInt32: return 0.0;
+    case Int8: return -128.0;
+    case Int16: return -32768.0;
+    case Int32: return -2147483648.0;
+    case Float32: return -double(FLT_MAX);
+    default: return -DBL_MAX;
+    }
+}
+
+
+/*!
+ * \param type Cell type.
+ * \return Largest finite value representable by the cell type.
+ */
+double RasterCell::getMaximum(Type type)
+{
+    switch (type)
+    {
+    case UInt8: return 255.0;
+    case Int8: return 127.0;
+    case UInt16: return 65535.0;
+    case Int16: return 32767.0;
+    case UInt32: return 4294967295.0;
+    case Int32: return 2147483647.0;
+    case Float32: return double(FLT_MAX);
+    default: return DBL_MAX;
+    }
+}
+
+
+/*!
+ * \brief Converts a cell type to its name.
+ * \param type Cell type.
+ * \return Cell type name.
+ */
+QString RasterCell::toString(Type type)
+{
+    switch (type)
+    {
+    case UInt8: return "UInt8";
+    case Int8: return "Int8";
+    case UInt16: return "UInt16";
+    case Int16: return "Int16";
+    case UInt32: return "UInt32";
+    case Int32: return "Int32";
+    case Float32: return "Float32";
+    case Float64: return "Float64";
+    default: return "Undefined";
+    }
+}
+
+
+/*!
+ * \brief Converts a cell type name to the cell type.
+ * \param name Cell type name.
+ * \return Cell type, Undefined for unknown names.
+ */
+RasterCell::Type RasterCell::fromString(QString name)
+{
+    for (int type = UInt8; type <= Float64; type++)
+        if (toString(Type(type)) == name) return Type(type);
+    return Undefined;
+}
+
+
+/*!
+ * \brief Reads a cell of a given type as double.
+ * \param type Cell type.
+ * \param cell Pointer to the cell.
+ * \return Cell value.
+ */
+double RasterCell::toDouble(Type type, const void *cell)
+{
+    switch (type)
+    {
+    case UInt8: return double(*static_cast<const quint8 *>(cell));
+    case Int8: return double(*static_cast<const qint8 *>(cell));
+    case UInt16: { quint16 v; memcpy(&v, cell, sizeof(v)); return double(v); }
+    case Int16: { qint16 v; memcpy(&v, cell, sizeof(v)); return double(v); }
+    case UInt32: { quint32 v; memcpy(&v, cell, sizeof(v)); return double(v); }
+    case Int32: { qint32 v; memcpy(&v, cell, sizeof(v)); return double(v); }
+    case Float32: { float v; memcpy(&v, cell, sizeof(v)); return double(v); }
+    case Float64: { double v; memcpy(&v, cell, sizeof(v)); return v; }
+    default: return 0.0;
+    }
+}
+
+
+/*!
+ * \brief Writes a double value to a cell of a given type.
+ *        Integer cells receive the value truncated toward zero and saturated to the range of the type; NaN is written as 0.
+ *        Float32 cells receive finite values outside the float range saturated to the largest finite float;
+ *        infinities and NaN are kept.
+ * \param type Cell type.
+ * \param value Written value.
+ * \param cell Pointer to the cell.
+ */
+void RasterCell::fromDouble(Type type, double value, void *cell)
+{
+    if (isInteger(type))
+    {
+        if (value != value) value = 0.0;
+        value = qBound(getMinimum(type), value, getMaximum(type));
+    }
+    else if ((type == Float32) && qIsFinite(value)) value = qBound(-double(FLT_MAX), value, double(FLT_MAX));
+
+    switch (type)
+    {
+    case UInt8: *static_cast<quint8 *>(cell) = quint8(value); break;
+    case Int8: *static_cast<qint8 *>(cell) = qint8(value); break;
+    case UInt16: { quint16 v = quint16(value); memcpy(cell, &v, sizeof(v)); break; }
+    case Int16: { qint16 v = qint16(value); memcpy(cell, &v, sizeof(v)); break; }
+    case UInt32: { quint32 v = quint32(value); memcpy(cell, &v, sizeof(v)); break; }
+    case Int32: { qint32 v = qint32(value); memcpy(cell, &v, sizeof(v)); break; }
+    case Float32: { float v = float(value); memcpy(cell, &v, sizeof(v)); break; }
+    case Float64: memcpy(cell, &value, sizeof(value)); break;
+    default: break;
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef RASTERCELL_H
+#define RASTERCELL_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file rastercell.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include "g3dtcore_global.h"
+
+
+/*!
+ * \brief The RasterCell defines raster cell types and scalar access to cells of any type.
+ */
+class G3DTCORE_EXPORT RasterCell
+{
+public:
+    enum Type
+    {
+        Undefined = 0,
+        UInt8 = 1,
+        Int8 = 2,
+        UInt16 = 3,
+        Int16 = 4,
+        UInt32 = 5,
+        Int32 = 6,
+        Float32 = 7,
+        Float64 = 8
+    };
+
+public:
+    static qint64 getSize(Type type);
+    static bool isInteger(Type type);
+    static double getMinimum(Type type);
+    static double getMaximum(Type type);
+    static QString toString(Type type);
+    static Type fromString(QString name);
+    static double toDouble(Type type, const void *cell);
+    static void fromDouble(Type type, double value, void *cell);
+};
+
+#endif // RASTERCELL_H
@@ -0,0 +1,492 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file rasterconvert.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <math.h>
+#include <string.h>
+#include "rasterconvert.h"
+#include "g3dtparallel.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define RASTERCONVERT_X86
+#include <immintrin.h>
+#endif
+
+
+/*!
+ * \brief Number of cells converted together through a double buffer.
+ */
+static const qint64 rasterConvertLanes = 1024;
+
+
+/*!
+ * \brief Conversion parameters resolved for a pair of cell types.
+ */
+struct RasterConvertParameters
+{
+    double scale, offset;
+    double sourceNoData;
+    double fill; //!< value written for NoData cells and NaN results
+    double lo, hi; //!< clamping range
+    bool keepInfinity; //!< floating-point target, infinities are not clamped
+    bool useNoData;
+    bool round;
+    bool wrap; //!< integer target without saturation
+};
+
+
+typedef void (*RasterConvertKernel)(const void *source, void *target, qint64 n, const RasterConvertParameters *p);
+
+
+/*!
+ * \brief Widens source cells to doubles.
+ */
+template <typename S>
+static Q_ALWAYS_INLINE void rasterConvertLoad(const S *source, double *buffer, qint64 n)
+{
+    for (qint64 i = 0; i < n; i++) buffer[i] = double(source[i]);
+}
+
+
+/*!
+ * \brief Narrows transformed doubles to target cells. Values are already inside the target range.
+ */
+template <typename D>
+static Q_ALWAYS_INLINE void rasterConvertStore(const double *buffer, D *target, qint64 n, bool wrap)
+{
+    if (wrap)
+    {
+        for (qint64 i = 0; i < n; i++) target[i] = D(qint64(buffer[i]));
+    }
+    else
+    {
+        for (qint64 i = 0; i < n; i++) target[i] = D(buffer[i]);
+    }
+}
+
+
+/*!
+ * \brief Applies scale, offset, rounding, NoData translation and clamping to a buffer.
+ *        Infinities are kept for floating-point targets, only finite values are saturated.
+ */
+static void rasterConvertTransformScalar(double *buffer, qint64 n, const RasterConvertParameters *p)
+{
+    for (qint64 i = 0; i < n; i++)
+    {
+        double v = buffer[i];
+        bool nd = p->useNoData && (v == p->sourceNoData);
+        v = v * p->scale + p->offset;
+        if (p->round) v = rint(v);
+        if (nd || (v != v)) v = p->fill;
+        if (p->keepInfinity && qIsInf(v))
+        {
+            buffer[i] = v;
+            continue;
+        }
+        v = (p->lo > v) ? p->lo : v;
+        v = (p->hi < v) ? p->hi : v;
+        buffer[i] = v;
+    }
+}
+
+
+/*!
+ * \brief Converts cells with the scalar transform.
+ */
+template <typename S, typename D>
+static void rasterConvertScalar(const void *source, void *target, qint64 n, const RasterConvertParameters *p)
+{
+    double buffer[rasterConvertLanes];
+    const S *s = static_cast<const S *>(source);
+    D *d = static_cast<D *>(target);
+
+    for (qint64 i0 = 0; i0 < n; i0 += rasterConvertLanes)
+    {
+        qint64 nb = qMin(rasterConvertLanes, n - i0);
+        rasterConvertLoad(s + i0, buffer, nb);
+        rasterConvertTransformScalar(buffer, nb, p);
+        rasterConvertStore(buffer, d + i0, nb, p->wrap);
+    }
+}
+
+
+#ifdef RASTERCONVERT_X86
+/*!
+ * \brief AVX2 version of rasterConvertTransformScalar(). Whole vectors are
+ *        transformed by AVX2, the remaining cells by the scalar transform.
+ */
+__attribute__((target("avx2")))
+static void rasterConvertTransformAvx2(double *buffer, qint64 n, const RasterConvertParameters *p)
+{
+    __m256d scale = _mm256_set1_pd(p->scale), offset = _mm256_set1_pd(p->offset);
+    __m256d noData = _mm256_set1_pd(p->sourceNoData), fill = _mm256_set1_pd(p->fill);
+    __m256d lo = _mm256_set1_pd(p->lo), hi = _mm256_set1_pd(p->hi);
+    __m256d sign = _mm256_set1_pd(-0.0), infinity = _mm256_set1_pd(double(INFINITY));
+    qint64 i;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        __m256d v = _mm256_loadu_pd(buffer + i);
+        __m256d nd = p->useNoData ? _mm256_cmp_pd(v, noData, _CMP_EQ_OQ) : _mm256_setzero_pd();
+        v = _mm256_add_pd(_mm256_mul_pd(v, scale), offset);
+        if (p->round) v = _mm256_round_pd(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        nd = _mm256_or_pd(nd, _mm256_cmp_pd(v, v, _CMP_UNORD_Q));
+        v = _mm256_blendv_pd(v, fill, nd);
+        __m256d c = _mm256_min_pd(hi, _mm256_max_pd(lo, v));
+        if (p->keepInfinity) c = _mm256_blendv_pd(c, v, _mm256_cmp_pd(_mm256_andnot_pd(sign, v), infinity, _CMP_EQ_OQ));
+        _mm256_storeu_pd(buffer + i, c);
+    }
+    rasterConvertTransformScalar(buffer + i, n - i, p);
+}
+
+
+/*!
+ * \brief Converts cells with the AVX2 transform; loads and stores are compiled for AVX2.
+ */
+template <typename S, typename D>
+__attribute__((target("avx2")))
+static void rasterConvertAvx2(const void *source, void *target, qint64 n, const RasterConvertParameters *p)
+{
+    double buffer[rasterConvertLanes];
+    const S *s = static_cast<const S *>(source);
+    D *d = static_cast<D *>(target);
+
+    for (qint64 i0 = 0; i0 < n; i0 += rasterConvertLanes)
+    {
+        qint64 nb = qMin(rasterConvertLanes, n - i0);
+        if (nb == rasterConvertLanes)
+        {
+            rasterConvertLoad(s + i0, buffer, rasterConvertLanes);
+            rasterConvertTransformAvx2(buffer, rasterConvertLanes, p);
+            rasterConvertStore(buffer, d + i0, rasterConvertLanes, p->wrap);
+        }
+        else
+        {
+            rasterConvertLoad(s + i0, buffer, nb);
+            rasterConvertTransformAvx2(buffer, nb, p);
+            rasterConvertStore(buffer, d + i0, nb, p->wrap);
+        }
+    }
+}
+
+
+/*!
+ * \brief AVX-512 version of rasterConvertTransformScalar(). Whole vectors are
+ *        transformed by AVX-512, the remaining cells by the scalar transform.
+ */
+__attribute__((target("avx512f")))
+static void rasterConvertTransformAvx512(double *buffer, qint64 n, const RasterConvertParameters *p)
+{
+    __m512d scale = _mm512_set1_pd(p->scale), offset = _mm512_set1_pd(p->offset);
+    __m512d noData = _mm512_set1_pd(p->sourceNoData), fill = _mm512_set1_pd(p->fill);
+    __m512d lo = _mm512_set1_pd(p->lo), hi = _mm512_set1_pd(p->hi);
+    __m512d infinity = _mm512_set1_pd(double(INFINITY));
+    qint64 i;
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        __m512d v = _mm512_loadu_pd(buffer + i);
+        __mmask8 nd = p->useNoData ? _mm512_cmp_pd_mask(v, noData, _CMP_EQ_OQ) : __mmask8(0);
+        // explicit rounding keeps the compiler from contracting to FMA, so results match other kernels
+        v = _mm512_add_round_pd(_mm512_mul_round_pd(v, scale, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC), offset,
+                                _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        if (p->round) v = _mm512_roundscale_pd(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        nd = nd | _mm512_cmp_pd_mask(v, v, _CMP_UNORD_Q);
+        v = _mm512_mask_blend_pd(nd, v, fill);
+        __m512d c = _mm512_min_pd(hi, _mm512_max_pd(lo, v));
+        if (p->keepInfinity) c = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(_mm512_abs_pd(v), infinity, _CMP_EQ_OQ), c, v);
+        _mm512_storeu_pd(buffer + i, c);
+    }
+    rasterConvertTransformScalar(buffer + i, n - i, p);
+}
+
+
+/*!
+ * \brief Converts cells with the AVX-512 transform; loads and stores are compiled for AVX-512.
+ */
+template <typename S, typename D>
+__attribute__((target("avx512f,avx512bw,avx512vl,avx512dq")))
+static void rasterConvertAvx512(const void *source, void *target, qint64 n, const RasterConvertParameters *p)
+{
+    double buffer[rasterConvertLanes];
+    const S *s = static_cast<const S *>(source);
+    D *d = static_cast<D *>(target);
+
+    for (qint64 i0 = 0; i0 < n; i0 += rasterConvertLanes)
+    {
+        qint64 nb = qMin(rasterConvertLanes, n - i0);
+        if (nb == rasterConvertLanes)
+        {
+            rasterConvertLoad(s + i0, buffer, rasterConvertLanes);
+            rasterConvertTransformAvx512(buffer, rasterConvertLanes, p);
+            rasterConvertStore(buffer, d + i0, rasterConvertLanes, p->wrap);
+        }
+        else
+        {
+            rasterConvertLoad(s + i0, buffer, nb);
+            rasterConvertTransformAvx512(buffer, nb, p);
+            rasterConvertStore(buffer, d + i0, nb, p->wrap);
+        }
+    }
+}
+#endif
+
+
+/*!
+ * \brief Selects the kernel for a pair of cell types and an instruction set.
+ */
+template <typename S, typename D>
+static RasterConvertKernel rasterConvertSelect(RasterConvert::InstructionSet instructionSet)
+{
+#ifdef RASTERCONVERT_X86
+    if (instructionSet == RasterConvert::AVX512) return &rasterConvertAvx512<S, D>;
+    if (instructionSet == RasterConvert::AVX2) return &rasterConvertAvx2<S, D>;
+#else
+    Q_UNUSED(instructionSet);
+#endif
+    return &rasterConvertScalar<S, D>;
+}
+
+
+template <typename S>
+static RasterConvertKernel rasterConvertSelect(RasterCell::Type targetType, RasterConvert::InstructionSet instructionSet)
+{
+    switch (targetType)
+    {
+    case RasterCell::UInt8: return rasterConvertSelect<S, quint8>(instructionSet);
+    case RasterCell::Int8: return rasterConvertSelect<S, qint8>(instructionSet);
+    case RasterCell::UInt16: return rasterConvertSelect<S, quint16>(instructionSet);
+    case RasterCell::Int16: return rasterConvertSelect<S, qint16>(instructionSet);
+    case RasterCell::UInt32: return rasterConvertSelect<S, quint32>(instructionSet);
+    case RasterCell::Int32: return rasterConvertSelect<S, qint32>(instructionSet);
+    case RasterCell::Float32: return rasterConvertSelect<S, float>(instructionSet);
+    case RasterCell::Float64: return rasterConvertSelect<S, double>(instructionSet);
+    default: return nullptr;
+    }
+}
+
+
+static RasterConvertKernel rasterConvertSelect(RasterCell::Type sourceType, RasterCell::Type targetType, RasterConvert::InstructionSet instructionSet)
+{
+    switch (sourceType)
+    {
+    case RasterCell::UInt8: return rasterConvertSelect<quint8>(targetType, instructionSet);
+    case RasterCell::Int8: return rasterConvertSelect<qint8>(targetType, instructionSet);
+    case RasterCell::UInt16: return rasterConvertSelect<quint16>(targetType, instructionSet);
+    case RasterCell::Int16: return rasterConvertSelect<qint16>(targetType, instructionSet);
+    case RasterCell::UInt32: return rasterConvertSelect<quint32>(targetType, instructionSet);
+    case RasterCell::Int32: return rasterConvertSelect<qint32>(targetType, instructionSet);
+    case RasterCell::Float32: return rasterConvertSelect<float>(targetType, instructionSet);
+    case RasterCell::Float64: return rasterConvertSelect<double>(targetType, instructionSet);
+    default: return nullptr;
+    }
+}
+
+
+/*!
+ * \brief Resolves conversion parameters for a target type.
+ */
+static void rasterConvertSetup(RasterConvert *convert, RasterCell::Type targetType, RasterConvertParameters *p)
+{
+    bool isInteger = RasterCell::isInteger(targetType);
+
+    p->scale = convert->scale;
+    p->offset = convert->offset;
+    p->sourceNoData = convert->sourceNoData;
+    p->useNoData = convert->useNoData;
+    p->round = isInteger && (convert->rounding == RasterConvert::Nearest);
+    p->wrap = isInteger && !convert->saturate;
+    p->keepInfinity = !isInteger;
+
+    if (isInteger)
+        p->fill = (convert->useNoData && !qIsNaN(convert->targetNoData)) ? convert->targetNoData : 0.0;
+    else
+        p->fill = convert->useNoData ? convert->targetNoData : double(NAN);
+
+    if (convert->saturate)
+    {
+        p->lo = RasterCell::getMinimum(targetType);
+        p->hi = RasterCell::getMaximum(targetType);
+    }
+    else if (isInteger)
+    {
+        // largest doubles inside the qint64 range; integers wrap around through qint64
+        p->lo = -9223372036854775808.0;
+        p->hi = 9223372036854774784.0;
+    }
+    else
+    {
+        p->lo = -double(INFINITY);
+        p->hi = double(INFINITY);
+    }
+}
+
+
+/*!
+ * \brief Default constructor. Values are copied unchanged, saturated and truncated; NoData is not translated.
+ */
+RasterConvert::RasterConvert()
+{
+    scale = 1.0;
+    offset = 0.0;
+    useNoData = false;
+    sourceNoData = -9999.0;
+    targetNoData = -9999.0;
+    saturate = true;
+    rounding = Truncate;
+    instructionSet = getSupportedInstructionSet();
+    nThreads = 0;
+    blockSize = 256 * 1024;
+}
+
+
+/*!
+ * \brief Detects the widest instruction set supported by the CPU and compiled into the library.
+ * \return Instruction set.
+ */
+RasterConvert::InstructionSet RasterConvert::getSupportedInstructionSet()
+{
+#ifdef RASTERCONVERT_X86
+    static const InstructionSet supported = []() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+            __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512dq")) return AVX512;
+        if (__builtin_cpu_supports("avx2")) return AVX2;
+        return Scalar;
+    }();
+    return supported;
+#else
+    return Scalar;
+#endif
+}
+
+
+/*!
+ * \param instructionSet Instruction set.
+ * \return Name of the instruction set.
+ */
+QString RasterConvert::toString(InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+    case AVX2: return "AVX2";
+    case AVX512: return "AVX-512";
+    default: return "Scalar";
+    }
+}
+
+
+/*!
+ * \brief Converts a raster between cell types.
+ * \param source Source cells.
+ * \param sourceType Source cell type.
+ * \param target Target cells; the buffer must not overlap the source unless both types have the same size.
+ * \param targetType Target cell type.
+ * \param size Pointer to the raster size.
+ * \return True, if the raster was converted.
+ */
+bool RasterConvert::convert(const void *source, RasterCell::Type sourceType, void *target, RasterCell::Type targetType, RasterSize3DT *size)
+{
+    return convert(source, sourceType, target, targetType, size->getNumberOfCells());
+}
+
+
+/*!
+ * \brief Converts an array of cells between cell types in parallel over blocks.
+ * \param source Source cells.
+ * \param sourceType Source cell type.
+ * \param target Target cells; the buffer must not overlap the source unless both types have the same size.
+ * \param targetType Target cell type.
+ * \param nCells Number of cells.
+ * \return True, if cells were converted; false also if the current G3DTCancelToken stopped the conversion.
+ */
+bool RasterConvert::convert(const void *source, RasterCell::Type sourceType, void *target, RasterCell::Type targetType, qint64 nCells)
+{
+    RasterConvertParameters p;
+    RasterConvertKernel kernel;
+    qint64 sourceSize = RasterCell::getSize(sourceType);
+    qint64 targetSize = RasterCell::getSize(targetType);
+
+    if (instructionSet > getSupportedInstructionSet()) instructionSet = getSupportedInstructionSet();
+    kernel = rasterConvertSelect(sourceType, targetType, instructionSet);
+    if (!kernel || (nCells < 0)) return false;
+    rasterConvertSetup(this, targetType, &p);
+
+    if (blockSize < rasterConvertLanes) blockSize = rasterConvertLanes;
+    return G3DTParallel::forEach((nCells + blockSize - 1) / blockSize, [&](qint64 iBlock) {
+        qint64 i0 = iBlock * blockSize;
+        qint64 n = qMin(blockSize, nCells - i0);
+        kernel(static_cast<const uchar *>(source) + i0 * sourceSize, static_cast<uchar *>(target) + i0 * targetSize, n, &p);
+    }, nThreads);
+}
+
+
+/*!
+ * \brief Converts cells of a view to a target view with the same extents.
+ *        Contiguous views are converted as arrays; other views are converted by lines,
+ *        strided lines are gathered to and scattered from small buffers.
+ * \param source Pointer to the source view.
+ * \param target Pointer to the target view.
+ * \return True, if cells were converted; false also if the current G3DTCancelToken stopped the conversion.
+ */
+bool RasterConvert::convert(RasterView *source, RasterView *target)
+{
+    RasterConvertParameters p;
+    RasterConvertKernel kernel;
+    RasterSize3DT *size = &source->size;
+    qint64 sourceSize = source->getCellSize();
+    qint64 targetSize = target->getCellSize();
+    qint64 nLines;
+
+    if (!source->isValid() || !target->isValid()) return false;
+    if ((size->nCols != target->size.nCols) || (size->nRows != target->size.nRows) || (size->nLays != target->size.nLays) ||
+        (size->nBands != target->size.nBands) || (size->nTicks != target->size.nTicks)) return false;
+
+    if (source->isContiguous() && target->isContiguous())
+        return convert(source->data, source->cellType, target->data, target->cellType, size->getNumberOfCells());
+
+    if (instructionSet > getSupportedInstructionSet()) instructionSet = getSupportedInstructionSet();
+    kernel = rasterConvertSelect(source->cellType, target->cellType, instructionSet);
+    if (!kernel) return false;
+    rasterConvertSetup(this, target->cellType, &p);
+
+    nLines = size->nRows * size->nLays * size->nBands * size->nTicks;
+    return G3DTParallel::forEach(nLines, [&](qint64 iLine) {
+        qint64 row = iLine % size->nRows;
+        qint64 lay = (iLine / size->nRows) % size->nLays;
+        qint64 band = (iLine / (size->nRows * size->nLays)) % size->nBands;
+        qint64 tick = iLine / (size->nRows * size->nLays * size->nBands);
+        const uchar *s = source->getCell(0, row, lay, band, tick);
+        uchar *d = target->getCell(0, row, lay, band, tick);
+        qint64 sourceStride = source->strides[RasterView::AxisCol];
+        qint64 targetStride = target->strides[RasterView::AxisCol];
+
+        if ((sourceStride == sourceSize) && (targetStride == targetSize))
+        {
+            kernel(s, d, size->nCols, &p);
+            return;
+        }
+
+        double sourceBuffer[rasterConvertLanes], targetBuffer[rasterConvertLanes];
+        uchar *sb = reinterpret_cast<uchar *>(sourceBuffer);
+        uchar *tb = reinterpret_cast<uchar *>(targetBuffer);
+        for (qint64 col0 = 0; col0 < size->nCols; col0 += rasterConvertLanes)
+        {
+            qint64 n = qMin(rasterConvertLanes, size->nCols - col0);
+            for (qint64 i = 0; i < n; i++)
+                memcpy(sb + i * sourceSize, s + (col0 + i) * sourceStride, size_t(sourceSize));
+            kernel(sb, tb, n, &p);
+            for (qint64 i = 0; i < n; i++)
+                memcpy(d + (col0 + i) * targetStride, tb + i * targetSize, size_t(targetSize));
+        }
+    }, nThreads);
+}
@@ -0,0 +1,70 @@
+#ifndef RASTERCONVERT_H
+#define RASTERCONVERT_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file rasterconvert.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <QString>
+#include "g3dtcore_global.h"
+#include "Geometry/rastersize3dt.h"
+#include "rastercell.h"
+#include "rasterview.h"
+
+
+/*!
+ * \brief The RasterConvert converts rasters between cell types.
+ *        Every cell is mapped to value * scale + offset, optionally rounded and saturated to the target range
+ *        (infinities are kept for floating-point targets);
+ *        source NoData cells and NaN results are written as target NoData.
+ *        Cells are converted in parallel over blocks. Each block is processed by an AVX-512, AVX2 or scalar
+ *        kernel selected at run time from the capabilities of the CPU; all kernels give identical results.
+ */
+class G3DTCORE_EXPORT RasterConvert
+{
+public:
+    enum Rounding
+    {
+        Truncate = 0, //!< integer targets receive values rounded towards zero
+        Nearest = 1 //!< values are rounded to the nearest integer, halves to even
+    };
+
+    enum InstructionSet
+    {
+        Scalar = 0,
+        AVX2 = 1,
+        AVX512 = 2
+    };
+
+    double scale; //!< scale applied to source values
+    double offset; //!< offset added to scaled values
+    bool useNoData; //!< translate sourceNoData to targetNoData
+    double sourceNoData; //!< NoData value of the source raster
+    double targetNoData; //!< NoData value of the target raster, also written for NaN results
+    bool saturate; //!< clamp values to the range of the target type; otherwise integers wrap around
+    Rounding rounding; //!< rounding of values written to integer targets
+    InstructionSet instructionSet; //!< kernel used for conversion, the best supported one by default
+    int nThreads; //!< number of threads, 0 for default
+    qint64 blockSize; //!< number of cells converted by one task
+
+public:
+    RasterConvert();
+
+    bool convert(const void *source, RasterCell::Type sourceType, void *target, RasterCell::Type targetType, RasterSize3DT *size);
+    bool convert(const void *source, RasterCell::Type sourceType, void *target, RasterCell::Type targetType, qint64 nCells);
+    bool convert(RasterView *source, RasterView *target);
+
+    static InstructionSet getSupportedInstructionSet();
+    static QString toString(InstructionSet instructionSet);
+};
+
+#endif // RASTERCONVERT_H
@@ -0,0 +1,454 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file rasterfile.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <atomic>
+#include <limits>
+#include <string.h>
+#include <QtEndian>
+#include "rasterfile.h"
+
+
+/*!
+ * \brief File signature and format version.
+ */
+static const char rasterFileMagic[8] = {'G', '3', 'D', 'T', 'R', 'A', 'S', 'T'};
+static const quint32 rasterFileVersion = 1;
+
+
+/*!
+ * \brief Byte offsets of header fields.
+ */
+enum RasterFileHeaderField
+{
+    RasterFileMagic = 0, //!< char[8]
+    RasterFileVersion = 8, //!< quint32
+    RasterFileHeaderSize = 12, //!< quint32
+    RasterFileCellType = 16, //!< quint32
+    RasterFileInterleave = 20, //!< quint32
+    RasterFileSize = 24, //!< qint64[5]: columns, rows, layers, bands, ticks
+    RasterFileBrickSize = 64, //!< qint64[5]
+    RasterFileExtent = 104, //!< double[8]: x0, y0, z0, t0, x1, y1, z1, t1
+    RasterFileNoData = 168, //!< double
+    RasterFileUseNoData = 176, //!< quint32
+    RasterFileBrickBytes = 184, //!< qint64
+    RasterFileDataOffset = 192 //!< qint64
+};
+
+
+template <typename T>
+static void rasterFilePut(uchar *header, int offset, T value)
+{
+    qToLittleEndian<T>(value, header + offset);
+}
+
+
+template <typename T>
+static T rasterFileGet(const uchar *header, int offset)
+{
+    return qFromLittleEndian<T>(header + offset);
+}
+
+
+static void rasterFilePutDouble(uchar *header, int offset, double value)
+{
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    rasterFilePut<quint64>(header, offset, bits);
+}
+
+
+static double rasterFileGetDouble(const uchar *header, int offset)
+{
+    quint64 bits = rasterFileGet<quint64>(header, offset);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+
+/*!
+ * \brief Multiplies non-negative numbers.
+ * \return False, if the product overflows qint64.
+ */
+static bool rasterFileMultiply(qint64 a, qint64 b, qint64 *product)
+{
+    if ((0 < a) && (std::numeric_limits<qint64>::max() / a < b)) return false;
+    *product = a * b;
+    return true;
+}
+
+
+/*!
+ * \brief Computes the number of bytes of all cells of a size.
+ * \return False, if the number overflows qint64.
+ */
+static bool rasterFileGetBytes(RasterSize3DT *size, qint64 cellSize, qint64 *nBytes)
+{
+    return rasterFileMultiply(size->nCols, size->nRows, nBytes) && rasterFileMultiply(*nBytes, size->nLays, nBytes) &&
+           rasterFileMultiply(*nBytes, size->nBands, nBytes) && rasterFileMultiply(*nBytes, size->nTicks, nBytes) &&
+           rasterFileMultiply(*nBytes, cellSize, nBytes);
+}
+
+
+/*!
+ * \brief Default constructor.
+ */
+RasterFile::RasterFile()
+{
+    brickSize.set(64, 64, 64, 1, 1);
+    cellType = RasterCell::Float64;
+    interleave = RasterView::BSQ;
+    useNoData = false;
+    noData = -9999.0;
+    alignment = 4096;
+    metrics = nullptr;
+    map = nullptr;
+    writable = false;
+    brickBytes = 0;
+    dataOffset = 0;
+}
+
+
+/*!
+ * \brief Destructor. Closes the file.
+ */
+RasterFile::~RasterFile()
+{
+    close();
+}
+
+
+/*!
+ * \brief Stores an error description.
+ * \return Always false.
+ */
+bool RasterFile::fail(QString message)
+{
+    errorString = message;
+    close();
+    return false;
+}
+
+
+/*!
+ * \brief Creates a raster file described by the public members and maps it for writing.
+ *        The file is sized but not filled, so unwritten bricks stay sparse on most file systems.
+ * \param fileName File name.
+ * \return True, if the file was created.
+ */
+bool RasterFile::create(QString fileName)
+{
+    uchar header[headerSize];
+    qint64 cellSize = RasterCell::getSize(cellType);
+    qint64 nBytes, fileSize;
+
+    close();
+    errorString.clear();
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    return fail("Raster files are not supported on big-endian hosts.");
+#endif
+    if (cellSize <= 0) return fail("Undefined cell type.");
+    if ((interleave < RasterView::BSQ) || (RasterView::BIP < interleave)) return fail("Unsupported interleave.");
+    if ((size.nCols < 1) || (size.nRows < 1) || (size.nLays < 1) || (size.nBands < 1) || (size.nTicks < 1)) return fail("Invalid raster size.");
+    if ((brickSize.nCols < 1) || (brickSize.nRows < 1) || (brickSize.nLays < 1) || (brickSize.nBands < 1) || (brickSize.nTicks < 1)) return fail("Invalid brick size.");
+    if ((alignment < 1) || (alignment & (alignment - 1))) return fail("Alignment must be a power of two.");
+    if (!rasterFileGetBytes(&size, cellSize, &nBytes)) return fail("The raster is too large.");
+
+    brickSize.set(qMin(brickSize.nCols, size.nCols), qMin(brickSize.nRows, size.nRows), qMin(brickSize.nLays, size.nLays),
+                  qMin(brickSize.nBands, size.nBands), qMin(brickSize.nTicks, size.nTicks));
+    grid.setup(&size, &brickSize);
+    // bricks are not larger than the raster, only alignment padding may overflow
+    if (std::numeric_limits<qint64>::max() - alignment < qMax(brickSize.getNumberOfCells() * cellSize, qint64(headerSize)))
+        return fail("Alignment is too large.");
+    brickBytes = (brickSize.getNumberOfCells() * cellSize + alignment - 1) & ~(alignment - 1);
+    dataOffset = (headerSize + alignment - 1) & ~(alignment - 1);
+    if (!rasterFileMultiply(getNumberOfBricks(), brickBytes, &fileSize) || (std::numeric_limits<qint64>::max() - dataOffset < fileSize))
+        return fail("The raster is too large.");
+    fileSize += dataOffset;
+
+    memset(header, 0, sizeof(header));
+    memcpy(header + RasterFileMagic, rasterFileMagic, sizeof(rasterFileMagic));
+    rasterFilePut<quint32>(header, RasterFileVersion, rasterFileVersion);
+    rasterFilePut<quint32>(header, RasterFileHeaderSize, quint32(headerSize));
+    rasterFilePut<quint32>(header, RasterFileCellType, quint32(cellType));
+    rasterFilePut<quint32>(header, RasterFileInterleave, quint32(interleave));
+    rasterFilePut<qint64>(header, RasterFileSize, size.nCols);
+    rasterFilePut<qint64>(header, RasterFileSize + 8, size.nRows);
+    rasterFilePut<qint64>(header, RasterFileSize + 16, size.nLays);
+    rasterFilePut<qint64>(header, RasterFileSize + 24, size.nBands);
+    rasterFilePut<qint64>(header, RasterFileSize + 32, size.nTicks);
+    rasterFilePut<qint64>(header, RasterFileBrickSize, brickSize.nCols);
+    rasterFilePut<qint64>(header, RasterFileBrickSize + 8, brickSize.nRows);
+    rasterFilePut<qint64>(header, RasterFileBrickSize + 16, brickSize.nLays);
+    rasterFilePut<qint64>(header, RasterFileBrickSize + 24, brickSize.nBands);
+    rasterFilePut<qint64>(header, RasterFileBrickSize + 32, brickSize.nTicks);
+    rasterFilePutDouble(header, RasterFileExtent, extent.p0.x);
+    rasterFilePutDouble(header, RasterFileExtent + 8, extent.p0.y);
+    rasterFilePutDouble(header, RasterFileExtent + 16, extent.p0.z);
+    rasterFilePutDouble(header, RasterFileExtent + 24, extent.p0.t);
+    rasterFilePutDouble(header, RasterFileExtent + 32, extent.p1.x);
+    rasterFilePutDouble(header, RasterFileExtent + 40, extent.p1.y);
+    rasterFilePutDouble(header, RasterFileExtent + 48, extent.p1.z);
+    rasterFilePutDouble(header, RasterFileExtent + 56, extent.p1.t);
+    rasterFilePutDouble(header, RasterFileNoData, noData);
+    rasterFilePut<quint32>(header, RasterFileUseNoData, useNoData ? 1 : 0);
+    rasterFilePut<qint64>(header, RasterFileBrickBytes, brickBytes);
+    rasterFilePut<qint64>(header, RasterFileDataOffset, dataOffset);
+
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate)) return fail("Cannot create " + fileName + ".");
+    if (file.write(reinterpret_cast<const char *>(header), headerSize) != headerSize) return fail("Cannot write the header of " + fileName + ".");
+    if (!file.resize(fileSize)) return fail("Cannot resize " + fileName + ".");
+    map = file.map(0, fileSize);
+    if (!map) return fail("Cannot map " + fileName + ".");
+    writable = true;
+    return true;
+}
+
+
+/*!
+ * \brief Opens a raster file and maps it. No cells are read.
+ * \param fileName File name.
+ * \param writable Map the file for writing.
+ * \return True, if the file was opened.
+ */
+bool RasterFile::open(QString fileName, bool writable)
+{
+    uchar header[headerSize];
+    quint32 version, type, mode;
+    qint64 nBytes, fileSize;
+
+    close();
+    errorString.clear();
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    return fail("Raster files are not supported on big-endian hosts.");
+#endif
+    file.setFileName(fileName);
+    if (!file.open(writable ? QIODevice::ReadWrite : QIODevice::ReadOnly)) return fail("Cannot open " + fileName + ".");
+    if (file.read(reinterpret_cast<char *>(header), headerSize) != headerSize) return fail("Cannot read the header of " + fileName + ".");
+    if (memcmp(header + RasterFileMagic, rasterFileMagic, sizeof(rasterFileMagic)) != 0) return fail(fileName + " is not a raster file.");
+
+    version = rasterFileGet<quint32>(header, RasterFileVersion);
+    if (version != rasterFileVersion) return fail("Unsupported raster file version.");
+    type = rasterFileGet<quint32>(header, RasterFileCellType);
+    mode = rasterFileGet<quint32>(header, RasterFileInterleave);
+    if ((type < RasterCell::UInt8) || (RasterCell::Float64 < type)) return fail("Unsupported cell type.");
+    if (RasterView::BIP < mode) return fail("Unsupported interleave.");
+    cellType = RasterCell::Type(type);
+    interleave = RasterView::Interleave(mode);
+
+    size.set(rasterFileGet<qint64>(header, RasterFileSize), rasterFileGet<qint64>(header, RasterFileSize + 8),
+             rasterFileGet<qint64>(header, RasterFileSize + 16), rasterFileGet<qint64>(header, RasterFileSize + 24),
+             rasterFileGet<qint64>(header, RasterFileSize + 32));
+    brickSize.set(rasterFileGet<qint64>(header, RasterFileBrickSize), rasterFileGet<qint64>(header, RasterFileBrickSize + 8),
+                  rasterFileGet<qint64>(header, RasterFileBrickSize + 16), rasterFileGet<qint64>(header, RasterFileBrickSize + 24),
+                  rasterFileGet<qint64>(header, RasterFileBrickSize + 32));
+    extent.set(rasterFileGetDouble(header, RasterFileExtent), rasterFileGetDouble(header, RasterFileExtent + 8),
+               rasterFileGetDouble(header, RasterFileExtent + 16), rasterFileGetDouble(header, RasterFileExtent + 24),
+               rasterFileGetDouble(header, RasterFileExtent + 32), rasterFileGetDouble(header, RasterFileExtent + 40),
+               rasterFileGetDouble(header, RasterFileExtent + 48), rasterFileGetDouble(header, RasterFileExtent + 56));
+    noData = rasterFileGetDouble(header, RasterFileNoData);
+    useNoData = rasterFileGet<quint32>(header, RasterFileUseNoData) != 0;
+    brickBytes = rasterFileGet<qint64>(header, RasterFileBrickBytes);
+    dataOffset = rasterFileGet<qint64>(header, RasterFileDataOffset);
+
+    if ((size.nCols < 1) || (size.nRows < 1) || (size.nLays < 1) || (size.nBands < 1) || (size.nTicks < 1)) return fail("Invalid raster size.");
+    if ((brickSize.nCols < 1) || (brickSize.nRows < 1) || (brickSize.nLays < 1) || (brickSize.nBands < 1) || (brickSize.nTicks < 1)) return fail("Invalid brick size.");
+    if ((size.nCols < brickSize.nCols) || (size.nRows < brickSize.nRows) || (size.nLays < brickSize.nLays) ||
+        (size.nBands < brickSize.nBands) || (size.nTicks < brickSize.nTicks)) return fail("Invalid brick size.");
+    // bricks are not larger than the raster and there are not more bricks than cells, so they cannot overflow
+    if (!rasterFileGetBytes(&size, RasterCell::getSize(cellType), &nBytes)) return fail("Invalid raster size.");
+    if ((brickBytes < brickSize.getNumberOfCells() * RasterCell::getSize(cellType)) || (dataOffset < headerSize)) return fail("Invalid brick layout.");
+
+    grid.setup(&size, &brickSize);
+    if (!rasterFileMultiply(getNumberOfBricks(), brickBytes, &fileSize) || (file.size() - fileSize < dataOffset))
+        return fail(fileName + " is truncated.");
+    fileSize += dataOffset;
+    map = file.map(0, fileSize);
+    if (!map) return fail("Cannot map " + fileName + ".");
+    this->writable = writable;
+    return true;
+}
+
+
+/*!
+ * \brief Unmaps and closes the file. Views returned by getBrick() become invalid.
+ */
+void RasterFile::close()
+{
+    if (map) file.unmap(map);
+    map = nullptr;
+    if (file.isOpen()) file.close();
+    writable = false;
+}
+
+
+/*!
+ * \return True, if the file is open and mapped.
+ */
+bool RasterFile::isOpen()
+{
+    return map != nullptr;
+}
+
+
+/*!
+ * \return True, if the file is mapped for writing.
+ */
+bool RasterFile::isWritable()
+{
+    return map && writable;
+}
+
+
+/*!
+ * \return Total number of bricks.
+ */
+qint64 RasterFile::getNumberOfBricks()
+{
+    return grid.getNumberOfBricks();
+}
+
+
+/*!
+ * \param axis Raster axis.
+ * \return Number of bricks along an axis.
+ */
+qint64 RasterFile::getNumberOfBricks(RasterView::Axis axis)
+{
+    return grid.nBricks[axis];
+}
+
+
+/*!
+ * \brief Returns the index of the brick containing a cell. Indexes are not checked.
+ * \return Brick index.
+ */
+qint64 RasterFile::getBrickIndex(qint64 col, qint64 row, qint64 lay, qint64 band, qint64 tick)
+{
+    return grid.getBrickIndex(col, row, lay, band, tick);
+}
+
+
+/*!
+ * \brief Returns cells covered by a brick, clipped to the raster.
+ * \param iBrick Brick index.
+ * \return Raster block of the brick.
+ */
+RasterBlock RasterFile::getBrickBlock(qint64 iBrick)
+{
+    return grid.getBrickBlock(iBrick);
+}
+
+
+/*!
+ * \return Distance between consecutive bricks in the file in bytes.
+ */
+qint64 RasterFile::getBrickBytes()
+{
+    return brickBytes;
+}
+
+
+/*!
+ * \param iBrick Brick index.
+ * \return File offset of a brick.
+ */
+qint64 RasterFile::getBrickOffset(qint64 iBrick)
+{
+    return dataOffset + iBrick * brickBytes;
+}
+
+
+/*!
+ * \param iBrick Brick index.
+ * \return Address of a brick in the memory map, nullptr if the file is not open.
+ */
+uchar *RasterFile::getBrickData(qint64 iBrick)
+{
+    if (!map || (iBrick < 0) || (getNumberOfBricks() <= iBrick)) return nullptr;
+    return map + getBrickOffset(iBrick);
+}
+
+
+/*!
+ * \brief Returns a zero-copy view of a brick clipped to the raster.
+ *        The view is valid until the file is closed; it must not be written unless the file is writable.
+ * \param iBrick Brick index.
+ * \return View of the brick, or an invalid view.
+ */
+RasterView RasterFile::getBrick(qint64 iBrick)
+{
+    RasterView view;
+    RasterBlock block;
+    uchar *data = getBrickData(iBrick);
+
+    if (!data) return view;
+    block = getBrickBlock(iBrick);
+    view.set(data, cellType, &brickSize, interleave);
+    view.size.set(block.getNumberOfColumns(), block.getNumberOfRows(), block.getNumberOfLayers(), block.getNumberOfBands(), block.getNumberOfTicks());
+    return view;
+}
+
+
+/*!
+ * \brief Copies cells between a raster block and a view, brick by brick in parallel
+ *        on the NUMA nodes holding the cells of the view.
+ * \return False, if the block or view do not match the file or the current G3DTCancelToken stopped copying.
+ */
+bool RasterFile::copyBlock(RasterBlock *block, RasterView *view, bool toFile, int nThreads)
+{
+    std::atomic<bool> ok(true);
+
+    if (!map || !view->isValid() || (view->cellType != cellType)) return false;
+    if (toFile && !writable) return false;
+    if ((view->size.nCols != block->getNumberOfColumns()) || (view->size.nRows != block->getNumberOfRows()) ||
+        (view->size.nLays != block->getNumberOfLayers()) || (view->size.nBands != block->getNumberOfBands()) ||
+        (view->size.nTicks != block->getNumberOfTicks())) return false;
+
+    if (!grid.forEachBrick(block, [&](qint64 iBrick, RasterBlock *inBrick, RasterBlock *inBlock) {
+        RasterView brickView = getBrick(iBrick).crop(inBrick);
+        RasterView part = view->crop(inBlock);
+        if (!(toFile ? part.copyTo(&brickView, 1) : brickView.copyTo(&part, 1))) ok = false;
+    }, nThreads, view)) return false;
+
+    if (ok && metrics)
+        metrics->getCounter(toFile ? "rasterFile.bytesWritten" : "rasterFile.bytesRead")->add(block->getNumberOfCells() * RasterCell::getSize(cellType));
+    return ok;
+}
+
+
+/*!
+ * \brief Reads a raster block into a view.
+ * \param block Pointer to a raster block.
+ * \param target Pointer to a view with the extents of the block and the cell type of the file.
+ * \param nThreads Number of threads, 0 for default.
+ * \return True, if cells were read.
+ */
+bool RasterFile::read(RasterBlock *block, RasterView *target, int nThreads)
+{
+    return copyBlock(block, target, false, nThreads);
+}
+
+
+/*!
+ * \brief Writes a view to a raster block of a writable file.
+ * \param block Pointer to a raster block.
+ * \param source Pointer to a view with the extents of the block and the cell type of the file.
+ * \param nThreads Number of threads, 0 for default.
+ * \return True, if cells were written.
+ */
+bool RasterFile::write(RasterBlock *block, RasterView *source, int nThreads)
+{
+    return copyBlock(block, source, true, nThreads);
+}
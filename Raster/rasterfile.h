@@ -0,0 +1,91 @@
+#ifndef RASTERFILE_H
+#define RASTERFILE_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file rasterfile.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <QFile>
+#include <QString>
+#include "g3dtcore_global.h"
+#include "g3dtmetrics.h"
+#include "Geometry/box3dt.h"
+#include "Geometry/rasterblock.h"
+#include "Geometry/rastersize3dt.h"
+#include "brickgrid.h"
+#include "rastercell.h"
+#include "rasterview.h"
+
+
+/*!
+ * \brief The RasterFile is a self-describing binary raster file accessed through a memory map.
+ *
+ *        The file starts with a fixed little-endian header (raster size, extent, cell type, interleave,
+ *        NoData and brick shape) followed by bricks. The raster is split into bricks of brickSize cells;
+ *        bricks are ordered by column, row, layer, band and tick brick index (column fastest), every brick
+ *        is stored with full brickSize extents (edge bricks are padded) in the file interleave and starts
+ *        at an aligned offset. Cells are stored in little-endian byte order.
+ *
+ *        Opening maps the whole file without reading cells; getBrick() returns zero-copy views into the map,
+ *        so only touched pages are read from disk.
+ */
+class G3DTCORE_EXPORT RasterFile
+{
+public:
+    RasterSize3DT size; //!< raster size
+    RasterSize3DT brickSize; //!< brick shape; extents larger than the raster are reduced by create()
+    Box3DT extent; //!< raster extent
+    RasterCell::Type cellType; //!< cell type
+    RasterView::Interleave interleave; //!< band interleave inside bricks
+    bool useNoData; //!< noData is defined
+    double noData; //!< NoData value
+    qint64 alignment; //!< alignment of bricks in bytes used by create()
+    G3DTMetrics *metrics; //!< receives the counters "rasterFile.bytesRead" and "rasterFile.bytesWritten" of read() and write(), may be nullptr
+    QString errorString; //!< description of the last error
+
+public:
+    RasterFile();
+    ~RasterFile();
+
+    bool create(QString fileName);
+    bool open(QString fileName, bool writable = false);
+    void close();
+    bool isOpen();
+    bool isWritable();
+
+    qint64 getNumberOfBricks();
+    qint64 getNumberOfBricks(RasterView::Axis axis);
+    qint64 getBrickIndex(qint64 col, qint64 row, qint64 lay, qint64 band, qint64 tick);
+    RasterBlock getBrickBlock(qint64 iBrick);
+    qint64 getBrickBytes();
+    qint64 getBrickOffset(qint64 iBrick);
+    uchar *getBrickData(qint64 iBrick);
+    RasterView getBrick(qint64 iBrick);
+
+    bool read(RasterBlock *block, RasterView *target, int nThreads = 0);
+    bool write(RasterBlock *block, RasterView *source, int nThreads = 0);
+
+    static const qint64 headerSize = 256; //!< size of the file header in bytes
+
+private:
+    QFile file;
+    uchar *map;
+    bool writable;
+    qint64 brickBytes; //!< distance between bricks in bytes
+    qint64 dataOffset; //!< offset of the first brick
+    BrickGrid grid;
+
+    bool fail(QString message);
+    bool copyBlock(RasterBlock *block, RasterView *view, bool toFile, int nThreads);
+};
+
+#endif // RASTERFILE_H
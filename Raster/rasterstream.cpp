@@ -0,0 +1,300 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file rasterstream.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include "g3dtcanceltoken.h"
+#include "g3dtexecutor.h"
+#include "g3dtnuma.h"
+#include "rasterstream.h"
+
+
+/*!
+ * \brief Returns a BSQ view with the extents of a raster block over a slab buffer.
+ */
+static RasterView rasterStreamView(G3DTNumaBuffer &buffer, RasterCell::Type cellType, RasterBlock *block)
+{
+    RasterSize3DT extents(block->getNumberOfColumns(), block->getNumberOfRows(), block->getNumberOfLayers(),
+                          block->getNumberOfBands(), block->getNumberOfTicks());
+    return RasterView(buffer.getData(), cellType, &extents);
+}
+
+
+/*!
+ * \brief Default constructor. Slabs are single ticks of the raster.
+ */
+RasterStream::RasterStream()
+{
+    qint64 all = std::numeric_limits<qint64>::max();
+
+    slabSize.set(all, all, all, all, 1);
+    inputType = RasterCell::Undefined;
+    outputType = RasterCell::Undefined;
+    memoryLimit = 0;
+    nThreads = 0;
+    metrics = nullptr;
+}
+
+
+/*!
+ * \brief Stores an error description.
+ * \return Always false.
+ */
+bool RasterStream::fail(QString message)
+{
+    errorString = message;
+    return false;
+}
+
+
+/*!
+ * \brief Sets slabs to single ticks of the raster. The raster size must be set.
+ */
+void RasterStream::setTickSlabs()
+{
+    slabSize.set(size.nCols, size.nRows, size.nLays, size.nBands, 1);
+}
+
+
+/*!
+ * \brief Sets slabs to groups of layers of a single tick. The raster size must be set.
+ * \param nLayers Number of layers per slab.
+ */
+void RasterStream::setLayerSlabs(qint64 nLayers)
+{
+    slabSize.set(size.nCols, size.nRows, nLayers, size.nBands, 1);
+}
+
+
+/*!
+ * \brief Sets slabs to tiles of the given shape.
+ * \param tileSize Pointer to the tile shape.
+ */
+void RasterStream::setTiles(RasterSize3DT *tileSize)
+{
+    slabSize = *tileSize;
+}
+
+
+/*!
+ * \brief Reads slabs from a raster file. Sets the raster size and input cell type.
+ * \param file Pointer to an open raster file; it must stay open while the stream runs.
+ */
+void RasterStream::setSource(RasterFile *file)
+{
+    size = file->size;
+    inputType = file->cellType;
+    reader = [file, this](RasterBlock *block, RasterView *view) { return file->read(block, view, nThreads); };
+}
+
+
+/*!
+ * \brief Reads slabs from a brick store. Sets the raster size and input cell type.
+ * \param store Pointer to an open brick store; it must stay open while the stream runs.
+ */
+void RasterStream::setSource(BrickStore *store)
+{
+    size = store->size;
+    inputType = store->cellType;
+    reader = [store, this](RasterBlock *block, RasterView *view) { return store->read(block, view, nThreads); };
+}
+
+
+/*!
+ * \brief Writes slabs to a raster file. Sets the output cell type.
+ * \param file Pointer to a writable raster file with the stream raster size.
+ */
+void RasterStream::setTarget(RasterFile *file)
+{
+    outputType = file->cellType;
+    writer = [file, this](RasterBlock *block, RasterView *view) { return file->write(block, view, nThreads); };
+}
+
+
+/*!
+ * \return Number of slabs, 0 if the raster or slab size is not valid.
+ */
+qint64 RasterStream::getNumberOfSlabs()
+{
+    RasterSize3DT shape(qMin(slabSize.nCols, size.nCols), qMin(slabSize.nRows, size.nRows), qMin(slabSize.nLays, size.nLays),
+                        qMin(slabSize.nBands, size.nBands), qMin(slabSize.nTicks, size.nTicks));
+
+    if (!grid.setup(&size, &shape)) return 0;
+    return grid.getNumberOfBricks();
+}
+
+
+/*!
+ * \brief Returns cells covered by a slab, clipped to the raster.
+ * \param iSlab Slab index in [0, getNumberOfSlabs()).
+ * \return Raster block of the slab.
+ */
+RasterBlock RasterStream::getSlab(qint64 iSlab)
+{
+    getNumberOfSlabs();
+    return grid.getBrickBlock(iSlab);
+}
+
+
+/*!
+ * \return Size of one input and one output slab buffer in bytes.
+ */
+qint64 RasterStream::getSlabBytes()
+{
+    qint64 cellBytes = 0;
+    RasterSize3DT shape(qMin(slabSize.nCols, size.nCols), qMin(slabSize.nRows, size.nRows), qMin(slabSize.nLays, size.nLays),
+                        qMin(slabSize.nBands, size.nBands), qMin(slabSize.nTicks, size.nTicks));
+
+    if (reader) cellBytes += RasterCell::getSize(inputType);
+    if (writer) cellBytes += RasterCell::getSize(outputType);
+    return shape.getNumberOfCells() * cellBytes;
+}
+
+
+/*!
+ * \return Size of all buffers allocated by run() in bytes (two input and two output slabs).
+ */
+qint64 RasterStream::getBufferBytes()
+{
+    return 2 * getSlabBytes();
+}
+
+
+/*!
+ * \brief Reduces the slab shape to the raster size and halves it until the buffers fit into memoryLimit.
+ *        Ticks are split first, then layers, rows, bands and columns, so slabs stay as contiguous as possible.
+ * \return True, if the buffers fit.
+ */
+bool RasterStream::fitToMemory()
+{
+    slabSize.set(qMin(slabSize.nCols, size.nCols), qMin(slabSize.nRows, size.nRows), qMin(slabSize.nLays, size.nLays),
+                 qMin(slabSize.nBands, size.nBands), qMin(slabSize.nTicks, size.nTicks));
+    if (memoryLimit <= 0) return true;
+
+    while (memoryLimit < getBufferBytes())
+    {
+        if (1 < slabSize.nTicks) slabSize.nTicks = (slabSize.nTicks + 1) / 2;
+        else if (1 < slabSize.nLays) slabSize.nLays = (slabSize.nLays + 1) / 2;
+        else if (1 < slabSize.nRows) slabSize.nRows = (slabSize.nRows + 1) / 2;
+        else if (1 < slabSize.nBands) slabSize.nBands = (slabSize.nBands + 1) / 2;
+        else if (1 < slabSize.nCols) slabSize.nCols = (slabSize.nCols + 1) / 2;
+        else return fail("Slab buffers do not fit into the memory limit.");
+    }
+    return true;
+}
+
+
+/*!
+ * \brief Streams the raster through a processing function.
+ *        Slabs are processed in order on the calling thread; reading of the next slab and writing
+ *        of the previous slab run concurrently as G3DTExecutor tasks with the current G3DTCancelToken.
+ *        A calling executor thread runs pending tasks while waiting for them.
+ * \param process Function processing a slab.
+ * \return True, if all slabs were read, processed and written.
+ */
+bool RasterStream::run(ProcessFunction process)
+{
+    G3DTNumaBuffer input[2], output[2];
+    qint64 nSlabs;
+    RasterBlock block;
+    G3DTExecutor *executor = G3DTExecutor::getGlobal();
+    G3DTCancelToken *token = G3DTCancelToken::getCurrent();
+    bool helping = 0 <= G3DTExecutor::getCurrentThread();
+    std::mutex mutex;
+    std::condition_variable finished;
+    int nRunning = 0;
+
+    errorString.clear();
+    if (!reader && !writer) return fail("Neither a reader nor a writer is set.");
+    if (reader && (RasterCell::getSize(inputType) <= 0)) return fail("Undefined input cell type.");
+    if (writer && (RasterCell::getSize(outputType) <= 0)) return fail("Undefined output cell type.");
+    if (!fitToMemory()) return false;
+    nSlabs = getNumberOfSlabs();
+    if (nSlabs <= 0) return fail("Invalid raster or slab size.");
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (reader && !input[i].allocate(slabSize.getNumberOfCells() * RasterCell::getSize(inputType)))
+            return fail("Cannot allocate slab buffers.");
+        if (writer && !output[i].allocate(slabSize.getNumberOfCells() * RasterCell::getSize(outputType)))
+            return fail("Cannot allocate slab buffers.");
+    }
+
+    auto readSlab = [&](qint64 iSlab) {
+        RasterBlock slab = grid.getBrickBlock(iSlab);
+        RasterView view = rasterStreamView(input[iSlab % 2], inputType, &slab);
+        if (!reader(&slab, &view)) return false;
+        if (metrics) metrics->getCounter("rasterStream.bytesRead")->add(slab.getNumberOfCells() * RasterCell::getSize(inputType));
+        return true;
+    };
+    auto writeSlab = [&](qint64 iSlab) {
+        RasterBlock slab = grid.getBrickBlock(iSlab);
+        RasterView view = rasterStreamView(output[iSlab % 2], outputType, &slab);
+        if (!writer(&slab, &view)) return false;
+        if (metrics) metrics->getCounter("rasterStream.bytesWritten")->add(slab.getNumberOfCells() * RasterCell::getSize(outputType));
+        return true;
+    };
+
+    auto startTask = [&](std::function<bool()> step, bool *ok) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            nRunning++;
+        }
+        executor->submit([&, step, ok]() {
+            G3DTCancelToken *previous = G3DTCancelToken::setCurrent(token);
+            *ok = step();
+            G3DTCancelToken::setCurrent(previous);
+            std::lock_guard<std::mutex> lock(mutex);
+            nRunning--;
+            finished.notify_all();
+        });
+    };
+    auto waitForTasks = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (nRunning != 0)
+        {
+            if (helping)
+            {
+                lock.unlock();
+                bool ran = executor->runPending();
+                lock.lock();
+                if (ran) continue;
+            }
+            finished.wait_for(lock, std::chrono::milliseconds(1));
+        }
+    };
+
+    if (reader && !readSlab(0)) return fail("Cannot read slab 0.");
+    for (qint64 iSlab = 0; iSlab < nSlabs; iSlab++)
+    {
+        bool readOk = true, writeOk = true, processOk;
+
+        if (reader && (iSlab + 1 < nSlabs)) startTask([&readSlab, iSlab]() { return readSlab(iSlab + 1); }, &readOk);
+        if (writer && (0 < iSlab)) startTask([&writeSlab, iSlab]() { return writeSlab(iSlab - 1); }, &writeOk);
+
+        block = grid.getBrickBlock(iSlab);
+        RasterView inputView = reader ? rasterStreamView(input[iSlab % 2], inputType, &block) : RasterView();
+        RasterView outputView = writer ? rasterStreamView(output[iSlab % 2], outputType, &block) : RasterView();
+        processOk = process(&block, reader ? &inputView : nullptr, writer ? &outputView : nullptr);
+
+        waitForTasks();
+        if (!processOk) return fail(QString("Cannot process slab %1.").arg(iSlab));
+        if (!readOk) return fail(QString("Cannot read slab %1.").arg(iSlab + 1));
+        if (!writeOk) return fail(QString("Cannot write slab %1.").arg(iSlab - 1));
+    }
+    if (writer && !writeSlab(nSlabs - 1)) return fail(QString("Cannot write slab %1.").arg(nSlabs - 1));
+
+    return true;
+}
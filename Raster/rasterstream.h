@@ -0,0 +1,95 @@
+#ifndef RASTERSTREAM_H
+#define RASTERSTREAM_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file rasterstream.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <functional>
+#include <vector>
+#include <QString>
+#include "g3dtcore_global.h"
+#include "g3dtmetrics.h"
+#include "Geometry/rasterblock.h"
+#include "Geometry/rastersize3dt.h"
+#include "brickgrid.h"
+#include "brickstore.h"
+#include "rastercell.h"
+#include "rasterfile.h"
+#include "rasterview.h"
+
+
+/*!
+ * \brief The RasterStream processes a raster larger than memory slab by slab.
+ *
+ *        The raster is split into slabs of slabSize cells (one tick, a few layers or arbitrary tiles),
+ *        ordered column fastest and tick slowest. Slabs are read into BSQ buffers, processed and written
+ *        in a three-stage pipeline: while slab k is processed, slab k + 1 is read and slab k - 1 is written.
+ *        Two input and two output buffers are allocated, so memory use is bounded by getBufferBytes();
+ *        if memoryLimit is set, the slab shape is reduced to fit. Buffers are interleaved over NUMA nodes
+ *        (G3DTNumaBuffer), as readers, writers and the processing function touch them from all threads.
+ */
+class G3DTCORE_EXPORT RasterStream
+{
+public:
+    /*!
+     * \brief Fills a view with cells of a raster block. The view has the extents of the block.
+     */
+    typedef std::function<bool(RasterBlock *block, RasterView *view)> ReadFunction;
+
+    /*!
+     * \brief Stores cells of a raster block from a view with the extents of the block.
+     */
+    typedef std::function<bool(RasterBlock *block, RasterView *view)> WriteFunction;
+
+    /*!
+     * \brief Processes a slab. Input is nullptr without a reader, output is nullptr without a writer.
+     */
+    typedef std::function<bool(RasterBlock *block, RasterView *input, RasterView *output)> ProcessFunction;
+
+    RasterSize3DT size; //!< raster size
+    RasterSize3DT slabSize; //!< slab shape, reduced by run() to the raster size and memory limit
+    RasterCell::Type inputType; //!< cell type of input slabs
+    RasterCell::Type outputType; //!< cell type of output slabs
+    ReadFunction reader; //!< reads input slabs, or empty for output-only streams
+    WriteFunction writer; //!< writes output slabs, or empty for input-only streams
+    qint64 memoryLimit; //!< maximum size of slab buffers in bytes, 0 for no limit
+    int nThreads; //!< number of threads used by readers and writers, 0 for default
+    G3DTMetrics *metrics; //!< receives the counters "rasterStream.bytesRead" and "rasterStream.bytesWritten" of slabs, may be nullptr
+    QString errorString; //!< description of the last error
+
+public:
+    RasterStream();
+
+    void setTickSlabs();
+    void setLayerSlabs(qint64 nLayers);
+    void setTiles(RasterSize3DT *tileSize);
+
+    void setSource(RasterFile *file);
+    void setSource(BrickStore *store);
+    void setTarget(RasterFile *file);
+
+    qint64 getNumberOfSlabs();
+    RasterBlock getSlab(qint64 iSlab);
+    qint64 getSlabBytes();
+    qint64 getBufferBytes();
+    bool fitToMemory();
+
+    bool run(ProcessFunction process);
+
+private:
+    BrickGrid grid;
+
+    bool fail(QString message);
+};
+
+#endif // RASTERSTREAM_H
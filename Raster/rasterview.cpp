@@ -0,0 +1,701 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file rasterview.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "rasterview.h"
+#include "g3dtparallel.h"
+
+
+/*!
+ * \brief Edge length of square tiles used by cache-blocked copies of transposed views.
+ */
+static const qint64 rasterViewTileSize = 64;
+
+
+/*!
+ * \brief Copies a line of cells between strided addresses.
+ */
+template <typename T>
+static inline void rasterViewCopyLine(uchar *dst, qint64 dstStride, const uchar *src, qint64 srcStride, qint64 n)
+{
+    for (qint64 i = 0; i < n; i++)
+    {
+        memcpy(dst, src, sizeof(T));
+        dst += dstStride;
+        src += srcStride;
+    }
+}
+
+
+/*!
+ * \brief Copies a line of cells of a given size between strided addresses.
+ */
+static void rasterViewCopyLine(qint64 cellSize, uchar *dst, qint64 dstStride, const uchar *src, qint64 srcStride, qint64 n)
+{
+    if ((dstStride == cellSize) && (srcStride == cellSize))
+    {
+        memcpy(dst, src, size_t(n * cellSize));
+        return;
+    }
+    switch (cellSize)
+    {
+    case 1: rasterViewCopyLine<quint8>(dst, dstStride, src, srcStride, n); break;
+    case 2: rasterViewCopyLine<quint16>(dst, dstStride, src, srcStride, n); break;
+    case 4: rasterViewCopyLine<quint32>(dst, dstStride, src, srcStride, n); break;
+    case 8: rasterViewCopyLine<quint64>(dst, dstStride, src, srcStride, n); break;
+    default:
+        for (qint64 i = 0; i < n; i++)
+            memcpy(dst + i * dstStride, src + i * srcStride, size_t(cellSize));
+        break;
+    }
+}
+
+
+/*!
+ * \brief Transposes a tile of cells: cell (s, d) at src + d*srcLd + s*sizeof(T)
+ *        is written to dst + s*dstLd + d*sizeof(T).
+ */
+template <typename T>
+static void rasterViewTransposeTile(uchar *dst, qint64 dstLd, const uchar *src, qint64 srcLd, qint64 ns, qint64 nd)
+{
+    for (qint64 s = 0; s < ns; s++)
+    {
+        T *d = reinterpret_cast<T *>(dst + s * dstLd);
+        for (qint64 i = 0; i < nd; i++)
+            memcpy(d + i, src + i * srcLd + s * qint64(sizeof(T)), sizeof(T));
+    }
+}
+
+
+#ifdef __SSE2__
+/*!
+ * \brief Transposes a tile of 2-byte cells in 8 x 8 register blocks.
+ */
+template <>
+void rasterViewTransposeTile<quint16>(uchar *dst, qint64 dstLd, const uchar *src, qint64 srcLd, qint64 ns, qint64 nd)
+{
+    qint64 ns8 = ns & ~qint64(7), nd8 = nd & ~qint64(7);
+
+    for (qint64 d = 0; d < nd8; d += 8)
+    {
+        for (qint64 s = 0; s < ns8; s += 8)
+        {
+            const uchar *p = src + d * srcLd + s * 2;
+            __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + srcLd));
+            __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 2 * srcLd));
+            __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 3 * srcLd));
+            __m128i r4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 4 * srcLd));
+            __m128i r5 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 5 * srcLd));
+            __m128i r6 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 6 * srcLd));
+            __m128i r7 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 7 * srcLd));
+            __m128i a0 = _mm_unpacklo_epi16(r0, r1), a1 = _mm_unpackhi_epi16(r0, r1);
+            __m128i a2 = _mm_unpacklo_epi16(r2, r3), a3 = _mm_unpackhi_epi16(r2, r3);
+            __m128i a4 = _mm_unpacklo_epi16(r4, r5), a5 = _mm_unpackhi_epi16(r4, r5);
+            __m128i a6 = _mm_unpacklo_epi16(r6, r7), a7 = _mm_unpackhi_epi16(r6, r7);
+            __m128i b0 = _mm_unpacklo_epi32(a0, a2), b1 = _mm_unpackhi_epi32(a0, a2);
+            __m128i b2 = _mm_unpacklo_epi32(a1, a3), b3 = _mm_unpackhi_epi32(a1, a3);
+            __m128i b4 = _mm_unpacklo_epi32(a4, a6), b5 = _mm_unpackhi_epi32(a4, a6);
+            __m128i b6 = _mm_unpacklo_epi32(a5, a7), b7 = _mm_unpackhi_epi32(a5, a7);
+            uchar *q = dst + s * dstLd + d * 2;
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(q), _mm_unpacklo_epi64(b0, b4));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(q + dstLd), _mm_unpackhi_epi64(b0, b4));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(q + 2 * dstLd), _mm_unpacklo_epi64(b1, b5));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(q + 3 * dstLd), _mm_unpackhi_epi64(b1, b5));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(q + 4 * dstLd), _mm_unpacklo_epi64(b2, b6));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(q + 5 * dstLd), _mm_unpackhi_epi64(b2, b6));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(q + 6 * dstLd), _mm_unpacklo_epi64(b3, b7));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(q + 7 * dstLd), _mm_unpackhi_epi64(b3, b7));
+        }
+    }
+    // remaining columns and rows
+    if (ns8 < ns) rasterViewTransposeTile<quint8[2]>(dst + ns8 * dstLd, dstLd, src + ns8 * 2, srcLd, ns - ns8, nd);
+    if (nd8 < nd) rasterViewTransposeTile<quint8[2]>(dst + nd8 * 2, dstLd, src + nd8 * srcLd, srcLd, ns8, nd - nd8);
+}
+
+
+/*!
+ * \brief Transposes a tile of 4-byte cells in 4 x 4 register blocks.
+ */
+template <>
+void rasterViewTransposeTile<quint32>(uchar *dst, qint64 dstLd, const uchar *src, qint64 srcLd, qint64 ns, qint64 nd)
+{
+    qint64 ns4 = ns & ~qint64(3), nd4 = nd & ~qint64(3);
+
+    for (qint64 d = 0; d < nd4; d += 4)
+    {
+        for (qint64 s = 0; s < ns4; s += 4)
+        {
+            const uchar *p = src + d * srcLd + s * 4;
+            __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + srcLd));
+            __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 2 * srcLd));
+            __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 3 * srcLd));
+            __m128i a0 = _mm_unpacklo_epi32(r0, r1), a1 = _mm_unpackhi_epi32(r0, r1);
+            __m128i a2 = _mm_unpacklo_epi32(r2, r3), a3 = _mm_unpackhi_epi32(r2, r3);
+            uchar *q = dst + s * dstLd + d * 4;
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(q), _mm_unpacklo_epi64(a0, a2));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(q + dstLd), _mm_unpackhi_epi64(a0, a2));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(q + 2 * dstLd), _mm_unpacklo_epi64(a1, a3));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(q + 3 * dstLd), _mm_unpackhi_epi64(a1, a3));
+        }
+    }
+    if (ns4 < ns) rasterViewTransposeTile<quint8[4]>(dst + ns4 * dstLd, dstLd, src + ns4 * 4, srcLd, ns - ns4, nd);
+    if (nd4 < nd) rasterViewTransposeTile<quint8[4]>(dst + nd4 * 4, dstLd, src + nd4 * srcLd, srcLd, ns4, nd - nd4);
+}
+
+
+/*!
+ * \brief Transposes a tile of 8-byte cells in 2 x 2 register blocks.
+ */
+template <>
+void rasterViewTransposeTile<quint64>(uchar *dst, qint64 dstLd, const uchar *src, qint64 srcLd, qint64 ns, qint64 nd)
+{
+    qint64 ns2 = ns & ~qint64(1), nd2 = nd & ~qint64(1);
+
+    for (qint64 d = 0; d < nd2; d += 2)
+    {
+        for (qint64 s = 0; s < ns2; s += 2)
+        {
+            const uchar *p = src + d * srcLd + s * 8;
+            __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + srcLd));
+            uchar *q = dst + s * dstLd + d * 8;
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(q), _mm_unpacklo_epi64(r0, r1));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(q + dstLd), _mm_unpackhi_epi64(r0, r1));
+        }
+    }
+    if (ns2 < ns) rasterViewTransposeTile<quint8[8]>(dst + ns2 * dstLd, dstLd, src + ns2 * 8, srcLd, ns - ns2, nd);
+    if (nd2 < nd) rasterViewTransposeTile<quint8[8]>(dst + nd2 * 8, dstLd, src + nd2 * srcLd, srcLd, ns2, nd - nd2);
+}
+#endif
+
+
+/*!
+ * \brief Default constructor. Creates an invalid view.
+ */
+RasterView::RasterView()
+{
+    data = nullptr;
+    cellType = RasterCell::Undefined;
+    for (int i = 0; i < 5; i++) strides[i] = 0;
+}
+
+
+/*!
+ * \brief Constructs a view of a contiguous raster buffer.
+ * \param data Pointer to the raster buffer.
+ * \param cellType Cell type.
+ * \param size Pointer to the raster size.
+ * \param interleave Band interleave of the buffer.
+ */
+RasterView::RasterView(void *data, RasterCell::Type cellType, RasterSize3DT *size, Interleave interleave)
+{
+    set(data, cellType, size, interleave);
+}
+
+
+/*!
+ * \brief Sets the view to a contiguous raster buffer.
+ *        Ticks are always the slowest axis; the order of bands, columns, rows and layers follows the interleave.
+ * \param data Pointer to the raster buffer.
+ * \param cellType Cell type.
+ * \param size Pointer to the raster size.
+ * \param interleave Band interleave of the buffer; InterleaveOther is treated as BSQ.
+ */
+void RasterView::set(void *data, RasterCell::Type cellType, RasterSize3DT *size, Interleave interleave)
+{
+    qint64 cellSize = RasterCell::getSize(cellType);
+
+    this->data = static_cast<uchar *>(data);
+    this->cellType = cellType;
+    this->size = *size;
+    switch (interleave)
+    {
+    case BIL:
+        strides[AxisCol] = cellSize;
+        strides[AxisBand] = strides[AxisCol] * size->nCols;
+        strides[AxisRow] = strides[AxisBand] * size->nBands;
+        strides[AxisLay] = strides[AxisRow] * size->nRows;
+        strides[AxisTick] = strides[AxisLay] * size->nLays;
+        break;
+    case BIP:
+        strides[AxisBand] = cellSize;
+        strides[AxisCol] = strides[AxisBand] * size->nBands;
+        strides[AxisRow] = strides[AxisCol] * size->nCols;
+        strides[AxisLay] = strides[AxisRow] * size->nRows;
+        strides[AxisTick] = strides[AxisLay] * size->nLays;
+        break;
+    default:
+        strides[AxisCol] = cellSize;
+        strides[AxisRow] = strides[AxisCol] * size->nCols;
+        strides[AxisLay] = strides[AxisRow] * size->nRows;
+        strides[AxisBand] = strides[AxisLay] * size->nLays;
+        strides[AxisTick] = strides[AxisBand] * size->nBands;
+        break;
+    }
+}
+
+
+/*!
+ * \brief Returns a pointer to the extent of a given axis.
+ */
+qint64 *RasterView::getExtentPointer(int axis)
+{
+    switch (axis)
+    {
+    case AxisCol: return &size.nCols;
+    case AxisRow: return &size.nRows;
+    case AxisLay: return &size.nLays;
+    case AxisBand: return &size.nBands;
+    default: return &size.nTicks;
+    }
+}
+
+
+/*!
+ * \return True, if the view references cells of a defined type and all extents are positive.
+ */
+bool RasterView::isValid()
+{
+    return data && (0 < getCellSize()) && (0 < size.nCols) && (0 < size.nRows) && (0 < size.nLays) && (0 < size.nBands) && (0 < size.nTicks);
+}
+
+
+/*!
+ * \return True, if the view covers a contiguous band-sequential buffer.
+ */
+bool RasterView::isContiguous()
+{
+    qint64 stride = getCellSize();
+
+    for (int axis = AxisCol; axis <= AxisTick; axis++)
+    {
+        if ((1 < *getExtentPointer(axis)) && (strides[axis] != stride)) return false;
+        stride *= *getExtentPointer(axis);
+    }
+    return true;
+}
+
+
+/*!
+ * \brief Tests whether views have the same extents and cell type.
+ * \param view Pointer to a compared view.
+ * \return True, if views have the same shape.
+ */
+bool RasterView::hasSameShape(RasterView *view)
+{
+    return (cellType == view->cellType) && (size.nCols == view->size.nCols) && (size.nRows == view->size.nRows) &&
+           (size.nLays == view->size.nLays) && (size.nBands == view->size.nBands) && (size.nTicks == view->size.nTicks);
+}
+
+
+/*!
+ * \brief Detects the band interleave of a contiguous view.
+ * \return BSQ, BIL or BIP, or InterleaveOther for cropped, subsampled or transposed views.
+ *         Views with a single band are reported as BSQ.
+ */
+RasterView::Interleave RasterView::getInterleave()
+{
+    RasterView view;
+
+    for (int interleave = BSQ; interleave <= BIP; interleave++)
+    {
+        view.set(data, cellType, &size, Interleave(interleave));
+        bool same = true;
+        for (int axis = AxisCol; axis <= AxisTick; axis++)
+            if ((1 < *getExtentPointer(axis)) && (strides[axis] != view.strides[axis])) same = false;
+        if (same) return Interleave(interleave);
+    }
+    return InterleaveOther;
+}
+
+
+/*!
+ * \return Cell size in bytes.
+ */
+qint64 RasterView::getCellSize()
+{
+    return RasterCell::getSize(cellType);
+}
+
+
+/*!
+ * \return Number of cells in the view.
+ */
+qint64 RasterView::getNumberOfCells()
+{
+    return size.nCols * size.nRows * size.nLays * size.nBands * size.nTicks;
+}
+
+
+/*!
+ * \param axis Raster axis.
+ * \return Extent of the view along a given axis.
+ */
+qint64 RasterView::getExtent(Axis axis)
+{
+    return *getExtentPointer(axis);
+}
+
+
+/*!
+ * \brief Returns the address of a cell. Indexes are not checked.
+ * \return Pointer to the cell.
+ */
+uchar *RasterView::getCell(qint64 col, qint64 row, qint64 lay, qint64 band, qint64 tick)
+{
+    return data + col * strides[AxisCol] + row * strides[AxisRow] + lay * strides[AxisLay] + band * strides[AxisBand] + tick * strides[AxisTick];
+}
+
+
+/*!
+ * \brief Reads a cell value as double. Indexes are not checked.
+ * \return Cell value.
+ */
+double RasterView::getValue(qint64 col, qint64 row, qint64 lay, qint64 band, qint64 tick)
+{
+    return RasterCell::toDouble(cellType, getCell(col, row, lay, band, tick));
+}
+
+
+/*!
+ * \brief Writes a cell value. Indexes are not checked.
+ */
+void RasterView::setValue(qint64 col, qint64 row, qint64 lay, qint64 band, qint64 tick, double value)
+{
+    RasterCell::fromDouble(cellType, value, getCell(col, row, lay, band, tick));
+}
+
+
+/*!
+ * \brief Returns a view of a raster block.
+ * \param block Pointer to a raster block in view coordinates.
+ * \return View of the block, or an invalid view if the block is not inside the view.
+ */
+RasterView RasterView::crop(RasterBlock *block)
+{
+    RasterView view;
+
+    if ((block->col0 < 0) || (size.nCols <= block->col1) || (block->col1 < block->col0)) return view;
+    if ((block->row0 < 0) || (size.nRows <= block->row1) || (block->row1 < block->row0)) return view;
+    if ((block->lay0 < 0) || (size.nLays <= block->lay1) || (block->lay1 < block->lay0)) return view;
+    if ((block->band0 < 0) || (size.nBands <= block->band1) || (block->band1 < block->band0)) return view;
+    if ((block->tick0 < 0) || (size.nTicks <= block->tick1) || (block->tick1 < block->tick0)) return view;
+
+    view = *this;
+    view.data = getCell(block->col0, block->row0, block->lay0, block->band0, block->tick0);
+    view.size.set(block->getNumberOfColumns(), block->getNumberOfRows(), block->getNumberOfLayers(), block->getNumberOfBands(), block->getNumberOfTicks());
+    return view;
+}
+
+
+/*!
+ * \brief Returns a view of every n-th cell along each axis.
+ * \param colStep Column step.
+ * \param rowStep Row step.
+ * \param layStep Layer step.
+ * \param bandStep Band step.
+ * \param tickStep Tick step.
+ * \return Subsampled view, or an invalid view for non-positive steps.
+ */
+RasterView RasterView::subsample(qint64 colStep, qint64 rowStep, qint64 layStep, qint64 bandStep, qint64 tickStep)
+{
+    RasterView view;
+    qint64 steps[5] = {colStep, rowStep, layStep, bandStep, tickStep};
+
+    for (int axis = AxisCol; axis <= AxisTick; axis++)
+        if (steps[axis] < 1) return view;
+
+    view = *this;
+    for (int axis = AxisCol; axis <= AxisTick; axis++)
+    {
+        qint64 *extent = view.getExtentPointer(axis);
+        *extent = (*extent + steps[axis] - 1) / steps[axis];
+        view.strides[axis] *= steps[axis];
+    }
+    return view;
+}
+
+
+/*!
+ * \brief Returns a single-layer view.
+ * \param lay Layer index.
+ * \return View of the layer, or an invalid view if the layer does not exist.
+ */
+RasterView RasterView::selectLayer(qint64 lay)
+{
+    RasterView view;
+
+    if ((lay < 0) || (size.nLays <= lay)) return view;
+    view = *this;
+    view.data += lay * strides[AxisLay];
+    view.size.nLays = 1;
+    return view;
+}
+
+
+/*!
+ * \brief Returns a single-band view.
+ * \param band Band index.
+ * \return View of the band, or an invalid view if the band does not exist.
+ */
+RasterView RasterView::selectBand(qint64 band)
+{
+    RasterView view;
+
+    if ((band < 0) || (size.nBands <= band)) return view;
+    view = *this;
+    view.data += band * strides[AxisBand];
+    view.size.nBands = 1;
+    return view;
+}
+
+
+/*!
+ * \brief Returns a single-tick view.
+ * \param tick Tick index.
+ * \return View of the tick, or an invalid view if the tick does not exist.
+ */
+RasterView RasterView::selectTick(qint64 tick)
+{
+    RasterView view;
+
+    if ((tick < 0) || (size.nTicks <= tick)) return view;
+    view = *this;
+    view.data += tick * strides[AxisTick];
+    view.size.nTicks = 1;
+    return view;
+}
+
+
+/*!
+ * \brief Returns a view with two axes swapped.
+ * \param axis0 First axis.
+ * \param axis1 Second axis.
+ * \return Transposed view.
+ */
+RasterView RasterView::transpose(Axis axis0, Axis axis1)
+{
+    RasterView view = *this;
+
+    std::swap(*view.getExtentPointer(axis0), *view.getExtentPointer(axis1));
+    std::swap(view.strides[axis0], view.strides[axis1]);
+    return view;
+}
+
+
+/*!
+ * \brief Copies cells of the view to a target view of the same shape.
+ *        When the fastest axes of source and target differ (transposition, interleave change),
+ *        cells are copied in square tiles so that both sides stay in cache.
+ *        Outer lines or tiles are copied in parallel.
+ * \param target Pointer to the target view.
+ * \param nThreads Number of threads, 0 for default.
+ * \return True, if cells were copied; false if the shapes differ or the current G3DTCancelToken stopped copying.
+ */
+bool RasterView::copyTo(RasterView *target, int nThreads)
+{
+    qint64 cellSize = getCellSize();
+    qint64 extents[5];
+    int srcInner = AxisCol, dstInner = AxisCol;
+    int outer[5], nOuter = 0;
+    qint64 nOuterItems = 1;
+
+    if (!isValid() || !target->isValid() || !hasSameShape(target)) return false;
+
+    for (int axis = AxisCol; axis <= AxisTick; axis++)
+        extents[axis] = *getExtentPointer(axis);
+
+    // fastest axes of source and target
+    for (int axis = AxisCol; axis <= AxisTick; axis++)
+    {
+        if (extents[axis] <= 1) continue;
+        if ((extents[srcInner] <= 1) || (qAbs(strides[axis]) < qAbs(strides[srcInner]))) srcInner = axis;
+        if ((extents[dstInner] <= 1) || (qAbs(target->strides[axis]) < qAbs(target->strides[dstInner]))) dstInner = axis;
+    }
+
+    for (int axis = AxisCol; axis <= AxisTick; axis++)
+    {
+        if ((axis == srcInner) || (axis == dstInner)) continue;
+        outer[nOuter++] = axis;
+        nOuterItems *= extents[axis];
+    }
+
+    if (srcInner == dstInner)
+    {
+        // line copies along the common fastest axis
+        return G3DTParallel::forEach(nOuterItems, [&](qint64 iItem) {
+            qint64 rest = iItem;
+            uchar *src = data;
+            uchar *dst = target->data;
+            for (int i = 0; i < nOuter; i++)
+            {
+                qint64 index = rest % extents[outer[i]];
+                rest /= extents[outer[i]];
+                src += index * strides[outer[i]];
+                dst += index * target->strides[outer[i]];
+            }
+            rasterViewCopyLine(cellSize, dst, target->strides[srcInner], src, strides[srcInner], extents[srcInner]);
+        }, nThreads);
+    }
+
+    // tiled copy over the two fastest axes
+    qint64 nTilesS = (extents[srcInner] + rasterViewTileSize - 1) / rasterViewTileSize;
+    qint64 nTilesD = (extents[dstInner] + rasterViewTileSize - 1) / rasterViewTileSize;
+    bool unitTiles = (strides[srcInner] == cellSize) && (target->strides[dstInner] == cellSize) &&
+                     ((cellSize == 1) || (cellSize == 2) || (cellSize == 4) || (cellSize == 8));
+    return G3DTParallel::forEach(nOuterItems * nTilesS * nTilesD, [&](qint64 iItem) {
+        qint64 tileS = iItem % nTilesS;
+        qint64 tileD = (iItem / nTilesS) % nTilesD;
+        qint64 rest = iItem / (nTilesS * nTilesD);
+        qint64 s0 = tileS * rasterViewTileSize, s1 = qMin(s0 + rasterViewTileSize, extents[srcInner]);
+        qint64 d0 = tileD * rasterViewTileSize, d1 = qMin(d0 + rasterViewTileSize, extents[dstInner]);
+        uchar *src = data;
+        uchar *dst = target->data;
+
+        for (int i = 0; i < nOuter; i++)
+        {
+            qint64 index = rest % extents[outer[i]];
+            rest /= extents[outer[i]];
+            src += index * strides[outer[i]];
+            dst += index * target->strides[outer[i]];
+        }
+        if (unitTiles)
+        {
+            // dense tiles are transposed in registers
+            uchar *tileDst = dst + s0 * target->strides[srcInner] + d0 * target->strides[dstInner];
+            const uchar *tileSrc = src + s0 * strides[srcInner] + d0 * strides[dstInner];
+            switch (cellSize)
+            {
+            case 1: rasterViewTransposeTile<quint8>(tileDst, target->strides[srcInner], tileSrc, strides[dstInner], s1 - s0, d1 - d0); break;
+            case 2: rasterViewTransposeTile<quint16>(tileDst, target->strides[srcInner], tileSrc, strides[dstInner], s1 - s0, d1 - d0); break;
+            case 4: rasterViewTransposeTile<quint32>(tileDst, target->strides[srcInner], tileSrc, strides[dstInner], s1 - s0, d1 - d0); break;
+            default: rasterViewTransposeTile<quint64>(tileDst, target->strides[srcInner], tileSrc, strides[dstInner], s1 - s0, d1 - d0); break;
+            }
+            return;
+        }
+        // lines along the target fastest axis; the source tile stays in cache
+        for (qint64 s = s0; s < s1; s++)
+        {
+            rasterViewCopyLine(cellSize,
+                               dst + s * target->strides[srcInner] + d0 * target->strides[dstInner], target->strides[dstInner],
+                               src + s * strides[srcInner] + d0 * strides[dstInner], strides[dstInner], d1 - d0);
+        }
+    }, nThreads);
+}
+
+
+/*!
+ * \brief Copies cells of the view to a contiguous band-sequential buffer.
+ * \param buffer Target buffer of getNumberOfCells() * getCellSize() bytes.
+ * \param nThreads Number of threads, 0 for default.
+ * \return True, if cells were copied.
+ */
+bool RasterView::materialize(void *buffer, int nThreads)
+{
+    RasterView target(buffer, cellType, &size);
+    return copyTo(&target, nThreads);
+}
+
+
+/*!
+ * \brief Copies cells of the view to a contiguous buffer with a given interleave.
+ * \param buffer Target buffer of getNumberOfCells() * getCellSize() bytes.
+ * \param interleave Band interleave of the target buffer.
+ * \param nThreads Number of threads, 0 for default.
+ * \return True, if cells were copied.
+ */
+bool RasterView::materialize(void *buffer, Interleave interleave, int nThreads)
+{
+    RasterView target(buffer, cellType, &size, interleave);
+    return copyTo(&target, nThreads);
+}
+
+
+/*!
+ * \brief Returns a read-only view repeating a single cell over a raster size (all strides are zero),
+ *        e.g. to fill a view with a constant by copyTo().
+ * \param cell Pointer to the cell.
+ * \param cellType Cell type.
+ * \param size Pointer to the extents of the view.
+ * \return View of the cell.
+ */
+RasterView RasterView::broadcast(const void *cell, RasterCell::Type cellType, RasterSize3DT *size)
+{
+    RasterView view;
+
+    view.data = static_cast<uchar *>(const_cast<void *>(cell));
+    view.cellType = cellType;
+    view.size = *size;
+    for (int axis = AxisCol; axis <= AxisTick; axis++)
+        view.strides[axis] = 0;
+    return view;
+}
+
+
+/*!
+ * \brief Converts the band interleave of a raster buffer.
+ *        Columns and bands are exchanged in cache-sized tiles transposed in SIMD registers,
+ *        tiles are processed in parallel.
+ * \param source Source buffer.
+ * \param sourceInterleave Band interleave of the source buffer.
+ * \param target Target buffer of the same size; it must not overlap the source.
+ * \param targetInterleave Band interleave of the target buffer.
+ * \param cellType Cell type.
+ * \param size Pointer to the raster size.
+ * \param nThreads Number of threads, 0 for default.
+ * \return True, if the raster was converted.
+ */
+bool RasterView::convertInterleave(const void *source, Interleave sourceInterleave, void *target, Interleave targetInterleave,
+                                   RasterCell::Type cellType, RasterSize3DT *size, int nThreads)
+{
+    if ((sourceInterleave == InterleaveOther) || (targetInterleave == InterleaveOther)) return false;
+
+    RasterView sourceView(const_cast<void *>(source), cellType, size, sourceInterleave);
+    RasterView targetView(target, cellType, size, targetInterleave);
+    return sourceView.copyTo(&targetView, nThreads);
+}
+
+
+/*!
+ * \param interleave Band interleave.
+ * \return Name of the interleave: BSQ, BIL or BIP.
+ */
+QString RasterView::toString(Interleave interleave)
+{
+    switch (interleave)
+    {
+    case BSQ: return "BSQ";
+    case BIL: return "BIL";
+    case BIP: return "BIP";
+    default: return "";
+    }
+}
+
+
+/*!
+ * \param interleave Name of the interleave, case insensitive.
+ * \return Band interleave, or InterleaveOther for unknown names.
+ */
+RasterView::Interleave RasterView::fromString(QString interleave)
+{
+    interleave = interleave.trimmed().toUpper();
+    if (interleave == "BSQ") return BSQ;
+    if (interleave == "BIL") return BIL;
+    if (interleave == "BIP") return BIP;
+    return InterleaveOther;
+}
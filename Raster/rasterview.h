@@ -0,0 +1,95 @@
+#ifndef RASTERVIEW_H
+#define RASTERVIEW_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file rasterview.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <QString>
+#include "g3dtcore_global.h"
+#include "Geometry/rasterblock.h"
+#include "Geometry/rastersize3dt.h"
+#include "rastercell.h"
+
+
+/*!
+ * \brief The RasterView is a lightweight window into an existing raster buffer.
+ *        It holds the address of its first cell, extents along the five raster axes and per-axis strides in bytes.
+ *        Cropping, subsampling, band/tick/layer selection and transposition return new views
+ *        over the same buffer without allocation. Cells are copied only by copyTo() or materialize().
+ *        Buffers may be band sequential (BSQ), band interleaved by line (BIL) or by pixel (BIP).
+ */
+class G3DTCORE_EXPORT RasterView
+{
+public:
+    enum Axis
+    {
+        AxisCol = 0,
+        AxisRow = 1,
+        AxisLay = 2,
+        AxisBand = 3,
+        AxisTick = 4
+    };
+
+    enum Interleave
+    {
+        BSQ = 0, //!< band sequential: col + nCols*(row + nRows*(lay + nLays*(band + nBands*tick)))
+        BIL = 1, //!< band interleaved by line: col + nCols*(band + nBands*(row + nRows*(lay + nLays*tick)))
+        BIP = 2, //!< band interleaved by pixel: band + nBands*(col + nCols*(row + nRows*(lay + nLays*tick)))
+        InterleaveOther = 3 //!< any other stride layout
+    };
+
+    uchar *data; //!< address of the first cell of the view
+    RasterCell::Type cellType; //!< cell type
+    RasterSize3DT size; //!< extents of the view
+    qint64 strides[5]; //!< distance between neighbouring cells along each axis in bytes
+
+public:
+    RasterView();
+    RasterView(void *data, RasterCell::Type cellType, RasterSize3DT *size, Interleave interleave = BSQ);
+
+    void set(void *data, RasterCell::Type cellType, RasterSize3DT *size, Interleave interleave = BSQ);
+    bool isValid();
+    bool isContiguous();
+    bool hasSameShape(RasterView *view);
+    Interleave getInterleave();
+
+    qint64 getCellSize();
+    qint64 getNumberOfCells();
+    qint64 getExtent(Axis axis);
+
+    uchar *getCell(qint64 col, qint64 row, qint64 lay, qint64 band, qint64 tick);
+    double getValue(qint64 col, qint64 row, qint64 lay, qint64 band, qint64 tick);
+    void setValue(qint64 col, qint64 row, qint64 lay, qint64 band, qint64 tick, double value);
+
+    RasterView crop(RasterBlock *block);
+    RasterView subsample(qint64 colStep, qint64 rowStep, qint64 layStep = 1, qint64 bandStep = 1, qint64 tickStep = 1);
+    RasterView selectLayer(qint64 lay);
+    RasterView selectBand(qint64 band);
+    RasterView selectTick(qint64 tick);
+    RasterView transpose(Axis axis0 = AxisCol, Axis axis1 = AxisRow);
+
+    bool copyTo(RasterView *target, int nThreads = 0);
+    bool materialize(void *buffer, int nThreads = 0);
+    bool materialize(void *buffer, Interleave interleave, int nThreads = 0);
+
+    static RasterView broadcast(const void *cell, RasterCell::Type cellType, RasterSize3DT *size);
+    static bool convertInterleave(const void *source, Interleave sourceInterleave, void *target, Interleave targetInterleave,
+                                  RasterCell::Type cellType, RasterSize3DT *size, int nThreads = 0);
+    static QString toString(Interleave interleave);
+    static Interleave fromString(QString interleave);
+
+private:
+    qint64 *getExtentPointer(int axis);
+};
+
+#endif // RASTERVIEW_H
@@ -0,0 +1,521 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file tickstore.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <math.h>
+#include <string.h>
+#include <QDir>
+#include <QtEndian>
+#include "tickstore.h"
+#include "rasterfile.h"
+
+
+/*!
+ * \brief Index signature, format version and file name.
+ */
+static const char tickStoreMagic[8] = {'G', '3', 'D', 'T', 'T', 'I', 'C', 'K'};
+static const quint32 tickStoreVersion = 1;
+static const char tickStoreIndexName[] = "/index.g3t";
+
+
+/*!
+ * \brief Size of an index entry in bytes: qint64 id, qint64 tick0, qint64 nTicks, double t0, double t1.
+ */
+static const qint64 tickStoreEntrySize = 40;
+
+
+/*!
+ * \brief Byte offsets of index header fields.
+ */
+enum TickStoreHeaderField
+{
+    TickStoreMagic = 0, //!< char[8]
+    TickStoreVersion = 8, //!< quint32
+    TickStoreHeaderSize = 12, //!< quint32
+    TickStoreCellType = 16, //!< quint32
+    TickStoreInterleave = 20, //!< quint32
+    TickStoreSize = 24, //!< qint64[4]: columns, rows, layers, bands
+    TickStoreBrickSize = 56, //!< qint64[5]
+    TickStoreExtent = 96, //!< double[6]: x0, y0, z0, x1, y1, z1
+    TickStoreNoData = 144, //!< double
+    TickStoreUseNoData = 152, //!< quint32
+    TickStoreNumberOfSegments = 160 //!< qint64, written last by append()
+};
+
+
+template <typename T>
+static void tickStorePut(uchar *buffer, qint64 offset, T value)
+{
+    qToLittleEndian<T>(value, buffer + offset);
+}
+
+
+template <typename T>
+static T tickStoreGet(const uchar *buffer, qint64 offset)
+{
+    return qFromLittleEndian<T>(buffer + offset);
+}
+
+
+static void tickStorePutDouble(uchar *buffer, qint64 offset, double value)
+{
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    tickStorePut<quint64>(buffer, offset, bits);
+}
+
+
+static double tickStoreGetDouble(const uchar *buffer, qint64 offset)
+{
+    quint64 bits = tickStoreGet<quint64>(buffer, offset);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+
+/*!
+ * \brief Default constructor.
+ */
+TickStore::TickStore()
+{
+    size.set(0, 0, 1, 1, 0);
+    brickSize.set(64, 64, 64, 1, 1);
+    cellType = RasterCell::Float64;
+    interleave = RasterView::BSQ;
+    useNoData = false;
+    noData = -9999.0;
+    writable = false;
+}
+
+
+/*!
+ * \brief Destructor. Closes the store.
+ */
+TickStore::~TickStore()
+{
+    close();
+}
+
+
+/*!
+ * \brief Stores an error description and closes the store.
+ * \return Always false.
+ */
+bool TickStore::fail(QString message)
+{
+    errorString = message;
+    close();
+    return false;
+}
+
+
+/*!
+ * \brief Creates an empty store: the directory (if needed) and the index. Segment files of a previous
+ *        store in the directory are overwritten by later appends.
+ *        The size (except nTicks), brick size, extent (except t), cell type, interleave and NoData must be set.
+ * \param directory Directory of the store.
+ * \return True, if the store was created; it is open for appending.
+ */
+bool TickStore::create(QString directory)
+{
+    uchar header[headerSize];
+    qint64 cellSize = RasterCell::getSize(cellType);
+
+    close();
+    errorString.clear();
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    return fail("Tick stores are not supported on big-endian hosts.");
+#endif
+    if (cellSize <= 0) return fail("Undefined cell type.");
+    if ((interleave < RasterView::BSQ) || (RasterView::BIP < interleave)) return fail("Unsupported interleave.");
+    if ((size.nCols < 1) || (size.nRows < 1) || (size.nLays < 1) || (size.nBands < 1)) return fail("Invalid raster size.");
+    if ((brickSize.nCols < 1) || (brickSize.nRows < 1) || (brickSize.nLays < 1) || (brickSize.nBands < 1) || (brickSize.nTicks < 1)) return fail("Invalid brick size.");
+    if (!QDir().mkpath(directory)) return fail("Cannot create " + directory + ".");
+
+    memset(header, 0, sizeof(header));
+    memcpy(header + TickStoreMagic, tickStoreMagic, sizeof(tickStoreMagic));
+    tickStorePut<quint32>(header, TickStoreVersion, tickStoreVersion);
+    tickStorePut<quint32>(header, TickStoreHeaderSize, quint32(headerSize));
+    tickStorePut<quint32>(header, TickStoreCellType, quint32(cellType));
+    tickStorePut<quint32>(header, TickStoreInterleave, quint32(interleave));
+    tickStorePut<qint64>(header, TickStoreSize, size.nCols);
+    tickStorePut<qint64>(header, TickStoreSize + 8, size.nRows);
+    tickStorePut<qint64>(header, TickStoreSize + 16, size.nLays);
+    tickStorePut<qint64>(header, TickStoreSize + 24, size.nBands);
+    tickStorePut<qint64>(header, TickStoreBrickSize, brickSize.nCols);
+    tickStorePut<qint64>(header, TickStoreBrickSize + 8, brickSize.nRows);
+    tickStorePut<qint64>(header, TickStoreBrickSize + 16, brickSize.nLays);
+    tickStorePut<qint64>(header, TickStoreBrickSize + 24, brickSize.nBands);
+    tickStorePut<qint64>(header, TickStoreBrickSize + 32, brickSize.nTicks);
+    tickStorePutDouble(header, TickStoreExtent, extent.p0.x);
+    tickStorePutDouble(header, TickStoreExtent + 8, extent.p0.y);
+    tickStorePutDouble(header, TickStoreExtent + 16, extent.p0.z);
+    tickStorePutDouble(header, TickStoreExtent + 24, extent.p1.x);
+    tickStorePutDouble(header, TickStoreExtent + 32, extent.p1.y);
+    tickStorePutDouble(header, TickStoreExtent + 40, extent.p1.z);
+    tickStorePutDouble(header, TickStoreNoData, noData);
+    tickStorePut<quint32>(header, TickStoreUseNoData, useNoData ? 1 : 0);
+    tickStorePut<qint64>(header, TickStoreNumberOfSegments, 0);
+
+    index.setFileName(directory + tickStoreIndexName);
+    if (!index.open(QIODevice::ReadWrite | QIODevice::Truncate)) return fail("Cannot create " + index.fileName() + ".");
+    if ((index.write(reinterpret_cast<const char *>(header), headerSize) != headerSize) || !index.flush())
+        return fail("Cannot write " + index.fileName() + ".");
+    this->directory = directory;
+    size.nTicks = 0;
+    extent.p0.t = extent.p1.t = 0.0;
+    writable = true;
+    return true;
+}
+
+
+/*!
+ * \brief Opens a store and reads the snapshot of segments complete at this moment.
+ * \param directory Directory of the store.
+ * \param writable Open for appending. A store must have a single writer.
+ * \return True, if the store was opened.
+ */
+bool TickStore::open(QString directory, bool writable)
+{
+    close();
+    errorString.clear();
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    return fail("Tick stores are not supported on big-endian hosts.");
+#endif
+    index.setFileName(directory + tickStoreIndexName);
+    if (!index.open(writable ? QIODevice::ReadWrite : QIODevice::ReadOnly)) return fail("Cannot open " + index.fileName() + ".");
+    this->directory = directory;
+    this->writable = writable;
+    return readIndex(true);
+}
+
+
+/*!
+ * \brief Reads segments appended since the last read of the index. Readers call it to see new ticks.
+ * \return True, if the index was read.
+ */
+bool TickStore::refresh()
+{
+    if (!isOpen()) return false;
+    return readIndex(false);
+}
+
+
+/*!
+ * \brief Reads the number of segments and the new index entries, optionally with the header fields.
+ *        The number of segments is read first, so entries below it are complete.
+ */
+bool TickStore::readIndex(bool withHeader)
+{
+    uchar header[headerSize];
+    qint64 nSegments, nNew, n0 = qint64(segments.size());
+    std::vector<uchar> entries;
+
+    if (!index.seek(0) || (index.read(reinterpret_cast<char *>(header), headerSize) != headerSize)) return fail("Cannot read the index.");
+    if (withHeader)
+    {
+        quint32 type, mode;
+        if (memcmp(header + TickStoreMagic, tickStoreMagic, sizeof(tickStoreMagic)) != 0) return fail(index.fileName() + " is not a tick store index.");
+        if (tickStoreGet<quint32>(header, TickStoreVersion) != tickStoreVersion) return fail("Unsupported tick store version.");
+        type = tickStoreGet<quint32>(header, TickStoreCellType);
+        mode = tickStoreGet<quint32>(header, TickStoreInterleave);
+        if ((type < RasterCell::UInt8) || (RasterCell::Float64 < type)) return fail("Unsupported cell type.");
+        if (RasterView::BIP < mode) return fail("Unsupported interleave.");
+        cellType = RasterCell::Type(type);
+        interleave = RasterView::Interleave(mode);
+        size.set(tickStoreGet<qint64>(header, TickStoreSize), tickStoreGet<qint64>(header, TickStoreSize + 8),
+                 tickStoreGet<qint64>(header, TickStoreSize + 16), tickStoreGet<qint64>(header, TickStoreSize + 24), 0);
+        brickSize.set(tickStoreGet<qint64>(header, TickStoreBrickSize), tickStoreGet<qint64>(header, TickStoreBrickSize + 8),
+                      tickStoreGet<qint64>(header, TickStoreBrickSize + 16), tickStoreGet<qint64>(header, TickStoreBrickSize + 24),
+                      tickStoreGet<qint64>(header, TickStoreBrickSize + 32));
+        extent.set(tickStoreGetDouble(header, TickStoreExtent), tickStoreGetDouble(header, TickStoreExtent + 8),
+                   tickStoreGetDouble(header, TickStoreExtent + 16), 0.0, tickStoreGetDouble(header, TickStoreExtent + 24),
+                   tickStoreGetDouble(header, TickStoreExtent + 32), tickStoreGetDouble(header, TickStoreExtent + 40), 0.0);
+        noData = tickStoreGetDouble(header, TickStoreNoData);
+        useNoData = tickStoreGet<quint32>(header, TickStoreUseNoData) != 0;
+        if ((size.nCols < 1) || (size.nRows < 1) || (size.nLays < 1) || (size.nBands < 1)) return fail("Invalid raster size.");
+    }
+
+    nSegments = tickStoreGet<qint64>(header, TickStoreNumberOfSegments);
+    if (nSegments < n0) return fail("The tick store index was truncated.");
+    nNew = nSegments - n0;
+    if (nNew == 0) return true;
+    if ((index.size() - headerSize) / tickStoreEntrySize - n0 < nNew) return fail("The tick store index was truncated.");
+    entries.resize(size_t(nNew * tickStoreEntrySize));
+    if (!index.seek(headerSize + n0 * tickStoreEntrySize) ||
+        (index.read(reinterpret_cast<char *>(entries.data()), qint64(entries.size())) != qint64(entries.size())))
+        return fail("Cannot read the index.");
+
+    for (qint64 i = 0; i < nNew; i++)
+    {
+        const uchar *entry = entries.data() + i * tickStoreEntrySize;
+        TickSegment segment;
+        segment.id = tickStoreGet<qint64>(entry, 0);
+        segment.tick0 = tickStoreGet<qint64>(entry, 8);
+        segment.nTicks = tickStoreGet<qint64>(entry, 16);
+        segment.t0 = tickStoreGetDouble(entry, 24);
+        segment.t1 = tickStoreGetDouble(entry, 32);
+        if ((segment.tick0 != size.nTicks) || (segment.nTicks < 1)) return fail("Invalid tick store index entry.");
+        segments.push_back(segment);
+        size.nTicks += segment.nTicks;
+    }
+    extent.p0.t = segments.front().t0;
+    extent.p1.t = segments.back().t1;
+    return true;
+}
+
+
+/*!
+ * \brief Closes the store.
+ */
+void TickStore::close()
+{
+    if (index.isOpen()) index.close();
+    segments.clear();
+    size.nTicks = 0;
+    writable = false;
+}
+
+
+/*!
+ * \return True, if the store is open.
+ */
+bool TickStore::isOpen()
+{
+    return index.isOpen();
+}
+
+
+/*!
+ * \return Number of ticks of the snapshot.
+ */
+qint64 TickStore::getNumberOfTicks()
+{
+    return size.nTicks;
+}
+
+
+/*!
+ * \return Number of segments of the snapshot.
+ */
+qint64 TickStore::getNumberOfSegments()
+{
+    return qint64(segments.size());
+}
+
+
+/*!
+ * \param iSegment Segment index. Indexes are not checked.
+ * \return Segment.
+ */
+TickSegment TickStore::getSegment(qint64 iSegment)
+{
+    return segments[size_t(iSegment)];
+}
+
+
+/*!
+ * \param id Segment number.
+ * \return Name of the segment file.
+ */
+QString TickStore::getSegmentFileName(qint64 id)
+{
+    return directory + QString("/segment%1.g3r").arg(id, 8, 10, QChar('0'));
+}
+
+
+/*!
+ * \return Index of the segment containing a tick, -1 if the tick is outside the store.
+ */
+qint64 TickStore::findSegment(qint64 tick)
+{
+    qint64 lo = 0, hi = qint64(segments.size());
+
+    if ((tick < 0) || (size.nTicks <= tick)) return -1;
+    while (1 < hi - lo)
+    {
+        qint64 mid = (lo + hi) / 2;
+        if (segments[size_t(mid)].tick0 <= tick) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+
+/*!
+ * \param tick Tick index.
+ * \return Time of a tick, NaN if the tick is outside the store.
+ */
+double TickStore::getTickTime(qint64 tick)
+{
+    qint64 iSegment = findSegment(tick);
+
+    if (iSegment < 0) return double(NAN);
+    const TickSegment &segment = segments[size_t(iSegment)];
+    if (segment.nTicks == 1) return segment.t0;
+    return segment.t0 + (segment.t1 - segment.t0) * double(tick - segment.tick0) / double(segment.nTicks - 1);
+}
+
+
+/*!
+ * \brief Appends ticks as a new segment. The segment file is written completely before it is added to the
+ *        index, and the number of segments is updated last.
+ * \param source View with the raster size of the store, the cell type of the store and one or more ticks.
+ * \param t0 Time of the first tick; it must be greater than the time of the last stored tick.
+ * \param t1 Time of the last tick, ignored for a single tick.
+ * \param nThreads Number of threads, 0 for default.
+ * \return True, if the ticks were appended.
+ */
+bool TickStore::append(RasterView *source, double t0, double t1, int nThreads)
+{
+    RasterFile file;
+    RasterBlock block;
+    TickSegment segment;
+    uchar entry[tickStoreEntrySize], count[8];
+
+    errorString.clear();
+    if (!isOpen() || !writable) return false;
+    if (!source->isValid() || (source->cellType != cellType)) return false;
+    if ((source->size.nCols != size.nCols) || (source->size.nRows != size.nRows) ||
+        (source->size.nLays != size.nLays) || (source->size.nBands != size.nBands)) return false;
+    if (source->size.nTicks == 1) t1 = t0;
+    if (!(t0 <= t1) || (!segments.empty() && !(segments.back().t1 < t0)))
+    {
+        errorString = "Tick times must increase.";
+        return false;
+    }
+
+    segment.id = qint64(segments.size());
+    segment.tick0 = size.nTicks;
+    segment.nTicks = source->size.nTicks;
+    segment.t0 = t0;
+    segment.t1 = t1;
+
+    file.size = size;
+    file.size.nTicks = segment.nTicks;
+    file.brickSize = brickSize;
+    file.extent = extent;
+    file.extent.p0.t = t0;
+    file.extent.p1.t = t1;
+    file.cellType = cellType;
+    file.interleave = interleave;
+    file.useNoData = useNoData;
+    file.noData = noData;
+    if (!file.create(getSegmentFileName(segment.id)))
+    {
+        errorString = file.errorString;
+        return false;
+    }
+    block.set(0, 0, 0, 0, 0, size.nCols - 1, size.nRows - 1, size.nLays - 1, size.nBands - 1, segment.nTicks - 1);
+    if (!file.write(&block, source, nThreads))
+    {
+        errorString = "Cannot write " + getSegmentFileName(segment.id) + ".";
+        return false;
+    }
+    file.close();
+
+    tickStorePut<qint64>(entry, 0, segment.id);
+    tickStorePut<qint64>(entry, 8, segment.tick0);
+    tickStorePut<qint64>(entry, 16, segment.nTicks);
+    tickStorePutDouble(entry, 24, segment.t0);
+    tickStorePutDouble(entry, 32, segment.t1);
+    tickStorePut<qint64>(count, 0, segment.id + 1);
+    if (!index.seek(headerSize + segment.id * tickStoreEntrySize) || (index.write(reinterpret_cast<const char *>(entry), tickStoreEntrySize) != tickStoreEntrySize) ||
+        !index.flush() || !index.seek(TickStoreNumberOfSegments) || (index.write(reinterpret_cast<const char *>(count), 8) != 8) || !index.flush())
+        return fail("Cannot write " + index.fileName() + ".");
+
+    segments.push_back(segment);
+    size.nTicks += segment.nTicks;
+    extent.p0.t = segments.front().t0;
+    extent.p1.t = t1;
+    return true;
+}
+
+
+/*!
+ * \brief Reads a raster block into a view. Only segments overlapping the ticks of the block are opened.
+ * \param block Pointer to a raster block inside the snapshot.
+ * \param target Pointer to a view with the extents of the block and the cell type of the store.
+ * \param nThreads Number of threads, 0 for default.
+ * \return True, if cells were read.
+ */
+bool TickStore::read(RasterBlock *block, RasterView *target, int nThreads)
+{
+    qint64 iSegment = findSegment(block->tick0);
+
+    if (!isOpen() || !target->isValid() || (target->cellType != cellType) || (iSegment < 0)) return false;
+    if ((block->col0 < 0) || (size.nCols <= block->col1) || (block->row0 < 0) || (size.nRows <= block->row1) ||
+        (block->lay0 < 0) || (size.nLays <= block->lay1) || (block->band0 < 0) || (size.nBands <= block->band1) ||
+        (size.nTicks <= block->tick1)) return false;
+    if ((target->size.nCols != block->getNumberOfColumns()) || (target->size.nRows != block->getNumberOfRows()) ||
+        (target->size.nLays != block->getNumberOfLayers()) || (target->size.nBands != block->getNumberOfBands()) ||
+        (target->size.nTicks != block->getNumberOfTicks())) return false;
+
+    for (; (iSegment < qint64(segments.size())) && (segments[size_t(iSegment)].tick0 <= block->tick1); iSegment++)
+    {
+        const TickSegment &segment = segments[size_t(iSegment)];
+        qint64 tick0 = qMax(block->tick0, segment.tick0), tick1 = qMin(block->tick1, segment.tick0 + segment.nTicks - 1);
+        RasterFile file;
+        RasterBlock inSegment = *block, inTarget;
+        RasterView part;
+
+        inSegment.tick0 = tick0 - segment.tick0;
+        inSegment.tick1 = tick1 - segment.tick0;
+        inTarget.set(0, 0, 0, 0, tick0 - block->tick0, target->size.nCols - 1, target->size.nRows - 1,
+                     target->size.nLays - 1, target->size.nBands - 1, tick1 - block->tick0);
+        part = target->crop(&inTarget);
+        if (!file.open(getSegmentFileName(segment.id)) || !file.read(&inSegment, &part, nThreads))
+        {
+            errorString = "Cannot read " + getSegmentFileName(segment.id) + ".";
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/*!
+ * \brief Finds the ticks with times inside a time range. Segments are searched by binary search, so
+ *        the ticks can be read by read() touching only the segments of the range.
+ * \param t0 Start of the time range.
+ * \param t1 End of the time range.
+ * \param tick0 Output index of the first tick with time not less than t0.
+ * \param tick1 Output index of the last tick with time not greater than t1.
+ * \return True, if the range contains at least one tick.
+ */
+bool TickStore::findTicks(double t0, double t1, qint64 *tick0, qint64 *tick1)
+{
+    qint64 lo = 0, hi = size.nTicks;
+
+    if (!isOpen() || (size.nTicks == 0) || !(t0 <= t1)) return false;
+
+    // first tick with time >= t0
+    while (lo < hi)
+    {
+        qint64 mid = (lo + hi) / 2;
+        if (getTickTime(mid) < t0) lo = mid + 1;
+        else hi = mid;
+    }
+    *tick0 = lo;
+
+    // first tick with time > t1
+    hi = size.nTicks;
+    while (lo < hi)
+    {
+        qint64 mid = (lo + hi) / 2;
+        if (getTickTime(mid) <= t1) lo = mid + 1;
+        else hi = mid;
+    }
+    *tick1 = lo - 1;
+    return *tick0 <= *tick1;
+}
@@ -0,0 +1,99 @@
+#ifndef TICKSTORE_H
+#define TICKSTORE_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file tickstore.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <vector>
+#include <QFile>
+#include <QString>
+#include "g3dtcore_global.h"
+#include "Geometry/box3dt.h"
+#include "Geometry/rasterblock.h"
+#include "Geometry/rastersize3dt.h"
+#include "rastercell.h"
+#include "rasterview.h"
+
+
+/*!
+ * \brief A group of ticks appended at once and stored in one segment file.
+ */
+struct TickSegment
+{
+    qint64 id; //!< segment number, part of the file name
+    qint64 tick0; //!< index of the first tick
+    qint64 nTicks; //!< number of ticks
+    double t0; //!< time of the first tick
+    double t1; //!< time of the last tick
+};
+
+
+/*!
+ * \brief The TickStore is a raster growing along the tick axis, stored as a directory of segments.
+ *
+ *        Every append() writes its ticks to a new segment (a RasterFile) and then adds the segment to an
+ *        append-only index file, so appending costs the size of the appended ticks only and the volume is
+ *        never rewritten. The index header holds the number of segments, which is updated after the segment
+ *        and its index entry are complete; readers therefore always see a consistent snapshot of whole
+ *        segments and may run concurrently with a single writer. refresh() picks up ticks appended since
+ *        the store was opened.
+ *
+ *        Ticks of a segment are evenly spaced between its first and last time; times must increase.
+ *        Reads only open the segments overlapping the requested ticks or time range.
+ */
+class G3DTCORE_EXPORT TickStore
+{
+public:
+    RasterSize3DT size; //!< raster size, nTicks is the number of ticks of the snapshot
+    RasterSize3DT brickSize; //!< brick shape of segment files
+    Box3DT extent; //!< raster extent, t-coordinates are times of the first and last tick
+    RasterCell::Type cellType; //!< cell type
+    RasterView::Interleave interleave; //!< band interleave inside bricks
+    bool useNoData; //!< noData is defined
+    double noData; //!< NoData value
+    QString errorString; //!< description of the last error
+
+public:
+    TickStore();
+    ~TickStore();
+
+    bool create(QString directory);
+    bool open(QString directory, bool writable = false);
+    bool refresh();
+    void close();
+    bool isOpen();
+
+    qint64 getNumberOfTicks();
+    qint64 getNumberOfSegments();
+    TickSegment getSegment(qint64 iSegment);
+    double getTickTime(qint64 tick);
+    QString getSegmentFileName(qint64 id);
+
+    bool append(RasterView *source, double t0, double t1, int nThreads = 0);
+    bool read(RasterBlock *block, RasterView *target, int nThreads = 0);
+    bool findTicks(double t0, double t1, qint64 *tick0, qint64 *tick1);
+
+    static const qint64 headerSize = 256; //!< size of the index header in bytes
+
+private:
+    QString directory;
+    QFile index;
+    bool writable;
+    std::vector<TickSegment> segments;
+
+    bool fail(QString message);
+    bool readIndex(bool withHeader);
+    qint64 findSegment(qint64 tick);
+};
+
+#endif // TICKSTORE_H
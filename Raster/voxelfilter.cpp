@@ -0,0 +1,461 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file voxelfilter.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <float.h>
+#include <math.h>
+#include "voxelfilter.h"
+#include "g3dtparallel.h"
+
+
+/*!
+ * \brief Voxel key and index of an input point.
+ */
+struct VoxelFilterEntry
+{
+    quint64 key;
+    qint64 iPoint;
+};
+
+
+/*!
+ * \brief Point source reading an array of 3DT point objects.
+ */
+struct VoxelFilterObjectSource
+{
+    Point3DT *points;
+
+    inline double x(qint64 i) { return points[i].x; }
+    inline double y(qint64 i) { return points[i].y; }
+    inline double z(qint64 i) { return points[i].z; }
+    inline double t(qint64 i) { return points[i].t; }
+};
+
+
+/*!
+ * \brief Point source reading separate coordinate arrays (structure of arrays).
+ */
+struct VoxelFilterArraySource
+{
+    const double *px, *py, *pz, *pt;
+
+    inline double x(qint64 i) { return px[i]; }
+    inline double y(qint64 i) { return py[i]; }
+    inline double z(qint64 i) { return pz ? pz[i] : 0.0; }
+    inline double t(qint64 i) { return pt ? pt[i] : 0.0; }
+};
+
+
+/*!
+ * \brief Tests whether all coordinates of a point are finite.
+ */
+template <class Source>
+static inline bool voxelFilterIsFinite(Source &source, qint64 i)
+{
+    return qIsFinite(source.x(i)) && qIsFinite(source.y(i)) && qIsFinite(source.z(i)) && qIsFinite(source.t(i));
+}
+
+
+/*!
+ * \brief Returns the number of voxels along an axis, 0 if the extent holds too many voxels to index.
+ */
+static quint64 voxelFilterCount(double length, double size)
+{
+    double n = floor(length / size);
+
+    if (!(n < 4611686018427387904.0)) return 0;
+    return quint64(n) + 1;
+}
+
+
+/*!
+ * \brief Returns the number of bits needed to store a non-negative value.
+ */
+static int voxelFilterBits(quint64 value)
+{
+    int n = 0;
+    while (value)
+    {
+        n++;
+        value >>= 1;
+    }
+    return n;
+}
+
+
+/*!
+ * \brief Stable parallel LSD radix sort of entries by the lowest nBits bits of their keys.
+ *        Each pass builds per-chunk digit histograms, computes digit-major offsets and scatters chunks in parallel.
+ * \return False, if sorting was cancelled; entries are then in an unspecified order.
+ */
+static bool voxelFilterRadixSort(std::vector<VoxelFilterEntry> &entries, int nBits, int nThreads)
+{
+    const int digitBits = 8;
+    const qint64 nDigits = qint64(1) << digitBits;
+    qint64 n = qint64(entries.size());
+    qint64 nChunks = qMax(qint64(1), qMin(qint64(nThreads) * 4, n / 4096));
+    qint64 chunkSize = (n + nChunks - 1) / nChunks;
+    std::vector<VoxelFilterEntry> buffer(entries.size());
+    std::vector<qint64> offsets(size_t(nChunks * nDigits));
+    VoxelFilterEntry *src = entries.data();
+    VoxelFilterEntry *dst = buffer.data();
+
+    for (int shift = 0; shift < nBits; shift += digitBits)
+    {
+        std::fill(offsets.begin(), offsets.end(), 0);
+
+        if (!G3DTParallel::forEach(nChunks, [&](qint64 iChunk) {
+            qint64 *histogram = offsets.data() + iChunk * nDigits;
+            qint64 i0 = qMin(iChunk * chunkSize, n);
+            qint64 i1 = qMin(i0 + chunkSize, n);
+            for (qint64 i = i0; i < i1; i++)
+                histogram[(src[i].key >> shift) & quint64(nDigits - 1)]++;
+        }, nThreads)) return false;
+
+        qint64 total = 0;
+        for (qint64 iDigit = 0; iDigit < nDigits; iDigit++)
+        {
+            for (qint64 iChunk = 0; iChunk < nChunks; iChunk++)
+            {
+                qint64 c = offsets[size_t(iChunk * nDigits + iDigit)];
+                offsets[size_t(iChunk * nDigits + iDigit)] = total;
+                total += c;
+            }
+        }
+
+        if (!G3DTParallel::forEach(nChunks, [&](qint64 iChunk) {
+            qint64 *cursor = offsets.data() + iChunk * nDigits;
+            qint64 i0 = qMin(iChunk * chunkSize, n);
+            qint64 i1 = qMin(i0 + chunkSize, n);
+            for (qint64 i = i0; i < i1; i++)
+                dst[cursor[(src[i].key >> shift) & quint64(nDigits - 1)]++] = src[i];
+        }, nThreads)) return false;
+
+        std::swap(src, dst);
+    }
+
+    if (src != entries.data())
+        entries.swap(buffer);
+    return true;
+}
+
+
+/*!
+ * \brief Default constructor.
+ */
+VoxelFilter::VoxelFilter()
+{
+    voxelSizeX = voxelSizeY = voxelSizeZ = 1.0;
+    representative = RepresentativeCentroid;
+    nThreads = 0;
+}
+
+
+/*!
+ * \brief Sets the edge length of cubic voxels.
+ * \param size Voxel edge length.
+ */
+void VoxelFilter::setVoxelSize(double size)
+{
+    setVoxelSize(size, size, size);
+}
+
+
+/*!
+ * \brief Sets the voxel size.
+ * \param sizeX Voxel size in the x-direction.
+ * \param sizeY Voxel size in the y-direction.
+ * \param sizeZ Voxel size in the z-direction.
+ */
+void VoxelFilter::setVoxelSize(double sizeX, double sizeY, double sizeZ)
+{
+    voxelSizeX = sizeX;
+    voxelSizeY = sizeY;
+    voxelSizeZ = sizeZ;
+}
+
+
+/*!
+ * \brief Stores an error description.
+ * \return Always false.
+ */
+bool VoxelFilter::fail(QString message)
+{
+    errorString = message;
+    return false;
+}
+
+
+/*!
+ * \brief Releases output arrays and stores the description of a cancelled filtering.
+ * \return Always false.
+ */
+bool VoxelFilter::failCancelled()
+{
+    destroy();
+    return fail("Filtering was cancelled.");
+}
+
+
+/*!
+ * \brief Releases output arrays.
+ */
+void VoxelFilter::destroy()
+{
+    std::vector<Point3DT>().swap(points);
+    std::vector<Index3D>().swap(voxels);
+    std::vector<qint64>().swap(counts);
+    std::vector<Box3DT>().swap(extents);
+    extent.empty();
+}
+
+
+/*!
+ * \return Number of non-empty voxels produced by the last filtering.
+ */
+qint64 VoxelFilter::getNumberOfVoxels()
+{
+    return qint64(points.size());
+}
+
+
+/*!
+ * \brief Decimates an array of 3DT points.
+ * \param points Pointer to an array of points.
+ * \param nPoints Number of points.
+ * \return True, if points were filtered. False for invalid voxel sizes, too many voxels to key in 63 bits
+ *         or if the current G3DTCancelToken stopped filtering; errorString describes the error and outputs are empty.
+ */
+bool VoxelFilter::filter(Point3DT *points, qint64 nPoints)
+{
+    VoxelFilterObjectSource source;
+
+    source.points = points;
+    return filterPoints(source, nPoints);
+}
+
+
+/*!
+ * \brief Decimates points stored in separate coordinate arrays.
+ * \param x Array of x-coordinates.
+ * \param y Array of y-coordinates.
+ * \param z Array of z-coordinates, or null for 0.
+ * \param t Array of t-coordinates, or null for 0.
+ * \param nPoints Number of points.
+ * \return True, if points were filtered. False for invalid voxel sizes, too many voxels to key in 63 bits
+ *         or if the current G3DTCancelToken stopped filtering; errorString describes the error and outputs are empty.
+ */
+bool VoxelFilter::filter(const double *x, const double *y, const double *z, const double *t, qint64 nPoints)
+{
+    VoxelFilterArraySource source;
+
+    source.px = x;
+    source.py = y;
+    source.pz = z;
+    source.pt = t;
+    return filterPoints(source, nPoints);
+}
+
+
+/*!
+ * \brief Computes voxel keys, groups points by a radix sort and reduces every voxel.
+ *        Points with a non-finite coordinate are skipped.
+ */
+template <class Source>
+bool VoxelFilter::filterPoints(Source &source, qint64 nPoints)
+{
+    int n = (nThreads <= 0) ? G3DTParallel::getNumberOfThreads() : nThreads;
+    qint64 nChunks = qMax(qint64(1), qMin(qint64(n) * 4, nPoints / 4096));
+    qint64 chunkSize;
+    std::vector<Box3DT> chunkExtents;
+    std::vector<qint64> chunkEntries;
+    std::vector<VoxelFilterEntry> entries;
+    std::vector<qint64> runStarts;
+    std::vector<qint64> chunkRuns;
+    quint64 nx, ny, nz;
+    int bx, by, bz;
+    qint64 nEntries, nVoxels;
+
+    destroy();
+    errorString.clear();
+    if (!(0.0 < voxelSizeX) || !(0.0 < voxelSizeY) || !(0.0 < voxelSizeZ) || !qIsFinite(voxelSizeX) || !qIsFinite(voxelSizeY) ||
+        !qIsFinite(voxelSizeZ))
+        return fail("Voxel sizes must be positive and finite.");
+    if (nPoints <= 0) return true;
+    chunkSize = (nPoints + nChunks - 1) / nChunks;
+
+    // extent and number of input points with finite coordinates
+    chunkExtents.resize(size_t(nChunks));
+    chunkEntries.assign(size_t(nChunks + 1), 0);
+    if (!G3DTParallel::forEach(nChunks, [&](qint64 iChunk) {
+        qint64 i0 = qMin(iChunk * chunkSize, nPoints);
+        qint64 i1 = qMin(i0 + chunkSize, nPoints);
+        qint64 c = 0;
+        double x0 = DBL_MAX, y0 = DBL_MAX, z0 = DBL_MAX, t0 = DBL_MAX;
+        double x1 = -DBL_MAX, y1 = -DBL_MAX, z1 = -DBL_MAX, t1 = -DBL_MAX;
+        for (qint64 i = i0; i < i1; i++)
+        {
+            if (!voxelFilterIsFinite(source, i)) continue;
+            double x = source.x(i), y = source.y(i), z = source.z(i), t = source.t(i);
+            c++;
+            if (x < x0) x0 = x;
+            if (x1 < x) x1 = x;
+            if (y < y0) y0 = y;
+            if (y1 < y) y1 = y;
+            if (z < z0) z0 = z;
+            if (z1 < z) z1 = z;
+            if (t < t0) t0 = t;
+            if (t1 < t) t1 = t;
+        }
+        chunkExtents[size_t(iChunk)].set(x0, y0, z0, t0, x1, y1, z1, t1);
+        chunkEntries[size_t(iChunk + 1)] = c;
+    }, n)) return failCancelled();
+    for (size_t i = 0; i < chunkExtents.size(); i++)
+        if (0 < chunkEntries[i + 1]) extent.include(&chunkExtents[i]);
+    for (qint64 iChunk = 0; iChunk < nChunks; iChunk++)
+        chunkEntries[size_t(iChunk + 1)] += chunkEntries[size_t(iChunk)];
+    nEntries = chunkEntries[size_t(nChunks)];
+    if (nEntries == 0) return true;
+
+    // key layout: column bits, then row bits, then layer bits
+    nx = voxelFilterCount(extent.getLengthX(), voxelSizeX);
+    ny = voxelFilterCount(extent.getLengthY(), voxelSizeY);
+    nz = voxelFilterCount(extent.getLengthZ(), voxelSizeZ);
+    if ((nx == 0) || (ny == 0) || (nz == 0)) return fail("Too many voxels to index.");
+    bx = voxelFilterBits(nx - 1);
+    by = voxelFilterBits(ny - 1);
+    bz = voxelFilterBits(nz - 1);
+    if (63 < bx + by + bz) return fail("Too many voxels to index.");
+
+    entries.resize(size_t(nEntries));
+    if (!G3DTParallel::forEach(nChunks, [&](qint64 iChunk) {
+        qint64 i0 = qMin(iChunk * chunkSize, nPoints);
+        qint64 i1 = qMin(i0 + chunkSize, nPoints);
+        qint64 iEntry = chunkEntries[size_t(iChunk)];
+        quint64 ix, iy, iz;
+        for (qint64 i = i0; i < i1; i++)
+        {
+            if (!voxelFilterIsFinite(source, i)) continue;
+            ix = quint64((source.x(i) - extent.p0.x) / voxelSizeX);
+            iy = quint64((source.y(i) - extent.p0.y) / voxelSizeY);
+            iz = quint64((source.z(i) - extent.p0.z) / voxelSizeZ);
+            if (nx <= ix) ix = nx - 1;
+            if (ny <= iy) iy = ny - 1;
+            if (nz <= iz) iz = nz - 1;
+            entries[size_t(iEntry)].key = ix | (iy << bx) | (iz << (bx + by));
+            entries[size_t(iEntry)].iPoint = i;
+            iEntry++;
+        }
+    }, n)) return failCancelled();
+
+    if (!voxelFilterRadixSort(entries, bx + by + bz, n)) return failCancelled();
+
+    // group-by: starts of runs of equal keys
+    chunkSize = (nEntries + nChunks - 1) / nChunks;
+    chunkRuns.assign(size_t(nChunks + 1), 0);
+    if (!G3DTParallel::forEach(nChunks, [&](qint64 iChunk) {
+        qint64 i0 = qMin(iChunk * chunkSize, nEntries);
+        qint64 i1 = qMin(i0 + chunkSize, nEntries);
+        qint64 c = 0;
+        for (qint64 i = i0; i < i1; i++)
+            if ((i == 0) || (entries[size_t(i)].key != entries[size_t(i - 1)].key)) c++;
+        chunkRuns[size_t(iChunk + 1)] = c;
+    }, n)) return failCancelled();
+    for (qint64 iChunk = 0; iChunk < nChunks; iChunk++)
+        chunkRuns[size_t(iChunk + 1)] += chunkRuns[size_t(iChunk)];
+    nVoxels = chunkRuns[size_t(nChunks)];
+
+    runStarts.resize(size_t(nVoxels + 1));
+    runStarts[size_t(nVoxels)] = nEntries;
+    if (!G3DTParallel::forEach(nChunks, [&](qint64 iChunk) {
+        qint64 i0 = qMin(iChunk * chunkSize, nEntries);
+        qint64 i1 = qMin(i0 + chunkSize, nEntries);
+        qint64 iRun = chunkRuns[size_t(iChunk)];
+        for (qint64 i = i0; i < i1; i++)
+            if ((i == 0) || (entries[size_t(i)].key != entries[size_t(i - 1)].key)) runStarts[size_t(iRun++)] = i;
+    }, n)) return failCancelled();
+
+    // per-voxel reduction
+    this->points.resize(size_t(nVoxels));
+    this->voxels.resize(size_t(nVoxels));
+    this->counts.resize(size_t(nVoxels));
+    this->extents.resize(size_t(nVoxels));
+
+    const qint64 rangeSize = 4096;
+    if (!G3DTParallel::forEach((nVoxels + rangeSize - 1) / rangeSize, [&](qint64 iRange) {
+        qint64 iVoxel0 = iRange * rangeSize;
+        qint64 iVoxel1 = qMin(iVoxel0 + rangeSize, nVoxels);
+        quint64 maskX = (quint64(1) << bx) - 1;
+        quint64 maskY = (quint64(1) << by) - 1;
+
+        for (qint64 iVoxel = iVoxel0; iVoxel < iVoxel1; iVoxel++)
+        {
+            qint64 iEntry0 = runStarts[size_t(iVoxel)];
+            qint64 iEntry1 = runStarts[size_t(iVoxel + 1)];
+            quint64 key = entries[size_t(iEntry0)].key;
+            Box3DT *box = &this->extents[size_t(iVoxel)];
+            double cx = 0.0, cy = 0.0, cz = 0.0, ct = 0.0;
+            qint64 iBest = entries[size_t(iEntry0)].iPoint;
+            double best;
+            qint64 i;
+
+            box->empty();
+            for (qint64 iEntry = iEntry0; iEntry < iEntry1; iEntry++)
+            {
+                i = entries[size_t(iEntry)].iPoint;
+                box->include(source.x(i), source.y(i), source.z(i), source.t(i));
+                cx += source.x(i);
+                cy += source.y(i);
+                cz += source.z(i);
+                ct += source.t(i);
+            }
+            cx /= double(iEntry1 - iEntry0);
+            cy /= double(iEntry1 - iEntry0);
+            cz /= double(iEntry1 - iEntry0);
+            ct /= double(iEntry1 - iEntry0);
+
+            if (representative == RepresentativeCentroid)
+            {
+                this->points[size_t(iVoxel)].set(cx, cy, cz, ct);
+            }
+            else
+            {
+                best = -DBL_MAX;
+                for (qint64 iEntry = iEntry0; iEntry < iEntry1; iEntry++)
+                {
+                    double score;
+                    i = entries[size_t(iEntry)].iPoint;
+                    if (representative == RepresentativeLatest)
+                    {
+                        score = source.t(i);
+                    }
+                    else
+                    {
+                        double dx = source.x(i) - cx, dy = source.y(i) - cy, dz = source.z(i) - cz;
+                        score = -(dx * dx + dy * dy + dz * dz);
+                    }
+                    if (best <= score)
+                    {
+                        best = score;
+                        iBest = i;
+                    }
+                }
+                this->points[size_t(iVoxel)].set(source.x(iBest), source.y(iBest), source.z(iBest), source.t(iBest));
+            }
+
+            this->voxels[size_t(iVoxel)].set(qint64(key & maskX), qint64((key >> bx) & maskY), qint64(key >> (bx + by)), 0);
+            this->counts[size_t(iVoxel)] = iEntry1 - iEntry0;
+        }
+    }, n)) return failCancelled();
+
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef VOXELFILTER_H
+#define VOXELFILTER_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file voxelfilter.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <vector>
+#include <QString>
+#include "g3dtcore_global.h"
+#include "Geometry/box3dt.h"
+#include "Geometry/index3d.h"
+
+
+/*!
+ * \brief The VoxelFilter decimates a point cloud by keeping one representative point per voxel.
+ *        Points are keyed by their voxel index, grouped by a parallel LSD radix sort and reduced per voxel.
+ *        Output voxels are ordered by layer, row and column; voxel indexes are relative to the input extent.
+ *        Points with a non-finite coordinate are skipped.
+ */
+class G3DTCORE_EXPORT VoxelFilter
+{
+public:
+    enum Representative
+    {
+        RepresentativeCentroid, //!< mean of all points in the voxel
+        RepresentativeNearestToCentroid, //!< input point nearest to the voxel centroid (in 3D)
+        RepresentativeLatest //!< input point with the greatest t-coordinate
+    };
+
+    double voxelSizeX; //!< voxel size in the x-direction
+    double voxelSizeY; //!< voxel size in the y-direction
+    double voxelSizeZ; //!< voxel size in the z-direction
+    Representative representative; //!< representative point of a voxel
+    int nThreads; //!< number of threads, 0 for default
+
+    Box3DT extent; //!< extent of input points, origin of voxel indexes
+    std::vector<Point3DT> points; //!< representative point per voxel
+    std::vector<Index3D> voxels; //!< voxel index per voxel
+    std::vector<qint64> counts; //!< number of input points per voxel
+    std::vector<Box3DT> extents; //!< extent of input points per voxel
+    QString errorString; //!< description of the last error
+
+public:
+    VoxelFilter();
+
+    void setVoxelSize(double size);
+    void setVoxelSize(double sizeX, double sizeY, double sizeZ);
+    void destroy();
+
+    bool filter(Point3DT *points, qint64 nPoints);
+    bool filter(const double *x, const double *y, const double *z, const double *t, qint64 nPoints);
+
+    qint64 getNumberOfVoxels();
+
+private:
+    bool fail(QString message);
+    bool failCancelled();
+    template <class Source> bool filterPoints(Source &source, qint64 nPoints);
+};
+
+#endif // VOXELFILTER_H
@@ -0,0 +1,230 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file g3dtcanceltoken.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <chrono>
+#include <QString>
+#include "g3dtcanceltoken.h"
+#include "g3dtexecutor.h"
+
+
+/*!
+ * \brief Token of the job running on the calling thread.
+ */
+static thread_local G3DTCancelToken *g3dtCancelTokenCurrent = nullptr;
+
+
+/*!
+ * \brief Set while a paused thread runs other tasks, so that it does not nest further while paused.
+ */
+static thread_local bool g3dtCancelTokenHelping = false;
+
+
+/*!
+ * \return Steady clock time in nanoseconds.
+ */
+static qint64 g3dtCancelTokenNow()
+{
+    return qint64(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+
+G3DTCancelToken::G3DTCancelToken()
+    : state(Active), deadline(0), paused(false)
+{
+}
+
+
+/*!
+ * \brief Makes the token active again: clears cancellation, deadline and pause.
+ */
+void G3DTCancelToken::reset()
+{
+    state = Active;
+    deadline = 0;
+    resume();
+}
+
+
+/*!
+ * \brief Requests the job to stop. Paused work wakes up and stops.
+ */
+void G3DTCancelToken::cancel()
+{
+    int active = Active;
+
+    state.compare_exchange_strong(active, Cancelled);
+    std::lock_guard<std::mutex> lock(mutex);
+    resumed.notify_all();
+}
+
+
+/*!
+ * \brief Sets a deadline after which check() fails.
+ * \param msecs Time from now in milliseconds.
+ */
+void G3DTCancelToken::setDeadline(qint64 msecs)
+{
+    deadline = qMax(g3dtCancelTokenNow() + qMax(msecs, qint64(0)) * 1000000, qint64(1));
+}
+
+
+/*!
+ * \brief Removes the deadline.
+ */
+void G3DTCancelToken::clearDeadline()
+{
+    deadline = 0;
+}
+
+
+/*!
+ * \return Milliseconds to the deadline (0 if it passed), -1 without a deadline.
+ */
+qint64 G3DTCancelToken::getRemainingTime()
+{
+    qint64 d = deadline;
+
+    if (d == 0) return -1;
+    return qMax(d - g3dtCancelTokenNow(), qint64(0)) / 1000000;
+}
+
+
+/*!
+ * \brief Pauses work at its next check().
+ */
+void G3DTCancelToken::pause()
+{
+    paused = true;
+}
+
+
+/*!
+ * \brief Resumes paused work.
+ */
+void G3DTCancelToken::resume()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    paused = false;
+    resumed.notify_all();
+}
+
+
+/*!
+ * \return True, if the token is paused.
+ */
+bool G3DTCancelToken::isPaused()
+{
+    return paused;
+}
+
+
+/*!
+ * \return State of the token; a passed deadline is reported as Expired.
+ */
+G3DTCancelToken::State G3DTCancelToken::getState()
+{
+    qint64 d = deadline;
+
+    if ((state == Active) && (d != 0) && (d <= g3dtCancelTokenNow()))
+    {
+        int active = Active;
+        state.compare_exchange_strong(active, Expired);
+    }
+    return State(int(state));
+}
+
+
+/*!
+ * \return True, if the token was cancelled or its deadline passed.
+ */
+bool G3DTCancelToken::isStopped()
+{
+    return getState() != Active;
+}
+
+
+/*!
+ * \brief Checks whether work may continue; waits while the token is paused.
+ * \return False, if the token was cancelled or its deadline passed.
+ */
+bool G3DTCancelToken::check()
+{
+    if (paused) waitWhilePaused();
+    return getState() == Active;
+}
+
+
+/*!
+ * \brief Waits until resumed, cancelled or expired. Executor threads run other queued tasks meanwhile.
+ */
+void G3DTCancelToken::waitWhilePaused()
+{
+    G3DTExecutor *executor = G3DTExecutor::getGlobal();
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (paused && (getState() == Active))
+    {
+        if (!g3dtCancelTokenHelping && (0 <= G3DTExecutor::getCurrentThread()))
+        {
+            bool ran;
+            G3DTCancelToken *current = setCurrent(nullptr);
+
+            lock.unlock();
+            g3dtCancelTokenHelping = true;
+            ran = executor->runPending();
+            g3dtCancelTokenHelping = false;
+            setCurrent(current);
+            lock.lock();
+            if (ran) continue;
+        }
+        resumed.wait_for(lock, std::chrono::milliseconds(10));
+    }
+}
+
+
+/*!
+ * \return Token of the job running on the calling thread, nullptr if none.
+ */
+G3DTCancelToken *G3DTCancelToken::getCurrent()
+{
+    return g3dtCancelTokenCurrent;
+}
+
+
+/*!
+ * \brief Sets the token of the job running on the calling thread.
+ * \param token Token, may be nullptr.
+ * \return Previous token of the thread.
+ */
+G3DTCancelToken *G3DTCancelToken::setCurrent(G3DTCancelToken *token)
+{
+    G3DTCancelToken *previous = g3dtCancelTokenCurrent;
+    g3dtCancelTokenCurrent = token;
+    return previous;
+}
+
+
+/*!
+ * \param state Token state.
+ * \return Name of the state.
+ */
+QString G3DTCancelToken::toString(State state)
+{
+    switch (state)
+    {
+    case Active: return "Active";
+    case Cancelled: return "Cancelled";
+    case Expired: return "Expired";
+    }
+    return "Unknown";
+}
@@ -0,0 +1,75 @@
+#ifndef G3DTCANCELTOKEN_H
+#define G3DTCANCELTOKEN_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file g3dtcanceltoken.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <QString>
+#include "g3dtcore_global.h"
+
+
+/*!
+ * \brief The G3DTCancelToken stops or pauses a job cooperatively.
+ *
+ *        Work checks the token by check() at block granularity: it returns false once the token was cancelled
+ *        or its deadline passed, and blocks while the token is paused. A paused executor thread runs other
+ *        queued tasks meanwhile, so paused jobs yield their threads to other jobs.
+ *
+ *        The token of the running job is the current token of the thread (setCurrent()); G3DTParallel loops
+ *        check the current token before every item and pass it on to their helper threads.
+ */
+class G3DTCORE_EXPORT G3DTCancelToken
+{
+public:
+    enum State
+    {
+        Active = 0, //!< work may continue
+        Cancelled = 1, //!< cancel() was called
+        Expired = 2 //!< the deadline passed
+    };
+
+public:
+    G3DTCancelToken();
+
+    void reset();
+    void cancel();
+    void setDeadline(qint64 msecs);
+    void clearDeadline();
+    qint64 getRemainingTime();
+
+    void pause();
+    void resume();
+    bool isPaused();
+
+    State getState();
+    bool isStopped();
+    bool check();
+
+    static G3DTCancelToken *getCurrent();
+    static G3DTCancelToken *setCurrent(G3DTCancelToken *token);
+    static QString toString(State state);
+
+private:
+    std::atomic<int> state;
+    std::atomic<qint64> deadline; //!< steady clock time in nanoseconds, 0 for none
+    std::atomic<bool> paused;
+    std::mutex mutex;
+    std::condition_variable resumed;
+
+    void waitWhilePaused();
+};
+
+#endif // G3DTCANCELTOKEN_H
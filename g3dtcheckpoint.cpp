@@ -0,0 +1,414 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file g3dtcheckpoint.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <string.h>
+#include <QSaveFile>
+#include <QtEndian>
+#include "g3dtcheckpoint.h"
+
+#if defined(Q_OS_UNIX)
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <io.h>
+#endif
+
+
+/*!
+ * \brief Journal signature and format version.
+ */
+static const char g3dtCheckpointMagic[8] = {'G', '3', 'D', 'T', 'C', 'K', 'P', 'T'};
+static const quint32 g3dtCheckpointVersion = 1;
+
+
+/*!
+ * \brief Journal header: char[8] magic, quint32 version, quint32 reserved, qint64 number of blocks, quint64 schedule hash.
+ */
+static const qint64 g3dtCheckpointHeaderSize = 32;
+
+
+/*!
+ * \brief Record header: qint64 number of completed blocks, qint64 state size. It is followed by the block
+ *        indexes (qint64 each), the state and a quint64 checksum of the record.
+ */
+static const qint64 g3dtCheckpointRecordHeaderSize = 16;
+
+
+/*!
+ * \brief Journals shorter than this are never compacted.
+ */
+static const qint64 g3dtCheckpointCompactSize = 1024 * 1024;
+
+
+/*!
+ * \brief FNV-1a hash.
+ */
+static quint64 g3dtCheckpointHash(const uchar *data, qint64 size, quint64 hash = 14695981039346656037ULL)
+{
+    for (qint64 i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+/*!
+ * \brief Flushes a file and forces its data to disk.
+ */
+static bool g3dtCheckpointSync(QFileDevice *file)
+{
+    if (!file->flush()) return false;
+#if defined(Q_OS_UNIX)
+    return ::fsync(file->handle()) == 0;
+#elif defined(Q_OS_WIN)
+    return ::_commit(file->handle()) == 0;
+#else
+    return true;
+#endif
+}
+
+
+static void g3dtCheckpointWriteHeader(uchar *header, qint64 nBlocks, quint64 scheduleHash)
+{
+    memset(header, 0, g3dtCheckpointHeaderSize);
+    memcpy(header, g3dtCheckpointMagic, sizeof(g3dtCheckpointMagic));
+    qToLittleEndian<quint32>(g3dtCheckpointVersion, header + 8);
+    qToLittleEndian<qint64>(nBlocks, header + 16);
+    qToLittleEndian<quint64>(scheduleHash, header + 24);
+}
+
+
+/*!
+ * \brief Encodes a record of completed blocks and the job state.
+ */
+static QByteArray g3dtCheckpointRecord(const std::vector<qint64> &blocks, const QByteArray &state)
+{
+    qint64 size = g3dtCheckpointRecordHeaderSize + 8 * qint64(blocks.size()) + state.size() + 8;
+    QByteArray record(int(size), Qt::Uninitialized);
+    uchar *p = reinterpret_cast<uchar *>(record.data());
+
+    qToLittleEndian<qint64>(qint64(blocks.size()), p);
+    qToLittleEndian<qint64>(state.size(), p + 8);
+    p += g3dtCheckpointRecordHeaderSize;
+    for (size_t i = 0; i < blocks.size(); i++, p += 8) qToLittleEndian<qint64>(blocks[i], p);
+    memcpy(p, state.constData(), size_t(state.size()));
+    p += state.size();
+    qToLittleEndian<quint64>(g3dtCheckpointHash(reinterpret_cast<const uchar *>(record.constData()), size - 8), p);
+    return record;
+}
+
+
+/*!
+ * \brief Default constructor.
+ */
+G3DTCheckpoint::G3DTCheckpoint()
+{
+    interval = 10.0;
+    maxOverhead = 0.01;
+    nCompleted = 0;
+    resumed = false;
+    commitSeconds = 0.0;
+    lastCommitSeconds = 0.0;
+}
+
+
+/*!
+ * \brief Destructor. Commits pending blocks and closes the journal.
+ */
+G3DTCheckpoint::~G3DTCheckpoint()
+{
+    close();
+}
+
+
+/*!
+ * \brief Stores an error description.
+ * \return Always false.
+ */
+bool G3DTCheckpoint::fail(QString message)
+{
+    errorString = message;
+    return false;
+}
+
+
+/*!
+ * \brief Opens the journal of a schedule. Completed blocks and the state of a previous run of the same
+ *        schedule are loaded; a journal of a different schedule is discarded.
+ * \param fileName Journal file name.
+ * \param schedule Blocks of the job; block indexes refer to this vector.
+ * \return True, if the journal was opened.
+ */
+bool G3DTCheckpoint::open(QString fileName, const std::vector<RasterBlock> &schedule)
+{
+    qint64 nBlocks = qint64(schedule.size());
+    quint64 scheduleHash = g3dtCheckpointHash(nullptr, 0);
+    uchar header[g3dtCheckpointHeaderSize], buffer[RasterBlock::binarySize];
+    QByteArray bytes;
+    qint64 position, validEnd;
+
+    close();
+    errorString.clear();
+    setNumberOfBlocks(nBlocks);
+    for (qint64 i = 0; i < nBlocks; i++)
+    {
+        RasterBlock block = schedule[size_t(i)];
+        block.toBinary(buffer);
+        scheduleHash = g3dtCheckpointHash(buffer, RasterBlock::binarySize, scheduleHash);
+    }
+
+    journal.setFileName(fileName);
+    if (!journal.open(QIODevice::ReadWrite)) return fail("Cannot open " + fileName + ".");
+    bytes = journal.readAll();
+    const uchar *data = reinterpret_cast<const uchar *>(bytes.constData());
+
+    g3dtCheckpointWriteHeader(header, nBlocks, scheduleHash);
+    if ((bytes.size() < g3dtCheckpointHeaderSize) || (memcmp(data, header, g3dtCheckpointHeaderSize) != 0))
+    {
+        // new journal, or journal of another schedule
+        if (!journal.resize(0) || !journal.seek(0) ||
+            (journal.write(reinterpret_cast<const char *>(header), g3dtCheckpointHeaderSize) != g3dtCheckpointHeaderSize) ||
+            !g3dtCheckpointSync(&journal))
+        {
+            journal.close();
+            return fail("Cannot write " + fileName + ".");
+        }
+        sinceCommit.start();
+        return true;
+    }
+
+    // replay records up to the first incomplete or damaged one
+    position = validEnd = g3dtCheckpointHeaderSize;
+    while (position + g3dtCheckpointRecordHeaderSize + 8 <= bytes.size())
+    {
+        qint64 nRecordBlocks = qFromLittleEndian<qint64>(data + position);
+        qint64 stateSize = qFromLittleEndian<qint64>(data + position + 8);
+        qint64 remaining = bytes.size() - position - g3dtCheckpointRecordHeaderSize - 8;
+        if ((nRecordBlocks < 0) || (stateSize < 0) || (remaining / 8 < nRecordBlocks) || (remaining - 8 * nRecordBlocks < stateSize)) break;
+        qint64 size = g3dtCheckpointRecordHeaderSize + 8 * nRecordBlocks + stateSize;
+        if (qFromLittleEndian<quint64>(data + position + size) != g3dtCheckpointHash(data + position, size)) break;
+
+        const uchar *p = data + position + g3dtCheckpointRecordHeaderSize;
+        for (qint64 i = 0; i < nRecordBlocks; i++, p += 8)
+        {
+            qint64 iBlock = qFromLittleEndian<qint64>(p);
+            if ((0 <= iBlock) && (iBlock < nBlocks) && !completed[size_t(iBlock)])
+            {
+                completed[size_t(iBlock)] = true;
+                nCompleted++;
+            }
+        }
+        state = QByteArray(reinterpret_cast<const char *>(p), int(stateSize));
+        position += size + 8;
+        validEnd = position;
+        resumed = true;
+    }
+    if ((validEnd < bytes.size()) && !journal.resize(validEnd))
+    {
+        journal.close();
+        return fail("Cannot truncate " + fileName + ".");
+    }
+    journal.seek(validEnd);
+    sinceCommit.start();
+    return true;
+}
+
+
+/*!
+ * \brief Commits pending blocks and closes the journal. Completed blocks are kept until the next open().
+ */
+void G3DTCheckpoint::close()
+{
+    if (journal.isOpen())
+    {
+        commit();
+        journal.close();
+    }
+}
+
+
+/*!
+ * \return True, if a journal is open.
+ */
+bool G3DTCheckpoint::isOpen()
+{
+    return journal.isOpen();
+}
+
+
+/*!
+ * \brief Closes and deletes the journal, e.g. after the results of a finished job were saved.
+ * \return True, if the journal was deleted.
+ */
+bool G3DTCheckpoint::remove()
+{
+    QString fileName = journal.fileName();
+
+    if (journal.isOpen()) journal.close();
+    pending.clear();
+    return !fileName.isEmpty() && QFile::remove(fileName);
+}
+
+
+/*!
+ * \brief Starts tracking a schedule in memory, without a journal.
+ * \param nBlocks Number of blocks.
+ */
+void G3DTCheckpoint::setNumberOfBlocks(qint64 nBlocks)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    completed.assign(size_t(qMax(nBlocks, qint64(0))), false);
+    pending.clear();
+    nCompleted = 0;
+    state.clear();
+    resumed = false;
+    commitSeconds = 0.0;
+    lastCommitSeconds = 0.0;
+}
+
+
+/*!
+ * \return Number of blocks of the schedule.
+ */
+qint64 G3DTCheckpoint::getNumberOfBlocks()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return qint64(completed.size());
+}
+
+
+/*!
+ * \return Number of completed blocks, including blocks completed by previous runs.
+ */
+qint64 G3DTCheckpoint::getNumberOfCompleted()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return nCompleted;
+}
+
+
+/*!
+ * \param iBlock Block index.
+ * \return True, if the block was completed.
+ */
+bool G3DTCheckpoint::isCompleted(qint64 iBlock)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return (0 <= iBlock) && (iBlock < qint64(completed.size())) && completed[size_t(iBlock)];
+}
+
+
+/*!
+ * \return True, if the journal contained committed blocks of a previous run.
+ */
+bool G3DTCheckpoint::isResumed()
+{
+    return resumed;
+}
+
+
+/*!
+ * \return Job state of the last commit, or of the previous run after open().
+ */
+QByteArray G3DTCheckpoint::getState()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return state;
+}
+
+
+/*!
+ * \brief Marks a block as completed; may be called from any thread. The journal is committed when the
+ *        commit interval has elapsed.
+ * \param iBlock Block index. Blocks already completed are ignored.
+ * \param merge Function merging the block result into the job state, or nullptr. It runs under the
+ *        checkpoint lock, so a committed state always contains exactly the committed blocks.
+ */
+void G3DTCheckpoint::complete(qint64 iBlock, std::function<void()> merge)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if ((iBlock < 0) || (qint64(completed.size()) <= iBlock) || completed[size_t(iBlock)]) return;
+    if (merge) merge();
+    completed[size_t(iBlock)] = true;
+    nCompleted++;
+    if (!journal.isOpen()) return;
+    pending.push_back(iBlock);
+    if (double(sinceCommit.nsecsElapsed()) * 1e-9 >= qMax(interval, lastCommitSeconds / maxOverhead)) commitLocked();
+}
+
+
+/*!
+ * \brief Writes pending blocks with the current state to the journal and syncs it.
+ * \return True, if nothing was pending or the record was written.
+ */
+bool G3DTCheckpoint::commit()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return commitLocked();
+}
+
+
+bool G3DTCheckpoint::commitLocked()
+{
+    QElapsedTimer timer;
+    QByteArray record;
+    qint64 compactSize;
+
+    if (!journal.isOpen() || pending.empty()) return true;
+    timer.start();
+    state = saveState ? saveState() : QByteArray();
+    record = g3dtCheckpointRecord(pending, state);
+    if ((journal.write(record) != record.size()) || !g3dtCheckpointSync(&journal)) return fail("Cannot write " + journal.fileName() + ".");
+    pending.clear();
+
+    // rewrite a journal dominated by old states as a single record
+    compactSize = g3dtCheckpointHeaderSize + g3dtCheckpointRecordHeaderSize + 8 * nCompleted + state.size() + 8;
+    if ((g3dtCheckpointCompactSize < journal.size()) && (4 * compactSize < journal.size()))
+    {
+        QString fileName = journal.fileName();
+        QSaveFile file(fileName);
+        uchar header[g3dtCheckpointHeaderSize];
+        std::vector<qint64> blocks;
+
+        journal.seek(0);
+        journal.read(reinterpret_cast<char *>(header), g3dtCheckpointHeaderSize);
+        for (qint64 i = 0; i < qint64(completed.size()); i++)
+            if (completed[size_t(i)]) blocks.push_back(i);
+        record = g3dtCheckpointRecord(blocks, state);
+        if (file.open(QIODevice::WriteOnly) && (file.write(reinterpret_cast<const char *>(header), g3dtCheckpointHeaderSize) == g3dtCheckpointHeaderSize) &&
+            (file.write(record) == record.size()) && g3dtCheckpointSync(&file) && file.commit())
+        {
+            journal.close();
+            if (!journal.open(QIODevice::ReadWrite)) return fail("Cannot open " + fileName + ".");
+        }
+        journal.seek(journal.size());
+    }
+
+    lastCommitSeconds = double(timer.nsecsElapsed()) * 1e-9;
+    commitSeconds += lastCommitSeconds;
+    sinceCommit.restart();
+    return true;
+}
+
+
+/*!
+ * \return Total time spent by commits in seconds.
+ */
+double G3DTCheckpoint::getCommitSeconds()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return commitSeconds;
+}
@@ -0,0 +1,84 @@
+#ifndef G3DTCHECKPOINT_H
+#define G3DTCHECKPOINT_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file g3dtcheckpoint.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+#include "g3dtcore_global.h"
+#include "Geometry/rasterblock.h"
+
+
+/*!
+ * \brief The G3DTCheckpoint records completed blocks of a block schedule in a journal file, so that
+ *        a restarted job skips finished blocks and reloads its partial reductions.
+ *
+ *        The journal starts with a header identifying the schedule; a journal of another schedule is discarded.
+ *        Completed blocks are collected in memory and committed in batches together with the job state
+ *        (saveState), appended as checksummed records and synced to disk. A torn record at the end of the
+ *        journal, left by a crash during a commit, is ignored. Commits are spaced so that their measured
+ *        duration stays below maxOverhead of the run time, but not more often than every interval seconds.
+ *
+ *        Without a journal file (open() not called) blocks are tracked in memory only.
+ */
+class G3DTCORE_EXPORT G3DTCheckpoint
+{
+public:
+    double interval; //!< minimum time between commits in seconds
+    double maxOverhead; //!< maximum fraction of run time spent by commits
+    std::function<QByteArray()> saveState; //!< returns the job state consistent with completed blocks, called on commit
+    QString errorString; //!< description of the last error
+
+public:
+    G3DTCheckpoint();
+    ~G3DTCheckpoint();
+
+    bool open(QString fileName, const std::vector<RasterBlock> &schedule);
+    void close();
+    bool isOpen();
+    bool remove();
+
+    void setNumberOfBlocks(qint64 nBlocks);
+    qint64 getNumberOfBlocks();
+    qint64 getNumberOfCompleted();
+    bool isCompleted(qint64 iBlock);
+    bool isResumed();
+    QByteArray getState();
+
+    void complete(qint64 iBlock, std::function<void()> merge = nullptr);
+    bool commit();
+    double getCommitSeconds();
+
+private:
+    QFile journal;
+    std::mutex mutex;
+    std::vector<bool> completed;
+    std::vector<qint64> pending; //!< completed blocks not yet committed
+    qint64 nCompleted;
+    QByteArray state; //!< state of the last committed record
+    bool resumed;
+    QElapsedTimer sinceCommit;
+    double commitSeconds; //!< total time spent by commits
+    double lastCommitSeconds;
+
+    bool fail(QString message);
+    bool commitLocked();
+};
+
+#endif // G3DTCHECKPOINT_H
@@ -16,6 +16,15 @@
 
 #include "g3dtcore_global.h"
 #include "Geometry/geometry.h"
+#include "Raster/raster.h"
+#include "g3dtcanceltoken.h"
+#include "g3dtcheckpoint.h"
+#include "g3dtexecutor.h"
+#include "g3dtmetrics.h"
+#include "g3dtnuma.h"
+#include "g3dtparallel.h"
+#include "g3dtpipeline.h"
+#include "g3dtprogress.h"
 #include "g3dtworker.h"
 
 #endif // G3DTCORE_H
@@ -0,0 +1,490 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file g3dtexecutor.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <QThread>
+#include "g3dtexecutor.h"
+#include "g3dtnuma.h"
+
+
+/*!
+ * \brief Task queue of an executor thread. The owner takes tasks from the back, thieves from the front.
+ */
+struct G3DTExecutorQueue
+{
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+};
+
+
+/*!
+ * \brief Executor and thread index of the calling thread, -1 outside executor threads.
+ */
+static thread_local G3DTExecutor *g3dtExecutorCurrent = nullptr;
+static thread_local int g3dtExecutorThread = -1;
+
+/*!
+ * \brief True while the calling thread runs a job with a positive priority or one of its tasks.
+ */
+static thread_local bool g3dtExecutorUrgent = false;
+
+
+/*!
+ * \brief Constructor. Starts the threads.
+ * \param nThreads Number of threads, 0 for the number of logical processors.
+ */
+G3DTExecutor::G3DTExecutor(int nThreads)
+    : nPending(0), nSteals(0), nUrgent(0), pinGeneration(0), pinning(false)
+{
+    int nNodes = G3DTNuma::getNumberOfNodes();
+
+    if (nThreads <= 0) nThreads = QThread::idealThreadCount();
+    if (nThreads < 1) nThreads = 1;
+    stopping = false;
+    maxJobs = nThreads;
+    nRunningJobs = 0;
+
+    nodeShared.resize(size_t(nNodes));
+    queues.resize(size_t(nThreads));
+    threadNodes.resize(size_t(nThreads));
+    for (int i = 0; i < nThreads; i++)
+    {
+        queues[size_t(i)] = new G3DTExecutorQueue();
+        threadNodes[size_t(i)] = int(qint64(i) * nNodes / nThreads);
+    }
+    for (int i = 0; i < nThreads; i++)
+        threads.push_back(std::thread(&G3DTExecutor::workLoop, this, i));
+}
+
+
+/*!
+ * \brief Destructor. Runs all submitted tasks and jobs, then stops the threads.
+ */
+G3DTExecutor::~G3DTExecutor()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    available.notify_all();
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    for (size_t i = 0; i < queues.size(); i++)
+        delete queues[i];
+}
+
+
+/*!
+ * \return Number of executor threads.
+ */
+int G3DTExecutor::getNumberOfThreads()
+{
+    return int(threads.size());
+}
+
+
+/*!
+ * \brief Sets the maximum number of concurrently running jobs and starts queued jobs up to it.
+ * \param maxJobs Maximum number of running jobs, 0 for no limit.
+ */
+void G3DTExecutor::setMaxJobs(int maxJobs)
+{
+    std::vector<std::function<void()>> started;
+
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        this->maxJobs = qMax(maxJobs, 0);
+        while (!jobs.empty() && ((this->maxJobs == 0) || (nRunningJobs < this->maxJobs)))
+        {
+            started.push_back(jobs.front().second);
+            jobs.pop_front();
+            nRunningJobs++;
+        }
+    }
+    for (size_t i = 0; i < started.size(); i++)
+        startJob(started[i], false);
+}
+
+
+/*!
+ * \return Maximum number of concurrently running jobs, 0 for no limit.
+ */
+int G3DTExecutor::getMaxJobs()
+{
+    std::lock_guard<std::mutex> lock(jobMutex);
+    return maxJobs;
+}
+
+
+/*!
+ * \return Number of started and not finished jobs.
+ */
+int G3DTExecutor::getNumberOfRunningJobs()
+{
+    std::lock_guard<std::mutex> lock(jobMutex);
+    return nRunningJobs;
+}
+
+
+/*!
+ * \return Number of jobs waiting for a free slot.
+ */
+qint64 G3DTExecutor::getNumberOfQueuedJobs()
+{
+    std::lock_guard<std::mutex> lock(jobMutex);
+    return qint64(jobs.size());
+}
+
+
+/*!
+ * \return Number of tasks taken from queues of other threads.
+ */
+qint64 G3DTExecutor::getNumberOfSteals()
+{
+    return nSteals;
+}
+
+
+/*!
+ * \return Number of NUMA nodes of the threads.
+ */
+int G3DTExecutor::getNumberOfNodes()
+{
+    return int(nodeShared.size());
+}
+
+
+/*!
+ * \param iThread Thread index.
+ * \return NUMA node assigned to the thread.
+ */
+int G3DTExecutor::getThreadNode(int iThread)
+{
+    return threadNodes[size_t(iThread)];
+}
+
+
+/*!
+ * \brief Pins every thread to the processors of its node, or restores the affinity the threads had before.
+ *        Threads apply the change before their next task.
+ * \param pin True to pin threads.
+ */
+void G3DTExecutor::setThreadPinning(bool pin)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pinning = pin;
+        pinGeneration++;
+    }
+    available.notify_all();
+}
+
+
+/*!
+ * \return True, if threads are pinned to their nodes.
+ */
+bool G3DTExecutor::getThreadPinning()
+{
+    return pinning;
+}
+
+
+/*!
+ * \brief Submits a task. Tasks submitted from an executor thread are queued on that thread,
+ *        unless a node is given. Tasks submitted by an interactive job go to the urgent queue.
+ * \param task Task.
+ * \param node Node whose threads should run the task, -1 for any.
+ */
+void G3DTExecutor::submit(std::function<void()> task, int node)
+{
+    enqueue(task, node, g3dtExecutorUrgent && (g3dtExecutorCurrent == this));
+}
+
+
+/*!
+ * \brief Queues a task on the urgent queue, the calling thread, a node or the shared queue.
+ *        Urgent tasks run with the urgent flag, so their subtasks are urgent too.
+ */
+void G3DTExecutor::enqueue(std::function<void()> task, int node, bool isUrgent)
+{
+    bool local;
+
+    if (isUrgent)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            urgent.push_back([task]() {
+                bool previous = g3dtExecutorUrgent;
+                g3dtExecutorUrgent = true;
+                task();
+                g3dtExecutorUrgent = previous;
+            });
+            nUrgent++;
+            nPending++;
+        }
+        available.notify_one();
+        return;
+    }
+
+    if ((int(nodeShared.size()) <= node) || (nodeShared.size() <= 1)) node = -1;
+    local = (g3dtExecutorCurrent == this) && (node < 0);
+    if (local)
+    {
+        G3DTExecutorQueue *queue = queues[size_t(g3dtExecutorThread)];
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->tasks.push_back(task);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (0 <= node) nodeShared[size_t(node)].push_back(task);
+        else if (!local) shared.push_back(task);
+        nPending++;
+    }
+    available.notify_one();
+}
+
+
+/*!
+ * \brief Submits a job. The job starts when fewer than maxJobs jobs are running. A job with a positive
+ *        priority starts at once on the urgent queue: the next idle thread or the next item boundary
+ *        of a running parallel loop runs it.
+ * \param job Job.
+ * \param priority Priority; queued jobs with higher priorities start first.
+ */
+void G3DTExecutor::submitJob(std::function<void()> job, int priority)
+{
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        if ((priority <= 0) && (maxJobs != 0) && (maxJobs <= nRunningJobs))
+        {
+            auto position = jobs.begin();
+            while ((position != jobs.end()) && (priority <= position->first)) ++position;
+            jobs.insert(position, std::make_pair(priority, job));
+            return;
+        }
+        nRunningJobs++;
+    }
+    startJob(job, 0 < priority);
+}
+
+
+/*!
+ * \brief Submits a job holding a job slot; the slot passes to the next queued job when it finishes.
+ * \param isUrgent True to queue the job on the urgent queue.
+ */
+void G3DTExecutor::startJob(std::function<void()> job, bool isUrgent)
+{
+    enqueue([this, job, isUrgent]() {
+        std::function<void()> next;
+        bool previous = g3dtExecutorUrgent;
+
+        g3dtExecutorUrgent = isUrgent;
+        job();
+        g3dtExecutorUrgent = previous;
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            if (!jobs.empty() && ((maxJobs == 0) || (nRunningJobs <= maxJobs)))
+            {
+                next = jobs.front().second;
+                jobs.pop_front();
+            }
+            else
+            {
+                nRunningJobs--;
+            }
+        }
+        if (next) startJob(next, false);
+    }, -1, isUrgent);
+}
+
+
+/*!
+ * \brief Runs one queued task on the calling thread, e.g. while waiting for subtasks.
+ * \return True, if a task was run.
+ */
+bool G3DTExecutor::runPending()
+{
+    std::function<void()> task;
+
+    if (!takeTask((g3dtExecutorCurrent == this) ? g3dtExecutorThread : -1, &task)) return false;
+    task();
+    return true;
+}
+
+
+/*!
+ * \brief Runs one task of the urgent queue on the calling executor thread. Parallel loops call it between items,
+ *        so interactive jobs pre-empt running jobs.
+ * \return True, if a task was run; false on threads of other executors or if there was no urgent task.
+ */
+bool G3DTExecutor::runUrgent()
+{
+    std::function<void()> task;
+
+    if ((nUrgent <= 0) || (g3dtExecutorCurrent != this)) return false;
+    if (!takeUrgent(&task)) return false;
+    task();
+    return true;
+}
+
+
+/*!
+ * \brief Takes a task from the urgent queue.
+ */
+bool G3DTExecutor::takeUrgent(std::function<void()> *task)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (urgent.empty()) return false;
+    *task = urgent.front();
+    urgent.pop_front();
+    nUrgent--;
+    nPending--;
+    return true;
+}
+
+
+/*!
+ * \brief Takes a task from the urgent queue, the own queue, the queue of the own node, the shared queue, queues of other nodes,
+ *        or another thread's queue.
+ * \param iThread Index of the calling executor thread, -1 for other threads.
+ */
+bool G3DTExecutor::takeTask(int iThread, std::function<void()> *task)
+{
+    int nQueues = int(queues.size()), node = 0;
+
+    if (nPending <= 0) return false;
+    if ((0 < nUrgent) && takeUrgent(task)) return true;
+    if (0 <= iThread)
+    {
+        G3DTExecutorQueue *queue = queues[size_t(iThread)];
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        if (!queue->tasks.empty())
+        {
+            *task = queue->tasks.back();
+            queue->tasks.pop_back();
+            nPending--;
+            return true;
+        }
+    }
+    if (0 <= iThread) node = threadNodes[size_t(iThread)];
+    else if (1 < nodeShared.size()) node = G3DTNuma::getCurrentNode();
+    if (takeShared(node, task)) return true;
+    for (int k = 1; k <= nQueues; k++)
+    {
+        int iVictim = (qMax(iThread, 0) + k) % nQueues;
+        G3DTExecutorQueue *queue = queues[size_t(iVictim)];
+
+        if (iVictim == iThread) continue;
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        if (!queue->tasks.empty())
+        {
+            *task = queue->tasks.front();
+            queue->tasks.pop_front();
+            nPending--;
+            nSteals++;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/*!
+ * \brief Takes a task submitted for a node, then a shared task, then a task submitted for another node.
+ * \param node Node of the calling thread.
+ */
+bool G3DTExecutor::takeShared(int node, std::function<void()> *task)
+{
+    int nNodes = int(nodeShared.size());
+    std::lock_guard<std::mutex> lock(mutex);
+    std::deque<std::function<void()>> *queue = nullptr;
+
+    if ((0 <= node) && (node < nNodes) && !nodeShared[size_t(node)].empty()) queue = &nodeShared[size_t(node)];
+    else if (!shared.empty()) queue = &shared;
+    for (int k = 1; !queue && (k < nNodes); k++)
+    {
+        int iNode = (qMax(node, 0) + k) % nNodes;
+        if (!nodeShared[size_t(iNode)].empty())
+        {
+            queue = &nodeShared[size_t(iNode)];
+            nSteals++;
+        }
+    }
+    if (!queue) return false;
+    *task = queue->front();
+    queue->pop_front();
+    nPending--;
+    return true;
+}
+
+
+/*!
+ * \brief Thread loop: runs tasks, sleeps while there are none, exits when stopping and all tasks are done.
+ */
+void G3DTExecutor::workLoop(int iThread)
+{
+    int pinApplied = 0;
+
+    g3dtExecutorCurrent = this;
+    g3dtExecutorThread = iThread;
+
+    for (;;)
+    {
+        std::function<void()> task;
+
+        if (pinApplied != pinGeneration)
+        {
+            pinApplied = pinGeneration;
+            G3DTNuma::pinCurrentThread(pinning ? threadNodes[size_t(iThread)] : -1);
+        }
+        if (takeTask(iThread, &task))
+        {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        available.wait(lock, [this, pinApplied]() { return stopping || (0 < nPending) || (pinApplied != pinGeneration); });
+        if (stopping && (nPending <= 0)) break;
+    }
+}
+
+
+/*!
+ * \return Index of the executor thread the caller runs on, -1 for other threads.
+ */
+int G3DTExecutor::getCurrentThread()
+{
+    return g3dtExecutorThread;
+}
+
+
+/*!
+ * \return NUMA node of the calling thread: the assigned node of an executor thread, otherwise the node
+ *         of the processor it runs on.
+ */
+int G3DTExecutor::getCurrentNode()
+{
+    if (g3dtExecutorCurrent) return g3dtExecutorCurrent->threadNodes[size_t(g3dtExecutorThread)];
+    return G3DTNuma::getCurrentNode();
+}
+
+
+/*!
+ * \brief Returns the process-wide executor with one thread per logical processor.
+ * \return Pointer to the global executor.
+ */
+G3DTExecutor *G3DTExecutor::getGlobal()
+{
+    static G3DTExecutor executor;
+    return &executor;
+}
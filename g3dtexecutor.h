@@ -0,0 +1,109 @@
+#ifndef G3DTEXECUTOR_H
+#define G3DTEXECUTOR_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file g3dtexecutor.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "g3dtcore_global.h"
+
+
+struct G3DTExecutorQueue;
+
+
+/*!
+ * \brief The G3DTExecutor runs tasks on a fixed set of threads with work stealing.
+ *
+ *        Every thread has its own task queue. Tasks submitted from an executor thread go to its queue and
+ *        are taken newest first, keeping nested parallel work local; tasks submitted from other threads
+ *        go to a shared queue. Idle threads take tasks from the shared queue and steal the oldest tasks
+ *        from queues of busy threads. A thread waiting for its own subtasks should help by runPending()
+ *        instead of blocking.
+ *
+ *        Jobs (e.g. G3DTWorker runs) are tasks limited by maxJobs: further jobs wait in a queue and start
+ *        as running jobs finish, so hundreds of submitted jobs share the threads without oversubscription.
+ *        Queued jobs start by descending priority. Jobs with a positive priority (interactive requests) bypass
+ *        maxJobs and pre-empt running jobs at block granularity: they and all tasks they submit go to an urgent
+ *        queue, which idle threads take first and threads of running parallel loops drain by runUrgent()
+ *        between items, so an interactive job does not wait for a batch job holding all threads.
+ *
+ *        On NUMA systems threads are spread evenly over nodes. Tasks submitted for a node go to its queue
+ *        and are preferably taken by threads of that node; setThreadPinning() keeps threads on the processors
+ *        of their nodes, so that node-local memory stays local.
+ *
+ *        getGlobal() returns the executor used by G3DTParallel and G3DTWorker.
+ */
+class G3DTCORE_EXPORT G3DTExecutor
+{
+public:
+    explicit G3DTExecutor(int nThreads = 0);
+    ~G3DTExecutor();
+
+    int getNumberOfThreads();
+    void setMaxJobs(int maxJobs);
+    int getMaxJobs();
+    int getNumberOfRunningJobs();
+    qint64 getNumberOfQueuedJobs();
+    qint64 getNumberOfSteals();
+
+    int getNumberOfNodes();
+    int getThreadNode(int iThread);
+    void setThreadPinning(bool pin);
+    bool getThreadPinning();
+
+    void submit(std::function<void()> task, int node = -1);
+    void submitJob(std::function<void()> job, int priority = 0);
+    bool runPending();
+    bool runUrgent();
+
+    static int getCurrentThread();
+    static int getCurrentNode();
+    static G3DTExecutor *getGlobal();
+
+private:
+    std::vector<G3DTExecutorQueue *> queues;
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> shared; //!< tasks submitted from other threads
+    std::atomic<qint64> nPending; //!< tasks in all queues
+    std::atomic<qint64> nSteals;
+    std::vector<std::deque<std::function<void()>>> nodeShared; //!< tasks submitted for nodes
+    std::deque<std::function<void()>> urgent; //!< tasks of jobs with positive priorities
+    std::atomic<qint64> nUrgent; //!< tasks in the urgent queue
+    std::vector<int> threadNodes; //!< node of each thread
+    std::atomic<int> pinGeneration; //!< incremented by setThreadPinning(), threads apply it when it changes
+    std::atomic<bool> pinning;
+    bool stopping;
+    std::mutex mutex;
+    std::condition_variable available;
+
+    std::deque<std::pair<int, std::function<void()>>> jobs; //!< jobs waiting for a free slot with their priorities
+    int maxJobs;
+    int nRunningJobs;
+    std::mutex jobMutex;
+
+    void workLoop(int iThread);
+    bool takeTask(int iThread, std::function<void()> *task);
+    bool takeShared(int node, std::function<void()> *task);
+    bool takeUrgent(std::function<void()> *task);
+    void enqueue(std::function<void()> task, int node, bool isUrgent);
+    void startJob(std::function<void()> job, bool isUrgent);
+};
+
+#endif // G3DTEXECUTOR_H
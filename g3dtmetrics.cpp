@@ -0,0 +1,490 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file g3dtmetrics.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <chrono>
+#include <limits>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include "g3dtmetrics.h"
+
+
+/*!
+ * \brief Stripe of the calling thread, assigned round-robin on first use.
+ */
+static int g3dtMetricsStripe()
+{
+    static std::atomic<int> nextStripe(0);
+    static thread_local int stripe = -1;
+
+    if (stripe < 0) stripe = nextStripe++ % g3dtMetricsStripes;
+    return stripe;
+}
+
+
+/*!
+ * \brief Lowers an atomic minimum.
+ */
+static void g3dtMetricsMinimum(std::atomic<qint64> *minimum, qint64 value)
+{
+    qint64 current = minimum->load(std::memory_order_relaxed);
+    while ((value < current) && !minimum->compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+
+/*!
+ * \brief Raises an atomic maximum.
+ */
+static void g3dtMetricsMaximum(std::atomic<qint64> *maximum, qint64 value)
+{
+    qint64 current = maximum->load(std::memory_order_relaxed);
+    while ((current < value) && !maximum->compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+
+/*!
+ * \return Histogram bucket of a duration: the number of significant bits.
+ */
+static int g3dtMetricsBucket(qint64 nanoseconds)
+{
+    int bucket = 0;
+    quint64 value = quint64(nanoseconds);
+
+    while (value)
+    {
+        bucket++;
+        value >>= 1;
+    }
+    return qMin(bucket, G3DTHistogram::nBuckets - 1);
+}
+
+
+/*!
+ * \brief Constructor.
+ * \param name Name of the counter.
+ */
+G3DTCounter::G3DTCounter(QString name)
+{
+    this->name = name;
+    reset();
+}
+
+
+/*!
+ * \return Name of the counter.
+ */
+QString G3DTCounter::getName()
+{
+    return name;
+}
+
+
+/*!
+ * \brief Adds a value. May be called from several threads.
+ */
+void G3DTCounter::add(qint64 value)
+{
+    stripes[g3dtMetricsStripe()].value.fetch_add(value, std::memory_order_relaxed);
+}
+
+
+/*!
+ * \return Sum of added values.
+ */
+qint64 G3DTCounter::getValue()
+{
+    qint64 value = 0;
+
+    for (int i = 0; i < g3dtMetricsStripes; i++)
+        value += stripes[i].value.load(std::memory_order_relaxed);
+    return value;
+}
+
+
+/*!
+ * \brief Sets the counter to zero.
+ */
+void G3DTCounter::reset()
+{
+    for (int i = 0; i < g3dtMetricsStripes; i++)
+        stripes[i].value = 0;
+}
+
+
+/*!
+ * \brief Constructor.
+ * \param name Name of the histogram.
+ */
+G3DTHistogram::G3DTHistogram(QString name)
+{
+    this->name = name;
+    reset();
+}
+
+
+/*!
+ * \return Name of the histogram.
+ */
+QString G3DTHistogram::getName()
+{
+    return name;
+}
+
+
+/*!
+ * \brief Records a duration. May be called from several threads.
+ * \param nanoseconds Duration in nanoseconds; negative durations are recorded as 0.
+ */
+void G3DTHistogram::record(qint64 nanoseconds)
+{
+    Stripe *stripe = &stripes[g3dtMetricsStripe()];
+
+    nanoseconds = qMax(nanoseconds, qint64(0));
+    stripe->count.fetch_add(1, std::memory_order_relaxed);
+    stripe->total.fetch_add(nanoseconds, std::memory_order_relaxed);
+    stripe->buckets[g3dtMetricsBucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    g3dtMetricsMinimum(&stripe->minimum, nanoseconds);
+    g3dtMetricsMaximum(&stripe->maximum, nanoseconds);
+}
+
+
+/*!
+ * \return Number of recorded durations.
+ */
+qint64 G3DTHistogram::getCount()
+{
+    qint64 count = 0;
+
+    for (int i = 0; i < g3dtMetricsStripes; i++)
+        count += stripes[i].count.load(std::memory_order_relaxed);
+    return count;
+}
+
+
+/*!
+ * \return Sum of recorded durations in nanoseconds.
+ */
+qint64 G3DTHistogram::getTotal()
+{
+    qint64 total = 0;
+
+    for (int i = 0; i < g3dtMetricsStripes; i++)
+        total += stripes[i].total.load(std::memory_order_relaxed);
+    return total;
+}
+
+
+/*!
+ * \return Shortest recorded duration in nanoseconds, 0 if none.
+ */
+qint64 G3DTHistogram::getMinimum()
+{
+    qint64 minimum = std::numeric_limits<qint64>::max();
+
+    for (int i = 0; i < g3dtMetricsStripes; i++)
+        minimum = qMin(minimum, stripes[i].minimum.load(std::memory_order_relaxed));
+    return (minimum == std::numeric_limits<qint64>::max()) ? 0 : minimum;
+}
+
+
+/*!
+ * \return Longest recorded duration in nanoseconds, 0 if none.
+ */
+qint64 G3DTHistogram::getMaximum()
+{
+    qint64 maximum = 0;
+
+    for (int i = 0; i < g3dtMetricsStripes; i++)
+        maximum = qMax(maximum, stripes[i].maximum.load(std::memory_order_relaxed));
+    return maximum;
+}
+
+
+/*!
+ * \return Mean duration in nanoseconds, 0 if none.
+ */
+double G3DTHistogram::getMean()
+{
+    qint64 count = getCount();
+    return (0 < count) ? double(getTotal()) / double(count) : 0.0;
+}
+
+
+/*!
+ * \brief Estimates a percentile by linear interpolation inside its power-of-two bucket.
+ * \param percentile Percentile in [0, 100].
+ * \return Duration in nanoseconds, 0 if none were recorded.
+ */
+qint64 G3DTHistogram::getPercentile(double percentile)
+{
+    std::vector<qint64> buckets = getBuckets();
+    qint64 count = 0, cumulative = 0, target;
+
+    for (int b = 0; b < nBuckets; b++)
+        count += buckets[size_t(b)];
+    if (count == 0) return 0;
+    target = qBound(qint64(1), qint64(double(count) * qBound(0.0, percentile, 100.0) / 100.0 + 0.5), count);
+
+    for (int b = 0; b < nBuckets; b++)
+    {
+        qint64 n = buckets[size_t(b)];
+        if (cumulative + n < target)
+        {
+            cumulative += n;
+            continue;
+        }
+        double low = (b == 0) ? 0.0 : double(quint64(1) << (b - 1));
+        double high = (b == 0) ? 0.0 : 2.0 * low;
+        qint64 value = qint64(low + (high - low) * double(target - cumulative) / double(n));
+        return qBound(getMinimum(), value, getMaximum());
+    }
+    return getMaximum();
+}
+
+
+/*!
+ * \return Number of durations in each bucket.
+ */
+std::vector<qint64> G3DTHistogram::getBuckets()
+{
+    std::vector<qint64> buckets(size_t(nBuckets), 0);
+
+    for (int i = 0; i < g3dtMetricsStripes; i++)
+        for (int b = 0; b < nBuckets; b++)
+            buckets[size_t(b)] += stripes[i].buckets[b].load(std::memory_order_relaxed);
+    return buckets;
+}
+
+
+/*!
+ * \brief Removes all recorded durations.
+ */
+void G3DTHistogram::reset()
+{
+    for (int i = 0; i < g3dtMetricsStripes; i++)
+    {
+        stripes[i].count = 0;
+        stripes[i].total = 0;
+        stripes[i].minimum = std::numeric_limits<qint64>::max();
+        stripes[i].maximum = 0;
+        for (int b = 0; b < nBuckets; b++)
+            stripes[i].buckets[b] = 0;
+    }
+}
+
+
+/*!
+ * \return Statistics in nanoseconds; buckets lists [upper bound, count] of non-empty buckets.
+ */
+QJsonObject G3DTHistogram::toJson()
+{
+    QJsonObject qobj;
+    QJsonArray qbuckets;
+    std::vector<qint64> buckets = getBuckets();
+
+    qobj.insert("count", getCount());
+    qobj.insert("totalNs", getTotal());
+    qobj.insert("minNs", getMinimum());
+    qobj.insert("maxNs", getMaximum());
+    qobj.insert("meanNs", getMean());
+    qobj.insert("p50Ns", getPercentile(50.0));
+    qobj.insert("p90Ns", getPercentile(90.0));
+    qobj.insert("p99Ns", getPercentile(99.0));
+    for (int b = 0; b < nBuckets; b++)
+    {
+        if (buckets[size_t(b)] == 0) continue;
+        QJsonArray qbucket;
+        qbucket.append((b == 0) ? 0.0 : double(quint64(1) << (b - 1)) * 2.0);
+        qbucket.append(buckets[size_t(b)]);
+        qbuckets.append(qbucket);
+    }
+    qobj.insert("buckets", qbuckets);
+    return qobj;
+}
+
+
+/*!
+ * \brief Starts timing.
+ * \param histogram Histogram receiving the duration, may be nullptr.
+ */
+G3DTScopedTimer::G3DTScopedTimer(G3DTHistogram *histogram)
+{
+    this->histogram = histogram;
+    this->start = G3DTMetrics::now();
+}
+
+
+/*!
+ * \brief Records the duration since construction.
+ */
+G3DTScopedTimer::~G3DTScopedTimer()
+{
+    if (histogram) histogram->record(getElapsed());
+}
+
+
+/*!
+ * \return Nanoseconds since construction.
+ */
+qint64 G3DTScopedTimer::getElapsed()
+{
+    return G3DTMetrics::now() - start;
+}
+
+
+G3DTMetrics::G3DTMetrics()
+    : started(now())
+{
+}
+
+
+G3DTMetrics::~G3DTMetrics()
+{
+    for (auto it = counters.begin(); it != counters.end(); ++it)
+        delete it->second;
+    for (auto it = histograms.begin(); it != histograms.end(); ++it)
+        delete it->second;
+}
+
+
+/*!
+ * \brief Returns a counter, creating it on first request.
+ * \param name Name of the counter, e.g. "bytesRead".
+ * \return Pointer to the counter, valid as long as the registry.
+ */
+G3DTCounter *G3DTMetrics::getCounter(QString name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    G3DTCounter *&counter = counters[name];
+
+    if (!counter) counter = new G3DTCounter(name);
+    return counter;
+}
+
+
+/*!
+ * \brief Returns a histogram, creating it on first request.
+ * \param name Name of the histogram, e.g. "read".
+ * \return Pointer to the histogram, valid as long as the registry.
+ */
+G3DTHistogram *G3DTMetrics::getHistogram(QString name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    G3DTHistogram *&histogram = histograms[name];
+
+    if (!histogram) histogram = new G3DTHistogram(name);
+    return histogram;
+}
+
+
+/*!
+ * \return Names of all counters in ascending order.
+ */
+std::vector<QString> G3DTMetrics::getCounterNames()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<QString> names;
+
+    for (auto it = counters.begin(); it != counters.end(); ++it)
+        names.push_back(it->first);
+    return names;
+}
+
+
+/*!
+ * \return Names of all histograms in ascending order.
+ */
+std::vector<QString> G3DTMetrics::getHistogramNames()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<QString> names;
+
+    for (auto it = histograms.begin(); it != histograms.end(); ++it)
+        names.push_back(it->first);
+    return names;
+}
+
+
+/*!
+ * \return Nanoseconds since construction or reset().
+ */
+qint64 G3DTMetrics::getElapsed()
+{
+    return now() - started;
+}
+
+
+/*!
+ * \brief Zeroes all counters and histograms and restarts the elapsed time. Pointers stay valid.
+ */
+void G3DTMetrics::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto it = counters.begin(); it != counters.end(); ++it)
+        it->second->reset();
+    for (auto it = histograms.begin(); it != histograms.end(); ++it)
+        it->second->reset();
+    started = now();
+}
+
+
+/*!
+ * \return Elapsed time, counters and histograms.
+ */
+QJsonObject G3DTMetrics::toJson()
+{
+    QJsonObject qobj, qcounters, qhistograms;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto it = counters.begin(); it != counters.end(); ++it)
+        qcounters.insert(it->first, it->second->getValue());
+    for (auto it = histograms.begin(); it != histograms.end(); ++it)
+        qhistograms.insert(it->first, it->second->toJson());
+    qobj.insert("elapsedNs", getElapsed());
+    qobj.insert("counters", qcounters);
+    qobj.insert("histograms", qhistograms);
+    return qobj;
+}
+
+
+/*!
+ * \brief Writes toJson() to a file.
+ * \param fileName File name.
+ * \return True, if successful.
+ */
+bool G3DTMetrics::save(QString fileName)
+{
+    QSaveFile file(fileName);
+    QByteArray json = QJsonDocument(toJson()).toJson(QJsonDocument::Indented);
+
+    if (!file.open(QIODevice::WriteOnly)) return fail("Cannot create " + fileName + ".");
+    if ((file.write(json) != json.size()) || !file.commit()) return fail("Cannot write " + fileName + ".");
+    return true;
+}
+
+
+/*!
+ * \return Monotonic time in nanoseconds.
+ */
+qint64 G3DTMetrics::now()
+{
+    return qint64(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+
+bool G3DTMetrics::fail(QString message)
+{
+    errorString = message;
+    return false;
+}
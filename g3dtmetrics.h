@@ -0,0 +1,153 @@
+#ifndef G3DTMETRICS_H
+#define G3DTMETRICS_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file g3dtmetrics.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <QJsonObject>
+#include <QString>
+#include "g3dtcore_global.h"
+
+
+/*!
+ * \brief Number of stripes of counters and histograms. Threads update different stripes,
+ *        so they rarely share cache lines; readers sum the stripes.
+ */
+static const int g3dtMetricsStripes = 16;
+
+
+/*!
+ * \brief The G3DTCounter sums values (cells processed, bytes read or written) from any number of threads
+ *        by relaxed atomic additions without locks.
+ */
+class G3DTCORE_EXPORT G3DTCounter
+{
+public:
+    explicit G3DTCounter(QString name);
+
+    QString getName();
+    void add(qint64 value = 1);
+    qint64 getValue();
+    void reset();
+
+private:
+    struct Stripe
+    {
+        std::atomic<qint64> value;
+        char padding[56];
+    };
+
+    QString name;
+    Stripe stripes[g3dtMetricsStripes];
+};
+
+
+/*!
+ * \brief The G3DTHistogram collects durations in nanoseconds: count, total, minimum, maximum and
+ *        a histogram of powers of two, from which percentiles are estimated. Recording is lock-free.
+ */
+class G3DTCORE_EXPORT G3DTHistogram
+{
+public:
+    static const int nBuckets = 64; //!< bucket b holds durations in [2^(b-1), 2^b) ns, bucket 0 holds 0
+
+public:
+    explicit G3DTHistogram(QString name);
+
+    QString getName();
+    void record(qint64 nanoseconds);
+    qint64 getCount();
+    qint64 getTotal();
+    qint64 getMinimum();
+    qint64 getMaximum();
+    double getMean();
+    qint64 getPercentile(double percentile);
+    std::vector<qint64> getBuckets();
+    void reset();
+    QJsonObject toJson();
+
+private:
+    struct Stripe
+    {
+        std::atomic<qint64> count;
+        std::atomic<qint64> total;
+        std::atomic<qint64> minimum;
+        std::atomic<qint64> maximum;
+        std::atomic<qint64> buckets[nBuckets];
+        char padding[32];
+    };
+
+    QString name;
+    Stripe stripes[g3dtMetricsStripes];
+};
+
+
+/*!
+ * \brief The G3DTScopedTimer records the time from its construction to its destruction into a histogram.
+ */
+class G3DTCORE_EXPORT G3DTScopedTimer
+{
+public:
+    explicit G3DTScopedTimer(G3DTHistogram *histogram);
+    ~G3DTScopedTimer();
+
+    qint64 getElapsed();
+
+private:
+    G3DTHistogram *histogram;
+    qint64 start;
+};
+
+
+/*!
+ * \brief The G3DTMetrics is a registry of named counters and timing histograms of a job.
+ *
+ *        Counters and histograms are created on first request and live as long as the registry, so callers
+ *        should look them up once and keep the pointers for hot loops. All times are monotonic nanoseconds
+ *        of now(). toJson() and save() export all values for later analysis.
+ */
+class G3DTCORE_EXPORT G3DTMetrics
+{
+public:
+    QString errorString; //!< description of the last error
+
+public:
+    G3DTMetrics();
+    ~G3DTMetrics();
+
+    G3DTCounter *getCounter(QString name);
+    G3DTHistogram *getHistogram(QString name);
+    std::vector<QString> getCounterNames();
+    std::vector<QString> getHistogramNames();
+    qint64 getElapsed();
+    void reset();
+
+    QJsonObject toJson();
+    bool save(QString fileName);
+
+    static qint64 now();
+
+private:
+    std::mutex mutex;
+    std::map<QString, G3DTCounter *> counters;
+    std::map<QString, G3DTHistogram *> histograms;
+    std::atomic<qint64> started; //!< now() at construction or reset()
+
+    bool fail(QString message);
+};
+
+#endif // G3DTMETRICS_H
@@ -0,0 +1,459 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file g3dtnuma.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "g3dtnuma.h"
+
+#if defined(Q_OS_LINUX)
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#if defined(Q_OS_UNIX)
+#include <unistd.h>
+#endif
+
+
+#if defined(Q_OS_LINUX)
+
+/*!
+ * \brief Reads a sysfs list such as "0-3,8-11".
+ * \return Listed numbers, empty if the file cannot be read.
+ */
+static std::vector<int> g3dtNumaReadList(const char *fileName)
+{
+    std::vector<int> list;
+    char text[4096];
+    FILE *file = fopen(fileName, "r");
+
+    if (!file) return list;
+    if (!fgets(text, sizeof(text), file)) text[0] = 0;
+    fclose(file);
+
+    char *p = text;
+    while (('0' <= *p) && (*p <= '9'))
+    {
+        int first = int(strtol(p, &p, 10)), last = first;
+        if (*p == '-') last = int(strtol(p + 1, &p, 10));
+        for (int i = first; i <= last; i++)
+            list.push_back(i);
+        if (*p == ',') p++;
+    }
+    return list;
+}
+
+
+/*!
+ * \brief Topology read once from sysfs.
+ */
+struct G3DTNumaTopology
+{
+    int nNodes;
+    std::vector<std::vector<int>> cpus; //!< CPUs of each node
+
+    G3DTNumaTopology()
+    {
+        std::vector<int> online = g3dtNumaReadList("/sys/devices/system/node/online");
+
+        nNodes = online.empty() ? 1 : online.back() + 1;
+        cpus.resize(size_t(nNodes));
+        for (size_t i = 0; i < online.size(); i++)
+        {
+            char fileName[64];
+            snprintf(fileName, sizeof(fileName), "/sys/devices/system/node/node%d/cpulist", online[i]);
+            cpus[size_t(online[i])] = g3dtNumaReadList(fileName);
+        }
+        if (online.empty())
+        {
+            for (int cpu = 0; cpu < int(sysconf(_SC_NPROCESSORS_ONLN)); cpu++)
+                cpus[0].push_back(cpu);
+        }
+    }
+};
+
+
+static G3DTNumaTopology *g3dtNumaTopology()
+{
+    static G3DTNumaTopology topology;
+    return &topology;
+}
+
+
+/*!
+ * \brief Sets the memory policy of page-aligned memory by the mbind system call.
+ * \param nodes Nodes of the policy mask.
+ */
+static bool g3dtNumaBind(void *address, qint64 nBytes, int mode, const std::vector<int> &nodes)
+{
+    int nNodes = g3dtNumaTopology()->nNodes;
+    int nBits = int(8 * sizeof(unsigned long));
+    std::vector<unsigned long> mask(size_t((nNodes + nBits - 1) / nBits), 0);
+
+    if (nBytes <= 0) return true;
+    for (size_t i = 0; i < nodes.size(); i++)
+        mask[size_t(nodes[i] / nBits)] |= 1UL << (nodes[i] % nBits);
+    return syscall(SYS_mbind, address, (unsigned long)nBytes, mode, mask.data(), (unsigned long)(nNodes + 1), 0) == 0;
+}
+
+#endif
+
+
+/*!
+ * \return Number of NUMA nodes (highest node number + 1), 1 on non-NUMA systems.
+ */
+int G3DTNuma::getNumberOfNodes()
+{
+#if defined(Q_OS_LINUX)
+    return g3dtNumaTopology()->nNodes;
+#else
+    return 1;
+#endif
+}
+
+
+/*!
+ * \param node Node, -1 for all nodes.
+ * \return Logical processors of the node.
+ */
+std::vector<int> G3DTNuma::getNodeCpus(int node)
+{
+    std::vector<int> cpus;
+
+#if defined(Q_OS_LINUX)
+    G3DTNumaTopology *topology = g3dtNumaTopology();
+    for (int i = 0; i < topology->nNodes; i++)
+    {
+        if ((node < 0) || (node == i))
+            cpus.insert(cpus.end(), topology->cpus[size_t(i)].begin(), topology->cpus[size_t(i)].end());
+    }
+#else
+    Q_UNUSED(node);
+#endif
+    return cpus;
+}
+
+
+/*!
+ * \return Node of the processor running the calling thread.
+ */
+int G3DTNuma::getCurrentNode()
+{
+#if defined(Q_OS_LINUX)
+    unsigned int cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) return 0;
+    return int(node);
+#else
+    return 0;
+#endif
+}
+
+
+/*!
+ * \brief Returns the node holding a page. The page is queried by the move_pages system call without touching it,
+ *        so untouched pages stay unplaced.
+ * \return Node, -1 if the page was not touched yet or the node is unknown.
+ */
+int G3DTNuma::getNodeOfAddress(const void *address)
+{
+#if defined(Q_OS_LINUX)
+    void *page = const_cast<void *>(address);
+    int status = -1;
+    if (syscall(SYS_move_pages, 0, 1UL, &page, nullptr, &status, 0) != 0) return -1;
+    return (0 <= status) ? status : -1;
+#else
+    Q_UNUSED(address);
+    return 0;
+#endif
+}
+
+
+/*!
+ * \brief Returns the node of a byte of a buffer with Blocked placement.
+ *        Parts are whole pages, so the mapping is exact for page-aligned buffers.
+ * \param offset Byte offset in the buffer.
+ * \param nBytes Size of the buffer.
+ * \return Node.
+ */
+int G3DTNuma::getBlockedNode(qint64 offset, qint64 nBytes)
+{
+    qint64 nNodes = getNumberOfNodes(), pageSize = getPageSize();
+    qint64 partBytes = ((nBytes + nNodes - 1) / nNodes + pageSize - 1) / pageSize * pageSize;
+
+    if ((nNodes <= 1) || (partBytes <= 0)) return 0;
+    return int(qBound(qint64(0), offset / partBytes, nNodes - 1));
+}
+
+
+/*!
+ * \return Size of a memory page in bytes.
+ */
+qint64 G3DTNuma::getPageSize()
+{
+#if defined(Q_OS_UNIX)
+    static qint64 pageSize = qint64(sysconf(_SC_PAGESIZE));
+    return (0 < pageSize) ? pageSize : 4096;
+#else
+    return 4096;
+#endif
+}
+
+
+/*!
+ * \brief Allocates page-aligned memory with a placement. Pages are placed when first touched.
+ * \param nBytes Size in bytes.
+ * \param placement Placement of pages on nodes.
+ * \return Pointer to the memory, nullptr if it cannot be allocated. Free it by deallocate().
+ */
+void *G3DTNuma::allocate(qint64 nBytes, Placement placement)
+{
+    if (nBytes <= 0) return nullptr;
+#if defined(Q_OS_LINUX)
+    void *buffer = mmap(nullptr, size_t(nBytes), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED) return nullptr;
+    bind(buffer, nBytes, placement);
+    return buffer;
+#else
+    Q_UNUSED(placement);
+    return malloc(size_t(nBytes));
+#endif
+}
+
+
+/*!
+ * \brief Frees memory returned by allocate().
+ * \param buffer Memory, may be nullptr.
+ * \param nBytes Size passed to allocate().
+ */
+void G3DTNuma::deallocate(void *buffer, qint64 nBytes)
+{
+    if (!buffer) return;
+#if defined(Q_OS_LINUX)
+    munmap(buffer, size_t(nBytes));
+#else
+    Q_UNUSED(nBytes);
+    free(buffer);
+#endif
+}
+
+
+/*!
+ * \brief Sets the placement of pages of a buffer not touched yet; touched pages keep their nodes.
+ *        Only whole pages inside the buffer are affected.
+ * \param buffer Memory.
+ * \param nBytes Size in bytes.
+ * \param placement Placement of pages.
+ * \return True, if the placement was set or there is a single node.
+ */
+bool G3DTNuma::bind(void *buffer, qint64 nBytes, Placement placement)
+{
+#if defined(Q_OS_LINUX)
+    G3DTNumaTopology *topology = g3dtNumaTopology();
+    qint64 pageSize = getPageSize();
+    quintptr begin = (quintptr(buffer) + quintptr(pageSize) - 1) / quintptr(pageSize) * quintptr(pageSize);
+    quintptr end = (quintptr(buffer) + quintptr(nBytes)) / quintptr(pageSize) * quintptr(pageSize);
+    bool ok = true;
+
+    if ((topology->nNodes <= 1) || (end <= begin)) return true;
+    if (placement == Local) return g3dtNumaBind(reinterpret_cast<void *>(begin), qint64(end - begin), MPOL_DEFAULT, std::vector<int>());
+    if (placement == Interleaved)
+    {
+        std::vector<int> nodes;
+        for (int i = 0; i < topology->nNodes; i++)
+            if (!topology->cpus[size_t(i)].empty()) nodes.push_back(i);
+        return g3dtNumaBind(reinterpret_cast<void *>(begin), qint64(end - begin), MPOL_INTERLEAVE, nodes);
+    }
+
+    for (quintptr page = begin; page < end; )
+    {
+        int node = getBlockedNode(qint64(page - quintptr(buffer)), nBytes);
+        quintptr next = page + quintptr(pageSize);
+        while ((next < end) && (getBlockedNode(qint64(next - quintptr(buffer)), nBytes) == node))
+            next += quintptr(pageSize);
+        ok = g3dtNumaBind(reinterpret_cast<void *>(page), qint64(next - page), MPOL_PREFERRED, std::vector<int>(1, node)) && ok;
+        page = next;
+    }
+    return ok;
+#else
+    Q_UNUSED(buffer);
+    Q_UNUSED(nBytes);
+    Q_UNUSED(placement);
+    return true;
+#endif
+}
+
+
+#if defined(Q_OS_LINUX)
+/*!
+ * \brief Affinity of the calling thread before it was first pinned, restored by pinCurrentThread(-1).
+ */
+static thread_local cpu_set_t g3dtNumaSavedAffinity;
+static thread_local bool g3dtNumaPinned = false;
+#endif
+
+
+/*!
+ * \brief Restricts the calling thread to the processors of a node that it may run on. The affinity the thread had
+ *        before (e.g. set by taskset or a cpuset) is saved when it is first pinned and restored by unpinning.
+ * \param node Node, -1 to restore the saved affinity.
+ * \return True, if successful.
+ */
+bool G3DTNuma::pinCurrentThread(int node)
+{
+#if defined(Q_OS_LINUX)
+    std::vector<int> cpus;
+    cpu_set_t set;
+
+    if (node < 0)
+    {
+        if (!g3dtNumaPinned) return true;
+        g3dtNumaPinned = false;
+        return sched_setaffinity(0, sizeof(g3dtNumaSavedAffinity), &g3dtNumaSavedAffinity) == 0;
+    }
+
+    cpus = getNodeCpus(node);
+    if (cpus.empty()) return false;
+    if (!g3dtNumaPinned)
+    {
+        if (sched_getaffinity(0, sizeof(g3dtNumaSavedAffinity), &g3dtNumaSavedAffinity) != 0) return false;
+        g3dtNumaPinned = true;
+    }
+    CPU_ZERO(&set);
+    for (size_t i = 0; i < cpus.size(); i++)
+        if ((cpus[i] < CPU_SETSIZE) && CPU_ISSET(cpus[i], &g3dtNumaSavedAffinity)) CPU_SET(cpus[i], &set);
+    if (CPU_COUNT(&set) == 0) return false;
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    Q_UNUSED(node);
+    return false;
+#endif
+}
+
+
+/*!
+ * \param placement Placement.
+ * \return Name of the placement.
+ */
+QString G3DTNuma::toString(Placement placement)
+{
+    switch (placement)
+    {
+    case Local: return "Local";
+    case Interleaved: return "Interleaved";
+    case Blocked: return "Blocked";
+    }
+    return "Local";
+}
+
+
+/*!
+ * \param placement Name of a placement.
+ * \return Placement, Local for unknown names.
+ */
+G3DTNuma::Placement G3DTNuma::fromString(QString placement)
+{
+    placement = placement.trimmed().toUpper();
+    if (placement == "INTERLEAVED") return Interleaved;
+    if (placement == "BLOCKED") return Blocked;
+    return Local;
+}
+
+
+G3DTNumaBuffer::G3DTNumaBuffer()
+{
+    data = nullptr;
+    nBytes = 0;
+    placement = G3DTNuma::Local;
+}
+
+
+G3DTNumaBuffer::~G3DTNumaBuffer()
+{
+    release();
+}
+
+
+/*!
+ * \brief Allocates the buffer, releasing a previous one. Cells are zero when first read.
+ * \param nBytes Size in bytes.
+ * \param placement Placement of pages on nodes.
+ * \return True, if successful.
+ */
+bool G3DTNumaBuffer::allocate(qint64 nBytes, G3DTNuma::Placement placement)
+{
+    release();
+    data = static_cast<uchar *>(G3DTNuma::allocate(nBytes, placement));
+    if (!data) return false;
+#if !defined(Q_OS_LINUX)
+    memset(data, 0, size_t(nBytes));
+#endif
+    this->nBytes = nBytes;
+    this->placement = placement;
+    return true;
+}
+
+
+/*!
+ * \brief Frees the buffer.
+ */
+void G3DTNumaBuffer::release()
+{
+    G3DTNuma::deallocate(data, nBytes);
+    data = nullptr;
+    nBytes = 0;
+}
+
+
+/*!
+ * \return Cells of the buffer, nullptr if not allocated.
+ */
+uchar *G3DTNumaBuffer::getData()
+{
+    return data;
+}
+
+
+/*!
+ * \return Size of the buffer in bytes.
+ */
+qint64 G3DTNumaBuffer::getSize()
+{
+    return nBytes;
+}
+
+
+/*!
+ * \return Placement of the buffer.
+ */
+G3DTNuma::Placement G3DTNumaBuffer::getPlacement()
+{
+    return placement;
+}
+
+
+/*!
+ * \brief Returns the node owning a byte of the buffer, used to schedule blocks on the node of their cells
+ *        (see G3DTParallel::forEachOnNodes()). Interleaved buffers have no owner. Pages of Local buffers
+ *        have no owner until first touched; the query does not touch them.
+ * \param offset Byte offset.
+ * \return Node, -1 if the byte has no owning node.
+ */
+int G3DTNumaBuffer::getNode(qint64 offset)
+{
+    if (!data || (offset < 0) || (nBytes <= offset)) return -1;
+    if (placement == G3DTNuma::Blocked) return G3DTNuma::getBlockedNode(offset, nBytes);
+    if (placement == G3DTNuma::Interleaved) return -1;
+    return G3DTNuma::getNodeOfAddress(data + offset);
+}
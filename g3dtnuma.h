@@ -0,0 +1,87 @@
+#ifndef G3DTNUMA_H
+#define G3DTNUMA_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file g3dtnuma.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <vector>
+#include <QString>
+#include "g3dtcore_global.h"
+
+
+/*!
+ * \brief The G3DTNuma provides NUMA topology, memory placement and thread pinning.
+ *
+ *        On Linux, nodes are read from /sys/devices/system/node and memory policies are set by the mbind
+ *        system call, so no NUMA library is required. On other systems there is one node, placement is
+ *        ignored and pinning fails.
+ *
+ *        Memory is placed when first touched. Placement must therefore be set before a buffer is filled,
+ *        which allocate() does for fresh pages.
+ */
+class G3DTCORE_EXPORT G3DTNuma
+{
+public:
+    enum Placement
+    {
+        Local = 0, //!< pages on the node of the thread touching them first (system default)
+        Interleaved = 1, //!< pages spread round-robin over all nodes, for buffers read by all threads
+        Blocked = 2 //!< consecutive equal parts of the buffer on consecutive nodes, see getBlockedNode()
+    };
+
+public:
+    static int getNumberOfNodes();
+    static std::vector<int> getNodeCpus(int node);
+    static int getCurrentNode();
+    static int getNodeOfAddress(const void *address);
+    static int getBlockedNode(qint64 offset, qint64 nBytes);
+    static qint64 getPageSize();
+
+    static void *allocate(qint64 nBytes, Placement placement = Local);
+    static void deallocate(void *buffer, qint64 nBytes);
+    static bool bind(void *buffer, qint64 nBytes, Placement placement);
+
+    static bool pinCurrentThread(int node);
+
+    static QString toString(Placement placement);
+    static Placement fromString(QString placement);
+};
+
+
+/*!
+ * \brief The G3DTNumaBuffer owns a raster buffer allocated with a NUMA placement.
+ */
+class G3DTCORE_EXPORT G3DTNumaBuffer
+{
+public:
+    G3DTNumaBuffer();
+    ~G3DTNumaBuffer();
+
+    bool allocate(qint64 nBytes, G3DTNuma::Placement placement = G3DTNuma::Interleaved);
+    void release();
+
+    uchar *getData();
+    qint64 getSize();
+    G3DTNuma::Placement getPlacement();
+    int getNode(qint64 offset);
+
+private:
+    uchar *data;
+    qint64 nBytes;
+    G3DTNuma::Placement placement;
+
+    G3DTNumaBuffer(const G3DTNumaBuffer &) = delete;
+    G3DTNumaBuffer &operator=(const G3DTNumaBuffer &) = delete;
+};
+
+#endif // G3DTNUMA_H
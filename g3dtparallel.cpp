@@ -0,0 +1,227 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file g3dtparallel.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "g3dtcanceltoken.h"
+#include "g3dtexecutor.h"
+#include "g3dtparallel.h"
+
+
+/*!
+ * \brief State shared by the calling thread and executor tasks of one parallel loop.
+ *        Items of a loop over nodes are split into lists of their nodes; a thread takes items of its own node
+ *        first and then items of other nodes.
+ */
+struct G3DTParallelLoop
+{
+    std::function<void(qint64, int)> func;
+    qint64 nItems;
+    std::atomic<qint64> nextItem;
+    std::vector<std::vector<qint64>> nodeItems; //!< items of each node, empty for loops over items
+    std::unique_ptr<std::atomic<qint64>[]> nodeNext; //!< next position in the item list of each node
+    std::atomic<int> nRunning;
+    std::atomic<bool> stopped;
+    G3DTCancelToken *token; //!< token of the calling thread, passed on to helpers
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    bool takeItem(int node, qint64 *iItem)
+    {
+        int nNodes = int(nodeItems.size());
+
+        if (nNodes == 0)
+        {
+            *iItem = nextItem++;
+            return *iItem < nItems;
+        }
+        for (int k = 0; k < nNodes; k++)
+        {
+            size_t iNode = size_t((qMax(node, 0) + k) % nNodes);
+            qint64 position = nodeNext[iNode]++;
+            if (position < qint64(nodeItems[iNode].size()))
+            {
+                *iItem = nodeItems[iNode][size_t(position)];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void stop()
+    {
+        stopped = true;
+        nextItem = nItems;
+        for (size_t iNode = 0; iNode < nodeItems.size(); iNode++)
+            nodeNext[iNode] = qint64(nodeItems[iNode].size());
+    }
+
+    void work(int iThread)
+    {
+        qint64 iItem;
+        int node = nodeItems.empty() ? 0 : G3DTExecutor::getCurrentNode();
+        G3DTExecutor *executor = G3DTExecutor::getGlobal();
+        G3DTCancelToken *previous = G3DTCancelToken::setCurrent(token);
+
+        nRunning++;
+        for (;;)
+        {
+            while (executor->runUrgent()) {}
+            if (!takeItem(node, &iItem)) break;
+            if (token && !token->check())
+            {
+                stop();
+                break;
+            }
+            func(iItem, iThread);
+        }
+        G3DTCancelToken::setCurrent(previous);
+        if (--nRunning == 0)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.notify_all();
+        }
+    }
+};
+
+
+/*!
+ * \brief Returns the default number of threads used by parallel loops.
+ * \return Number of threads (at least 1).
+ */
+int G3DTParallel::getNumberOfThreads()
+{
+    return G3DTExecutor::getGlobal()->getNumberOfThreads();
+}
+
+
+/*!
+ * \brief Calls a function for each item in [0, nItems) in parallel.
+ *        Helper tasks that start after all items were taken return immediately,
+ *        so nested loops cannot dead-lock on a saturated executor.
+ *        The current G3DTCancelToken of the calling thread is checked before every item, and executor threads
+ *        run waiting tasks of interactive jobs (G3DTExecutor::runUrgent()) between items.
+ * \param nItems Number of items (e.g. raster blocks).
+ * \param func Function called with the item index and thread slot index in [0, nThreads).
+ * \param nThreads Number of threads, or 0 for the default number of threads.
+ * \return True, if all items were processed; false if the loop was cancelled or its deadline passed.
+ */
+bool G3DTParallel::forEach(qint64 nItems, std::function<void(qint64 iItem, int iThread)> func, int nThreads)
+{
+    G3DTCancelToken *token = G3DTCancelToken::getCurrent();
+
+    if (nItems <= 0) return true;
+    if (nThreads <= 0) nThreads = getNumberOfThreads();
+    if (nItems < nThreads) nThreads = int(nItems);
+
+    if (nThreads == 1)
+    {
+        G3DTExecutor *executor = G3DTExecutor::getGlobal();
+        for (qint64 iItem = 0; iItem < nItems; iItem++)
+        {
+            while (executor->runUrgent()) {}
+            if (token && !token->check()) return false;
+            func(iItem, 0);
+        }
+        return true;
+    }
+
+    std::shared_ptr<G3DTParallelLoop> loop(new G3DTParallelLoop());
+    loop->func = func;
+    loop->nItems = nItems;
+    loop->nextItem = 0;
+    loop->nRunning = 0;
+    loop->stopped = false;
+    loop->token = token;
+
+    for (int iThread = 1; iThread < nThreads; iThread++)
+        G3DTExecutor::getGlobal()->submit([loop, iThread]() { loop->work(iThread); });
+    loop->work(0);
+
+    std::unique_lock<std::mutex> lock(loop->mutex);
+    loop->finished.wait(lock, [&loop]() { return loop->nRunning == 0; });
+    return !loop->stopped;
+}
+
+
+/*!
+ * \brief Calls a function for each item in [0, nItems) in parallel.
+ * \param nItems Number of items.
+ * \param func Function called with the item index.
+ * \param nThreads Number of threads, or 0 for the default number of threads.
+ * \return True, if all items were processed.
+ */
+bool G3DTParallel::forEach(qint64 nItems, std::function<void(qint64 iItem)> func, int nThreads)
+{
+    return forEach(nItems, [&func](qint64 iItem, int) { func(iItem); }, nThreads);
+}
+
+
+/*!
+ * \brief Calls a function for each item in [0, nItems) in parallel, preferably on threads of the NUMA node
+ *        owning the item's memory. Helpers are spread over nodes by their numbers of items; threads
+ *        take items of other nodes once their own node has none left. Threads of the node should be pinned
+ *        (G3DTExecutor::setThreadPinning()) for the node assignment to hold. Without several nodes,
+ *        the loop equals forEach().
+ * \param nItems Number of items (e.g. raster blocks).
+ * \param nodeOf Function returning the node of an item, e.g. by G3DTNumaBuffer::getNode(); -1 for any node.
+ * \param func Function called with the item index and thread slot index in [0, nThreads).
+ * \param nThreads Number of threads, or 0 for the default number of threads.
+ * \return True, if all items were processed; false if the loop was cancelled or its deadline passed.
+ */
+bool G3DTParallel::forEachOnNodes(qint64 nItems, std::function<int(qint64 iItem)> nodeOf, std::function<void(qint64 iItem, int iThread)> func,
+                                  int nThreads)
+{
+    G3DTExecutor *executor = G3DTExecutor::getGlobal();
+    int nNodes = executor->getNumberOfNodes();
+
+    if (nNodes <= 1) return forEach(nItems, func, nThreads);
+    if (nItems <= 0) return true;
+    if (nThreads <= 0) nThreads = getNumberOfThreads();
+    if (nItems < nThreads) nThreads = int(nItems);
+
+    std::shared_ptr<G3DTParallelLoop> loop(new G3DTParallelLoop());
+    loop->func = func;
+    loop->nItems = nItems;
+    loop->nextItem = 0;
+    loop->nodeItems.resize(size_t(nNodes));
+    loop->nodeNext.reset(new std::atomic<qint64>[size_t(nNodes)]);
+    loop->nRunning = 0;
+    loop->stopped = false;
+    loop->token = G3DTCancelToken::getCurrent();
+
+    for (qint64 iItem = 0; iItem < nItems; iItem++)
+    {
+        int node = nodeOf(iItem);
+        if ((node < 0) || (nNodes <= node)) node = int(iItem % nNodes);
+        loop->nodeItems[size_t(node)].push_back(iItem);
+    }
+    for (int iNode = 0; iNode < nNodes; iNode++)
+        loop->nodeNext[iNode] = 0;
+
+    qint64 nAssigned = 0;
+    for (int iNode = 0, iThread = 1; iNode < nNodes; iNode++)
+    {
+        nAssigned += qint64(loop->nodeItems[size_t(iNode)].size());
+        for (int last = int(nAssigned * nThreads / nItems); iThread < last; iThread++)
+            executor->submit([loop, iThread]() { loop->work(iThread); }, iNode);
+    }
+    loop->work(0);
+
+    std::unique_lock<std::mutex> lock(loop->mutex);
+    loop->finished.wait(lock, [&loop]() { return loop->nRunning == 0; });
+    return !loop->stopped;
+}
@@ -0,0 +1,40 @@
+#ifndef G3DTPARALLEL_H
+#define G3DTPARALLEL_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file g3dtparallel.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <functional>
+#include "g3dtcore_global.h"
+
+
+/*!
+ * \brief The G3DTParallel provides block-parallel loops executed on the global G3DTExecutor.
+ *        Items are distributed dynamically; the calling thread takes part in the work. Loops started
+ *        inside executor tasks queue their helpers on the calling thread, where idle threads steal them.
+ *        Loops stop early when the current G3DTCancelToken of the calling thread is cancelled or expires
+ *        and then return false; kernels built on them pass the false on and skip passes depending on the stopped
+ *        loop. Loops yield to jobs with positive priorities between items.
+ *        forEachOnNodes() runs items on threads of the NUMA node holding their memory.
+ */
+class G3DTCORE_EXPORT G3DTParallel
+{
+public:
+    static int getNumberOfThreads();
+    static bool forEach(qint64 nItems, std::function<void(qint64 iItem, int iThread)> func, int nThreads = 0);
+    static bool forEach(qint64 nItems, std::function<void(qint64 iItem)> func, int nThreads = 0);
+    static bool forEachOnNodes(qint64 nItems, std::function<int(qint64 iItem)> nodeOf, std::function<void(qint64 iItem, int iThread)> func,
+                               int nThreads = 0);
+};
+
+#endif // G3DTPARALLEL_H
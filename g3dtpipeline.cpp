@@ -0,0 +1,582 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file g3dtpipeline.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <chrono>
+#include <thread>
+#include "g3dtexecutor.h"
+#include "g3dtpipeline.h"
+
+
+G3DTPipelineChunk::G3DTPipelineChunk()
+{
+    index = -1;
+    cellType = RasterCell::Undefined;
+}
+
+
+/*!
+ * \brief Allocates data for all cells of the block.
+ * \param cellType Cell type.
+ * \return True, if successful.
+ */
+bool G3DTPipelineChunk::allocate(RasterCell::Type cellType)
+{
+    qint64 nBytes = block.getNumberOfCells() * RasterCell::getSize(cellType);
+
+    if ((nBytes <= 0) || (0x7fffffff < nBytes)) return false;
+    this->cellType = cellType;
+    data.resize(int(nBytes));
+    return true;
+}
+
+
+/*!
+ * \return View of the chunk data in BSQ order, invalid if no data are allocated.
+ */
+RasterView G3DTPipelineChunk::getView()
+{
+    RasterSize3DT size(block.getNumberOfColumns(), block.getNumberOfRows(), block.getNumberOfLayers(), block.getNumberOfBands(), block.getNumberOfTicks());
+
+    if (data.isEmpty() || (data.size() < size.getNumberOfCells() * RasterCell::getSize(cellType))) return RasterView();
+    return RasterView(data.data(), cellType, &size);
+}
+
+
+/*!
+ * \brief Constructor.
+ * \param capacity Maximum number of queued chunks.
+ */
+G3DTPipelineQueue::G3DTPipelineQueue(qint64 capacity)
+    : head(0), tail(0)
+{
+    qint64 nSlots = 2;
+
+    this->capacity = qMax(capacity, qint64(1));
+    while (nSlots < this->capacity) nSlots *= 2;
+    slots = new Slot[size_t(nSlots)];
+    for (qint64 i = 0; i < nSlots; i++)
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    mask = nSlots - 1;
+}
+
+
+G3DTPipelineQueue::~G3DTPipelineQueue()
+{
+    delete[] slots;
+}
+
+
+/*!
+ * \return Capacity of the queue.
+ */
+qint64 G3DTPipelineQueue::getCapacity()
+{
+    return capacity;
+}
+
+
+/*!
+ * \brief Appends a chunk.
+ * \return False, if the queue is full.
+ */
+bool G3DTPipelineQueue::push(const G3DTPipelineChunkPtr &chunk)
+{
+    Slot *slot;
+    qint64 position = tail.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+        slot = &slots[position & mask];
+        qint64 difference = slot->sequence.load(std::memory_order_acquire) - position;
+        if (difference == 0)
+        {
+            if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+        }
+        else if (difference < 0) return false;
+        else position = tail.load(std::memory_order_relaxed);
+    }
+    slot->chunk = chunk;
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+
+/*!
+ * \brief Removes the oldest chunk.
+ * \param chunk Removed chunk.
+ * \return False, if the queue is empty.
+ */
+bool G3DTPipelineQueue::pop(G3DTPipelineChunkPtr *chunk)
+{
+    Slot *slot;
+    qint64 position = head.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+        slot = &slots[position & mask];
+        qint64 difference = slot->sequence.load(std::memory_order_acquire) - (position + 1);
+        if (difference == 0)
+        {
+            if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+        }
+        else if (difference < 0) return false;
+        else position = head.load(std::memory_order_relaxed);
+    }
+    *chunk = slot->chunk;
+    slot->chunk.reset();
+    slot->sequence.store(position + mask + 1, std::memory_order_release);
+    return true;
+}
+
+
+/*!
+ * \brief Connection of two stages. reserved counts queued chunks, chunks held by the consumer
+ *        and slots reserved by running producer tasks.
+ */
+struct G3DTPipeline::Edge
+{
+    Stage *from;
+    Stage *to;
+    int iInput; //!< input index of the edge in the consuming stage
+    G3DTPipelineQueue *queue;
+    std::atomic<qint64> reserved;
+
+    Edge(qint64 capacity) : queue(new G3DTPipelineQueue(capacity)), reserved(0) {}
+    ~Edge() { delete queue; }
+};
+
+
+/*!
+ * \brief Processing stage. Fields without atomics are used by the pump only.
+ */
+struct G3DTPipeline::Stage
+{
+    QString name;
+    StageFunction func;
+    int nThreads;
+    std::vector<Edge *> inputs;
+    std::vector<Edge *> outputs;
+    std::atomic<int> running;
+    std::atomic<qint64> nProcessed;
+    std::atomic<qint64> busyNanoseconds;
+    G3DTHistogram *latency; //!< chunk latencies in metrics, nullptr if not collected
+    qint64 nextIndex; //!< next chunk created by a source
+    std::map<qint64, std::vector<G3DTPipelineChunkPtr>> pending; //!< received input chunks by block index
+    std::map<qint64, int> nReceived; //!< number of received inputs of pending chunks
+    bool finished;
+
+    Stage() : running(0), nProcessed(0), busyNanoseconds(0), latency(nullptr) {}
+};
+
+
+G3DTPipeline::G3DTPipeline()
+    : nRunning(0), nTasks(0), pumpRequests(0), failed(false)
+{
+    queueCapacity = 4;
+    metrics = nullptr;
+    schedule = nullptr;
+    progress = nullptr;
+    token = nullptr;
+    done = false;
+}
+
+
+G3DTPipeline::~G3DTPipeline()
+{
+    clear();
+}
+
+
+/*!
+ * \brief Adds a stage.
+ * \param name Name of the stage used in messages.
+ * \param func Stage function, called concurrently by up to nThreads tasks.
+ * \param nThreads Maximum number of concurrently processed chunks of the stage.
+ * \return Index of the stage.
+ */
+int G3DTPipeline::addStage(QString name, StageFunction func, int nThreads)
+{
+    Stage *stage = new Stage();
+
+    stage->name = name;
+    stage->func = func;
+    stage->nThreads = qMax(nThreads, 1);
+    stage->nextIndex = 0;
+    stage->finished = false;
+    stages.push_back(stage);
+    return int(stages.size()) - 1;
+}
+
+
+/*!
+ * \brief Connects output of a stage to the next input of another stage.
+ * \param fromStage Producing stage.
+ * \param toStage Consuming stage.
+ * \param capacity Maximum number of chunks on the edge, 0 for queueCapacity.
+ * \return True, if successful.
+ */
+bool G3DTPipeline::connect(int fromStage, int toStage, int capacity)
+{
+    if ((fromStage < 0) || (int(stages.size()) <= fromStage) || (toStage < 0) || (int(stages.size()) <= toStage) || (fromStage == toStage))
+        return fail("Invalid pipeline stages.");
+
+    Edge *edge = new Edge((0 < capacity) ? capacity : qMax(queueCapacity, 1));
+    edge->from = stages[size_t(fromStage)];
+    edge->to = stages[size_t(toStage)];
+    edge->iInput = int(edge->to->inputs.size());
+    edge->from->outputs.push_back(edge);
+    edge->to->inputs.push_back(edge);
+    edges.push_back(edge);
+    return true;
+}
+
+
+/*!
+ * \brief Removes all stages and edges.
+ */
+void G3DTPipeline::clear()
+{
+    for (size_t i = 0; i < edges.size(); i++)
+        delete edges[i];
+    edges.clear();
+    for (size_t i = 0; i < stages.size(); i++)
+        delete stages[i];
+    stages.clear();
+    order.clear();
+}
+
+
+/*!
+ * \return Number of stages.
+ */
+int G3DTPipeline::getNumberOfStages()
+{
+    return int(stages.size());
+}
+
+
+/*!
+ * \param iStage Stage index.
+ * \return Name of the stage.
+ */
+QString G3DTPipeline::getStageName(int iStage)
+{
+    return stages[size_t(iStage)]->name;
+}
+
+
+/*!
+ * \param iStage Stage index.
+ * \return Number of chunks processed by the stage in the last run.
+ */
+qint64 G3DTPipeline::getNumberOfProcessed(int iStage)
+{
+    return stages[size_t(iStage)]->nProcessed;
+}
+
+
+/*!
+ * \param iStage Stage index.
+ * \return Time spent in the stage function by all its tasks in the last run in seconds.
+ *         The stage with the highest time per thread limits the throughput.
+ */
+double G3DTPipeline::getBusySeconds(int iStage)
+{
+    return double(stages[size_t(iStage)]->busyNanoseconds) * 1e-9;
+}
+
+
+/*!
+ * \brief Streams all blocks of a schedule through the pipeline. Returns when all stages finished.
+ *        Called from an executor thread, the thread runs queued tasks while waiting.
+ * \param schedule Blocks; every source stage creates one chunk for each of them.
+ * \param progress Progress counting chunks completed by sink stages, may be nullptr.
+ * \return True, if all chunks passed all stages.
+ */
+bool G3DTPipeline::run(const std::vector<RasterBlock> &schedule, G3DTProgress *progress)
+{
+    G3DTExecutor *executor = G3DTExecutor::getGlobal();
+    bool helping = (0 <= G3DTExecutor::getCurrentThread());
+    qint64 nSinks = 0;
+
+    errorString = "";
+    failed = false;
+    if (stages.empty()) return fail("Pipeline has no stages.");
+    if (!sortStages()) return false;
+
+    for (size_t i = 0; i < stages.size(); i++)
+    {
+        Stage *stage = stages[i];
+        stage->nProcessed = 0;
+        stage->busyNanoseconds = 0;
+        stage->nextIndex = 0;
+        stage->finished = false;
+        stage->latency = metrics ? metrics->getHistogram("pipeline." + stage->name) : nullptr;
+        if (stage->outputs.empty()) nSinks++;
+    }
+    this->schedule = &schedule;
+    this->progress = progress;
+    this->token = G3DTCancelToken::getCurrent();
+    if (progress) progress->setTotal(qint64(schedule.size()) * nSinks);
+    done = false;
+
+    pump();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!done)
+        {
+            if (helping)
+            {
+                lock.unlock();
+                bool ran = executor->runPending();
+                lock.lock();
+                if (ran) continue;
+            }
+            completed.wait_for(lock, std::chrono::milliseconds(1));
+        }
+    }
+    while (nTasks != 0) std::this_thread::yield();
+
+    for (size_t i = 0; i < stages.size(); i++)
+    {
+        stages[i]->pending.clear();
+        stages[i]->nReceived.clear();
+    }
+    for (size_t i = 0; i < edges.size(); i++)
+    {
+        G3DTPipelineChunkPtr chunk;
+        while (edges[i]->queue->pop(&chunk)) {}
+        edges[i]->reserved = 0;
+    }
+    this->schedule = nullptr;
+
+    if (!failed && token && token->isStopped()) fail("Pipeline stopped: " + G3DTCancelToken::toString(token->getState()) + ".");
+    return !failed;
+}
+
+
+bool G3DTPipeline::fail(QString message)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!failed)
+    {
+        errorString = message;
+        failed = true;
+    }
+    return false;
+}
+
+
+/*!
+ * \brief Orders stages topologically into order, producers first.
+ * \return False, if the stages contain a cycle.
+ */
+bool G3DTPipeline::sortStages()
+{
+    std::vector<Stage *> sorted;
+    std::map<Stage *, size_t> nInputs;
+
+    for (size_t i = 0; i < stages.size(); i++)
+    {
+        nInputs[stages[i]] = stages[i]->inputs.size();
+        if (stages[i]->inputs.empty()) sorted.push_back(stages[i]);
+    }
+    for (size_t i = 0; i < sorted.size(); i++)
+    {
+        for (size_t j = 0; j < sorted[i]->outputs.size(); j++)
+        {
+            Stage *next = sorted[i]->outputs[j]->to;
+            if (--nInputs[next] == 0) sorted.push_back(next);
+        }
+    }
+    if (sorted.size() != stages.size()) return fail("Pipeline stages contain a cycle.");
+    order = sorted;
+    return true;
+}
+
+
+/*!
+ * \brief Starts stage tasks that have inputs and free output slots. Pumps never run concurrently:
+ *        a request arriving during a pump is served by the running pump, which repeats.
+ *        The pump that finds no running tasks and nothing to start completes the run.
+ */
+void G3DTPipeline::pump()
+{
+    int nHandled;
+    bool complete = false;
+
+    if (pumpRequests.fetch_add(1) != 0) return;
+    do
+    {
+        nHandled = pumpRequests;
+
+        bool idle = (nRunning == 0);
+        bool stopping = failed || (token && token->isStopped());
+        bool started = false, allFinished = true;
+
+        for (size_t i = order.size(); !stopping && (0 < i); i--)
+            started = startTasks(order[i - 1]) || started;
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            order[i]->finished = isFinished(order[i]);
+            allFinished = allFinished && order[i]->finished;
+        }
+        if (idle && !started)
+        {
+            if (!stopping && !allFinished) fail("Pipeline stalled: increase capacity of edges into stages with several inputs.");
+            complete = true;
+        }
+    }
+    while (pumpRequests.fetch_sub(nHandled) != nHandled);
+
+    if (complete) setDone();
+}
+
+
+/*!
+ * \brief Starts tasks of a stage while it has ready inputs, free threads and free output slots.
+ * \return True, if a task started.
+ */
+bool G3DTPipeline::startTasks(Stage *stage)
+{
+    bool started = false;
+    G3DTPipelineChunkPtr chunk;
+
+    for (size_t i = 0; i < stage->inputs.size(); i++)
+    {
+        Edge *edge = stage->inputs[i];
+        while (edge->queue->pop(&chunk))
+        {
+            std::vector<G3DTPipelineChunkPtr> &received = stage->pending[chunk->index];
+            if (received.empty()) received.resize(stage->inputs.size());
+            received[size_t(edge->iInput)] = chunk;
+            stage->nReceived[chunk->index]++;
+        }
+    }
+
+    while (stage->running < stage->nThreads)
+    {
+        std::vector<G3DTPipelineChunkPtr> inputs;
+        qint64 index = -1;
+        bool available = true;
+
+        for (size_t i = 0; available && (i < stage->outputs.size()); i++)
+            available = (stage->outputs[i]->reserved < stage->outputs[i]->queue->getCapacity());
+        if (!available) break;
+
+        if (stage->inputs.empty())
+        {
+            if (qint64(schedule->size()) <= stage->nextIndex) break;
+            index = stage->nextIndex++;
+        }
+        else
+        {
+            for (auto it = stage->nReceived.begin(); it != stage->nReceived.end(); ++it)
+            {
+                if (it->second < int(stage->inputs.size())) continue;
+                index = it->first;
+                inputs.swap(stage->pending[index]);
+                stage->pending.erase(index);
+                stage->nReceived.erase(it);
+                break;
+            }
+            if (index < 0) break;
+        }
+
+        chunk = std::make_shared<G3DTPipelineChunk>();
+        chunk->index = index;
+        chunk->block = (*schedule)[size_t(index)];
+        for (size_t i = 0; i < stage->outputs.size(); i++)
+            stage->outputs[i]->reserved++;
+        stage->running++;
+        nRunning++;
+        nTasks++;
+        G3DTExecutor::getGlobal()->submit([this, stage, chunk, inputs]() mutable {
+            runTask(stage, chunk, inputs);
+            nTasks--;
+        });
+        started = true;
+    }
+    return started;
+}
+
+
+/*!
+ * \return True, if the stage will not process further chunks. Producers must be evaluated first.
+ */
+bool G3DTPipeline::isFinished(Stage *stage)
+{
+    if (stage->running != 0) return false;
+    if (stage->inputs.empty()) return qint64(schedule->size()) <= stage->nextIndex;
+    for (size_t i = 0; i < stage->inputs.size(); i++)
+    {
+        Edge *edge = stage->inputs[i];
+        if (!edge->from->finished || (edge->reserved != 0)) return false;
+    }
+    return stage->pending.empty();
+}
+
+
+/*!
+ * \brief Processes a chunk, passes it to the output edges and releases the input slots.
+ *        The chunks are released here, as soon as they are not needed.
+ */
+void G3DTPipeline::runTask(Stage *stage, G3DTPipelineChunkPtr &chunk, std::vector<G3DTPipelineChunkPtr> &inputs)
+{
+    G3DTCancelToken *previous = G3DTCancelToken::setCurrent(token);
+    bool ok = !failed && (!token || token->check());
+
+    if (ok)
+    {
+        std::vector<G3DTPipelineChunk *> inputChunks(inputs.size());
+        qint64 start = G3DTMetrics::now(), duration;
+
+        for (size_t i = 0; i < inputs.size(); i++)
+            inputChunks[i] = inputs[i].get();
+        ok = stage->func(chunk.get(), inputChunks);
+        duration = G3DTMetrics::now() - start;
+        stage->busyNanoseconds += duration;
+        if (stage->latency) stage->latency->record(duration);
+        if (!ok) fail(QString("Pipeline stage %1 failed at block %2.").arg(stage->name).arg(chunk->index));
+    }
+    G3DTCancelToken::setCurrent(previous);
+
+    for (size_t i = 0; i < stage->outputs.size(); i++)
+    {
+        if (!ok || !stage->outputs[i]->queue->push(chunk)) stage->outputs[i]->reserved--;
+    }
+    if (ok)
+    {
+        stage->nProcessed++;
+        if (progress && stage->outputs.empty()) progress->add();
+    }
+    chunk.reset();
+    inputs.clear();
+    for (size_t i = 0; i < stage->inputs.size(); i++)
+        stage->inputs[i]->reserved--;
+
+    stage->running--;
+    nRunning--;
+    pump();
+}
+
+
+/*!
+ * \brief Signals run() that the pipeline completed.
+ */
+void G3DTPipeline::setDone()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+    completed.notify_all();
+}
@@ -0,0 +1,160 @@
+#ifndef G3DTPIPELINE_H
+#define G3DTPIPELINE_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file g3dtpipeline.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <QByteArray>
+#include <QString>
+#include "g3dtcore_global.h"
+#include "g3dtcanceltoken.h"
+#include "g3dtmetrics.h"
+#include "g3dtprogress.h"
+#include "Geometry/rasterblock.h"
+#include "Raster/rasterview.h"
+
+
+/*!
+ * \brief The G3DTPipelineChunk is a block of cells passed between pipeline stages.
+ *        Chunks received from other stages are shared and must not be modified.
+ */
+class G3DTCORE_EXPORT G3DTPipelineChunk
+{
+public:
+    qint64 index; //!< index of the block in the schedule
+    RasterBlock block; //!< cells of the chunk
+    RasterCell::Type cellType; //!< type of cells in data
+    QByteArray data; //!< cells of the block in BSQ order, filled by the producing stage
+
+public:
+    G3DTPipelineChunk();
+
+    bool allocate(RasterCell::Type cellType);
+    RasterView getView();
+};
+
+typedef std::shared_ptr<G3DTPipelineChunk> G3DTPipelineChunkPtr;
+
+
+/*!
+ * \brief The G3DTPipelineQueue is a bounded lock-free multi-producer multi-consumer queue of chunks.
+ *        Every slot carries a sequence number telling producers and consumers whose turn it is,
+ *        so push() and pop() only contend on the head and tail counters.
+ */
+class G3DTCORE_EXPORT G3DTPipelineQueue
+{
+public:
+    explicit G3DTPipelineQueue(qint64 capacity);
+    ~G3DTPipelineQueue();
+
+    qint64 getCapacity();
+    bool push(const G3DTPipelineChunkPtr &chunk);
+    bool pop(G3DTPipelineChunkPtr *chunk);
+
+private:
+    struct Slot
+    {
+        std::atomic<qint64> sequence;
+        G3DTPipelineChunkPtr chunk;
+    };
+
+    Slot *slots;
+    qint64 mask;
+    qint64 capacity;
+    std::atomic<qint64> head; //!< next slot to pop
+    std::atomic<qint64> tail; //!< next slot to push
+
+    G3DTPipelineQueue(const G3DTPipelineQueue &) = delete;
+    G3DTPipelineQueue &operator=(const G3DTPipelineQueue &) = delete;
+};
+
+
+/*!
+ * \brief The G3DTPipeline streams blocks through a directed acyclic graph of processing stages.
+ *
+ *        Stages exchange chunks of one block through bounded queues (edges) instead of materializing
+ *        intermediate rasters, so an edge holds at most its capacity of chunks. Every chunk of the schedule
+ *        is created by each source stage (a stage without inputs) and flows through the graph; a stage with
+ *        several inputs receives the chunks of the same block index from all of them. Stages run concurrently
+ *        on the global G3DTExecutor, each on up to its own number of threads.
+ *
+ *        Backpressure: a stage task starts only when every output edge has a free slot, which it reserves;
+ *        the slot is released when the consuming stage finished the chunk. Slow stages thus stall their
+ *        producers instead of accumulating chunks. Edges into a stage with several inputs should hold
+ *        more chunks than threads of the faster branch, which may run ahead.
+ *
+ *        The current G3DTCancelToken of the calling thread stops the pipeline; stage functions run with it.
+ */
+class G3DTCORE_EXPORT G3DTPipeline
+{
+public:
+    /*!
+     * \brief Stage function. It fills chunk (index and block set) from inputs ordered as connected.
+     *        Sources receive no inputs, sinks fill nothing. Returning false stops the pipeline.
+     */
+    typedef std::function<bool(G3DTPipelineChunk *chunk, const std::vector<G3DTPipelineChunk *> &inputs)> StageFunction;
+
+    int queueCapacity; //!< default number of chunks of an edge
+    G3DTMetrics *metrics; //!< receives the chunk latency histogram "pipeline.<stage name>" of every stage, may be nullptr
+    QString errorString; //!< description of the last error
+
+public:
+    G3DTPipeline();
+    ~G3DTPipeline();
+
+    int addStage(QString name, StageFunction func, int nThreads = 1);
+    bool connect(int fromStage, int toStage, int capacity = 0);
+    void clear();
+
+    int getNumberOfStages();
+    QString getStageName(int iStage);
+    qint64 getNumberOfProcessed(int iStage);
+    double getBusySeconds(int iStage);
+
+    bool run(const std::vector<RasterBlock> &schedule, G3DTProgress *progress = nullptr);
+
+private:
+    struct Edge;
+    struct Stage;
+
+    std::vector<Stage *> stages;
+    std::vector<Stage *> order; //!< stages in topological order
+    std::vector<Edge *> edges;
+    const std::vector<RasterBlock> *schedule;
+    G3DTProgress *progress;
+    G3DTCancelToken *token;
+    std::atomic<int> nRunning; //!< running stage tasks
+    std::atomic<int> nTasks; //!< submitted tasks not yet returned, the pipeline must outlive them
+    std::atomic<int> pumpRequests;
+    std::atomic<bool> failed;
+    bool done;
+    std::mutex mutex;
+    std::condition_variable completed;
+
+    bool fail(QString message);
+    bool sortStages();
+    void pump();
+    bool startTasks(Stage *stage);
+    bool isFinished(Stage *stage);
+    void runTask(Stage *stage, G3DTPipelineChunkPtr &chunk, std::vector<G3DTPipelineChunkPtr> &inputs);
+    void setDone();
+};
+
+#endif // G3DTPIPELINE_H
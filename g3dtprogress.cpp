@@ -0,0 +1,310 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file g3dtprogress.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+#include "g3dtprogress.h"
+
+
+/*!
+ * \brief Registered report of the sampler.
+ */
+struct G3DTProgressReport
+{
+    G3DTProgress *progress;
+    std::function<void(G3DTProgress *)> report;
+    std::chrono::milliseconds interval;
+    std::chrono::steady_clock::time_point due;
+};
+
+
+/*!
+ * \brief Thread calling registered reports at their intervals. It is started with the first report.
+ *        Reports are called under the sampler mutex, so a removed report is never called afterwards.
+ */
+struct G3DTProgressSampler
+{
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<G3DTProgressReport> reports;
+    std::thread thread;
+    bool stopping;
+
+    G3DTProgressSampler()
+    {
+        stopping = false;
+    }
+
+    ~G3DTProgressSampler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        if (thread.joinable()) thread.join();
+    }
+
+    void add(const G3DTProgressReport &report)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        reports.push_back(report);
+        if (!thread.joinable()) thread = std::thread(&G3DTProgressSampler::loop, this);
+        changed.notify_all();
+    }
+
+    void remove(G3DTProgress *progress)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < reports.size(); i++)
+        {
+            if (reports[i].progress != progress) continue;
+            reports.erase(reports.begin() + qint64(i));
+            break;
+        }
+    }
+
+    void loop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (!stopping)
+        {
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            std::chrono::steady_clock::time_point next = now + std::chrono::seconds(60);
+
+            for (size_t i = 0; i < reports.size(); i++)
+            {
+                G3DTProgressReport *report = &reports[i];
+                if (report->due <= now)
+                {
+                    report->report(report->progress);
+                    report->due = now + report->interval;
+                }
+                if (report->due < next) next = report->due;
+            }
+            changed.wait_until(lock, next);
+        }
+    }
+};
+
+
+static G3DTProgressSampler *g3dtProgressSampler()
+{
+    static G3DTProgressSampler sampler;
+    return &sampler;
+}
+
+
+/*!
+ * \brief Constructor.
+ * \param weight Weight among stages of the parent progress.
+ */
+G3DTProgress::G3DTProgress(double weight)
+    : completed(0), total(0), finished(false), reporting(false)
+{
+    this->weight = weight;
+    timer.start();
+}
+
+
+/*!
+ * \brief Destructor. Stops reporting and deletes stages.
+ */
+G3DTProgress::~G3DTProgress()
+{
+    if (reporting) g3dtProgressSampler()->remove(this);
+    for (size_t i = 0; i < stages.size(); i++)
+        delete stages[i];
+}
+
+
+/*!
+ * \brief Starts counting again: clears completed units, removes stages and restarts the elapsed time.
+ *        Must not run concurrently with add() or addStage().
+ * \param total Total number of units, 0 if the progress consists of stages only.
+ */
+void G3DTProgress::reset(qint64 total)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (size_t i = 0; i < stages.size(); i++)
+        delete stages[i];
+    stages.clear();
+    completed = 0;
+    this->total = total;
+    finished = false;
+    timer.restart();
+}
+
+
+/*!
+ * \param total Total number of units.
+ */
+void G3DTProgress::setTotal(qint64 total)
+{
+    this->total = total;
+}
+
+
+/*!
+ * \return Total number of units.
+ */
+qint64 G3DTProgress::getTotal()
+{
+    return total;
+}
+
+
+/*!
+ * \return Number of completed units.
+ */
+qint64 G3DTProgress::getCompleted()
+{
+    return completed.load(std::memory_order_relaxed);
+}
+
+
+/*!
+ * \brief Marks the progress as complete, regardless of counted units.
+ */
+void G3DTProgress::finish()
+{
+    finished = true;
+}
+
+
+/*!
+ * \brief Adds a stage. The stage is owned by this progress.
+ * \param weight Share of the stage in this progress, e.g. its expected duration.
+ * \param total Total number of units of the stage.
+ * \return Pointer to the stage.
+ */
+G3DTProgress *G3DTProgress::addStage(double weight, qint64 total)
+{
+    G3DTProgress *stage = new G3DTProgress(weight);
+    std::lock_guard<std::mutex> lock(mutex);
+
+    stage->total = total;
+    stages.push_back(stage);
+    return stage;
+}
+
+
+/*!
+ * \return Weight among stages of the parent progress.
+ */
+double G3DTProgress::getWeight()
+{
+    return weight;
+}
+
+
+/*!
+ * \return Completed fraction in [0, 1].
+ */
+double G3DTProgress::getFraction()
+{
+    double sum = 0.0, sumWeights = 0.0;
+    qint64 n = total;
+
+    if (finished) return 1.0;
+    if (0 < n)
+    {
+        sum = qMin(double(getCompleted()) / double(n), 1.0);
+        sumWeights = 1.0;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < stages.size(); i++)
+    {
+        sum += stages[i]->weight * stages[i]->getFraction();
+        sumWeights += stages[i]->weight;
+    }
+    return (0.0 < sumWeights) ? sum / sumWeights : 0.0;
+}
+
+
+/*!
+ * \return Completed percentage in [0, 100].
+ */
+int G3DTProgress::getPercentage()
+{
+    return int(100.0 * getFraction());
+}
+
+
+/*!
+ * \return Seconds since construction or reset().
+ */
+double G3DTProgress::getElapsedSeconds()
+{
+    return double(timer.nsecsElapsed()) * 1e-9;
+}
+
+
+/*!
+ * \brief Estimates the remaining time from the mean rate since the start.
+ * \return Estimated remaining seconds, -1 before any progress.
+ */
+double G3DTProgress::getRemainingSeconds()
+{
+    double fraction = getFraction();
+
+    if (fraction <= 0.0) return -1.0;
+    return getElapsedSeconds() * (1.0 - fraction) / fraction;
+}
+
+
+/*!
+ * \brief Calls a function with this progress every interval on the sampler thread.
+ * \param report Function reporting the progress, e.g. emitting a signal. It must not call stopReporting().
+ * \param intervalMs Interval in milliseconds.
+ * \return True, if reporting started; false if it is already running.
+ */
+bool G3DTProgress::startReporting(std::function<void(G3DTProgress *progress)> report, int intervalMs)
+{
+    G3DTProgressReport entry;
+
+    if (!report || reporting.exchange(true)) return false;
+    entry.progress = this;
+    entry.report = report;
+    entry.interval = std::chrono::milliseconds(qMax(intervalMs, 1));
+    entry.due = std::chrono::steady_clock::now();
+    g3dtProgressSampler()->add(entry);
+    reportFunction = report;
+    return true;
+}
+
+
+/*!
+ * \brief Stops periodic reporting and reports the final progress on the calling thread.
+ */
+void G3DTProgress::stopReporting()
+{
+    if (!reporting) return;
+    g3dtProgressSampler()->remove(this);
+    reportFunction(this);
+    reportFunction = nullptr;
+    reporting = false;
+}
+
+
+/*!
+ * \return True, if the progress is being reported.
+ */
+bool G3DTProgress::isReporting()
+{
+    return reporting;
+}
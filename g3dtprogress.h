@@ -0,0 +1,81 @@
+#ifndef G3DTPROGRESS_H
+#define G3DTPROGRESS_H
+
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file g3dtprogress.h
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <QElapsedTimer>
+#include "g3dtcore_global.h"
+
+
+/*!
+ * \brief The G3DTProgress counts completed work units (cells, blocks) of a job.
+ *
+ *        add() is a relaxed atomic increment, cheap enough for inner loops and safe from any thread;
+ *        nothing is reported by it. Progress is instead sampled at a fixed rate: startReporting() registers
+ *        a callback called by a single process-wide sampler thread every interval, and once more by
+ *        stopReporting().
+ *
+ *        A multi-stage job splits its progress into weighted stages by addStage(); every stage counts
+ *        its own units and may have stages of its own. The fraction of a progress is the weighted mean
+ *        of the fractions of its own units (weight 1, if it has a total) and of its stages.
+ */
+class G3DTCORE_EXPORT G3DTProgress
+{
+public:
+    G3DTProgress(double weight = 1.0);
+    ~G3DTProgress();
+
+    void reset(qint64 total = 0);
+    void setTotal(qint64 total);
+    qint64 getTotal();
+    qint64 getCompleted();
+    void finish();
+
+    /*!
+     * \brief Adds completed work units. May be called from several threads.
+     */
+    inline void add(qint64 units = 1)
+    {
+        completed.fetch_add(units, std::memory_order_relaxed);
+    }
+
+    G3DTProgress *addStage(double weight, qint64 total = 0);
+    double getWeight();
+
+    double getFraction();
+    int getPercentage();
+    double getElapsedSeconds();
+    double getRemainingSeconds();
+
+    bool startReporting(std::function<void(G3DTProgress *progress)> report, int intervalMs = 250);
+    void stopReporting();
+    bool isReporting();
+
+private:
+    std::atomic<qint64> completed;
+    std::atomic<qint64> total;
+    std::atomic<bool> finished;
+    double weight; //!< weight among stages of the parent
+    std::vector<G3DTProgress *> stages;
+    std::mutex mutex; //!< guards stages
+    QElapsedTimer timer;
+    std::atomic<bool> reporting;
+    std::function<void(G3DTProgress *)> reportFunction;
+};
+
+#endif // G3DTPROGRESS_H
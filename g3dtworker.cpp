@@ -11,13 +11,34 @@
  * *****************************************************************
  */
 
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include "g3dtworker.h"
+#include "g3dtexecutor.h"
+#include "g3dtparallel.h"
 
 
-G3DTWorker::G3DTWorker(QObject *parent) : QThread(parent)
+G3DTWorker::G3DTWorker(QObject *parent) : QObject(parent), nsStarted(0), nsFinished(0)
 {
     this->dtStarted = QDateTime::currentDateTime();
     this->dtFinished = QDateTime::currentDateTime();
+    this->state = Idle;
+    this->progressInterval = 250;
+    this->priority = 0;
+    this->reportedPercentage = -1;
+}
+
+
+/*!
+ * \brief Destructor. The job must not be queued or running any more: the derived part of the object is already
+ *        destroyed here, so a derived class whose job may still run must call wait() in its own destructor.
+ *        Debug builds assert it; otherwise the destructor still waits, keeping the base members alive.
+ */
+G3DTWorker::~G3DTWorker()
+{
+    Q_ASSERT_X(wait(0), "G3DTWorker::~G3DTWorker", "a derived class must wait() for its job in its destructor");
+    wait();
 }
 
 QString G3DTWorker::processingTimeToString()
@@ -26,14 +47,7 @@ QString G3DTWorker::processingTimeToString()
     qint64 h, m;
     double s;
 
-    if (this->isRunning())
-    {
-        ms = QDateTime::currentMSecsSinceEpoch() - this->dtStarted.toMSecsSinceEpoch();
-    }
-    else
-    {
-        ms = this->dtFinished.toMSecsSinceEpoch() - this->dtStarted.toMSecsSinceEpoch();
-    }
+    ms = getElapsedNanoseconds() / 1000000;
 
     h = ms / (60 * 60 * 1000);
     ms = ms % (60 * 60 * 1000);
@@ -46,35 +60,336 @@ QString G3DTWorker::processingTimeToString()
 
 double G3DTWorker::processingTimeInSeconds()
 {
-    if (this->isRunning())
+    return double(getElapsedNanoseconds()) * 1e-9;
+}
+
+double G3DTWorker::processingTimeInMinutes()
+{
+    return processingTimeInSeconds() / 60.0;
+}
+
+
+/*!
+ * \brief Measures the processing time on the monotonic clock, unaffected by changes of the system time.
+ * \return Nanoseconds doWork() ran, or has been running so far; 0 before the first run.
+ */
+qint64 G3DTWorker::getElapsedNanoseconds()
+{
+    qint64 started = nsStarted, finished = nsFinished;
+
+    if (started == 0) return 0;
+    return ((finished < started) ? G3DTMetrics::now() : finished) - started;
+}
+
+/*!
+ * \brief Queues the job on the global executor. A queued or running job is not started again.
+ * \return True, if the job was queued.
+ */
+bool G3DTWorker::start()
+{
     {
-        return double(QDateTime::currentMSecsSinceEpoch() - this->dtStarted.toMSecsSinceEpoch())/1000.0;
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if ((state == Queued) || (state == Running)) return false;
+        state = Queued;
     }
-    else
+    cancelToken.reset();
+    std::shared_ptr<std::atomic<bool>> claimed(new std::atomic<bool>(false));
     {
-        return double(this->dtFinished.toMSecsSinceEpoch() - this->dtStarted.toMSecsSinceEpoch())/1000.0;
+        std::lock_guard<std::mutex> lock(stateMutex);
+        this->claimed = claimed;
     }
+    G3DTExecutor::getGlobal()->submitJob([this, claimed]() {
+        if (!claimed->exchange(true)) runJob();
+    }, priority);
+    return true;
 }
 
-double G3DTWorker::processingTimeInMinutes()
+
+/*!
+ * rief Runs the queued job on the calling thread, on an executor slot or inline in wait().
+ */
+void G3DTWorker::runJob()
 {
-    if (this->isRunning())
+    G3DTCancelToken *previous = G3DTCancelToken::setCurrent(&cancelToken);
+
+    setState(Running);
+    emit started();
+    progress.reset();
+    metrics.reset();
+    startProgress();
+    if (!cancelToken.isStopped()) run();
+    stopProgress();
+    G3DTCancelToken::setCurrent(previous);
+    emit finished();
+    setState(Finished);
+}
+
+
+/*!
+ * \return True, if doWork() is running.
+ */
+bool G3DTWorker::isRunning()
+{
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return state == Running;
+}
+
+
+/*!
+ * \return True, if the last started job finished.
+ */
+bool G3DTWorker::isFinished()
+{
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return state == Finished;
+}
+
+
+/*!
+ * \brief Waits until a queued or running job finishes.
+ *        On an executor thread (e.g. a job waiting for a nested job) the thread does not block its slot:
+ *        a job still waiting for a slot runs inline, and while the job runs elsewhere the thread runs
+ *        pending tasks, so waits cannot dead-lock once all job slots are held by waiting jobs.
+ *        wait(0) only tests the state.
+ * \param msecs Timeout in milliseconds, -1 to wait without a timeout.
+ * \return True, if no job is queued or running.
+ */
+bool G3DTWorker::wait(qint64 msecs)
+{
+    std::unique_lock<std::mutex> lock(stateMutex);
+    auto done = [this]() { return (state != Queued) && (state != Running); };
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(qMax(msecs, qint64(0)));
+    G3DTExecutor *executor = G3DTExecutor::getGlobal();
+
+    if ((msecs == 0) || (G3DTExecutor::getCurrentThread() < 0))
     {
-        return double(QDateTime::currentSecsSinceEpoch() - this->dtStarted.toSecsSinceEpoch())/60.0;
+        if (msecs < 0)
+        {
+            stateChanged.wait(lock, done);
+            return true;
+        }
+        return stateChanged.wait_for(lock, std::chrono::milliseconds(msecs), done);
     }
-    else
+
+    if ((state == Queued) && claimed && !claimed->exchange(true))
     {
-        return double(this->dtFinished.toSecsSinceEpoch() - this->dtStarted.toSecsSinceEpoch())/60.0;
+        lock.unlock();
+        runJob();
+        lock.lock();
     }
+    while (!done())
+    {
+        if ((0 <= msecs) && (deadline <= std::chrono::steady_clock::now())) return false;
+        lock.unlock();
+        bool ran = executor->runPending();
+        lock.lock();
+        if (!ran) stateChanged.wait_for(lock, std::chrono::milliseconds(1), done);
+    }
+    return true;
+}
+
+
+/*!
+ * \brief Requests the job to stop at its next check; a queued job does not run.
+ */
+void G3DTWorker::cancel()
+{
+    cancelToken.cancel();
+}
+
+
+/*!
+ * \brief Sets a deadline after which the job stops at its next check. Call after start().
+ * \param msecs Time from now in milliseconds.
+ */
+void G3DTWorker::setDeadline(qint64 msecs)
+{
+    cancelToken.setDeadline(msecs);
+}
+
+
+/*!
+ * \brief Pauses the job at its next check; its threads run other jobs meanwhile.
+ */
+void G3DTWorker::pause()
+{
+    cancelToken.pause();
+}
+
+
+/*!
+ * \brief Resumes a paused job.
+ */
+void G3DTWorker::resume()
+{
+    cancelToken.resume();
 }
 
+
+/*!
+ * \return True, if the job was cancelled or its deadline passed.
+ */
+bool G3DTWorker::isCancelled()
+{
+    return cancelToken.isStopped();
+}
+
+
+void G3DTWorker::setState(State state)
+{
+    std::lock_guard<std::mutex> lock(stateMutex);
+    this->state = state;
+    stateChanged.notify_all();
+}
+
+
+/*!
+ * \brief Starts sampling progress, unless it is already sampled.
+ * \return True, if sampling started.
+ */
+bool G3DTWorker::startProgress()
+{
+    if (progress.isReporting()) return false;
+    reportedPercentage = -1;
+    return progress.startReporting([this](G3DTProgress *p) {
+        int perc = p->getPercentage();
+        if (perc == reportedPercentage) return;
+        reportedPercentage = perc;
+        emit showPercentage(perc);
+    }, progressInterval);
+}
+
+
+/*!
+ * \brief Stops sampling progress and emits the final percentage.
+ */
+void G3DTWorker::stopProgress()
+{
+    progress.stopReporting();
+}
+
+
 void G3DTWorker::run()
 {
+    G3DTScopedTimer timer(metrics.getHistogram("doWork"));
+
     this->dtStarted = QDateTime::currentDateTime();
+    this->nsStarted = G3DTMetrics::now();
     doWork();
+    this->nsFinished = G3DTMetrics::now();
     this->dtFinished = QDateTime::currentDateTime();
 }
 
 void G3DTWorker::doWork()
 {
 }
+
+
+/*!
+ * \brief Processes a block schedule in parallel with checkpointing. If checkpointFileName is set, blocks
+ *        completed by a previous run of the same schedule are skipped and the job state is restored by
+ *        loadState(); completed blocks are committed to the journal with the state returned by saveState().
+ *        A block function merging into a shared reduction should do so by checkpoint.complete(iBlock, merge),
+ *        so that committed states match committed blocks; other blocks are completed when the function returns.
+ *        Results written by block functions must be durable when saveState() is called.
+ *        Processing stops early when cancelToken is cancelled or expires; completed blocks are committed,
+ *        so that a later run resumes the schedule.
+ * \param schedule Blocks of the job.
+ * \param func Function processing a block; returning false stops processing.
+ * \param nThreads Number of threads, 0 for default.
+ * \param stage Progress counting completed blocks, e.g. a stage of progress; nullptr to reset and use progress.
+ * \param timerName Name of the block latency histogram in metrics; the counter of cells is timerName + "Cells".
+ * \return True, if all blocks were completed.
+ */
+bool G3DTWorker::processBlocks(const std::vector<RasterBlock> &schedule, std::function<bool(qint64 iBlock, RasterBlock *block)> func, int nThreads,
+                               G3DTProgress *stage, QString timerName)
+{
+    G3DTHistogram *latency = metrics.getHistogram(timerName);
+    G3DTCounter *cells = metrics.getCounter(timerName + "Cells");
+    qint64 nBlocks = qint64(schedule.size());
+    std::atomic<bool> failed(false);
+    bool reporting, stopped;
+    G3DTCancelToken *previous;
+
+    checkpoint.saveState = nullptr;
+    if (checkpointFileName.isEmpty()) checkpoint.setNumberOfBlocks(nBlocks);
+    else if (!checkpoint.open(checkpointFileName, schedule))
+    {
+        emit showMessage(checkpoint.errorString);
+        return false;
+    }
+    if (checkpoint.isResumed())
+    {
+        if (!loadState(checkpoint.getState()))
+        {
+            checkpoint.close();
+            emit showMessage("Cannot restore the state of " + checkpointFileName + ".");
+            return false;
+        }
+        emit showMessage(QString("Resuming: %1 of %2 blocks completed.").arg(checkpoint.getNumberOfCompleted()).arg(nBlocks));
+    }
+    checkpoint.saveState = [this]() { return saveState(); };
+    if (stage)
+    {
+        stage->setTotal(nBlocks);
+    }
+    else
+    {
+        stage = &progress;
+        progress.reset(nBlocks);
+    }
+    stage->add(checkpoint.getNumberOfCompleted());
+    reporting = startProgress();
+    previous = G3DTCancelToken::setCurrent(&cancelToken);
+
+    stopped = !G3DTParallel::forEach(nBlocks, [&](qint64 iBlock) {
+        RasterBlock block = schedule[size_t(iBlock)];
+        qint64 start;
+
+        if (failed || checkpoint.isCompleted(iBlock)) return;
+        start = G3DTMetrics::now();
+        if (!func(iBlock, &block))
+        {
+            failed = true;
+            return;
+        }
+        latency->record(G3DTMetrics::now() - start);
+        cells->add(block.getNumberOfCells());
+        checkpoint.complete(iBlock);
+        stage->add();
+    }, nThreads);
+
+    G3DTCancelToken::setCurrent(previous);
+    if (reporting) stopProgress();
+    if (stopped)
+    {
+        emit showMessage(QString("%1: %2 of %3 blocks completed.").arg(G3DTCancelToken::toString(cancelToken.getState()))
+                         .arg(checkpoint.getNumberOfCompleted()).arg(nBlocks));
+    }
+
+    if (!checkpoint.commit()) emit showMessage(checkpoint.errorString);
+    checkpoint.close();
+    checkpoint.saveState = nullptr;
+    return !failed && !stopped;
+}
+
+
+/*!
+ * \brief Returns the job state (e.g. partial reductions) to be committed with completed blocks.
+ *        The default job has no state.
+ */
+QByteArray G3DTWorker::saveState()
+{
+    return QByteArray();
+}
+
+
+/*!
+ * \brief Restores the job state committed by a previous run.
+ * \return True, if the state was restored.
+ */
+bool G3DTWorker::loadState(QByteArray state)
+{
+    Q_UNUSED(state);
+    return true;
+}
@@ -14,31 +14,112 @@
  * *****************************************************************
  */
 
-#include <QThread>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <QByteArray>
+#include <QDateTime>
+#include <QObject>
+#include <QString>
 #include "g3dtcore_global.h"
+#include "g3dtcanceltoken.h"
+#include "g3dtcheckpoint.h"
+#include "g3dtmetrics.h"
+#include "g3dtprogress.h"
+#include "Geometry/rasterblock.h"
 
 
-class G3DTCORE_EXPORT G3DTWorker : public QThread
+/*!
+ * \brief The G3DTWorker is a job running doWork() on the global G3DTExecutor.
+ *        start() queues the job; jobs share the executor threads, at most G3DTExecutor::getMaxJobs()
+ *        of them run at once, and parallel loops inside doWork() run on the same threads.
+ *        Signals are emitted from executor threads.
+ *
+ *        Jobs count completed work in progress (progress.add() is a relaxed atomic increment); while the job
+ *        runs, showPercentage() is emitted by a sampler at progressInterval when the percentage changes.
+ *
+ *        cancel(), a deadline and pause() act through cancelToken, which parallel loops of the job check
+ *        per block; doWork() should check it between its own steps and return early, keeping partial results.
+ *
+ *        metrics collects monotonic timings and counters of the job: doWork() duration, per-block latencies
+ *        of processBlocks() and any timers or counters added by doWork(). It is cleared when the job starts.
+ *
+ *        A derived class must call wait() in its destructor if its job may still be queued or running:
+ *        the base destructor runs after the derived members, and doWork(), are gone.
+ */
+class G3DTCORE_EXPORT G3DTWorker : public QObject
 {
     Q_OBJECT
 
 public:
     QDateTime dtStarted;
     QDateTime dtFinished;
+    QString checkpointFileName; //!< journal of completed blocks used by processBlocks(), empty to disable checkpointing
+    G3DTCheckpoint checkpoint; //!< completed blocks of the current schedule
+    G3DTProgress progress; //!< completed work units of the job, reported by showPercentage()
+    int progressInterval; //!< progress sampling interval in milliseconds
+    G3DTCancelToken cancelToken; //!< cancellation, deadline and pause of the job
+    int priority; //!< executor priority; positive priorities pre-empt running jobs between blocks, see G3DTExecutor
+    G3DTMetrics metrics; //!< timers and counters of the job
 
 public:
     G3DTWorker(QObject *parent = nullptr);
+    ~G3DTWorker();
 
     double processingTimeInSeconds();
     double processingTimeInMinutes();
     QString processingTimeToString();
+    qint64 getElapsedNanoseconds();
 
-    void run() override;
+    bool start();
+    bool isRunning();
+    bool isFinished();
+    bool wait(qint64 msecs = -1);
+
+    void cancel();
+    void setDeadline(qint64 msecs);
+    void pause();
+    void resume();
+    bool isCancelled();
+
+    virtual void run();
     virtual void doWork();
 
+    bool processBlocks(const std::vector<RasterBlock> &schedule, std::function<bool(qint64 iBlock, RasterBlock *block)> func, int nThreads = 0,
+                       G3DTProgress *stage = nullptr, QString timerName = "block");
+    virtual QByteArray saveState();
+    virtual bool loadState(QByteArray state);
+
 Q_SIGNALS:
+    void started();
+    void finished();
     void showMessage(QString msg);
     void showPercentage(int perc);
+
+private:
+    enum State
+    {
+        Idle, //!< not started
+        Queued, //!< waiting for an executor slot
+        Running, //!< doWork() is running
+        Finished //!< doWork() returned
+    };
+
+    State state;
+    int reportedPercentage;
+    std::atomic<qint64> nsStarted; //!< G3DTMetrics::now() when doWork() started
+    std::atomic<qint64> nsFinished; //!< G3DTMetrics::now() when doWork() returned
+    std::mutex stateMutex;
+    std::condition_variable stateChanged;
+    std::shared_ptr<std::atomic<bool>> claimed; //!< set by whoever runs the queued job: its executor task or wait()
+
+    void runJob();
+    void setState(State state);
+    bool startProgress();
+    void stopProgress();
 };
 
 #endif // G3DTWORKER_H
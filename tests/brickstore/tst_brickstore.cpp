@@ -0,0 +1,274 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file tst_brickstore.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <QtTest>
+#include "Raster/brickcodec.h"
+#include "Raster/brickstore.h"
+
+
+/*!
+ * \brief Tests of brick codecs and compressed brick stores.
+ */
+class TestBrickStore : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void codecsRoundTrip();
+    void corruptPayloadsFail();
+    void storeRoundTripForEveryCodecAndInterleave();
+    void missingBricksReadAsNoData();
+    void duplicateBricksShareAPayload();
+    void openRejectsOtherFiles();
+    void metricsCountPayloadBytes();
+};
+
+
+/*!
+ * \brief Fills a two-band raster with a smooth field, a checkerboard mask and a constant corner.
+ */
+static void tstBrickStoreFill(RasterView *view)
+{
+    RasterSize3DT *size = &view->size;
+
+    for (qint64 band = 0; band < size->nBands; band++)
+        for (qint64 lay = 0; lay < size->nLays; lay++)
+            for (qint64 row = 0; row < size->nRows; row++)
+                for (qint64 col = 0; col < size->nCols; col++)
+                {
+                    double value = (band == 0) ? std::sin(col * 0.05) * std::cos(row * 0.07) + lay : double((col / 20 + row / 20) % 2);
+                    if ((col < 32) && (row < 16) && (lay < 8)) value = 7.0;
+                    view->setValue(col, row, lay, band, 0, value);
+                }
+}
+
+
+/*!
+ * \brief Every codec decodes to the encoded cells for all cell sizes; Auto picks Constant and RunLength where they fit.
+ */
+void TestBrickStore::codecsRoundTrip()
+{
+    const qint64 nCells = 4096;
+    std::vector<quint64> smooth(nCells), runs(nCells), constant(nCells, 42), decoded(nCells);
+    BrickCodec::Type used;
+
+    for (qint64 i = 0; i < nCells; i++)
+    {
+        smooth[size_t(i)] = quint64(1000 + 3 * i + (i % 7));
+        runs[size_t(i)] = quint64(i / 512);
+    }
+
+    for (BrickCodec::Type codec : { BrickCodec::Raw, BrickCodec::RunLength, BrickCodec::DeltaShuffle, BrickCodec::Deflate, BrickCodec::Auto })
+        for (qint64 cellSize : { 1, 2, 4, 8 })
+            for (const std::vector<quint64> *cells : { &smooth, &runs, &constant })
+            {
+                QByteArray payload = BrickCodec::encode(cells->data(), nCells, cellSize, codec, &used);
+                if (codec != BrickCodec::Auto) QVERIFY((used == codec) || ((codec == BrickCodec::DeltaShuffle) && (used == BrickCodec::Deflate)));
+                std::memset(decoded.data(), 0xAB, size_t(nCells * cellSize));
+                QVERIFY(BrickCodec::decode(reinterpret_cast<const uchar *>(payload.constData()), payload.size(), used, decoded.data(), nCells, cellSize));
+                QVERIFY(std::memcmp(decoded.data(), cells->data(), size_t(nCells * cellSize)) == 0);
+            }
+
+    BrickCodec::encode(constant.data(), nCells, 8, BrickCodec::Auto, &used);
+    QCOMPARE(used, BrickCodec::Constant);
+    BrickCodec::encode(runs.data(), nCells, 8, BrickCodec::Auto, &used);
+    QCOMPARE(used, BrickCodec::RunLength);
+    QVERIFY(BrickCodec::isConstant(constant.data(), nCells, 8));
+    QCOMPARE(BrickCodec::getNumberOfRuns(runs.data(), nCells, 8), qint64(8));
+}
+
+
+/*!
+ * \brief Truncated payloads and run lengths not matching the brick fail instead of overrunning buffers.
+ */
+void TestBrickStore::corruptPayloadsFail()
+{
+    const qint64 nCells = 1024;
+    std::vector<quint32> cells(nCells), decoded(nCells);
+    BrickCodec::Type used;
+
+    for (qint64 i = 0; i < nCells; i++) cells[size_t(i)] = quint32(i / 100);
+
+    for (BrickCodec::Type codec : { BrickCodec::Raw, BrickCodec::Constant, BrickCodec::RunLength, BrickCodec::DeltaShuffle, BrickCodec::Deflate })
+    {
+        QByteArray payload = BrickCodec::encode(cells.data(), nCells, 4, codec, &used);
+        QVERIFY(!BrickCodec::decode(reinterpret_cast<const uchar *>(payload.constData()), payload.size() - 1, used, decoded.data(), nCells, 4));
+    }
+
+    QByteArray runs = BrickCodec::encode(cells.data(), nCells, 4, BrickCodec::RunLength, &used);
+    QVERIFY(!BrickCodec::decode(reinterpret_cast<const uchar *>(runs.constData()), runs.size(), used, decoded.data(), nCells - 1, 4));
+}
+
+
+/*!
+ * \brief A block read from a store equals the written raster for every codec and interleave.
+ */
+void TestBrickStore::storeRoundTripForEveryCodecAndInterleave()
+{
+    QTemporaryDir dir;
+    RasterSize3DT size(101, 57, 9, 2, 1), blockSize(95, 53, 8, 2, 1);
+    std::vector<float> cells(size_t(size.getNumberOfCells())), blockCells(size_t(blockSize.getNumberOfCells()));
+    RasterView source(cells.data(), RasterCell::Float32, &size);
+    RasterBlock block;
+
+    QVERIFY(dir.isValid());
+    tstBrickStoreFill(&source);
+    block.set(5, 3, 1, 0, 0, 99, 55, 8, 1, 0);
+
+    for (BrickCodec::Type codec : { BrickCodec::Raw, BrickCodec::RunLength, BrickCodec::DeltaShuffle, BrickCodec::Deflate, BrickCodec::Auto })
+        for (RasterView::Interleave interleave : { RasterView::BSQ, RasterView::BIL, RasterView::BIP })
+        {
+            BrickStore writer, reader;
+            RasterView target(blockCells.data(), RasterCell::Float32, &blockSize);
+
+            writer.size = size;
+            writer.brickSize.set(32, 16, 8, 2, 1);
+            writer.cellType = RasterCell::Float32;
+            writer.interleave = interleave;
+            writer.codec = codec;
+            QVERIFY(writer.create(dir.filePath("store.g3b")));
+            QVERIFY(writer.write(&source, 4));
+            if (codec != BrickCodec::Raw) QVERIFY(1.0 < writer.getCompressionRatio());
+            QVERIFY(writer.close());
+
+            QVERIFY(reader.open(dir.filePath("store.g3b")));
+            QVERIFY(reader.interleave == interleave);
+            QVERIFY(reader.isConstantBrick(0) == (codec == BrickCodec::Auto));
+            QVERIFY(reader.read(&block, &target, 4));
+            for (qint64 band = 0; band < blockSize.nBands; band++)
+                for (qint64 lay = 0; lay < blockSize.nLays; lay++)
+                    for (qint64 row = 0; row < blockSize.nRows; row++)
+                        for (qint64 col = 0; col < blockSize.nCols; col++)
+                            QCOMPARE(target.getValue(col, row, lay, band, 0), source.getValue(col + 5, row + 3, lay + 1, band, 0));
+        }
+}
+
+
+/*!
+ * \brief Bricks never written read as NoData and are reported constant.
+ */
+void TestBrickStore::missingBricksReadAsNoData()
+{
+    QTemporaryDir dir;
+    BrickStore writer, reader;
+    std::vector<qint16> cells;
+    double value;
+
+    writer.size.set(101, 57, 9, 2, 1);
+    writer.brickSize.set(32, 16, 8, 2, 1);
+    writer.cellType = RasterCell::Int16;
+    writer.useNoData = true;
+    writer.noData = -5;
+    QVERIFY(writer.create(dir.filePath("missing.g3b")));
+    QVERIFY(writer.writeConstantBrick(1, 3.0));
+    QVERIFY(writer.close());
+
+    QVERIFY(reader.open(dir.filePath("missing.g3b")));
+    cells.resize(size_t(reader.getNumberOfBrickCells()));
+    QVERIFY(reader.readBrick(3, cells.data()));
+    QCOMPARE(cells[100], qint16(-5));
+    QVERIFY(reader.isConstantBrick(3, &value));
+    QCOMPARE(value, -5.0);
+    QVERIFY(reader.isConstantBrick(1, &value));
+    QCOMPARE(value, 3.0);
+    QVERIFY(reader.readBrick(1, cells.data()));
+    QCOMPARE(cells[100], qint16(3));
+}
+
+
+/*!
+ * \brief With deduplication, bricks with equal contents share one payload and still read back.
+ */
+void TestBrickStore::duplicateBricksShareAPayload()
+{
+    QTemporaryDir dir;
+    BrickStore writer, reader;
+    std::vector<float> brick, decoded;
+
+    writer.size.set(64, 64, 8, 1, 1);
+    writer.brickSize.set(32, 32, 8, 1, 1);
+    writer.cellType = RasterCell::Float32;
+    writer.deduplicate = true;
+    QVERIFY(writer.create(dir.filePath("dedup.g3b")));
+    brick.resize(size_t(writer.getNumberOfBrickCells()));
+    for (size_t i = 0; i < brick.size(); i++) brick[i] = float(i % 1013) * 0.25f;
+    for (qint64 iBrick = 0; iBrick < writer.getNumberOfBricks(); iBrick++) QVERIFY(writer.writeBrick(iBrick, brick.data()));
+    QCOMPARE(writer.getNumberOfSharedBricks(), writer.getNumberOfBricks() - 1);
+    QVERIFY(writer.close());
+
+    QVERIFY(reader.open(dir.filePath("dedup.g3b")));
+    decoded.resize(brick.size());
+    for (qint64 iBrick = 0; iBrick < reader.getNumberOfBricks(); iBrick++)
+    {
+        QVERIFY(reader.readBrick(iBrick, decoded.data()));
+        QVERIFY(decoded == brick);
+    }
+}
+
+
+/*!
+ * \brief Files that are not brick stores are rejected with a message.
+ */
+void TestBrickStore::openRejectsOtherFiles()
+{
+    QTemporaryDir dir;
+    QFile file(dir.filePath("other.g3b"));
+    BrickStore store;
+
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QVERIFY(file.write(QByteArray(1024, 'x')) == 1024);
+    file.close();
+
+    QVERIFY(!store.open(dir.filePath("other.g3b")));
+    QVERIFY(!store.errorString.isEmpty());
+    QVERIFY(!store.open(dir.filePath("none.g3b")));
+}
+
+
+/*!
+ * \brief Stored and decoded payload bytes are counted; shared payloads and missing bricks are not.
+ */
+void TestBrickStore::metricsCountPayloadBytes()
+{
+    QTemporaryDir dir;
+    G3DTMetrics metrics;
+    BrickStore writer, reader;
+    std::vector<float> brick;
+
+    writer.size.set(64, 64, 8, 1, 1);
+    writer.brickSize.set(32, 32, 8, 1, 1);
+    writer.cellType = RasterCell::Float32;
+    writer.metrics = &metrics;
+    QVERIFY(writer.create(dir.filePath("metrics.g3b")));
+    brick.resize(size_t(writer.getNumberOfBrickCells()));
+    for (size_t i = 0; i < brick.size(); i++) brick[i] = float(i % 1013) * 0.25f;
+    QVERIFY(writer.writeBrick(0, brick.data()));
+    QVERIFY(writer.writeBrick(1, brick.data()));
+    QCOMPARE(metrics.getCounter("brickStore.bytesWritten")->getValue(), writer.getStoredBytes());
+    QVERIFY(writer.close());
+
+    reader.metrics = &metrics;
+    QVERIFY(reader.open(dir.filePath("metrics.g3b")));
+    QVERIFY(reader.readBrick(0, brick.data()));
+    QVERIFY(reader.readBrick(1, brick.data()));
+    QVERIFY(reader.readBrick(2, brick.data()));
+    QCOMPARE(metrics.getCounter("brickStore.bytesRead")->getValue(), 2 * reader.getStoredBytes());
+}
+
+
+QTEST_GUILESS_MAIN(TestBrickStore)
+
+#include "tst_brickstore.moc"
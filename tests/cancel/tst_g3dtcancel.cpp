@@ -0,0 +1,224 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file tst_g3dtcancel.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <QtTest>
+#include "g3dtcanceltoken.h"
+#include "g3dtparallel.h"
+#include "Raster/isosurface.h"
+#include "Raster/pointbinner.h"
+#include "Raster/voxelfilter.h"
+
+
+/*!
+ * \brief Tests of kernels cancelled while running: a stopped kernel must return false
+ *        and must not leave results of skipped passes behind.
+ */
+class TestG3DTCancel : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void forEachStopsWhenCancelledMidway();
+    void isoSurfaceCancelledMidway();
+    void voxelFilterCancelledMidway();
+    void pointBinnerCancelledMidway();
+};
+
+
+//! Delays of cancellation in microseconds; -1 cancels before the kernel starts.
+static const qint64 tstCancelDelays[] = { -1, 0, 50, 200, 1000, 5000, 20000 };
+
+
+/*!
+ * \brief Runs a kernel under a new current token, cancelled by another thread after a delay.
+ * \param delay Delay in microseconds, negative to cancel the token before the kernel starts.
+ * \param kernel Kernel.
+ * \return Result of the kernel.
+ */
+static bool tstCancelRun(qint64 delay, std::function<bool()> kernel)
+{
+    G3DTCancelToken token;
+    G3DTCancelToken *previous = G3DTCancelToken::setCurrent(&token);
+    std::thread canceller;
+    bool ok;
+
+    if (delay < 0) token.cancel();
+    else canceller = std::thread([&token, delay]() {
+            std::this_thread::sleep_for(std::chrono::microseconds(delay));
+            token.cancel();
+        });
+    ok = kernel();
+    if (canceller.joinable()) canceller.join();
+    G3DTCancelToken::setCurrent(previous);
+    return ok;
+}
+
+
+/*!
+ * \brief An item cancelling the token stops the loop: forEach() returns false and items taken later are not run.
+ */
+void TestG3DTCancel::forEachStopsWhenCancelledMidway()
+{
+    const qint64 nItems = 10000;
+    G3DTCancelToken token;
+    G3DTCancelToken *previous = G3DTCancelToken::setCurrent(&token);
+    std::atomic<qint64> nProcessed(0);
+    bool ok;
+
+    ok = G3DTParallel::forEach(nItems, [&](qint64 iItem) {
+        if (iItem == 100) token.cancel();
+        nProcessed++;
+    }, 4);
+    G3DTCancelToken::setCurrent(previous);
+
+    QVERIFY(!ok);
+    QVERIFY(nProcessed < nItems);
+    QVERIFY(G3DTParallel::forEach(nItems, [](qint64) {}, 4));
+}
+
+
+/*!
+ * \brief An extraction cancelled in any of its passes returns false with an empty mesh;
+ *        an extraction that finished before the cancellation equals an uncancelled one.
+ */
+void TestG3DTCancel::isoSurfaceCancelledMidway()
+{
+    RasterSize3D size(60, 63, 58, 1);
+    std::vector<double> cells(size_t(size.nCols * size.nRows * size.nLays));
+    IsoSurface reference;
+    qint64 nVertices, nTriangles;
+
+    for (qint64 lay = 0; lay < size.nLays; lay++)
+        for (qint64 row = 0; row < size.nRows; row++)
+            for (qint64 col = 0; col < size.nCols; col++)
+            {
+                double x = col - 29.3, y = row - 31.1, z = lay - 28.2;
+                cells[size_t(col + size.nCols * (row + size.nRows * lay))] = std::sqrt(x * x + y * y + z * z);
+            }
+
+    reference.brickSize = 8;
+    QVERIFY(reference.setup(cells.data(), &size));
+    QVERIFY(reference.extract(20.0));
+    nVertices = reference.getNumberOfVertices();
+    nTriangles = reference.getNumberOfTriangles();
+    QVERIFY(0 < nTriangles);
+
+    for (qint64 delay : tstCancelDelays)
+    {
+        IsoSurface iso;
+        iso.brickSize = 8;
+        QVERIFY(iso.setup(cells.data(), &size));
+        if (tstCancelRun(delay, [&iso]() { return iso.extract(20.0); }))
+        {
+            QCOMPARE(iso.getNumberOfVertices(), nVertices);
+            QCOMPARE(iso.getNumberOfTriangles(), nTriangles);
+        }
+        else
+        {
+            QCOMPARE(iso.getNumberOfVertices(), qint64(0));
+            QCOMPARE(iso.getNumberOfTriangles(), qint64(0));
+        }
+    }
+}
+
+
+/*!
+ * \brief A cancelled filtering fails with a message and no voxels; a finished one equals an uncancelled one.
+ */
+void TestG3DTCancel::voxelFilterCancelledMidway()
+{
+    const qint64 nPoints = 200000;
+    std::vector<Point3DT> points(nPoints);
+    VoxelFilter reference;
+
+    for (qint64 i = 0; i < nPoints; i++)
+        points[size_t(i)].set(double(i % 503) / 10.0, double(i % 499) / 10.0, double(i % 97) / 10.0, double(i % 11));
+
+    reference.setVoxelSize(2.5);
+    QVERIFY(reference.filter(points.data(), nPoints));
+
+    for (qint64 delay : tstCancelDelays)
+    {
+        VoxelFilter filter;
+        filter.setVoxelSize(2.5);
+        if (tstCancelRun(delay, [&]() { return filter.filter(points.data(), nPoints); }))
+        {
+            QCOMPARE(filter.getNumberOfVoxels(), reference.getNumberOfVoxels());
+            QVERIFY(filter.counts == reference.counts);
+        }
+        else
+        {
+            QVERIFY(!filter.errorString.isEmpty());
+            QCOMPARE(filter.getNumberOfVoxels(), qint64(0));
+        }
+    }
+}
+
+
+/*!
+ * \brief A cancelled binning returns false for both strategies; a finished one equals an uncancelled one.
+ */
+void TestG3DTCancel::pointBinnerCancelledMidway()
+{
+    const qint64 nPoints = 300000;
+    std::vector<double> x(nPoints), y(nPoints), z(nPoints), t(nPoints), values(nPoints);
+    Box3DT extent;
+    RasterSize3DT size(37, 23, 3, 1, 2);
+    PointBinner reference;
+    std::vector<double> expected;
+
+    for (qint64 i = 0; i < nPoints; i++)
+    {
+        x[size_t(i)] = double(i % 1009) / 100.0;
+        y[size_t(i)] = double(i % 1013) / 100.0;
+        z[size_t(i)] = double(i % 1019) / 100.0;
+        t[size_t(i)] = double(i % 10);
+        values[size_t(i)] = double(i % 7);
+    }
+    extent.set(0, 0, 0, 0, 10, 10, 10, 10);
+
+    QVERIFY(reference.setup(&extent, &size, PointBinner::StatAll));
+    QVERIFY(reference.add(x.data(), y.data(), z.data(), t.data(), values.data(), nPoints));
+    expected.resize(size_t(reference.getNumberOfCells()));
+    QVERIFY(reference.getStatistic(PointBinner::StatMean, expected.data(), -9999));
+
+    for (PointBinner::Strategy strategy : { PointBinner::StrategyPrivateGrids, PointBinner::StrategyPartitioned })
+        for (qint64 delay : tstCancelDelays)
+        {
+            PointBinner binner;
+            std::vector<double> means(expected.size());
+            binner.strategy = strategy;
+            binner.nThreads = 4;
+            QVERIFY(binner.setup(&extent, &size, PointBinner::StatAll));
+            if (tstCancelRun(delay, [&]() { return binner.add(x.data(), y.data(), z.data(), t.data(), values.data(), nPoints); }))
+            {
+                QVERIFY(binner.getStatistic(PointBinner::StatMean, means.data(), -9999));
+                QVERIFY(means == expected);
+            }
+            else
+            {
+                QVERIFY(!tstCancelRun(-1, [&]() { return binner.getStatistic(PointBinner::StatMean, means.data(), -9999); }));
+            }
+        }
+}
+
+
+QTEST_GUILESS_MAIN(TestG3DTCancel)
+
+#include "tst_g3dtcancel.moc"
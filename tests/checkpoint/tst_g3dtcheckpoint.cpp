@@ -0,0 +1,200 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file tst_g3dtcheckpoint.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <atomic>
+#include <cstring>
+#include <vector>
+#include <QtTest>
+#include "g3dtcheckpoint.h"
+#include "g3dtworker.h"
+
+
+/*!
+ * \brief Tests of checkpointing and resuming block schedules.
+ */
+class TestG3DTCheckpoint : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void journalKeepsCommittedBlocksAndState();
+    void crashedJobResumesWithItsState();
+    void tornRecordIsIgnored();
+    void cancelledJobResumes();
+    void otherScheduleDiscardsJournal();
+};
+
+
+/*!
+ * \brief A job summing column indexes of its blocks; the sum is the job state.
+ *        The block function fails or cancels the job after a given number of blocks.
+ */
+class TstCheckpointJob : public G3DTWorker
+{
+public:
+    double sum;
+    qint64 failAt; //!< number of processed blocks after which the block function fails, -1 for never
+    qint64 cancelAt; //!< number of processed blocks after which the job is cancelled, -1 for never
+    std::atomic<qint64> nProcessed;
+
+    TstCheckpointJob(QString fileName) : sum(0.0), failAt(-1), cancelAt(-1), nProcessed(0)
+    {
+        checkpointFileName = fileName;
+        checkpoint.interval = 0.0;
+    }
+
+    QByteArray saveState() override
+    {
+        return QByteArray(reinterpret_cast<const char *>(&sum), int(sizeof(sum)));
+    }
+
+    bool loadState(QByteArray state) override
+    {
+        if (state.size() != int(sizeof(sum))) return false;
+        memcpy(&sum, state.constData(), sizeof(sum));
+        return true;
+    }
+
+    bool run(qint64 nBlocks)
+    {
+        std::vector<RasterBlock> schedule(nBlocks);
+        for (qint64 i = 0; i < nBlocks; i++) schedule[size_t(i)].set(i, 0, 0, 0, 0, i, 0, 0, 0, 0);
+        return processBlocks(schedule, [this](qint64 iBlock, RasterBlock *block) {
+            qint64 n = nProcessed++;
+            double part = double(block->col0);
+            if (n == failAt) return false;
+            if (n == cancelAt) cancel();
+            checkpoint.complete(iBlock, [this, part]() { sum += part; });
+            return true;
+        }, 4);
+    }
+};
+
+
+//! Sum of column indexes of all blocks of a schedule.
+static double tstCheckpointSum(qint64 nBlocks)
+{
+    return double(nBlocks) * double(nBlocks - 1) / 2.0;
+}
+
+
+/*!
+ * \brief Committed blocks and the committed state are read back by a checkpoint of the same schedule.
+ */
+void TestG3DTCheckpoint::journalKeepsCommittedBlocksAndState()
+{
+    QTemporaryDir dir;
+    std::vector<RasterBlock> schedule(10);
+    G3DTCheckpoint writer, reader;
+
+    for (qint64 i = 0; i < 10; i++) schedule[size_t(i)].set(i, 0, 0, 0, 0, i, 0, 0, 0, 0);
+    writer.saveState = []() { return QByteArray("state"); };
+    QVERIFY(writer.open(dir.filePath("job.ckpt"), schedule));
+    QVERIFY(!writer.isResumed());
+    writer.complete(2);
+    writer.complete(7);
+    QVERIFY(writer.commit());
+    writer.close();
+
+    QVERIFY(reader.open(dir.filePath("job.ckpt"), schedule));
+    QVERIFY(reader.isResumed());
+    QCOMPARE(reader.getNumberOfCompleted(), qint64(2));
+    QVERIFY(reader.isCompleted(2) && reader.isCompleted(7) && !reader.isCompleted(3));
+    QVERIFY(reader.getState() == QByteArray("state"));
+    reader.close();
+    QVERIFY(reader.remove());
+}
+
+
+/*!
+ * \brief A job failing midway resumes from the journal: only blocks not committed are processed again,
+ *        and the restored state plus the remaining blocks give the result of an uninterrupted run.
+ */
+void TestG3DTCheckpoint::crashedJobResumesWithItsState()
+{
+    const qint64 nBlocks = 20000;
+    QTemporaryDir dir;
+    TstCheckpointJob crashed(dir.filePath("job.ckpt")), resumed(dir.filePath("job.ckpt")), finished(dir.filePath("job.ckpt"));
+
+    crashed.failAt = 7000;
+    QVERIFY(!crashed.run(nBlocks));
+
+    QVERIFY(resumed.run(nBlocks));
+    QVERIFY(resumed.nProcessed < nBlocks);
+    QCOMPARE(resumed.sum, tstCheckpointSum(nBlocks));
+
+    QVERIFY(finished.run(nBlocks));
+    QCOMPARE(finished.nProcessed.load(), qint64(0));
+    QCOMPARE(finished.sum, tstCheckpointSum(nBlocks));
+}
+
+
+/*!
+ * \brief Garbage appended to the journal, as left by a crash during a commit, does not prevent resuming.
+ */
+void TestG3DTCheckpoint::tornRecordIsIgnored()
+{
+    const qint64 nBlocks = 5000;
+    QTemporaryDir dir;
+    TstCheckpointJob crashed(dir.filePath("job.ckpt")), resumed(dir.filePath("job.ckpt"));
+    QFile journal(dir.filePath("job.ckpt"));
+
+    crashed.failAt = 3000;
+    QVERIFY(!crashed.run(nBlocks));
+    QVERIFY(journal.open(QIODevice::WriteOnly | QIODevice::Append));
+    QVERIFY(journal.write(QByteArray(28, 'x')) == 28);
+    journal.close();
+
+    QVERIFY(resumed.run(nBlocks));
+    QVERIFY(resumed.nProcessed < nBlocks);
+    QCOMPARE(resumed.sum, tstCheckpointSum(nBlocks));
+}
+
+
+/*!
+ * \brief A cancelled job commits its completed blocks, so that the next run finishes the schedule.
+ */
+void TestG3DTCheckpoint::cancelledJobResumes()
+{
+    const qint64 nBlocks = 5000;
+    QTemporaryDir dir;
+    TstCheckpointJob cancelled(dir.filePath("job.ckpt")), resumed(dir.filePath("job.ckpt"));
+
+    cancelled.cancelAt = 1000;
+    QVERIFY(!cancelled.run(nBlocks));
+    QVERIFY(cancelled.nProcessed < nBlocks);
+
+    QVERIFY(resumed.run(nBlocks));
+    QCOMPARE(cancelled.nProcessed + resumed.nProcessed, nBlocks);
+    QCOMPARE(resumed.sum, tstCheckpointSum(nBlocks));
+}
+
+
+/*!
+ * \brief A journal of another schedule is discarded and the job starts from scratch.
+ */
+void TestG3DTCheckpoint::otherScheduleDiscardsJournal()
+{
+    QTemporaryDir dir;
+    TstCheckpointJob first(dir.filePath("job.ckpt")), other(dir.filePath("job.ckpt"));
+
+    QVERIFY(first.run(1000));
+    QVERIFY(other.run(999));
+    QCOMPARE(other.nProcessed.load(), qint64(999));
+    QCOMPARE(other.sum, tstCheckpointSum(999));
+}
+
+
+QTEST_GUILESS_MAIN(TestG3DTCheckpoint)
+
+#include "tst_g3dtcheckpoint.moc"
@@ -0,0 +1,23 @@
+QT -= gui
+QT += testlib
+
+TEMPLATE = app
+TARGET = tst_g3dtexecutor
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+DEFINES += G3DTCORE_LIBRARY
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../g3dtcanceltoken.cpp \
+    ../../g3dtexecutor.cpp \
+    ../../g3dtnuma.cpp \
+    ../../g3dtparallel.cpp \
+    tst_g3dtexecutor.cpp
+
+HEADERS += \
+    ../../g3dtcanceltoken.h \
+    ../../g3dtexecutor.h \
+    ../../g3dtnuma.h \
+    ../../g3dtparallel.h
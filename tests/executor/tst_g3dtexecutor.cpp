@@ -0,0 +1,117 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file tst_g3dtexecutor.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <QtTest>
+#include "g3dtexecutor.h"
+#include "g3dtparallel.h"
+#include "g3dtworker.h"
+
+
+/*!
+ * \brief Tests of job scheduling on the global G3DTExecutor.
+ */
+class TestG3DTExecutor : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void interactiveJobPreemptsBatchJob();
+    void nestedWaitsDoNotDeadlock();
+};
+
+
+/*!
+ * \brief A job with a positive priority submitted while a batch job occupies all threads by a parallel loop
+ *        must run between the batch items instead of waiting for the whole batch.
+ */
+void TestG3DTExecutor::interactiveJobPreemptsBatchJob()
+{
+    G3DTExecutor *executor = G3DTExecutor::getGlobal();
+    int nThreads = executor->getNumberOfThreads();
+    std::atomic<bool> batchDone(false), interactiveDone(false), batchDoneFirst(false);
+    auto sleepItem = [](qint64) { std::this_thread::sleep_for(std::chrono::milliseconds(10)); };
+
+    executor->submitJob([&]() {
+        G3DTParallel::forEach(qint64(100) * nThreads, sleepItem);
+        batchDone = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    executor->submitJob([&]() {
+        G3DTParallel::forEach(nThreads, sleepItem);
+        batchDoneFirst = batchDone.load();
+        interactiveDone = true;
+    }, 1);
+
+    QTRY_VERIFY_WITH_TIMEOUT(interactiveDone && batchDone, 30000);
+    QVERIFY(!batchDoneFirst);
+}
+
+
+/*!
+ * \brief A worker running a function as its job.
+ */
+class TstExecutorWorker : public G3DTWorker
+{
+public:
+    std::function<void()> function;
+
+    ~TstExecutorWorker() override
+    {
+        wait();
+    }
+
+    void doWork() override
+    {
+        function();
+    }
+};
+
+
+/*!
+ * \brief Jobs waiting for nested jobs must not dead-lock when they hold all job slots:
+ *        the nested jobs run inline or by the waiting threads.
+ */
+void TestG3DTExecutor::nestedWaitsDoNotDeadlock()
+{
+    G3DTExecutor *executor = G3DTExecutor::getGlobal();
+    int maxJobs = executor->getMaxJobs();
+    std::atomic<int> nInner(0);
+    TstExecutorWorker outer[4], inner[4];
+
+    executor->setMaxJobs(1);
+    for (int i = 0; i < 4; i++)
+    {
+        inner[i].function = [&nInner]() {
+            G3DTParallel::forEach(100, [](qint64) { std::this_thread::sleep_for(std::chrono::microseconds(100)); });
+            nInner++;
+        };
+        outer[i].function = [&inner, i]() {
+            inner[i].start();
+            inner[i].wait();
+        };
+    }
+    for (int i = 0; i < 4; i++) QVERIFY(outer[i].start());
+
+    QTRY_VERIFY_WITH_TIMEOUT(nInner == 4, 30000);
+    for (int i = 0; i < 4; i++) QVERIFY(outer[i].wait(30000));
+    executor->setMaxJobs(maxJobs);
+}
+
+
+QTEST_GUILESS_MAIN(TestG3DTExecutor)
+
+#include "tst_g3dtexecutor.moc"
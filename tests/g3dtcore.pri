@@ -0,0 +1,94 @@
+# Sources of the library compiled into test applications.
+
+DEFINES += G3DTCORE_LIBRARY
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    $$PWD/../Geometry/box2d.cpp \
+    $$PWD/../Geometry/box3dt.cpp \
+    $$PWD/../Geometry/geometrybinary.cpp \
+    $$PWD/../Geometry/geometryjsonreader.cpp \
+    $$PWD/../Geometry/geometryjsonwriter.cpp \
+    $$PWD/../Geometry/index2d.cpp \
+    $$PWD/../Geometry/index3d.cpp \
+    $$PWD/../Geometry/index3dt.cpp \
+    $$PWD/../Geometry/point2d.cpp \
+    $$PWD/../Geometry/point3d.cpp \
+    $$PWD/../Geometry/point3dt.cpp \
+    $$PWD/../Geometry/rasterblock.cpp \
+    $$PWD/../Geometry/rastersize2d.cpp \
+    $$PWD/../Geometry/rastersize3d.cpp \
+    $$PWD/../Geometry/rastersize3dt.cpp \
+    $$PWD/../Raster/brickcache.cpp \
+    $$PWD/../Raster/brickcodec.cpp \
+    $$PWD/../Raster/brickgrid.cpp \
+    $$PWD/../Raster/brickprefetcher.cpp \
+    $$PWD/../Raster/brickstore.cpp \
+    $$PWD/../Raster/envifile.cpp \
+    $$PWD/../Raster/isosurface.cpp \
+    $$PWD/../Raster/lasreader.cpp \
+    $$PWD/../Raster/mapalgebra.cpp \
+    $$PWD/../Raster/pointbinner.cpp \
+    $$PWD/../Raster/rastercell.cpp \
+    $$PWD/../Raster/rasterconvert.cpp \
+    $$PWD/../Raster/rasterfile.cpp \
+    $$PWD/../Raster/rasterstream.cpp \
+    $$PWD/../Raster/rasterview.cpp \
+    $$PWD/../Raster/tickstore.cpp \
+    $$PWD/../Raster/voxelfilter.cpp \
+    $$PWD/../g3dtcanceltoken.cpp \
+    $$PWD/../g3dtcheckpoint.cpp \
+    $$PWD/../g3dtexecutor.cpp \
+    $$PWD/../g3dtmetrics.cpp \
+    $$PWD/../g3dtnuma.cpp \
+    $$PWD/../g3dtparallel.cpp \
+    $$PWD/../g3dtpipeline.cpp \
+    $$PWD/../g3dtprogress.cpp \
+    $$PWD/../g3dtworker.cpp
+
+HEADERS += \
+    $$PWD/../Geometry/box2d.h \
+    $$PWD/../Geometry/box3dt.h \
+    $$PWD/../Geometry/geometry.h \
+    $$PWD/../Geometry/geometrybinary.h \
+    $$PWD/../Geometry/geometryjsonreader.h \
+    $$PWD/../Geometry/geometryjsonwriter.h \
+    $$PWD/../Geometry/index2d.h \
+    $$PWD/../Geometry/index3d.h \
+    $$PWD/../Geometry/index3dt.h \
+    $$PWD/../Geometry/point2d.h \
+    $$PWD/../Geometry/point3d.h \
+    $$PWD/../Geometry/point3dt.h \
+    $$PWD/../Geometry/rasterblock.h \
+    $$PWD/../Geometry/rastersize2d.h \
+    $$PWD/../Geometry/rastersize3d.h \
+    $$PWD/../Geometry/rastersize3dt.h \
+    $$PWD/../Raster/brickcache.h \
+    $$PWD/../Raster/brickcodec.h \
+    $$PWD/../Raster/brickgrid.h \
+    $$PWD/../Raster/brickprefetcher.h \
+    $$PWD/../Raster/brickstore.h \
+    $$PWD/../Raster/envifile.h \
+    $$PWD/../Raster/isosurface.h \
+    $$PWD/../Raster/lasreader.h \
+    $$PWD/../Raster/mapalgebra.h \
+    $$PWD/../Raster/pointbinner.h \
+    $$PWD/../Raster/raster.h \
+    $$PWD/../Raster/rastercell.h \
+    $$PWD/../Raster/rasterconvert.h \
+    $$PWD/../Raster/rasterfile.h \
+    $$PWD/../Raster/rasterstream.h \
+    $$PWD/../Raster/rasterview.h \
+    $$PWD/../Raster/tickstore.h \
+    $$PWD/../Raster/voxelfilter.h \
+    $$PWD/../g3dtcanceltoken.h \
+    $$PWD/../g3dtcheckpoint.h \
+    $$PWD/../g3dtcore.h \
+    $$PWD/../g3dtcore_global.h \
+    $$PWD/../g3dtexecutor.h \
+    $$PWD/../g3dtmetrics.h \
+    $$PWD/../g3dtnuma.h \
+    $$PWD/../g3dtparallel.h \
+    $$PWD/../g3dtpipeline.h \
+    $$PWD/../g3dtprogress.h \
+    $$PWD/../g3dtworker.h
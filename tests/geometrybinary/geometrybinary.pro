@@ -0,0 +1,12 @@
+QT -= gui
+QT += testlib
+
+TEMPLATE = app
+TARGET = tst_geometrybinary
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+include(../g3dtcore.pri)
+
+SOURCES += \
+    tst_geometrybinary.cpp
@@ -0,0 +1,208 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file tst_geometrybinary.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <limits>
+#include <vector>
+#include <QFile>
+#include <QtTest>
+#include "Geometry/geometry.h"
+
+
+/*!
+ * \brief Tests of the binary geometry format of GeometryBinary.
+ */
+class TestGeometryBinary : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void arraysRoundTripExactly();
+    void singleObjectsRoundTrip();
+    void invalidBuffersAreRejected();
+    void devicesRoundTrip();
+    void oversizedArraysAreNotEncoded();
+};
+
+
+/*!
+ * \brief Encodes and decodes an array; the decoded array must encode to the same bytes.
+ */
+template <class T>
+static bool tstGeometryBinaryRoundTrip(std::vector<T> &items)
+{
+    QByteArray encoded = GeometryBinary::encode(items.data(), qint64(items.size()));
+    std::vector<T> decoded;
+
+    if (encoded.size() != GeometryBinary::getEncodedSize<T>(qint64(items.size()))) return false;
+    if (!GeometryBinary::decode(encoded, &decoded) || (decoded.size() != items.size())) return false;
+    return GeometryBinary::encode(decoded.data(), qint64(decoded.size())) == encoded;
+}
+
+
+/*!
+ * \brief Arrays of every geometry type round-trip bit-exactly, including extreme doubles and 64-bit indexes.
+ */
+void TestGeometryBinary::arraysRoundTripExactly()
+{
+    const qint64 nItems = 1000;
+    const qint64 big = (qint64(1) << 62) + 7;
+    std::vector<Point2D> points2D(nItems);
+    std::vector<Point3D> points3D(nItems);
+    std::vector<Point3DT> points3DT(nItems);
+    std::vector<Box2D> boxes2D(nItems);
+    std::vector<Box3DT> boxes3DT(nItems);
+    std::vector<Index2D> indexes2D(nItems);
+    std::vector<Index3D> indexes3D(nItems);
+    std::vector<Index3DT> indexes3DT(nItems);
+    std::vector<RasterSize2D> sizes2D(nItems);
+    std::vector<RasterSize3D> sizes3D(nItems);
+    std::vector<RasterSize3DT> sizes3DT(nItems);
+    std::vector<RasterBlock> blocks(nItems);
+
+    for (qint64 i = 0; i < nItems; i++)
+    {
+        double a = double(i) * 0.1, b = 1e-300 * double(i) - 5e20, c = -0.0, d = std::numeric_limits<double>::denorm_min() * double(i);
+        points2D[size_t(i)].set(a, b);
+        points3D[size_t(i)].set(a, b, c);
+        points3DT[size_t(i)].set(a, b, c, d);
+        boxes2D[size_t(i)].p0.set(a, b);
+        boxes2D[size_t(i)].p1.set(c, d);
+        boxes3DT[size_t(i)].set(a, b, c, d, d, c, b, a);
+        indexes2D[size_t(i)].set(i, -i, big + i);
+        indexes3D[size_t(i)].set(i, -i, big + i, 3);
+        indexes3DT[size_t(i)] = Index3DT(i, -i, big + i, 3, big - i);
+        sizes2D[size_t(i)].set(i, big, 2);
+        sizes3D[size_t(i)].set(i, big, 2, 3);
+        sizes3DT[size_t(i)].set(i, big, 2, 3, 4);
+        blocks[size_t(i)].set(i, i + 1, i + 2, i + 3, big + i, i, i, i, i, i);
+        blocks[size_t(i)].numberOfNotNullCells = i;
+    }
+
+    QVERIFY(tstGeometryBinaryRoundTrip(points2D));
+    QVERIFY(tstGeometryBinaryRoundTrip(points3D));
+    QVERIFY(tstGeometryBinaryRoundTrip(points3DT));
+    QVERIFY(tstGeometryBinaryRoundTrip(boxes2D));
+    QVERIFY(tstGeometryBinaryRoundTrip(boxes3DT));
+    QVERIFY(tstGeometryBinaryRoundTrip(indexes2D));
+    QVERIFY(tstGeometryBinaryRoundTrip(indexes3D));
+    QVERIFY(tstGeometryBinaryRoundTrip(indexes3DT));
+    QVERIFY(tstGeometryBinaryRoundTrip(sizes2D));
+    QVERIFY(tstGeometryBinaryRoundTrip(sizes3D));
+    QVERIFY(tstGeometryBinaryRoundTrip(sizes3DT));
+    QVERIFY(tstGeometryBinaryRoundTrip(blocks));
+
+    std::vector<Index3DT> decoded;
+    QVERIFY(GeometryBinary::decode(GeometryBinary::encode(indexes3DT.data(), nItems), &decoded));
+    QCOMPARE(decoded[999].tick, big - 999);
+    QCOMPARE(decoded[999].lay, big + 999);
+}
+
+
+/*!
+ * \brief A single object decodes from an encoded array of one item, but not from arrays of other lengths.
+ */
+void TestGeometryBinary::singleObjectsRoundTrip()
+{
+    RasterSize3DT size(5, 6, 7, 8, 9), decoded;
+    Point3DT points[2];
+    Point3DT point;
+
+    QVERIFY(GeometryBinary::decode(GeometryBinary::encode(&size, 1), &decoded));
+    QCOMPARE(decoded.nCols, qint64(5));
+    QCOMPARE(decoded.nTicks, qint64(9));
+
+    points[0].set(1, 2, 3, 4);
+    points[1].set(5, 6, 7, 8);
+    QVERIFY(!GeometryBinary::decode(GeometryBinary::encode(points, 2), &point));
+    QVERIFY(GeometryBinary::decode(GeometryBinary::encode(points + 1, 1), &point));
+    QCOMPARE(point.t, 8.0);
+}
+
+
+/*!
+ * \brief Buffers of another type, truncated buffers and corrupt item counts are rejected.
+ */
+void TestGeometryBinary::invalidBuffersAreRejected()
+{
+    std::vector<RasterBlock> blocks(100), decoded;
+    std::vector<Point3D> points;
+    Index3DT index(1, 2, 3, 4, 5);
+    QByteArray encoded = GeometryBinary::encode(blocks.data(), 100);
+    QByteArray corrupt = encoded;
+
+    QVERIFY(!GeometryBinary::decode(encoded, &points));
+    QVERIFY(!GeometryBinary::decode(QByteArray(encoded.constData(), encoded.size() - 1), &decoded));
+    QVERIFY(!GeometryBinary::decode(QByteArray(encoded.constData(), int(GeometryBinary::headerSize) - 1), &decoded));
+
+    GeometryBinary::putInt64(reinterpret_cast<uchar *>(corrupt.data()) + 16, std::numeric_limits<qint64>::max());
+    QVERIFY(!GeometryBinary::decode(corrupt, &decoded));
+    GeometryBinary::putInt64(reinterpret_cast<uchar *>(corrupt.data()) + 16, -1);
+    QVERIFY(!GeometryBinary::decode(corrupt, &decoded));
+
+    corrupt = GeometryBinary::encode(&index, 1);
+    corrupt[0] = 'X';
+    QVERIFY(!GeometryBinary::decode(corrupt, &index));
+}
+
+
+/*!
+ * \brief Arrays written to a device in chunks are read back; corrupt counts fail without allocating for them.
+ */
+void TestGeometryBinary::devicesRoundTrip()
+{
+    const qint64 nItems = 100000;
+    QTemporaryDir dir;
+    std::vector<Box3DT> boxes(nItems), decoded;
+    QFile file(dir.filePath("boxes.bin"));
+
+    for (qint64 i = 0; i < nItems; i++) boxes[size_t(i)].set(i, i * 0.5, 1e-300 * i, -i, i + 1, i + 2, i + 3, double(qint64(1) << 60) + i);
+
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    QVERIFY(GeometryBinary::write(&file, boxes.data(), nItems));
+    file.close();
+
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.size(), GeometryBinary::getEncodedSize<Box3DT>(nItems));
+    QVERIFY(GeometryBinary::read(&file, &decoded));
+    file.close();
+    QCOMPARE(qint64(decoded.size()), nItems);
+    QVERIFY(GeometryBinary::encode(decoded.data(), nItems) == GeometryBinary::encode(boxes.data(), nItems));
+
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QByteArray count(8, '\0');
+    GeometryBinary::putInt64(reinterpret_cast<uchar *>(count.data()), qint64(1) << 40);
+    QVERIFY(file.seek(16));
+    QVERIFY(file.write(count) == 8);
+    QVERIFY(file.seek(0));
+    QVERIFY(!GeometryBinary::read(&file, &decoded));
+    file.close();
+}
+
+
+/*!
+ * \brief Arrays whose encoding exceeds the QByteArray size limit encode to an empty array without reading items.
+ */
+void TestGeometryBinary::oversizedArraysAreNotEncoded()
+{
+    Box3DT box;
+
+    QVERIFY(GeometryBinary::encode(&box, qint64(1) << 40).isEmpty());
+    QVERIFY(GeometryBinary::encode(&box, (qint64(1) << 31) / Box3DT::binarySize).isEmpty());
+    QVERIFY(GeometryBinary::encode(&box, -1).isEmpty());
+    QCOMPARE(GeometryBinary::encode(&box, 1).size(), int(GeometryBinary::getEncodedSize<Box3DT>(1)));
+}
+
+
+QTEST_GUILESS_MAIN(TestGeometryBinary)
+
+#include "tst_geometrybinary.moc"
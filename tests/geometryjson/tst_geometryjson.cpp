@@ -0,0 +1,244 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file tst_geometryjson.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+#include <QFile>
+#include <QtTest>
+#include "Geometry/geometryjsonreader.h"
+#include "Geometry/geometryjsonwriter.h"
+
+
+/*!
+ * \brief Tests of streaming geometry JSON by GeometryJsonWriter and GeometryJsonReader.
+ */
+class TestGeometryJson : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void writtenRecordsRoundTrip();
+    void nonFiniteNumbersAreWrittenAsNull();
+    void readerStopsWhenFunctionReturnsFalse();
+    void malformedInputFails();
+};
+
+
+/*!
+ * \brief Writes bytes to a file.
+ */
+static bool tstGeometryJsonWriteFile(QString fileName, const QByteArray &bytes)
+{
+    QFile file(fileName);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    return file.write(bytes) == bytes.size();
+}
+
+
+/*!
+ * \brief Reads all records of a file.
+ */
+static bool tstGeometryJsonReadFile(QString fileName, qint64 bufferSize, std::vector<GeometryJsonRecord> *records, QString *errorString = nullptr)
+{
+    QFile file(fileName);
+    bool ok;
+
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    GeometryJsonReader reader(&file, bufferSize);
+    records->clear();
+    ok = reader.read([records](GeometryJsonRecord *record) {
+        records->push_back(*record);
+        return true;
+    });
+    if (errorString) *errorString = reader.errorString;
+    return ok;
+}
+
+
+/*!
+ * \brief Records of every kind, including nested arrays, are read back exactly for any reader buffer size.
+ *        Doubles keep all bits and indexes above 2^53 stay exact.
+ */
+void TestGeometryJson::writtenRecordsRoundTrip()
+{
+    const qint64 nPoints = 5000;
+    const qint64 big = (qint64(1) << 62) + 7;
+    QTemporaryDir dir;
+    QString fileName = dir.filePath("records.json");
+    std::vector<double> x(nPoints), y(nPoints), z(nPoints), t(nPoints);
+    Box3DT box;
+    Index3DT index(1, -2, 3, 4, big);
+    RasterSize3DT size(9, 8, 7, 6, 5);
+    Point2D point2D(0.1, -2.75);
+
+    for (qint64 i = 0; i < nPoints; i++)
+    {
+        x[size_t(i)] = double(i) * 0.1;
+        y[size_t(i)] = std::sqrt(double(i));
+        z[size_t(i)] = double(i);
+        t[size_t(i)] = 1e-300 * double(i) - 5e20;
+    }
+    box.set(1.5, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, double(qint64(1) << 60) + 1.0);
+
+    {
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        GeometryJsonWriter writer(&file, 1000);
+        QVERIFY(writer.beginArray());
+        QVERIFY(writer.writePoints(x.data(), y.data(), z.data(), t.data(), nPoints));
+        QVERIFY(writer.write(&box));
+        QVERIFY(writer.beginArray());
+        QVERIFY(writer.write(&index));
+        QVERIFY(writer.write(&size));
+        QVERIFY(writer.endArray());
+        QVERIFY(writer.write(&point2D));
+        QVERIFY(writer.endArray());
+        QVERIFY(writer.flush());
+        QVERIFY(writer.isValid());
+    }
+
+    for (qint64 bufferSize : { 256, 4096, 65536 })
+    {
+        std::vector<GeometryJsonRecord> records;
+        QVERIFY(tstGeometryJsonReadFile(fileName, bufferSize, &records));
+        QCOMPARE(qint64(records.size()), nPoints + 4);
+        for (qint64 i = 0; i < nPoints; i++)
+        {
+            GeometryJsonRecord *record = &records[size_t(i)];
+            QVERIFY(record->type == GeometryBinary::Point3DTType);
+            QCOMPARE(record->p0.x, x[size_t(i)]);
+            QCOMPARE(record->p0.y, y[size_t(i)]);
+            QCOMPARE(record->p0.z, z[size_t(i)]);
+            QCOMPARE(record->p0.t, t[size_t(i)]);
+        }
+
+        GeometryJsonRecord *record = &records[size_t(nPoints)];
+        QVERIFY(record->type == GeometryBinary::Box3DTType);
+        QCOMPARE(record->p0.x, 1.5);
+        QCOMPARE(record->p1.t, box.p1.t);
+
+        record = &records[size_t(nPoints + 1)];
+        QVERIFY(record->type == GeometryBinary::Index3DTType);
+        QCOMPARE(record->index.row, qint64(-2));
+        QCOMPARE(record->index.tick, big);
+
+        record = &records[size_t(nPoints + 2)];
+        QVERIFY(record->type == GeometryBinary::RasterSize3DTType);
+        QCOMPARE(record->size.nCols, qint64(9));
+        QCOMPARE(record->size.nTicks, qint64(5));
+
+        record = &records[size_t(nPoints + 3)];
+        QVERIFY(record->type == GeometryBinary::Point2DType);
+        QCOMPARE(record->p0.x, 0.1);
+        QCOMPARE(record->p0.y, -2.75);
+    }
+}
+
+
+/*!
+ * \brief Non-finite numbers are written as null, which the reader leaves as zero.
+ */
+void TestGeometryJson::nonFiniteNumbersAreWrittenAsNull()
+{
+    QTemporaryDir dir;
+    QString fileName = dir.filePath("null.json");
+    std::vector<GeometryJsonRecord> records;
+    Point3D point(std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::infinity(), 2.5);
+
+    {
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        GeometryJsonWriter writer(&file);
+        QVERIFY(writer.write(&point));
+        QVERIFY(writer.flush());
+    }
+
+    {
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        std::string text = file.readAll().toStdString();
+        QVERIFY(text.find("\"x\":null") != std::string::npos);
+        QVERIFY(text.find("\"y\":null") != std::string::npos);
+    }
+
+    QVERIFY(tstGeometryJsonReadFile(fileName, 256, &records));
+    QCOMPARE(qint64(records.size()), qint64(1));
+    QCOMPARE(records[0].p0.x, 0.0);
+    QCOMPARE(records[0].p0.y, 0.0);
+    QCOMPARE(records[0].p0.z, 2.5);
+}
+
+
+/*!
+ * \brief Reading stops at the record for which the function returns false; points are collected by readPoints().
+ */
+void TestGeometryJson::readerStopsWhenFunctionReturnsFalse()
+{
+    QTemporaryDir dir;
+    QString fileName = dir.filePath("points.json");
+    std::vector<double> x, y, z;
+    qint64 nRecords = 0;
+
+    QVERIFY(tstGeometryJsonWriteFile(fileName, "{\"data\": [{\"type\": \"Point3D\", \"z\": 3, \"x\": 1, \"y\": 2},"
+                                               " {\"type\": \"Index2D\", \"col\": 1, \"row\": 2, \"band\": 0},"
+                                               " {\"name\": \"other\", \"x\": 5},"
+                                               " {\"type\": \"Point2D\", \"x\": 4e-1, \"y\": -1.5E2, \"extra\": [true, null, \"s\"]}]}"));
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    GeometryJsonReader reader(&file);
+    QVERIFY(reader.read([&nRecords](GeometryJsonRecord *) { return ++nRecords < 2; }));
+    QCOMPARE(nRecords, qint64(2));
+    file.close();
+
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    GeometryJsonReader pointReader(&file);
+    QVERIFY(pointReader.readPoints(&x, &y, &z));
+    QCOMPARE(qint64(x.size()), qint64(2));
+    QCOMPARE(x[0], 1.0);
+    QCOMPARE(z[0], 3.0);
+    QCOMPARE(x[1], 0.4);
+    QCOMPARE(y[1], -150.0);
+    QCOMPARE(z[1], 0.0);
+}
+
+
+/*!
+ * \brief Truncated input, missing separators and too deep nesting fail with a message.
+ */
+void TestGeometryJson::malformedInputFails()
+{
+    QTemporaryDir dir;
+    QString fileName = dir.filePath("bad.json");
+    std::vector<GeometryJsonRecord> records;
+    QString errorString;
+
+    for (const char *text : { "[{\"type\": \"Point2D\", \"x\": 1, \"y\": 2}", "[{\"type\": \"Point2D\" \"x\": 1}]", "[1 2]", "{\"x\": 1,}", "[tru]" })
+    {
+        QVERIFY(tstGeometryJsonWriteFile(fileName, text));
+        QVERIFY(!tstGeometryJsonReadFile(fileName, 256, &records, &errorString));
+        QVERIFY(!errorString.isEmpty());
+    }
+
+    QVERIFY(tstGeometryJsonWriteFile(fileName, QByteArray(100000, '[')));
+    QVERIFY(!tstGeometryJsonReadFile(fileName, 256, &records, &errorString));
+    QVERIFY(!errorString.isEmpty());
+}
+
+
+QTEST_GUILESS_MAIN(TestGeometryJson)
+
+#include "tst_geometryjson.moc"
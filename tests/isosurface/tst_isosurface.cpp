@@ -0,0 +1,181 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file tst_isosurface.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <cmath>
+#include <map>
+#include <utility>
+#include <vector>
+#include <QtTest>
+#include "Raster/isosurface.h"
+
+
+/*!
+ * \brief Tests of isosurface extraction by IsoSurface.
+ */
+class TestIsoSurface : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void sphereIsClosedForAnyBrickSize();
+    void noDataCubesAreSkipped();
+    void isoValueOutsideRangeGivesEmptyMesh();
+    void verticesFollowExtent();
+};
+
+
+/*!
+ * \brief Fills a raster with distances of cell centres from a point near the raster centre.
+ */
+static std::vector<double> tstIsoSurfaceDistances(RasterSize3D *size)
+{
+    std::vector<double> cells(size_t(size->nCols * size->nRows * size->nLays));
+
+    for (qint64 lay = 0; lay < size->nLays; lay++)
+        for (qint64 row = 0; row < size->nRows; row++)
+            for (qint64 col = 0; col < size->nCols; col++)
+            {
+                double x = col - 14.3, y = row - 15.1, z = lay - 13.2;
+                cells[size_t(col + size->nCols * (row + size->nRows * lay))] = std::sqrt(x * x + y * y + z * z);
+            }
+    return cells;
+}
+
+
+/*!
+ * \brief Counts directed edges of a mesh without exactly one opposite edge and returns the enclosed volume.
+ */
+static qint64 tstIsoSurfaceOpenEdges(IsoSurface *iso, double *volume)
+{
+    std::map<std::pair<qint64, qint64>, int> edges;
+    qint64 nOpen = 0;
+
+    *volume = 0.0;
+    for (qint64 iTriangle = 0; iTriangle < iso->getNumberOfTriangles(); iTriangle++)
+    {
+        qint64 a = iso->triangles[size_t(3 * iTriangle)], b = iso->triangles[size_t(3 * iTriangle + 1)], c = iso->triangles[size_t(3 * iTriangle + 2)];
+        const double *p = &iso->vertices[size_t(3 * a)], *q = &iso->vertices[size_t(3 * b)], *r = &iso->vertices[size_t(3 * c)];
+        edges[std::make_pair(a, b)]++;
+        edges[std::make_pair(b, c)]++;
+        edges[std::make_pair(c, a)]++;
+        *volume += (p[0] * (q[1] * r[2] - q[2] * r[1]) - p[1] * (q[0] * r[2] - q[2] * r[0]) + p[2] * (q[0] * r[1] - q[1] * r[0])) / 6.0;
+    }
+    for (auto &edge : edges)
+        if ((edge.second != 1) || (edges.count(std::make_pair(edge.first.second, edge.first.first)) != 1)) nOpen++;
+    return nOpen;
+}
+
+
+/*!
+ * \brief A sphere is a closed, consistently oriented mesh of the expected volume, and bricks do not change it.
+ */
+void TestIsoSurface::sphereIsClosedForAnyBrickSize()
+{
+    RasterSize3D size(30, 33, 28, 1);
+    std::vector<double> cells = tstIsoSurfaceDistances(&size);
+    qint64 nVertices = -1, nTriangles = -1;
+
+    for (qint64 brickSize : { 1, 3, 7, 64 })
+    {
+        IsoSurface iso;
+        double volume;
+        iso.brickSize = brickSize;
+        iso.nThreads = 4;
+        QVERIFY(iso.setup(cells.data(), &size));
+        QVERIFY(iso.extract(9.0));
+
+        QCOMPARE(tstIsoSurfaceOpenEdges(&iso, &volume), qint64(0));
+        QVERIFY(std::fabs(volume - 4.0 / 3.0 * M_PI * 729.0) < 0.01 * volume);
+        for (qint64 index : iso.triangles)
+            QVERIFY((0 <= index) && (index < iso.getNumberOfVertices()));
+        if (nVertices < 0)
+        {
+            nVertices = iso.getNumberOfVertices();
+            nTriangles = iso.getNumberOfTriangles();
+        }
+        QCOMPARE(iso.getNumberOfVertices(), nVertices);
+        QCOMPARE(iso.getNumberOfTriangles(), nTriangles);
+    }
+}
+
+
+/*!
+ * \brief Cubes with a noData cell produce no triangles, which opens the surface around them.
+ */
+void TestIsoSurface::noDataCubesAreSkipped()
+{
+    RasterSize3D size(30, 33, 28, 1);
+    std::vector<double> cells = tstIsoSurfaceDistances(&size);
+    IsoSurface iso;
+    double volume;
+
+    cells[size_t(5 + size.nCols * (15 + size.nRows * 13))] = -1.0;
+    iso.brickSize = 7;
+    iso.useNoData = true;
+    iso.noData = -1.0;
+    QVERIFY(iso.setup(cells.data(), &size));
+    QVERIFY(iso.extract(9.0));
+
+    QVERIFY(0 < tstIsoSurfaceOpenEdges(&iso, &volume));
+    for (qint64 index : iso.triangles)
+        QVERIFY((0 <= index) && (index < iso.getNumberOfVertices()));
+}
+
+
+/*!
+ * \brief An isovalue outside the raster value range gives an empty mesh.
+ */
+void TestIsoSurface::isoValueOutsideRangeGivesEmptyMesh()
+{
+    RasterSize3D size(30, 33, 28, 1);
+    std::vector<double> cells = tstIsoSurfaceDistances(&size);
+    IsoSurface iso;
+
+    iso.brickSize = 7;
+    QVERIFY(iso.setup(cells.data(), &size));
+    QVERIFY(iso.extract(1000.0));
+    QCOMPARE(iso.getNumberOfVertices(), qint64(0));
+    QCOMPARE(iso.getNumberOfTriangles(), qint64(0));
+}
+
+
+/*!
+ * \brief With an extent, vertices are cell-centre coordinates of the extent instead of cell indexes.
+ */
+void TestIsoSurface::verticesFollowExtent()
+{
+    RasterSize3D size(30, 33, 28, 1);
+    std::vector<double> cells = tstIsoSurfaceDistances(&size);
+    IsoSurface indexed, scaled;
+
+    QVERIFY(indexed.setup(cells.data(), &size));
+    QVERIFY(indexed.extract(9.0));
+    scaled.extent.set(100.0, 200.0, -10.0, 0.0, 160.0, 233.0, 18.0, 1.0);
+    QVERIFY(scaled.setup(cells.data(), &size));
+    QVERIFY(scaled.extract(9.0));
+
+    QCOMPARE(scaled.getNumberOfVertices(), indexed.getNumberOfVertices());
+    QVERIFY(scaled.triangles == indexed.triangles);
+    for (qint64 iVertex = 0; iVertex < indexed.getNumberOfVertices(); iVertex++)
+    {
+        const double *v = &indexed.vertices[size_t(3 * iVertex)], *w = &scaled.vertices[size_t(3 * iVertex)];
+        QVERIFY(std::fabs(w[0] - (101.0 + 2.0 * v[0])) < 1e-9);
+        QVERIFY(std::fabs(w[1] - (200.5 + v[1])) < 1e-9);
+        QVERIFY(std::fabs(w[2] - (-9.5 + v[2])) < 1e-9);
+    }
+}
+
+
+QTEST_GUILESS_MAIN(TestIsoSurface)
+
+#include "tst_isosurface.moc"
@@ -0,0 +1,182 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file tst_pointbinner.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <vector>
+#include <QtTest>
+#include "Raster/pointbinner.h"
+
+
+/*!
+ * \brief Tests of point binning by PointBinner.
+ */
+class TestPointBinner : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void statisticsMatchBruteForce();
+    void pointsOutsideExtentAreRejected();
+    void zCoordinatesAreBinnedWithoutValues();
+};
+
+
+/*!
+ * \brief Generates points partly outside the extent [0, 10] with unique t-coordinates and integer values,
+ *        so that every strategy must give exactly the same statistics.
+ */
+static void tstPointBinnerPoints(qint64 nPoints, std::vector<double> *x, std::vector<double> *y, std::vector<double> *z,
+                                 std::vector<double> *t, std::vector<double> *values)
+{
+    x->resize(size_t(nPoints));
+    y->resize(size_t(nPoints));
+    z->resize(size_t(nPoints));
+    t->resize(size_t(nPoints));
+    values->resize(size_t(nPoints));
+    for (qint64 i = 0; i < nPoints; i++)
+    {
+        (*x)[size_t(i)] = double(i * 7 % 1201) / 100.0 - 1.0;
+        (*y)[size_t(i)] = double(i * 11 % 1103) / 100.0 - 0.5;
+        (*z)[size_t(i)] = double(i * 13 % 997) / 100.0;
+        (*t)[size_t(i)] = double(nPoints - i) * 10.0 / double(nPoints);
+        (*values)[size_t(i)] = double(i % 13 - 6);
+    }
+}
+
+
+/*!
+ * \brief All statistics of both strategies and any number of threads equal a brute-force reference.
+ */
+void TestPointBinner::statisticsMatchBruteForce()
+{
+    const qint64 nPoints = 100000;
+    const double noData = -9999.0;
+    std::vector<double> x, y, z, t, values;
+    Box3DT extent;
+    RasterSize3DT size(17, 13, 3, 1, 2);
+
+    tstPointBinnerPoints(nPoints, &x, &y, &z, &t, &values);
+    extent.set(0, 0, 0, 0, 10, 10, 10, 10);
+
+    PointBinner reference;
+    QVERIFY(reference.setup(&extent, &size, PointBinner::StatCount));
+    qint64 nCells = reference.getNumberOfCells();
+    std::vector<double> counts(size_t(nCells), 0.0), sums(size_t(nCells), 0.0), mins(size_t(nCells), noData),
+            maxs(size_t(nCells), noData), lasts(size_t(nCells), noData), lastTimes(size_t(nCells), -1.0);
+    for (qint64 i = 0; i < nPoints; i++)
+    {
+        qint64 iCell = reference.getCellIndex(x[size_t(i)], y[size_t(i)], z[size_t(i)], t[size_t(i)]);
+        double value = values[size_t(i)];
+        if (iCell < 0) continue;
+        if (counts[size_t(iCell)] == 0.0) mins[size_t(iCell)] = maxs[size_t(iCell)] = value;
+        counts[size_t(iCell)] += 1.0;
+        sums[size_t(iCell)] += value;
+        mins[size_t(iCell)] = qMin(mins[size_t(iCell)], value);
+        maxs[size_t(iCell)] = qMax(maxs[size_t(iCell)], value);
+        if (lastTimes[size_t(iCell)] < t[size_t(i)])
+        {
+            lastTimes[size_t(iCell)] = t[size_t(i)];
+            lasts[size_t(iCell)] = value;
+        }
+    }
+
+    for (PointBinner::Strategy strategy : { PointBinner::StrategyPrivateGrids, PointBinner::StrategyPartitioned })
+        for (int nThreads : { 1, 4 })
+        {
+            PointBinner binner;
+            std::vector<double> raster(counts.size());
+            binner.strategy = strategy;
+            binner.nThreads = nThreads;
+            binner.memoryBudget = 100000;
+            QVERIFY(binner.setup(&extent, &size, PointBinner::StatAll));
+            QVERIFY(binner.add(x.data(), y.data(), z.data(), t.data(), values.data(), nPoints / 3));
+            QVERIFY(binner.add(x.data() + nPoints / 3, y.data() + nPoints / 3, z.data() + nPoints / 3, t.data() + nPoints / 3,
+                               values.data() + nPoints / 3, nPoints - nPoints / 3));
+
+            QVERIFY(binner.getStatistic(PointBinner::StatCount, raster.data(), noData));
+            QVERIFY(raster == counts);
+            QVERIFY(binner.getStatistic(PointBinner::StatSum, raster.data(), noData));
+            for (qint64 i = 0; i < nCells; i++)
+                if (counts[size_t(i)] == 0.0) QCOMPARE(raster[size_t(i)], noData);
+                else QCOMPARE(raster[size_t(i)], sums[size_t(i)]);
+            QVERIFY(binner.getStatistic(PointBinner::StatMin, raster.data(), noData));
+            QVERIFY(raster == mins);
+            QVERIFY(binner.getStatistic(PointBinner::StatMax, raster.data(), noData));
+            QVERIFY(raster == maxs);
+            QVERIFY(binner.getStatistic(PointBinner::StatLast, raster.data(), noData));
+            QVERIFY(raster == lasts);
+            QVERIFY(binner.getStatistic(PointBinner::StatMean, raster.data(), noData));
+            for (qint64 i = 0; i < nCells; i++)
+                if (counts[size_t(i)] == 0.0) QCOMPARE(raster[size_t(i)], noData);
+                else QCOMPARE(raster[size_t(i)], sums[size_t(i)] / counts[size_t(i)]);
+        }
+}
+
+
+/*!
+ * \brief Points outside the extent are counted as rejected; points on the upper boundary belong to the last cell.
+ */
+void TestPointBinner::pointsOutsideExtentAreRejected()
+{
+    double x[] = { 0.0, 10.0, -0.1, 5.0, 10.1, 5.0 };
+    double y[] = { 0.0, 10.0, 5.0, 5.0, 5.0, 5.0 };
+    double z[] = { 0.0, 10.0, 5.0, 5.0, 5.0, 11.0 };
+    double t[] = { 0.0, 10.0, 5.0, 5.0, 5.0, 5.0 };
+    Box3DT extent;
+    RasterSize3DT size(4, 4, 2, 1, 1);
+    PointBinner binner;
+
+    extent.set(0, 0, 0, 0, 10, 10, 10, 10);
+    QVERIFY(binner.setup(&extent, &size, PointBinner::StatCount));
+    QCOMPARE(binner.getCellIndex(10.0, 10.0, 10.0, 10.0), binner.getNumberOfCells() - 1);
+    QCOMPARE(binner.getCellIndex(-0.1, 5.0, 5.0, 5.0), qint64(-1));
+
+    QVERIFY(binner.add(x, y, z, t, nullptr, 6));
+    QCOMPARE(binner.numberOfBinnedPoints, qint64(3));
+    QCOMPARE(binner.numberOfRejectedPoints, qint64(3));
+    QCOMPARE(binner.counts[0], qint64(1));
+    QCOMPARE(binner.counts[size_t(binner.getNumberOfCells() - 1)], qint64(1));
+
+    binner.clear();
+    QCOMPARE(binner.counts[0], qint64(0));
+}
+
+
+/*!
+ * \brief Without values, z-coordinates of points are binned.
+ */
+void TestPointBinner::zCoordinatesAreBinnedWithoutValues()
+{
+    std::vector<Point3DT> points(4);
+    Box3DT extent;
+    RasterSize3DT size(1, 1, 1, 1, 1);
+    PointBinner binner;
+    double raster;
+
+    points[0].set(1, 1, 2, 1);
+    points[1].set(2, 2, 4, 2);
+    points[2].set(3, 3, 6, 3);
+    points[3].set(4, 4, 8, 0);
+    extent.set(0, 0, 0, 0, 10, 10, 10, 10);
+    QVERIFY(binner.setup(&extent, &size, PointBinner::StatAll));
+    QVERIFY(binner.add(points.data(), 4));
+
+    QVERIFY(binner.getStatistic(PointBinner::StatMean, &raster, -1.0));
+    QCOMPARE(raster, 5.0);
+    QVERIFY(binner.getStatistic(PointBinner::StatLast, &raster, -1.0));
+    QCOMPARE(raster, 6.0);
+}
+
+
+QTEST_GUILESS_MAIN(TestPointBinner)
+
+#include "tst_pointbinner.moc"
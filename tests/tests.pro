@@ -0,0 +1,12 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    brickstore \
+    cancel \
+    checkpoint \
+    executor \
+    geometrybinary \
+    geometryjson \
+    isosurface \
+    pointbinner \
+    voxelfilter
@@ -0,0 +1,184 @@
+/*!
+ * *****************************************************************
+ *                             G3DTCore
+ * *****************************************************************
+ * \file tst_voxelfilter.cpp
+ *
+ * \author M. Koren, milan.koren3@gmail.com
+ * Source: https://github.com/milan-koren/G3DTCore
+ * Licence: EUPL v. 1.2
+ * https://joinup.ec.europa.eu/collection/eupl
+ * *****************************************************************
+ */
+
+#include <cmath>
+#include <limits>
+#include <map>
+#include <random>
+#include <tuple>
+#include <vector>
+#include <QtTest>
+#include "Raster/voxelfilter.h"
+
+
+/*!
+ * \brief Tests of point cloud decimation by VoxelFilter.
+ */
+class TestVoxelFilter : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void representativesMatchBruteForce();
+    void nonFinitePointsAreSkipped();
+    void invalidVoxelSizeFails();
+};
+
+
+/*!
+ * \brief Voxels, counts, extents and representatives of every kind equal a brute-force grouping of points
+ *        ordered by layer, row and column. Points keep their input order within voxels.
+ */
+void TestVoxelFilter::representativesMatchBruteForce()
+{
+    const qint64 nPoints = 50000;
+    const double voxelSize = 2.5;
+    std::mt19937_64 random(7);
+    std::uniform_real_distribution<double> uniform(0.0, 50.0);
+    std::vector<Point3DT> points(nPoints);
+    std::vector<double> x(nPoints), y(nPoints), z(nPoints), t(nPoints);
+
+    for (qint64 i = 0; i < nPoints; i++)
+    {
+        x[size_t(i)] = uniform(random);
+        y[size_t(i)] = uniform(random);
+        z[size_t(i)] = uniform(random) / 5.0;
+        t[size_t(i)] = double(i % 1009) + double(i) / double(nPoints);
+        points[size_t(i)].set(x[size_t(i)], y[size_t(i)], z[size_t(i)], t[size_t(i)]);
+    }
+
+    for (VoxelFilter::Representative representative :
+         { VoxelFilter::RepresentativeCentroid, VoxelFilter::RepresentativeNearestToCentroid, VoxelFilter::RepresentativeLatest })
+    {
+        VoxelFilter filter;
+        filter.setVoxelSize(voxelSize);
+        filter.representative = representative;
+        filter.nThreads = 4;
+        if (representative == VoxelFilter::RepresentativeLatest) QVERIFY(filter.filter(x.data(), y.data(), z.data(), t.data(), nPoints));
+        else QVERIFY(filter.filter(points.data(), nPoints));
+
+        std::map<std::tuple<qint64, qint64, qint64>, std::vector<qint64>> groups;
+        for (qint64 i = 0; i < nPoints; i++)
+            groups[std::make_tuple(qint64((z[size_t(i)] - filter.extent.p0.z) / voxelSize), qint64((y[size_t(i)] - filter.extent.p0.y) / voxelSize),
+                                   qint64((x[size_t(i)] - filter.extent.p0.x) / voxelSize))].push_back(i);
+        QCOMPARE(filter.getNumberOfVoxels(), qint64(groups.size()));
+
+        size_t iVoxel = 0;
+        for (auto &group : groups)
+        {
+            const std::vector<qint64> &members = group.second;
+            double cx = 0.0, cy = 0.0, cz = 0.0, ct = 0.0, best = -1.0;
+            qint64 iBest = members[0];
+            Box3DT box;
+
+            QCOMPARE(filter.voxels[iVoxel].lay, std::get<0>(group.first));
+            QCOMPARE(filter.voxels[iVoxel].row, std::get<1>(group.first));
+            QCOMPARE(filter.voxels[iVoxel].col, std::get<2>(group.first));
+            QCOMPARE(filter.counts[iVoxel], qint64(members.size()));
+
+            box.empty();
+            for (qint64 i : members)
+            {
+                box.include(x[size_t(i)], y[size_t(i)], z[size_t(i)], t[size_t(i)]);
+                cx += x[size_t(i)];
+                cy += y[size_t(i)];
+                cz += z[size_t(i)];
+                ct += t[size_t(i)];
+            }
+            cx /= double(members.size());
+            cy /= double(members.size());
+            cz /= double(members.size());
+            ct /= double(members.size());
+            QCOMPARE(filter.extents[iVoxel].p0.x, box.p0.x);
+            QCOMPARE(filter.extents[iVoxel].p1.t, box.p1.t);
+
+            if (representative == VoxelFilter::RepresentativeCentroid)
+            {
+                QCOMPARE(filter.points[iVoxel].x, cx);
+                QCOMPARE(filter.points[iVoxel].y, cy);
+                QCOMPARE(filter.points[iVoxel].z, cz);
+                QCOMPARE(filter.points[iVoxel].t, ct);
+            }
+            else
+            {
+                for (qint64 i : members)
+                {
+                    double dx = x[size_t(i)] - cx, dy = y[size_t(i)] - cy, dz = z[size_t(i)] - cz;
+                    double distance = dx * dx + dy * dy + dz * dz;
+                    if ((representative == VoxelFilter::RepresentativeLatest) ? (t[size_t(iBest)] < t[size_t(i)]) : ((best < 0.0) || (distance < best)))
+                    {
+                        best = distance;
+                        iBest = i;
+                    }
+                }
+                QCOMPARE(filter.points[iVoxel].x, x[size_t(iBest)]);
+                QCOMPARE(filter.points[iVoxel].t, t[size_t(iBest)]);
+            }
+            iVoxel++;
+        }
+    }
+}
+
+
+/*!
+ * \brief Points with a non-finite coordinate neither count nor widen the extent.
+ */
+void TestVoxelFilter::nonFinitePointsAreSkipped()
+{
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double inf = std::numeric_limits<double>::infinity();
+    std::vector<Point3DT> points(5);
+    VoxelFilter filter;
+
+    points[0].set(0.5, 0.5, 0.5, 1.0);
+    points[1].set(nan, 0.5, 0.5, 1.0);
+    points[2].set(1.5, 0.5, 0.5, 2.0);
+    points[3].set(0.5, inf, 0.5, 1.0);
+    points[4].set(0.5, 0.5, 0.5, nan);
+    filter.setVoxelSize(1.0);
+
+    QVERIFY(filter.filter(points.data(), 5));
+    QCOMPARE(filter.getNumberOfVoxels(), qint64(2));
+    QCOMPARE(filter.counts[0] + filter.counts[1], qint64(2));
+    QCOMPARE(filter.extent.p1.x, 1.5);
+    QCOMPARE(filter.extent.p1.y, 0.5);
+}
+
+
+/*!
+ * \brief Non-positive and non-finite voxel sizes fail with a message and no voxels.
+ */
+void TestVoxelFilter::invalidVoxelSizeFails()
+{
+    Point3DT point;
+    VoxelFilter filter;
+
+    point.set(1.0, 2.0, 3.0, 4.0);
+    filter.setVoxelSize(0.0);
+    QVERIFY(!filter.filter(&point, 1));
+    QVERIFY(!filter.errorString.isEmpty());
+    QCOMPARE(filter.getNumberOfVoxels(), qint64(0));
+
+    filter.setVoxelSize(1.0, std::numeric_limits<double>::infinity(), 1.0);
+    QVERIFY(!filter.filter(&point, 1));
+
+    filter.setVoxelSize(1.0);
+    QVERIFY(filter.filter(&point, 1));
+    QVERIFY(filter.errorString.isEmpty());
+    QCOMPARE(filter.getNumberOfVoxels(), qint64(1));
+}
+
+
+QTEST_GUILESS_MAIN(TestVoxelFilter)
+
+#include "tst_voxelfilter.moc"